@@ -0,0 +1,517 @@
+// avxfloat.hpp
+
+/*
+    Header only C++ front end: avxfloat<Prec> values, and expression templates that fuse chains of additions.
+
+    a + b + c + d on avxfloat<Prec> values builds an expression rather than computing three rounded sums. Assigning
+    the expression evaluates it in one pass: every operand is padded into L lanes of 63 bits (enough for Prec bits plus
+    one guard lane), shifted down to the largest exponent and added into an accumulator kept in carry save form, so no
+    carry ripples across the lanes until the very end. The lanes live in ceil(L / 8) zmm registers from the first
+    operand to the rounding: each operand is packed and shifted in them straight from its mpfr limbs, and the
+    accumulator only goes through memory once, unpacked into limbs for the rounding. The sum is normalised once and
+    rounded once, with the rounding mode of the assignment.
+
+    The same operators work element wise on std::vector<avxfloat<Prec>> (found by argument dependent lookup), and
+    avx::assign(dst, v1 + v2 + v3) runs a single loop over the elements without any temporary vectors. Scalars in a
+    vector expression are broadcast to every element.
+
+    comparison_avxfloat measures a + b + c + e at 1.0 to 1.7x the speed of three mpfr_add() calls for 64 to 1024 bits,
+    the least at 64 bits where mpfr_add() itself is cheapest.
+
+    The fused sums are correctly rounded, except that the bits shifted out below the guard lane only survive as a
+    sticky bit: a sum within n units of the guard lane of a rounding boundary (62 equal bits right after the rounding
+    bit) may round the other way. Expressions mixing signs, and NaN or infinite operands, are evaluated left to right
+    with mpfr_add() / mpfr_sub(), rounding every step like the equivalent chain of MPFR calls.
+
+    Expressions only hold references to their operands: evaluate them in the statement that builds them rather than
+    keeping them in auto variables.
+*/
+
+#ifndef AVXFLOAT_HPP
+#define AVXFLOAT_HPP
+
+#include "avxmpfr_utilities.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace avx
+{
+
+template <mpfr_prec_t Prec> class avxfloat;
+
+namespace detail
+{
+
+// GCC 12 warns about the _mm512_undefined_epi32() inside its own AVX512 intrinsics when they are inlined into C++
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Padded lanes of the accumulator for precision Prec, the last one is the guard lane
+template <mpfr_prec_t Prec>
+constexpr int lanes()
+{
+    return (Prec + 62) / 63 + 1;
+}
+
+// Registers of 8 padded lanes holding the L lanes of precision Prec, lane k in element k % 8 of register k / 8
+template <mpfr_prec_t Prec>
+constexpr int registers()
+{
+    return (lanes<Prec>() + 7) / 8;
+}
+
+// Round the fused sum d * 2^(exp - 64 L) into the Prec bits of rop, d holding L + 1 limbs. What avxmpfr_round_limbs()
+// does, specialised: the leading bit is at the top of limb L - 1, or in the carries in limb L, so the mantissa is a
+// shift of the top limbs by the bits in limb L. The sum is at least its biggest term, and MPFR takes its inputs to be
+// within the exponent range, so only a sum whose exponent grew past exp can leave it
+template <mpfr_prec_t Prec>
+inline void round_sum(mpfr_ptr rop, int sign, const mp_limb_t *d, mpfr_exp_t exp, mpfr_rnd_t rnd)
+{
+    constexpr int L = lanes<Prec>();
+    constexpr mp_size_t n = (Prec + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    constexpr int unused = n * GMP_NUMB_BITS - Prec;
+    constexpr int base = L - n;		// At least 1, the guard lane
+    mp_limb_t *m = rop->_mpfr_d;
+
+    const int shift = d[L] ? GMP_NUMB_BITS - __builtin_clzl(d[L]) : 0;
+    for (int i = 0; i < n; i++)
+	m[i] = (d[base + i] >> shift) | ((d[base + i + 1] << 1) << (GMP_NUMB_BITS - 1 - shift));
+
+    // below holds the 64 bits under m[0], rest whether anything under those is set
+    const mp_limb_t below = ((d[base] << 1) << (GMP_NUMB_BITS - 1 - shift)) | (d[base - 1] >> shift);
+    int rest = ((d[base - 1] << 1) << (GMP_NUMB_BITS - 1 - shift)) != 0;
+    for (int i = 0; i < base - 1; i++)
+	rest |= d[i] != 0;
+
+    int round_bit, sticky;
+    if (unused > 0)
+    {
+	round_bit = (m[0] >> (unused - 1)) & 1;
+	sticky = (m[0] & ((((mp_limb_t) 1) << (unused - 1)) - 1)) != 0 || below != 0 || rest;
+    }
+    else
+    {
+	round_bit = below >> (GMP_NUMB_BITS - 1);
+	sticky = (below << 1) != 0 || rest;
+    }
+    const mp_limb_t ulp = ((mp_limb_t) 1) << unused;
+    m[0] &= ~(ulp - 1);
+
+    mpfr_exp_t rop_exp = exp + shift;
+    int ternary = 0;
+    if (round_bit || sticky)
+    {
+	const int up = avxmpfr_round_up_p(sign, (m[0] & ulp) != 0, round_bit, sticky, rnd);
+	if (up && mpn_add_1(m, m, n, ulp))
+	{
+	    m[n - 1] = ((mp_limb_t) 1) << (GMP_NUMB_BITS - 1);
+	    rop_exp++;
+	}
+	ternary = up ? sign : -sign;
+    }
+
+    rop->_mpfr_sign = sign;
+    rop->_mpfr_exp = rop_exp;
+    if (rop_exp > exp && rop_exp > mpfr_get_emax())
+	mpfr_check_range(rop, ternary, rnd);
+}
+
+// Sum n regular Prec bit operands of the same sign into rop, normalising and rounding once. The accumulator stays in
+// V registers from the first operand to the rounding
+template <mpfr_prec_t Prec>
+inline void fused_sum(mpfr_ptr rop, const mpfr_srcptr *ops, int n, int sign, mpfr_rnd_t rnd)
+{
+    constexpr int L = lanes<Prec>();
+    constexpr int V = registers<Prec>();
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    __m512i acc[V];
+    __m512i carry[V + 1];
+    __m512i top = _mm512_setzero_si512();	// Carries out of lane 0, in element 0
+    int sticky = 0;
+
+    for (int v = 0; v < V; v++)
+	acc[v] = _mm512_setzero_si512();
+    carry[V] = _mm512_setzero_si512();
+
+    mpfr_exp_t exp = MPFR_EXP_MIN;
+    for (int k = 0; k < n; k++)
+    {
+	if (!mpfr_zero_p(ops[k]) && ops[k]->_mpfr_exp > exp)
+	    exp = ops[k]->_mpfr_exp;
+    }
+
+    for (int k = 0; k < n; k++)
+    {
+	if (mpfr_zero_p(ops[k]))
+	    continue;
+
+	__m512i term[V];
+	const mpfr_exp_t gap = exp - ops[k]->_mpfr_exp;
+	sticky |= avxmpfr_pack_shifted(term, L, ops[k], (Prec + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS, gap);
+
+	// Carry save: each lane keeps at most 2^63 after this step, so the next term cannot overflow it
+	for (int v = 0; v < V; v++)
+	{
+	    acc[v] = _mm512_add_epi64(acc[v], term[v]);
+	    carry[v] = _mm512_srli_epi64(acc[v], 63);
+	    acc[v] = _mm512_and_si512(acc[v], mask);
+	}
+	top = _mm512_add_epi64(top, carry[0]);
+	for (int v = 0; v < V; v++)
+	    acc[v] = _mm512_add_epi64(acc[v], _mm512_alignr_epi64(carry[v + 1], carry[v], 1));
+    }
+
+    // Let the carries ripple through, as in add_limbs_avx512()
+    for (;;)
+    {
+	__mmask8 any = 0;
+	for (int v = 0; v < V; v++)
+	{
+	    carry[v] = _mm512_srli_epi64(acc[v], 63);
+	    acc[v] = _mm512_and_si512(acc[v], mask);
+	    any |= _mm512_test_epi64_mask(carry[v], carry[v]);
+	}
+	if (any == 0)
+	    break;
+	top = _mm512_add_epi64(top, carry[0]);
+	for (int v = 0; v < V; v++)
+	    acc[v] = _mm512_add_epi64(acc[v], _mm512_alignr_epi64(carry[v + 1], carry[v], 1));
+    }
+
+    // The L lanes unpack to L limbs holding the sum times 2^(64 L - exp), the carries out of lane 0 go on top.
+    // Limb L - 1 - k takes lane k and the top bits of lane k + 1, stored reversed 8 at a time (see
+    // avxmpfr_unpack_lanes()), with 8 limbs of room below d for the last partial register
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i reverse = _mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    mp_limb_t limbs[8 + L + 1];
+    mp_limb_t *d = limbs + 8;
+    for (int v = 0; v < V; v++)
+    {
+	const __m512i k = _mm512_add_epi64(lane, _mm512_set1_epi64(8 * v));
+	const __m512i following = _mm512_alignr_epi64(v + 1 < V ? acc[v + 1] : _mm512_setzero_si512(), acc[v], 1);
+	const __m512i limb = _mm512_or_si512(_mm512_sllv_epi64(acc[v], _mm512_add_epi64(k, _mm512_set1_epi64(1))),
+					     _mm512_srlv_epi64(following, _mm512_sub_epi64(_mm512_set1_epi64(62), k)));
+	_mm512_storeu_si512((void *) (d + L - 8 - 8 * v), _mm512_permutexvar_epi64(reverse, limb));
+    }
+    d[L] = _mm_cvtsi128_si64(_mm512_castsi512_si128(top));
+    d[0] |= sticky;		// Below the lowest lane bit, it only matters to the rounding
+    round_sum<Prec>(rop, sign, d, exp, rnd);
+}
+
+// Evaluate left to right with MPFR, rounding every step
+template <mpfr_prec_t Prec>
+inline void chained_sum(mpfr_ptr rop, const mpfr_srcptr *ops, const int *signs, int n, mpfr_rnd_t rnd)
+{
+    mpfr_t sum;
+    mpfr_init2(sum, Prec);
+
+    if (signs[0] > 0)
+	mpfr_set(sum, ops[0], rnd);
+    else
+	mpfr_neg(sum, ops[0], rnd);
+
+    for (int k = 1; k < n; k++)
+    {
+	if (signs[k] > 0)
+	    mpfr_add(sum, sum, ops[k], rnd);
+	else
+	    mpfr_sub(sum, sum, ops[k], rnd);
+    }
+
+    mpfr_swap(rop, sum);
+    mpfr_clear(sum);
+}
+
+// Sum of signs[k] * ops[k] into rop, ops may include rop itself
+template <mpfr_prec_t Prec>
+inline void evaluate(mpfr_ptr rop, const mpfr_srcptr *ops, const int *signs, int n, mpfr_rnd_t rnd)
+{
+    int sign = 0;
+
+    for (int k = 0; k < n; k++)
+    {
+	if (mpfr_zero_p(ops[k]))
+	    continue;
+
+	const int term_sign = mpfr_signbit(ops[k]) ? -signs[k] : signs[k];
+	if (!mpfr_regular_p(ops[k]) || (sign != 0 && term_sign != sign))
+	{
+	    chained_sum<Prec>(rop, ops, signs, n, rnd);
+	    return;
+	}
+	sign = term_sign;
+    }
+
+    // Only zeros, their signs follow the MPFR rules
+    if (sign == 0)
+	chained_sum<Prec>(rop, ops, signs, n, rnd);
+    else
+	fused_sum<Prec>(rop, ops, n, sign, rnd);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+} // namespace detail
+
+
+/*
+    Expressions. Every operand type provides
+	precision	the precision of every value it refers to
+	terms		the number of values summed
+	is_vector	true if it refers to std::vector operands
+	size()		the number of elements (0 for scalars)
+	collect()	the values and signs of element i
+*/
+
+template <mpfr_prec_t Prec>
+struct scalar_ref
+{
+    static constexpr mpfr_prec_t precision = Prec;
+    static constexpr int terms = 1;
+    static constexpr bool is_vector = false;
+
+    const avxfloat<Prec> *value;
+
+    std::size_t size() const { return 0; }
+    void collect(std::size_t, mpfr_srcptr *ops, int *signs, int sign) const
+    {
+	*ops = value->get();
+	*signs = sign;
+    }
+};
+
+template <mpfr_prec_t Prec>
+struct vector_ref
+{
+    static constexpr mpfr_prec_t precision = Prec;
+    static constexpr int terms = 1;
+    static constexpr bool is_vector = true;
+
+    const std::vector<avxfloat<Prec>> *values;
+
+    std::size_t size() const { return values->size(); }
+    void collect(std::size_t i, mpfr_srcptr *ops, int *signs, int sign) const
+    {
+	*ops = (*values)[i].get();
+	*signs = sign;
+    }
+};
+
+// a + b (Sign 1) or a - b (Sign -1)
+template <class A, class B, int Sign>
+struct sum_expr
+{
+    static_assert(A::precision == B::precision, "the operands of an expression must share their precision");
+
+    static constexpr mpfr_prec_t precision = A::precision;
+    static constexpr int terms = A::terms + B::terms;
+    static constexpr bool is_vector = A::is_vector || B::is_vector;
+
+    A a;
+    B b;
+
+    // Vectors of different lengths are cut to the shortest
+    std::size_t size() const
+    {
+	if (a.size() == 0 || b.size() == 0)
+	    return a.size() + b.size();
+	return a.size() < b.size() ? a.size() : b.size();
+    }
+
+    void collect(std::size_t i, mpfr_srcptr *ops, int *signs, int sign) const
+    {
+	a.collect(i, ops, signs, sign);
+	b.collect(i, ops + A::terms, signs + A::terms, sign * Sign);
+    }
+};
+
+// What each type becomes inside an expression
+template <class T>
+struct operand
+{
+    static constexpr bool value = false;
+};
+
+template <mpfr_prec_t Prec>
+struct operand<avxfloat<Prec>>
+{
+    static constexpr bool value = true;
+    typedef scalar_ref<Prec> type;
+    static type wrap(const avxfloat<Prec> &x) { return type{&x}; }
+};
+
+template <mpfr_prec_t Prec>
+struct operand<std::vector<avxfloat<Prec>>>
+{
+    static constexpr bool value = true;
+    typedef vector_ref<Prec> type;
+    static type wrap(const std::vector<avxfloat<Prec>> &x) { return type{&x}; }
+};
+
+template <class A, class B, int Sign>
+struct operand<sum_expr<A, B, Sign>>
+{
+    static constexpr bool value = true;
+    typedef sum_expr<A, B, Sign> type;
+    static const type &wrap(const type &x) { return x; }
+};
+
+template <class T>
+struct is_expression : std::false_type {};
+
+template <class A, class B, int Sign>
+struct is_expression<sum_expr<A, B, Sign>> : std::true_type {};
+
+template <class A, class B, int Sign>
+using sum_t = typename std::enable_if<operand<A>::value && operand<B>::value,
+				      sum_expr<typename operand<A>::type, typename operand<B>::type, Sign>>::type;
+
+template <class A, class B>
+inline sum_t<A, B, 1> operator+(const A &a, const B &b)
+{
+    return sum_t<A, B, 1>{operand<A>::wrap(a), operand<B>::wrap(b)};
+}
+
+template <class A, class B>
+inline sum_t<A, B, -1> operator-(const A &a, const B &b)
+{
+    return sum_t<A, B, -1>{operand<A>::wrap(a), operand<B>::wrap(b)};
+}
+
+
+template <mpfr_prec_t Prec>
+class avxfloat
+{
+    static_assert(Prec >= MPFR_PREC_MIN && detail::lanes<Prec>() <= 63, "avxfloat holds 1 to 3906 bits");
+
+public:
+    static constexpr mpfr_prec_t precision = Prec;
+
+    avxfloat()
+    {
+	mpfr_init2(value, Prec);
+	mpfr_set_zero(value, 1);
+    }
+
+    avxfloat(double x, mpfr_rnd_t rnd = MPFR_RNDN)
+    {
+	mpfr_init2(value, Prec);
+	mpfr_set_d(value, x, rnd);
+    }
+
+    explicit avxfloat(const char *str, int base = 10, mpfr_rnd_t rnd = MPFR_RNDN)
+    {
+	mpfr_init2(value, Prec);
+	mpfr_set_str(value, str, base, rnd);
+    }
+
+    avxfloat(const avxfloat &other)
+    {
+	mpfr_init2(value, Prec);
+	mpfr_set(value, other.value, MPFR_RNDN);
+    }
+
+    avxfloat(avxfloat &&other) noexcept
+    {
+	mpfr_init2(value, Prec);
+	mpfr_swap(value, other.value);
+    }
+
+    template <class E, class = typename std::enable_if<is_expression<E>::value>::type>
+    avxfloat(const E &e, mpfr_rnd_t rnd = MPFR_RNDN)
+    {
+	mpfr_init2(value, Prec);
+	assign(e, rnd);
+    }
+
+    ~avxfloat()
+    {
+	mpfr_clear(value);
+    }
+
+    avxfloat &operator=(const avxfloat &other)
+    {
+	mpfr_set(value, other.value, MPFR_RNDN);
+	return *this;
+    }
+
+    avxfloat &operator=(avxfloat &&other) noexcept
+    {
+	mpfr_swap(value, other.value);
+	return *this;
+    }
+
+    template <class E, class = typename std::enable_if<is_expression<E>::value>::type>
+    avxfloat &operator=(const E &e)
+    {
+	assign(e, MPFR_RNDN);
+	return *this;
+    }
+
+    template <class E>
+    avxfloat &operator+=(const E &e)
+    {
+	assign(*this + e, MPFR_RNDN);
+	return *this;
+    }
+
+    template <class E>
+    avxfloat &operator-=(const E &e)
+    {
+	assign(*this - e, MPFR_RNDN);
+	return *this;
+    }
+
+    // Evaluate the scalar expression e into this value, rounded once with rnd
+    template <class E>
+    void assign(const E &e, mpfr_rnd_t rnd)
+    {
+	typedef typename operand<E>::type expr;
+	static_assert(expr::precision == Prec, "the expression has a different precision");
+	static_assert(!expr::is_vector, "vector expressions are evaluated with avx::assign()");
+
+	mpfr_srcptr ops[expr::terms];
+	int signs[expr::terms];
+	operand<E>::wrap(e).collect(0, ops, signs, 1);
+	detail::evaluate<Prec>(value, ops, signs, expr::terms, rnd);
+    }
+
+    mpfr_ptr get() { return value; }
+    mpfr_srcptr get() const { return value; }
+
+private:
+    mpfr_t value;
+};
+
+
+// Evaluate e element by element into dst in a single loop, resizing dst to the length of the vector operands
+template <mpfr_prec_t Prec, class E>
+inline typename std::enable_if<operand<E>::value>::type
+assign(std::vector<avxfloat<Prec>> &dst, const E &e, mpfr_rnd_t rnd = MPFR_RNDN)
+{
+    typedef typename operand<E>::type expr;
+    static_assert(expr::precision == Prec, "the expression has a different precision");
+
+    const expr &x = operand<E>::wrap(e);
+    if (expr::is_vector && dst.size() != x.size())
+	dst.resize(x.size());
+
+    mpfr_srcptr ops[expr::terms];
+    int signs[expr::terms];
+    for (std::size_t i = 0; i < dst.size(); i++)
+    {
+	x.collect(i, ops, signs, 1);
+	detail::evaluate<Prec>(dst[i].get(), ops, signs, expr::terms, rnd);
+    }
+}
+
+} // namespace avx
+
+#endif // AVXFLOAT_HPP
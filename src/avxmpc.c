@@ -0,0 +1,363 @@
+// avxmpc.c
+
+/*
+    Complex addition, subtraction and multiplication with the results and return values of mpc_add(), mpc_sub() and
+    mpc_mul(), in every rounding mode.
+
+    GNU MPC runs the real and imaginary parts through separate mpfr calls. An avxmpc_t keeps the limbs of both parts in
+    one 64 byte aligned block instead, so that up to AVXMPC_PREC_PACKED bits one AVX512 register holds the whole
+    number, the real part in lanes 0 .. 3 and the imaginary part in lanes 4 .. 7. Addition and subtraction are then a
+    single pass over that register, each part a window of 4 full 64 bit limbs (see avxmpfr_windows.h):
+	Lining up. In every part the operand with the smaller exponent is shifted down with lane permutes and variable
+	shifts that stay within the part, noting whether nonzero bits fell off.
+	Adding. The carries are resolved with masks, a lookahead per part so that no carry crosses from the real part
+	into the imaginary one. A difference is a sum with the subtracted part complemented and a carry in of one.
+	Normalising. A carry out shifts a part right by a bit, a cancellation shifts it left by lanes and bits.
+	Rounding. Round and sticky bits of both parts are read with one test each, and an ulp is added where the
+	rounding mode of the part asks for it.
+    Beyond AVXMPC_PREC_PACKED a part is 8 limbs, a register of its own, and both registers go through the same steps
+    side by side.
+
+    A window holds at least two bits more than the precision. Bits of the shifted operand that fall off it can then
+    only matter as sticky bits, and when they belong to the operand being subtracted the window is decremented first
+    (R - f lies between R - 1 and R).
+
+    The single pass only pays off from AVXMPC_PREC_AORS_MIN bits on. Against mpc_add() and mpc_sub() it measured
+    0.77x - 0.99x at 53 and 113 bits, where mpfr has paths of its own for one and two limbs, so narrower additions
+    and subtractions go through MPC. Building the mpc_t views still costs 10 to 20 ns there (0.69x - 0.88x in
+    comparison_complex): numbers that narrow are best kept in mpc_t. From 192 bits on the single pass measured
+    0.98x - 1.08x up to PRECISION_256 and 1.1x - 1.45x at 448 and 504 bits.
+
+    Multiplication (a + bi)(c + di) up to AVXMPC_PREC_PACKED bits takes the four exact products from mpn_mul_n(), 8
+    limbs each, and adds ac - bd and ad + bc in two 8 limb windows, rounding each part once. Wider precisions go
+    through mpfr_fmms() / mpfr_fmma() like mpc_mul() itself. Parts that are zero, infinite or NaN, mixed precisions
+    and results that could leave the exponent range go through MPC, on mpc_t views of the avxmpc_t.
+*/
+
+#include "avxmpc.h"
+#include "avxmpfr_windows.h"
+#include <string.h>
+
+
+/* Views */
+
+// Lanes of a part for a precision
+static inline int part_lanes(mpfr_prec_t precision)
+{
+    return precision <= AVXMPC_PREC_PACKED ? 4 : 8;
+}
+
+// mpfr view of part k of x, sharing its limbs
+static inline void part_view(__mpfr_struct *view, avxmpc_srcptr x, int k)
+{
+    const int lanes = part_lanes(x->precision);
+    const int limbs = (x->precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    view->_mpfr_prec = x->precision;
+    view->_mpfr_sign = x->sign[k];
+    view->_mpfr_exp = x->exp[k];
+    view->_mpfr_d = (mp_limb_t *) x->limbs + k * lanes + lanes - limbs;
+}
+
+static inline void mpc_view(__mpc_struct *view, avxmpc_srcptr x)
+{
+    part_view(mpc_realref(view), x, 0);
+    part_view(mpc_imagref(view), x, 1);
+}
+
+// Take the exponents and signs of a view written by mpfr or MPC
+static inline void view_sync(avxmpc_ptr x, const __mpc_struct *view)
+{
+    x->exp[0] = mpc_realref(view)->_mpfr_exp;
+    x->exp[1] = mpc_imagref(view)->_mpfr_exp;
+    x->sign[0] = mpc_realref(view)->_mpfr_sign;
+    x->sign[1] = mpc_imagref(view)->_mpfr_sign;
+}
+
+static inline int part_regular(avxmpc_srcptr x, int k)
+{
+    __mpfr_struct view;
+    part_view(&view, x, k);
+    return mpfr_regular_p(&view);
+}
+
+static inline void part_set_zero(avxmpc_ptr x, int k, int sign)
+{
+    __mpfr_struct view;
+    part_view(&view, x, k);
+    mpfr_set_zero(&view, sign);
+    x->exp[k] = view._mpfr_exp;
+    x->sign[k] = view._mpfr_sign;
+}
+
+// An operation done by MPC on views. If rop is an operand the result goes to a copy first, MPC cannot tell that two
+// views share limbs
+static int through_mpc(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd,
+		       int (*operation)(mpc_ptr, mpc_srcptr, mpc_srcptr, mpc_rnd_t))
+{
+    if (rop != op1 && rop != op2)
+    {
+	__mpc_struct r, x, y;
+	mpc_view(&r, rop);
+	mpc_view(&x, op1);
+	mpc_view(&y, op2);
+	const int inexact = operation(&r, &x, &y, rnd);
+	view_sync(rop, &r);
+	return inexact;
+    }
+
+    avxmpc_t result;
+    memset(result, 0, sizeof(avxmpc_t));
+    result->precision = rop->precision;
+
+    __mpc_struct r, x, y;
+    mpc_view(&r, result);
+    mpc_view(&x, op1);
+    mpc_view(&y, op2);
+    const int inexact = operation(&r, &x, &y, rnd);
+    view_sync(result, &r);
+    *rop = *result;
+    return inexact;
+}
+
+
+/* Conversion */
+
+int avxmpc_init2(avxmpc_ptr x, mpfr_prec_t precision)
+{
+    /*
+	x is the complex number to initialise, both parts NaN like mpc_init2()
+	precision is the precision of both parts, from MPFR_PREC_MIN to AVXMPC_PREC_MAX
+	Returns -1 and leaves x as it is if the precision is not supported: wider parts would overflow the limbs
+    */
+
+    if (precision < MPFR_PREC_MIN || precision > AVXMPC_PREC_MAX)
+	return -1;
+
+    memset(x->limbs, 0, sizeof(x->limbs));
+    x->precision = precision;
+
+    __mpc_struct view;
+    mpc_view(&view, x);
+    mpfr_set_nan(mpc_realref(&view));
+    mpfr_set_nan(mpc_imagref(&view));
+    view_sync(x, &view);
+    return 0;
+}
+
+int avxmpc_set_mpc(avxmpc_ptr rop, mpc_srcptr op, mpc_rnd_t rnd)
+{
+    /*
+	rop = op rounded to the precision of rop, rnd as in mpc_set()
+	Returns the same value as mpc_set()
+    */
+
+    __mpc_struct view;
+    mpc_view(&view, rop);
+    const int inexact = mpc_set(&view, op, rnd);
+    view_sync(rop, &view);
+    return inexact;
+}
+
+int avxmpc_get_mpc(mpc_ptr rop, avxmpc_srcptr op, mpc_rnd_t rnd)
+{
+    /*
+	rop = op rounded to the precisions of rop, rnd as in mpc_set()
+	Returns the same value as mpc_set()
+    */
+
+    __mpc_struct view;
+    mpc_view(&view, op);
+    return mpc_set(rop, &view, rnd);
+}
+
+
+/* Results */
+
+// Exponent and sign of part k of rop from part j of its windows, the limbs are already stored
+static inline void part_store(avxmpc_ptr rop, int k, const windows *w, int j, mpfr_rnd_t rnd)
+{
+    if ((w->zero >> j) & 1)
+    {
+	// An exact cancellation is +0, or -0 rounding downwards
+	part_set_zero(rop, k, rnd == MPFR_RNDD ? -1 : 1);
+	return;
+    }
+    rop->exp[k] = w->exp[j];
+    rop->sign[k] = w->sign[j];
+}
+
+
+/* Operations */
+
+static int avxmpc_aors(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd, int negate)
+{
+    const int lanes = part_lanes(rop->precision);
+    int eligible = rop->precision >= AVXMPC_PREC_AORS_MIN && part_lanes(op1->precision) == lanes
+		   && part_lanes(op2->precision) == lanes;
+    mpfr_exp_t max = op1->exp[0], min = op1->exp[0];
+    for (int k = 0; k < 2 && eligible; k++)
+    {
+	eligible = part_regular(op1, k) && part_regular(op2, k);
+	max = op1->exp[k] > max ? op1->exp[k] : max;
+	max = op2->exp[k] > max ? op2->exp[k] : max;
+	min = op1->exp[k] < min ? op1->exp[k] : min;
+	min = op2->exp[k] < min ? op2->exp[k] : min;
+    }
+    if (!eligible || !exponents_fit(max, min, lanes))
+	return through_mpc(rop, op1, op2, rnd, negate ? mpc_sub : mpc_add);
+
+    const mpfr_rnd_t modes[2] = {MPC_RND_RE(rnd), MPC_RND_IM(rnd)};
+    const int sign2[2] = {negate ? -op2->sign[0] : op2->sign[0], negate ? -op2->sign[1] : op2->sign[1]};
+    int ternary[2];
+
+    if (lanes == 4)
+    {
+	// Both parts in one register, everything is read before rop is written
+	windows w;
+	__m512i a, b;
+	windows_prepare(4, &w, &a, &b, _mm512_load_si512((const void *) op1->limbs), op1->exp, op1->sign,
+			_mm512_load_si512((const void *) op2->limbs), op2->exp, sign2);
+	__m512i x = windows_aors(4, &w, a, b);
+	x = windows_round(4, &w, x, rop->precision, modes, ternary);
+
+	_mm512_store_si512((void *) rop->limbs, x);
+	part_store(rop, 0, &w, 0, modes[0]);
+	part_store(rop, 1, &w, 1, modes[1]);
+    }
+    else
+    {
+	// A register per part, step by step
+	windows w[2];
+	__m512i a[2], b[2], x[2];
+	for (int k = 0; k < 2; k++)
+	    windows_prepare(8, &w[k], &a[k], &b[k], _mm512_load_si512((const void *) (op1->limbs + 8 * k)),
+			    &op1->exp[k], &op1->sign[k], _mm512_load_si512((const void *) (op2->limbs + 8 * k)),
+			    &op2->exp[k], &sign2[k]);
+	for (int k = 0; k < 2; k++)
+	    x[k] = windows_aors(8, &w[k], a[k], b[k]);
+	for (int k = 0; k < 2; k++)
+	    x[k] = windows_round(8, &w[k], x[k], rop->precision, &modes[k], &ternary[k]);
+
+	for (int k = 0; k < 2; k++)
+	{
+	    _mm512_store_si512((void *) (rop->limbs + 8 * k), x[k]);
+	    part_store(rop, k, &w[k], 0, modes[k]);
+	}
+    }
+
+    if (ternary[0] || ternary[1])
+	mpfr_set_inexflag();
+    return MPC_INEX(ternary[0], ternary[1]);
+}
+
+int avxmpc_add(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd)
+{
+    /*
+	rop = op1 + op2, the real part rounded with MPC_RND_RE(rnd) and the imaginary part with MPC_RND_IM(rnd)
+	rop may be op1 or op2
+	Returns MPC_INEX() of the ternary values of both parts, like mpc_add()
+    */
+
+    return avxmpc_aors(rop, op1, op2, rnd, 0);
+}
+
+int avxmpc_sub(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd)
+{
+    /*
+	rop = op1 - op2, rounded like avxmpc_add()
+	rop may be op1 or op2
+	Returns MPC_INEX() of the ternary values of both parts, like mpc_sub()
+    */
+
+    return avxmpc_aors(rop, op1, op2, rnd, 1);
+}
+
+// (ac - bd) + (ad + bc)i with mpfr_fmms() / mpfr_fmma(), for precisions the packed kernel does not take
+static int mul_fmma(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd)
+{
+    avxmpc_t result;
+    memset(result, 0, sizeof(avxmpc_t));
+    result->precision = rop->precision;
+
+    __mpc_struct r, x, y;
+    mpc_view(&r, result);
+    mpc_view(&x, op1);
+    mpc_view(&y, op2);
+    const int inexact_re = mpfr_fmms(mpc_realref(&r), mpc_realref(&x), mpc_realref(&y), mpc_imagref(&x),
+				     mpc_imagref(&y), MPC_RND_RE(rnd));
+    const int inexact_im = mpfr_fmma(mpc_imagref(&r), mpc_realref(&x), mpc_imagref(&y), mpc_imagref(&x),
+				     mpc_realref(&y), MPC_RND_IM(rnd));
+    view_sync(result, &r);
+    *rop = *result;
+    return MPC_INEX(inexact_re, inexact_im);
+}
+
+int avxmpc_mul(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd)
+{
+    /*
+	rop = op1 * op2, rounded like avxmpc_add()
+	rop may be op1 or op2
+	Returns MPC_INEX() of the ternary values of both parts, like mpc_mul()
+    */
+
+    for (int k = 0; k < 2; k++)
+    {
+	if (!part_regular(op1, k) || !part_regular(op2, k))
+	    return through_mpc(rop, op1, op2, rnd, mpc_mul);
+    }
+
+    // ac, bd, ad and bc, with the parts they multiply
+    static const int factor[4][2] = {{0, 0}, {1, 1}, {0, 1}, {1, 0}};
+    mpfr_exp_t exp[4];
+    int sign[4];
+    mpfr_exp_t max = op1->exp[0] + op2->exp[0], min = max;
+    for (int i = 0; i < 4; i++)
+    {
+	exp[i] = op1->exp[factor[i][0]] + op2->exp[factor[i][1]];
+	sign[i] = op1->sign[factor[i][0]] * op2->sign[factor[i][1]];
+	max = exp[i] > max ? exp[i] : max;
+	min = exp[i] < min ? exp[i] : min;
+    }
+    if (op1->precision > AVXMPC_PREC_PACKED || op2->precision > AVXMPC_PREC_PACKED
+	|| rop->precision > AVXMPC_PREC_PACKED || !exponents_fit(max, min - 1, 8))
+	return mul_fmma(rop, op1, op2, rnd);
+
+    // The exact products, 8 limbs each, are normalised in windows of their own. Operands have at most 252 bits, so
+    // the products have at most 504 and the shift is exact
+    uint64_t products[4][8] __attribute__((aligned(64)));
+    __m512i p[4];
+    for (int i = 0; i < 4; i++)
+    {
+	mpn_mul_n((mp_ptr) products[i], (mp_srcptr) op1->limbs + 4 * factor[i][0],
+		  (mp_srcptr) op2->limbs + 4 * factor[i][1], 4);
+	p[i] = _mm512_load_si512((const void *) products[i]);
+	if (!(products[i][7] >> 63))
+	{
+	    p[i] = part_shift(8, p[i], _mm512_setzero_si512(), _mm512_set1_epi64(1));
+	    exp[i]--;
+	}
+    }
+    sign[1] = -sign[1];
+
+    const mpfr_rnd_t modes[2] = {MPC_RND_RE(rnd), MPC_RND_IM(rnd)};
+    windows w[2];
+    __m512i a[2], b[2], x[2];
+    int ternary[2];
+    for (int k = 0; k < 2; k++)
+	windows_prepare(8, &w[k], &a[k], &b[k], p[2 * k], &exp[2 * k], &sign[2 * k], p[2 * k + 1], &exp[2 * k + 1],
+			&sign[2 * k + 1]);
+    for (int k = 0; k < 2; k++)
+	x[k] = windows_aors(8, &w[k], a[k], b[k]);
+    for (int k = 0; k < 2; k++)
+	x[k] = windows_round(8, &w[k], x[k], rop->precision, &modes[k], &ternary[k]);
+
+    // The top halves of both windows make the packed result
+    _mm512_store_si512((void *) rop->limbs,
+		       _mm512_permutex2var_epi64(x[0], _mm512_set_epi64(15, 14, 13, 12, 7, 6, 5, 4), x[1]));
+    part_store(rop, 0, &w[0], 0, modes[0]);
+    part_store(rop, 1, &w[1], 0, modes[1]);
+
+    if (ternary[0] || ternary[1])
+	mpfr_set_inexflag();
+    return MPC_INEX(ternary[0], ternary[1]);
+}
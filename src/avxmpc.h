@@ -0,0 +1,49 @@
+// avxmpc.h
+
+/*
+    Complex numbers with both parts in AVX512 registers, see avxmpc.c. Kept out of avxmpfr_utilities.h so that only
+    the code using them needs GNU MPC.
+*/
+
+#ifndef AVXMPC_H
+#define AVXMPC_H
+
+#include "avxmpfr_utilities.h"
+#include <mpc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AVXMPC_PREC_MAX PRECISION_512		// Widest precision of an avxmpc_t
+#define AVXMPC_PREC_PACKED PRECISION_256	// Up to this precision both parts share one AVX512 register
+#define AVXMPC_PREC_AORS_MIN 129		// Narrower additions and subtractions are faster through MPC, see avxmpc.c
+
+// Up to AVXMPC_PREC_PACKED bits each part takes 4 limbs, the real part limbs[0 .. 3] and the imaginary part limbs[4 .. 7],
+// beyond that 8 limbs each. The limbs of a part are least significant first, its value in the top ones and the
+// limbs under it zero. avxmpc_t owns no memory, there is nothing to clear.
+typedef struct
+{
+    uint64_t limbs[16] __attribute__((aligned(64)));
+    mpfr_exp_t exp[2];		// Exponents of the real and imaginary parts, zeros, infinities and NaNs as in mpfr
+    int sign[2];
+    mpfr_prec_t precision;	// Of both parts, at most AVXMPC_PREC_MAX
+} avxmpc_struct;
+
+typedef avxmpc_struct avxmpc_t[1];
+typedef avxmpc_struct *avxmpc_ptr;
+typedef const avxmpc_struct *avxmpc_srcptr;
+
+int avxmpc_init2(avxmpc_ptr x, mpfr_prec_t precision);
+int avxmpc_set_mpc(avxmpc_ptr rop, mpc_srcptr op, mpc_rnd_t rnd);
+int avxmpc_get_mpc(mpc_ptr rop, avxmpc_srcptr op, mpc_rnd_t rnd);
+
+// Same results and return values as mpc_add(), mpc_sub() and mpc_mul()
+int avxmpc_add(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd);
+int avxmpc_sub(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd);
+int avxmpc_mul(avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // AVXMPC_H
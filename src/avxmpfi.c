@@ -0,0 +1,137 @@
+// avxmpfi.c
+
+/*
+    Interval addition and subtraction, MPFI style: rop = [op1.left + op2.left rounded down, op1.right + op2.right
+    rounded up], each endpoint exactly what mpfr_add() / mpfr_sub() gives with MPFR_RNDD / MPFR_RNDU.
+
+    Verified code spends its time doing every add twice, once per direction. Here each endpoint sum is a window of 8
+    limbs (see avxmpfr_windows.h), lined up, added, normalised and rounded in an AVX512 register all the way from the
+    operands to the limbs of rop, the two endpoints going through the same steps side by side. Operands of at most
+    AVXMPFI_PREC_MAX bits leave a whole limb of the window free, so bits that fall off the shifted operand only ever
+    matter as sticky bits.
+
+    The windows only pay off from AVXMPFI_PREC_MIN bits on. Against two mpfr calls, in comparison_interval, they
+    measured 0.95x - 1.10x at PRECISION_256 (mostly 1.05x - 1.10x), 0.99x - 1.14x at 320 bits and 1.05x - 1.25x at
+    448 bits. At 192 bits they measured 0.86x - 1.22x and under 0.9x at 53 and 113 bits, where mpfr has paths of its
+    own for one and two limbs, so these go to mpfr. PRECISION_512 fills all 8 limbs and leaves no guard limb: it always
+    takes the two mpfr calls, as do all precisions outside the range, where the table shows 0.86x - 1.06x, the noise
+    of timing the same calls twice. Putting both endpoints of up to 252 bits in one register, 4 lanes each with a
+    carry lookahead per half as avxmpc.c does, did no better (0.73x - 0.96x): half of the work is lining up, loading
+    and storing, which the shared register does not save.
+
+    Narrower or wider precisions, intervals with an endpoint that is zero, infinite or NaN, and sums that could leave
+    the exponent range go through two mpfr calls instead. The return value follows MPFI: bit 0 is set if the left
+    endpoint is inexact, bit 1 if the right one is.
+*/
+
+#include "avxmpfr_windows.h"
+
+
+/* Initialisation */
+
+void avxmpfi_init2(avxmpfi_t x, mpfr_prec_t precision)
+{
+    mpfr_init2(&x->left, precision);
+    mpfr_init2(&x->right, precision);
+}
+
+void avxmpfi_clear(avxmpfi_t x)
+{
+    mpfr_clear(&x->left);
+    mpfr_clear(&x->right);
+}
+
+
+// [x1 + y1, x2 + y2] rounded outwards, negate subtracting the y
+static int avxmpfi_aors(avxmpfi_ptr rop, mpfr_srcptr x1, mpfr_srcptr y1, mpfr_srcptr x2, mpfr_srcptr y2, int negate)
+{
+    mpfr_srcptr ops[4] = {x1, y1, x2, y2};
+    mpfr_prec_t precision = mpfr_get_prec(&rop->left) > mpfr_get_prec(&rop->right) ? mpfr_get_prec(&rop->left)
+										   : mpfr_get_prec(&rop->right);
+    for (int i = 0; i < 4; i++)
+	precision = mpfr_get_prec(ops[i]) > precision ? mpfr_get_prec(ops[i]) : precision;
+
+    // The precision first, narrow intervals should lose as little as possible on their way to mpfr
+    int windows_fit = precision >= AVXMPFI_PREC_MIN && precision <= AVXMPFI_PREC_MAX;
+    if (windows_fit)
+    {
+	mpfr_exp_t max = x1->_mpfr_exp, min = x1->_mpfr_exp;
+	for (int i = 0; i < 4; i++)
+	{
+	    windows_fit &= mpfr_regular_p(ops[i]);
+	    max = ops[i]->_mpfr_exp > max ? ops[i]->_mpfr_exp : max;
+	    min = ops[i]->_mpfr_exp < min ? ops[i]->_mpfr_exp : min;
+	}
+	windows_fit = windows_fit && exponents_fit(max, min, 8);
+    }
+
+    if (!windows_fit)
+    {
+	// The left endpoint of rop cannot be written first when it is an operand of the right one
+	if (&rop->left != x2 && &rop->left != y2)
+	{
+	    const int inexact_left = negate ? mpfr_sub(&rop->left, x1, y1, MPFR_RNDD)
+					    : mpfr_add(&rop->left, x1, y1, MPFR_RNDD);
+	    const int inexact_right = negate ? mpfr_sub(&rop->right, x2, y2, MPFR_RNDU)
+					     : mpfr_add(&rop->right, x2, y2, MPFR_RNDU);
+	    return (inexact_left != 0) | ((inexact_right != 0) << 1);
+	}
+
+	mpfr_t left;
+	mpfr_init2(left, mpfr_get_prec(&rop->left));
+	const int inexact_left = negate ? mpfr_sub(left, x1, y1, MPFR_RNDD) : mpfr_add(left, x1, y1, MPFR_RNDD);
+	const int inexact_right = negate ? mpfr_sub(&rop->right, x2, y2, MPFR_RNDU)
+					 : mpfr_add(&rop->right, x2, y2, MPFR_RNDU);
+	mpfr_swap(&rop->left, left);
+	mpfr_clear(left);
+	return (inexact_left != 0) | ((inexact_right != 0) << 1);
+    }
+
+    const mpfr_rnd_t modes[2] = {MPFR_RNDD, MPFR_RNDU};
+    const mpfr_exp_t ex[2] = {x1->_mpfr_exp, x2->_mpfr_exp};
+    const mpfr_exp_t ey[2] = {y1->_mpfr_exp, y2->_mpfr_exp};
+    const int sx[2] = {x1->_mpfr_sign, x2->_mpfr_sign};
+    const int sy[2] = {negate ? -y1->_mpfr_sign : y1->_mpfr_sign, negate ? -y2->_mpfr_sign : y2->_mpfr_sign};
+    int ternary[2];
+
+    // Everything is read before rop is written
+    mpfr_srcptr xs[2] = {x1, x2}, ys[2] = {y1, y2};
+    mpfr_ptr rops[2] = {&rop->left, &rop->right};
+    windows w[2];
+    __m512i a[2], b[2], x[2];
+    for (int k = 0; k < 2; k++)
+	windows_prepare(8, &w[k], &a[k], &b[k], window_load(xs[k]), &ex[k], &sx[k], window_load(ys[k]), &ey[k], &sy[k]);
+    for (int k = 0; k < 2; k++)
+	x[k] = windows_aors(8, &w[k], a[k], b[k]);
+    for (int k = 0; k < 2; k++)
+	x[k] = windows_round(8, &w[k], x[k], mpfr_get_prec(rops[k]), &modes[k], &ternary[k]);
+    for (int k = 0; k < 2; k++)
+	window_store(rops[k], x[k], &w[k], modes[k]);
+
+    const int inexact = (ternary[0] != 0) | ((ternary[1] != 0) << 1);
+    if (inexact)
+	mpfr_set_inexflag();
+    return inexact;
+}
+
+int avxmpfi_add(avxmpfi_ptr rop, avxmpfi_srcptr op1, avxmpfi_srcptr op2)
+{
+    /*
+	rop = [op1.left + op2.left, op1.right + op2.right], rounded down and up
+	rop may be op1 or op2
+	Returns bit 0 set if the left endpoint is inexact, bit 1 if the right one is
+    */
+
+    return avxmpfi_aors(rop, &op1->left, &op2->left, &op1->right, &op2->right, 0);
+}
+
+int avxmpfi_sub(avxmpfi_ptr rop, avxmpfi_srcptr op1, avxmpfi_srcptr op2)
+{
+    /*
+	rop = [op1.left - op2.right, op1.right - op2.left], rounded down and up
+	rop may be op1 or op2
+	Returns bit 0 set if the left endpoint is inexact, bit 1 if the right one is
+    */
+
+    return avxmpfi_aors(rop, &op1->left, &op2->right, &op1->right, &op2->left, 1);
+}
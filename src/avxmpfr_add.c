@@ -14,15 +14,21 @@ void avxmpfr_add(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const uint1
 	precision is the precision of the avx lanes you want to use and the assumed precision of your mpfr_number (Either PRECISION_256 / PRECISION_512)
     */
 
+    AVXMPFR_TIMER_START(total_timer);
+    AVXMPFR_TIMER_START(align_timer);
+
     // First allign the exponents of the numbers to be added and set rop exponent
     rop->_mpfr_exp = avxmpfr_exp_allign(op1, op2, PRECISION);
+    AVXMPFR_TIMER_STOP(align_timer, AVXMPFR_STAGE_ALIGN);
 
 //    mp_limb_t *limbs = (mp_limb_t *)op1->_mpfr_d; 
 //    print_binary(limbs, PRECISION_256);
 
+    AVXMPFR_TIMER_START(pad_timer);
     // Now pad the limbs of these numbers
     op1->_mpfr_d = avxmpfr_pad252(op1);
     op2->_mpfr_d = avxmpfr_pad252(op2);
+    AVXMPFR_TIMER_STOP(pad_timer, AVXMPFR_STAGE_PAD);
 
 //    printf("\n");
 //   limbs = (mp_limb_t *)op1->_mpfr_d; 
@@ -35,6 +41,8 @@ void avxmpfr_add(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const uint1
     // Now you can add these numbers and assign to rop
     // Note that you have to create a set of packed integers for the AVX lanes
     
+    AVXMPFR_TIMER_START(add_timer);
+
     // Set the first AVX register
     __m256i_u op1_avx = _mm256_set_epi64x(op1->_mpfr_d[0],  // The least significant AVX lane / MPFR limb
 					    op1->_mpfr_d[1],
@@ -77,8 +85,13 @@ void avxmpfr_add(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const uint1
 //    limbs = (mp_limb_t *)rop->_mpfr_d; 
 //    print_binary(limbs, PRECISION_256);
      
+    AVXMPFR_TIMER_STOP(add_timer, AVXMPFR_STAGE_ADD);
+
+    AVXMPFR_TIMER_START(unpad_timer);
     // Finally unpad rop
     rop->_mpfr_d = avxmpfr_unpad252(rop);
+    AVXMPFR_TIMER_STOP(unpad_timer, AVXMPFR_STAGE_UNPAD);
+    AVXMPFR_TIMER_STOP(total_timer, AVXMPFR_STAGE_TOTAL);
 
 //    printf("\n");
 //    printf("\n");
@@ -99,15 +112,21 @@ void avxmpfr_add_512(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const u
 	precision is the precision of the avx lanes you want to use and the assumed precision of your mpfr_number (Either PRECISION_256 / PRECISION_512)
     */
 
+    AVXMPFR_TIMER_START(total_timer);
+    AVXMPFR_TIMER_START(align_timer);
+
     // First allign the exponents of the numbers to be added and set rop exponent
     rop->_mpfr_exp = avxmpfr_exp_allign(op1, op2, PRECISION);
+    AVXMPFR_TIMER_STOP(align_timer, AVXMPFR_STAGE_ALIGN);
 	
     //mp_limb_t *limbs = (mp_limb_t *)op1->_mpfr_d; 
     //print_binary(limbs, PRECISION_512);
 
+    AVXMPFR_TIMER_START(pad_timer);
     // Now pad the limbs of these numbers
     op1->_mpfr_d = avxmpfr_pad504(op1);
     op2->_mpfr_d = avxmpfr_pad504(op2);
+    AVXMPFR_TIMER_STOP(pad_timer, AVXMPFR_STAGE_PAD);
 	
 //    printf("\n");
 //    mp_limb_t *limbs = (mp_limb_t *)op1->_mpfr_d; 
@@ -120,6 +139,8 @@ void avxmpfr_add_512(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const u
     // Now you can add these numbers and assign to rop
     // Note that you have to create a set of packed integers for the AVX lanes
     
+    AVXMPFR_TIMER_START(add_timer);
+
     // Set the first AVX register
 	__m512i_u op1_avx = _mm512_set_epi64(op1->_mpfr_d[0],  // The least significant AVX lane / MPFR limb
 						op1->_mpfr_d[1],
@@ -155,8 +176,13 @@ void avxmpfr_add_512(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const u
 		rop->_mpfr_d[6] = rop_avx[1];
 		rop->_mpfr_d[7] = rop_avx[0];
 
+    AVXMPFR_TIMER_STOP(add_timer, AVXMPFR_STAGE_ADD);
+
+    AVXMPFR_TIMER_START(unpad_timer);
     // Finally unpad rop
     rop->_mpfr_d = avxmpfr_unpad504(rop);
+    AVXMPFR_TIMER_STOP(unpad_timer, AVXMPFR_STAGE_UNPAD);
+    AVXMPFR_TIMER_STOP(total_timer, AVXMPFR_STAGE_TOTAL);
 
 }
 
@@ -0,0 +1,235 @@
+// avxmpfr_add128.c
+
+/*
+    Addition for values of at most PRECISION_128 = 126 bits, the double-quad range (113 to 126 bits) most of the data
+    needs. The smallest path otherwise is the 4 lane avx_add() of avxmpfr_add(), where half of the register and most
+    of the padding work is spent on limbs that are zero.
+
+    A value takes two padded 63 bit lanes, the low one in element 0 of an __m128i and the high one in element 1, so
+    that _mm_bslli_si128() / _mm_bsrli_si128() move a lane up or down. With only two lanes everything is straight line
+    code without loops:
+	the mpfr limbs are packed with one variable shift and one byte shift, and unpacked the same way
+	the smaller operand is alligned by moving the high lane down when the gap is 63 or more, then shifting both
+	lanes by the rest of the gap, the low lane taking the bits that fall off the high one
+	the carry out of the low lane can make the high lane carry at most once, into bit 63
+	a carry out of the high lane shifts the sum right by one and the exponent up by one
+
+    avxmpfr_add_128() adds one pair, avxmpfr_add_128_vec() adds arrays two pairs per __m256i, where the byte shifts
+    work within each 128 bit half and the per value choices are blends. avxmpfr_add_prec() uses avxmpfr_add_128() for
+    every precision up to PRECISION_128.
+
+    Like avxmpfr_add() the smaller operand is truncated when alligned and the sum when normalised, which for operands
+    of at most 126 bits is exactly mpfr_add() with MPFR_RNDZ. Operands with different signs, zeros, NaNs, infinities,
+    precisions above PRECISION_128 and sums beyond the exponent range go through mpfr_add() with rnd instead. The
+    operands are not modified and rop may be either of them.
+*/
+
+#include "avxmpfr_utilities.h"
+
+// 1 if op1 + op2 into rop has to go through mpfr_add()
+static inline int add128_needs_fallback(mpfr_t rop, mpfr_t op1, mpfr_t op2)
+{
+    return !mpfr_regular_p(op1) || !mpfr_regular_p(op2) || mpfr_signbit(op1) != mpfr_signbit(op2)
+	   || mpfr_get_prec(rop) > PRECISION_128 || mpfr_get_prec(op1) > PRECISION_128 || mpfr_get_prec(op2) > PRECISION_128;
+}
+
+// The two mpfr limbs of op, the top one in element 1, a single limb becomes the top one
+static inline __m128i add128_limbs(const mpfr_t op)
+{
+    return mpfr_get_prec(op) > GMP_NUMB_BITS ? _mm_loadu_si128((const __m128i *) op->_mpfr_d)
+					     : _mm_set_epi64x(op->_mpfr_d[0], 0);
+}
+
+// Two mpfr limbs into the padded lanes, the high lane their top 63 bits and the low lane the next 63
+static inline __m128i add128_pack(__m128i d)
+{
+    const __m128i up = _mm_and_si128(_mm_bsrli_si128(_mm_slli_epi64(d, 62), 8), _mm_set1_epi64x(AVXMPFR_PAD_MASK));
+    return _mm_or_si128(_mm_srlv_epi64(d, _mm_set_epi64x(1, 2)), up);
+}
+
+// The reverse of add128_pack(), the two bits under the low lane are zero
+static inline __m128i add128_unpack(__m128i x)
+{
+    return _mm_or_si128(_mm_sllv_epi64(x, _mm_set_epi64x(1, 2)), _mm_bslli_si128(_mm_srli_epi64(x, 62), 8));
+}
+
+// Store the top precision bits of the unpacked limbs into rop
+static inline void add128_store(mpfr_t rop, uint64_t low, uint64_t high, mpfr_exp_t exponent, int sign)
+{
+    const mpfr_prec_t precision = mpfr_get_prec(rop);
+    if (precision > GMP_NUMB_BITS)
+    {
+	rop->_mpfr_d[0] = low & ~((((mp_limb_t) 1) << (2 * GMP_NUMB_BITS - precision)) - 1);
+	rop->_mpfr_d[1] = high;
+    }
+    else
+	rop->_mpfr_d[0] = high & ~((((mp_limb_t) 1) << (GMP_NUMB_BITS - precision)) - 1);
+    rop->_mpfr_sign = sign;
+    rop->_mpfr_exp = exponent;
+}
+
+// The padded x shifted right by gap bits, truncated
+static inline __m128i add128_shift(__m128i x, int64_t gap)
+{
+    if (gap >= PRECISION_128)
+	return _mm_setzero_si128();
+    if (gap >= 63)
+    {
+	x = _mm_bsrli_si128(x, 8);
+	gap -= 63;
+    }
+    const __m128i fall = _mm_bsrli_si128(_mm_sll_epi64(x, _mm_cvtsi32_si128(63 - gap)), 8);
+    return _mm_or_si128(_mm_srl_epi64(x, _mm_cvtsi32_si128(gap)), _mm_and_si128(fall, _mm_set1_epi64x(AVXMPFR_PAD_MASK)));
+}
+
+// a + b on padded lanes, returns 1 in *carry_out if the sum carried out of the high lane and was normalised
+static inline __m128i add128_lanes(__m128i a, __m128i b, int *carry_out)
+{
+    const __m128i mask = _mm_set1_epi64x(AVXMPFR_PAD_MASK);
+    __m128i sum = _mm_add_epi64(a, b);
+    __m128i carry = _mm_srli_epi64(sum, 63);
+    sum = _mm_add_epi64(_mm_and_si128(sum, mask), _mm_bslli_si128(carry, 8));
+    carry = _mm_or_si128(carry, _mm_srli_epi64(sum, 63));
+    sum = _mm_and_si128(sum, mask);
+
+    // Only the high lane's carry counts, the low lane's went into the high one
+    *carry_out = _mm_extract_epi64(carry, 1);
+    if (*carry_out)
+    {
+	const __m128i down = _mm_bsrli_si128(_mm_slli_epi64(sum, 62), 8);
+	sum = _mm_or_si128(_mm_srli_epi64(sum, 1), _mm_and_si128(down, mask));
+	sum = _mm_or_si128(sum, _mm_set_epi64x(((uint64_t) 1) << 62, 0));
+	AVXMPFR_COUNT(normalisations, 1);
+    }
+    return sum;
+}
+
+void avxmpfr_add_128(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    /*
+	rop is resultant operand, of at most PRECISION_128 bits
+	op1 and op2 are the operands, of at most PRECISION_128 bits and not modified
+	rnd is the rounding mode, only used when the addition goes through mpfr_add()
+    */
+
+    if (add128_needs_fallback(rop, op1, op2))
+    {
+	mpfr_add(rop, op1, op2, rnd);
+	return;
+    }
+
+    // Make op1 the operand with the bigger exponent
+    if (op2->_mpfr_exp > op1->_mpfr_exp)
+    {
+	mpfr_ptr t = op1;
+	op1 = op2;
+	op2 = t;
+    }
+    const int64_t gap = op1->_mpfr_exp - op2->_mpfr_exp;
+    AVXMPFR_COUNT_GAP(gap);
+
+    int carry;
+    const __m128i sum = add128_lanes(add128_pack(add128_limbs(op1)), add128_shift(add128_pack(add128_limbs(op2)), gap), &carry);
+    const mpfr_exp_t exponent = op1->_mpfr_exp + carry;
+    if (carry && exponent > mpfr_get_emax())
+    {
+	mpfr_add(rop, op1, op2, rnd);
+	return;
+    }
+
+    const __m128i d = add128_unpack(sum);
+    add128_store(rop, _mm_cvtsi128_si64(d), _mm_extract_epi64(d, 1), exponent, op1->_mpfr_sign);
+}
+
+
+/* Two pairs per __m256i */
+
+// Pairs i and i + 1, both known not to need the fallback
+static inline void add128_two(mpfr_t rop0, mpfr_t rop1, mpfr_t *a, mpfr_t *b, mpfr_rnd_t rnd)
+{
+    const __m256i mask = _mm256_set1_epi64x(AVXMPFR_PAD_MASK);
+    const __m256i lane_shift = _mm256_set_epi64x(1, 2, 1, 2);
+
+    // Each pair with its bigger exponent first
+    mpfr_ptr big[2], small[2];
+    int64_t gap[2];
+    for (int j = 0; j < 2; j++)
+    {
+	const int swap = b[j]->_mpfr_exp > a[j]->_mpfr_exp;
+	big[j] = swap ? b[j] : a[j];
+	small[j] = swap ? a[j] : b[j];
+	gap[j] = big[j]->_mpfr_exp - small[j]->_mpfr_exp;
+	AVXMPFR_COUNT_GAP(gap[j]);
+    }
+
+    // Pack both halves at once
+    __m256i x = _mm256_set_m128i(add128_limbs(big[1]), add128_limbs(big[0]));
+    __m256i y = _mm256_set_m128i(add128_limbs(small[1]), add128_limbs(small[0]));
+    x = _mm256_or_si256(_mm256_srlv_epi64(x, lane_shift), _mm256_and_si256(_mm256_bsrli_epi128(_mm256_slli_epi64(x, 62), 8), mask));
+    y = _mm256_or_si256(_mm256_srlv_epi64(y, lane_shift), _mm256_and_si256(_mm256_bsrli_epi128(_mm256_slli_epi64(y, 62), 8), mask));
+
+    // Allign y, whole lanes then bits, a gap past both lanes clears its half
+    const int64_t q0 = gap[0] >= 63, q1 = gap[1] >= 63;
+    const int64_t r0 = gap[0] - 63 * q0, r1 = gap[1] - 63 * q1;
+    const int64_t z0 = gap[0] >= PRECISION_128, z1 = gap[1] >= PRECISION_128;
+    y = _mm256_blendv_epi8(y, _mm256_bsrli_epi128(y, 8), _mm256_set_epi64x(-q1, -q1, -q0, -q0));
+    const __m256i r = _mm256_set_epi64x(r1, r1, r0, r0);
+    const __m256i fall = _mm256_bsrli_epi128(_mm256_sllv_epi64(y, _mm256_sub_epi64(_mm256_set1_epi64x(63), r)), 8);
+    y = _mm256_or_si256(_mm256_srlv_epi64(y, r), _mm256_and_si256(fall, mask));
+    y = _mm256_andnot_si256(_mm256_set_epi64x(-z1, -z1, -z0, -z0), y);
+
+    // Add, the low lane's carry goes into the high lane which can then carry once
+    __m256i sum = _mm256_add_epi64(x, y);
+    __m256i carry = _mm256_srli_epi64(sum, 63);
+    sum = _mm256_add_epi64(_mm256_and_si256(sum, mask), _mm256_bslli_epi128(carry, 8));
+    carry = _mm256_or_si256(carry, _mm256_srli_epi64(sum, 63));
+    sum = _mm256_and_si256(sum, mask);
+
+    // Normalise the halves whose high lane carried, blending in the sum shifted right by one
+    const __m256i high_carry = _mm256_and_si256(carry, _mm256_set_epi64x(1, 0, 1, 0));
+    const __m256i normalise = _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_or_si256(high_carry, _mm256_bsrli_epi128(high_carry, 8)));
+    const __m256i down = _mm256_and_si256(_mm256_bsrli_epi128(_mm256_slli_epi64(sum, 62), 8), mask);
+    const __m256i top = _mm256_set_epi64x(((uint64_t) 1) << 62, 0, ((uint64_t) 1) << 62, 0);
+    const __m256i shifted = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi64(sum, 1), down), top);
+    sum = _mm256_blendv_epi8(sum, shifted, normalise);
+
+    // Unpack both
+    const __m256i d = _mm256_or_si256(_mm256_sllv_epi64(sum, lane_shift), _mm256_bslli_epi128(_mm256_srli_epi64(sum, 62), 8));
+    uint64_t out[4] __attribute__((aligned(32)));
+    _mm256_store_si256((__m256i *) out, d);
+
+    mpfr_ptr rop[2] = {rop0, rop1};
+    const int carried[2] = {_mm256_extract_epi64(high_carry, 1), _mm256_extract_epi64(high_carry, 3)};
+    for (int j = 0; j < 2; j++)
+    {
+	const mpfr_exp_t exponent = big[j]->_mpfr_exp + carried[j];
+	if (carried[j] && exponent > mpfr_get_emax())
+	    mpfr_add(rop[j], big[j], small[j], rnd);
+	else
+	    add128_store(rop[j], out[2 * j], out[2 * j + 1], exponent, big[j]->_mpfr_sign);
+    }
+    AVXMPFR_COUNT(normalisations, carried[0] + carried[1]);
+}
+
+void avxmpfr_add_128_vec(mpfr_t *rop, mpfr_t *op1, mpfr_t *op2, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	rop is an array of n resultant operands, rop[i] = op1[i] + op2[i], each of at most PRECISION_128 bits
+	op1 and op2 are arrays of n operands, not modified, rop may be either of them
+	rnd is the rounding mode, only used when an addition goes through mpfr_add()
+    */
+
+    size_t i = 0;
+    for (; i + 1 < n; i += 2)
+    {
+	if (add128_needs_fallback(rop[i], op1[i], op2[i]) || add128_needs_fallback(rop[i + 1], op1[i + 1], op2[i + 1]))
+	{
+	    avxmpfr_add_128(rop[i], op1[i], op2[i], rnd);
+	    avxmpfr_add_128(rop[i + 1], op1[i + 1], op2[i + 1], rnd);
+	    continue;
+	}
+	add128_two(rop[i], rop[i + 1], op1 + i, op2 + i, rnd);
+    }
+    if (i < n)
+	avxmpfr_add_128(rop[i], op1[i], op2[i], rnd);
+}
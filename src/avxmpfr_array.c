@@ -0,0 +1,424 @@
+// avxmpfr_array.c
+
+/*
+    Packed arrays of fixed precision numbers kept in the padded AVX layout, and the batched add that runs over them.
+
+    avxmpfr_add() spends most of its time getting numbers in and out of the AVX layout (avxmpfr_pad252() on the way in,
+    avxmpfr_unpad252() on the way out). A packed array stores the numbers already padded, so the batched add only has
+    to allign the exponents and run the SIMD addition.
+
+    Numbers are grouped in blocks of AVXMPFR_BLOCK. Each block holds:
+	The padded limbs, either number by number in AVX lane order (most significant limb first, AVXMPFR_LAYOUT_NATIVE)
+	or limb plane by limb plane with one number per lane (AVXMPFR_LAYOUT_SOA).
+	AVXMPFR_BLOCK exponents, using AVXMPFR_EXP_ZERO for zeros.
+	AVXMPFR_BLOCK signs (+1 / -1) in the first word of a 64 byte line.
+
+    Every block is 64 byte aligned, so the same bytes work in memory and in a mapped file (see avxmpfr_file.c).
+    NaNs and infinities cannot be packed.
+
+    The addition follows avxmpfr_add(), the smaller operand is truncated when alligned and the sum is truncated when
+    normalised. Operands with different signs are handed to mpfr_add() with MPFR_RNDZ.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Allocation and views */
+
+int avxmpfr_array_init(avxmpfr_array *array, uint16_t precision, uint32_t layout, uint64_t count)
+{
+    /*
+	precision is PRECISION_256 or PRECISION_512
+	layout is AVXMPFR_LAYOUT_NATIVE or AVXMPFR_LAYOUT_SOA
+	count is the number of values, all set to zero
+
+	Returns 0 on success and -1 if the allocation failed
+    */
+
+    array->precision = precision;
+    array->limbs = (precision + 62) / 63;
+    array->layout = layout;
+    array->count = count;
+
+    size_t bytes = avxmpfr_array_blocks(count) * avxmpfr_block_words(array->limbs) * sizeof(uint64_t);
+    array->blocks = aligned_alloc(64, bytes > 0 ? bytes : 64);
+    if (array->blocks == NULL)
+	return -1;
+
+    // Zero every block, then mark all values as positive zeros
+    memset(array->blocks, 0, bytes);
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(count); b++)
+    {
+	int64_t *exp = avxmpfr_block_exp(array, b);
+	int8_t *sign = avxmpfr_block_sign(array, b);
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    exp[lane] = AVXMPFR_EXP_ZERO;
+	    sign[lane] = 1;
+	}
+    }
+
+    return 0;
+}
+
+void avxmpfr_array_clear(avxmpfr_array *array)
+{
+    free(array->blocks);
+    array->blocks = NULL;
+    array->count = 0;
+}
+
+void avxmpfr_array_view(avxmpfr_array *view, const avxmpfr_array *array, uint64_t first, uint64_t count)
+{
+    /*
+	Make view refer to values [first, first + count) of array without copying.
+	first must be a multiple of AVXMPFR_BLOCK.
+    */
+
+    *view = *array;
+    view->blocks = avxmpfr_block(array, first / AVXMPFR_BLOCK);
+    view->count = count;
+}
+
+
+/* Conversion from and to mpfr_t */
+
+// Address of padded limb k of value lane in block
+static inline uint64_t *packed_limb(const avxmpfr_array *array, uint64_t *block, int lane, int k)
+{
+    if (array->layout == AVXMPFR_LAYOUT_SOA)
+	return block + k * AVXMPFR_BLOCK + lane;
+    return block + lane * array->limbs + k;
+}
+
+int avxmpfr_array_set(avxmpfr_array *array, uint64_t index, mpfr_t op)
+{
+    /*
+	Store op as value number index. op is not modified.
+	Precision beyond the array precision is truncated, like the AVX kernels do.
+
+	Returns 0 on success and -1 if op is NaN or infinite
+    */
+
+    uint64_t *block = avxmpfr_block(array, index / AVXMPFR_BLOCK);
+    int lane = index % AVXMPFR_BLOCK;
+    const int L = array->limbs;
+
+    if (mpfr_nan_p(op) || mpfr_inf_p(op))
+	return -1;
+
+    avxmpfr_block_sign(array, index / AVXMPFR_BLOCK)[lane] = mpfr_signbit(op) ? -1 : 1;
+
+    if (mpfr_zero_p(op))
+    {
+	for (int k = 0; k < L; k++)
+	    *packed_limb(array, block, lane, k) = 0;
+	avxmpfr_block_exp(array, index / AVXMPFR_BLOCK)[lane] = AVXMPFR_EXP_ZERO;
+	return 0;
+    }
+
+    avxmpfr_pack_lanes(packed_limb(array, block, lane, 0), array->layout == AVXMPFR_LAYOUT_SOA ? AVXMPFR_BLOCK : 1, L, op);
+    avxmpfr_block_exp(array, index / AVXMPFR_BLOCK)[lane] = op->_mpfr_exp;
+    return 0;
+}
+
+void avxmpfr_array_get(mpfr_t rop, const avxmpfr_array *array, uint64_t index, mpfr_rnd_t rnd)
+{
+    /*
+	Read value number index into rop, rounding if rop has less precision than the array
+    */
+
+    uint64_t *block = avxmpfr_block(array, index / AVXMPFR_BLOCK);
+    int lane = index % AVXMPFR_BLOCK;
+    const int L = array->limbs;
+    const int sign = avxmpfr_block_sign(array, index / AVXMPFR_BLOCK)[lane];
+    const int64_t exp = avxmpfr_block_exp(array, index / AVXMPFR_BLOCK)[lane];
+
+    if (exp == AVXMPFR_EXP_ZERO)
+    {
+	mpfr_set_zero(rop, sign);
+	return;
+    }
+
+    mp_limb_t d[L];
+    avxmpfr_unpack_lanes(d, packed_limb(array, block, lane, 0), array->layout == AVXMPFR_LAYOUT_SOA ? AVXMPFR_BLOCK : 1, L);
+
+    avxmpfr_round_limbs(rop, sign, d, L, exp - L * GMP_NUMB_BITS, rnd);
+}
+
+
+/* Batched addition */
+
+// Return 1 if the pair at lane needs the mpfr fallback (different signs, neither zero)
+static inline int needs_fallback(const int8_t *sign1, const int8_t *sign2, const int64_t *exp1, const int64_t *exp2, int lane)
+{
+    return sign1[lane] != sign2[lane] && exp1[lane] != AVXMPFR_EXP_ZERO && exp2[lane] != AVXMPFR_EXP_ZERO;
+}
+
+// Sign of the sum of a pair that does not need the fallback: op1's, op2's if op1 is zero, and +0 for a sum of zeros
+// with different signs as mpfr_add() gives in MPFR_RNDZ
+static inline int8_t sum_sign(const int8_t *sign1, const int8_t *sign2, const int64_t *exp1, const int64_t *exp2, int lane)
+{
+    if (exp1[lane] != AVXMPFR_EXP_ZERO)
+	return sign1[lane];
+    if (exp2[lane] != AVXMPFR_EXP_ZERO || sign1[lane] == sign2[lane])
+	return sign2[lane];
+    return 1;
+}
+
+// Compute a pair the kernels do not handle with mpfr, result must have the array precision
+static void add_fallback(mpfr_t result, const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t index)
+{
+    mpfr_t b;
+    mpfr_init2(b, op1->precision);
+    avxmpfr_array_get(result, op1, index, MPFR_RNDZ);
+    avxmpfr_array_get(b, op2, index, MPFR_RNDZ);
+    mpfr_add(result, result, b, MPFR_RNDZ);
+    mpfr_clear(b);
+    AVXMPFR_COUNT(fallbacks, 1);
+}
+
+// Native layout, 252 bits with AVX2 and avx_add()
+static void add_native252(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    mpfr_t fallback;
+    mpfr_init2(fallback, rop->precision);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(rop->count); b++)
+    {
+	const uint64_t *block1 = avxmpfr_block(op1, b);
+	const uint64_t *block2 = avxmpfr_block(op2, b);
+	uint64_t *block_rop = avxmpfr_block(rop, b);
+	const int64_t *exp1 = avxmpfr_block_exp(op1, b);
+	const int64_t *exp2 = avxmpfr_block_exp(op2, b);
+	const int8_t *sign1 = avxmpfr_block_sign(op1, b);
+	const int8_t *sign2 = avxmpfr_block_sign(op2, b);
+	int64_t *exp_rop = avxmpfr_block_exp(rop, b);
+	int8_t *sign_rop = avxmpfr_block_sign(rop, b);
+
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    if (needs_fallback(sign1, sign2, exp1, exp2, lane))
+	    {
+		if (b * AVXMPFR_BLOCK + lane < rop->count)
+		{
+		    add_fallback(fallback, op1, op2, b * AVXMPFR_BLOCK + lane);
+		    avxmpfr_array_set(rop, b * AVXMPFR_BLOCK + lane, fallback);
+		}
+		continue;
+	    }
+
+	    __m256i a = _mm256_load_si256((const __m256i *) (block1 + lane * 4));
+	    __m256i c = _mm256_load_si256((const __m256i *) (block2 + lane * 4));
+	    mpfr_exp_t exponent = exp1[lane];
+	    int8_t sign = sum_sign(sign1, sign2, exp1, exp2, lane);
+
+	    // Make a the operand with the bigger exponent, then allign c to it
+	    if (exp2[lane] > exp1[lane])
+	    {
+		__m256i t = a;
+		a = c;
+		c = t;
+		exponent = exp2[lane];
+	    }
+	    const int64_t gap = exponent - (exp1[lane] < exp2[lane] ? exp1[lane] : exp2[lane]);
+	    AVXMPFR_COUNT_GAP(gap);
+	    c = avxmpfr_shift_padded252(c, gap);
+
+	    __m256i result = avx_add(a, c, &exponent);
+	    _mm256_store_si256((__m256i *) (block_rop + lane * 4), result);
+	    exp_rop[lane] = exponent;
+	    sign_rop[lane] = sign;
+	}
+    }
+    mpfr_clear(fallback);
+}
+
+// Native layout, 504 bits with AVX512 and avx_add_512i()
+static void add_native504(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    mpfr_t fallback;
+    mpfr_init2(fallback, rop->precision);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(rop->count); b++)
+    {
+	const uint64_t *block1 = avxmpfr_block(op1, b);
+	const uint64_t *block2 = avxmpfr_block(op2, b);
+	uint64_t *block_rop = avxmpfr_block(rop, b);
+	const int64_t *exp1 = avxmpfr_block_exp(op1, b);
+	const int64_t *exp2 = avxmpfr_block_exp(op2, b);
+	const int8_t *sign1 = avxmpfr_block_sign(op1, b);
+	const int8_t *sign2 = avxmpfr_block_sign(op2, b);
+	int64_t *exp_rop = avxmpfr_block_exp(rop, b);
+	int8_t *sign_rop = avxmpfr_block_sign(rop, b);
+
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    if (needs_fallback(sign1, sign2, exp1, exp2, lane))
+	    {
+		if (b * AVXMPFR_BLOCK + lane < rop->count)
+		{
+		    add_fallback(fallback, op1, op2, b * AVXMPFR_BLOCK + lane);
+		    avxmpfr_array_set(rop, b * AVXMPFR_BLOCK + lane, fallback);
+		}
+		continue;
+	    }
+
+	    __m512i a = _mm512_load_si512((const void *) (block1 + lane * 8));
+	    __m512i c = _mm512_load_si512((const void *) (block2 + lane * 8));
+	    mpfr_exp_t exponent = exp1[lane];
+	    int8_t sign = sum_sign(sign1, sign2, exp1, exp2, lane);
+
+	    if (exp2[lane] > exp1[lane])
+	    {
+		__m512i t = a;
+		a = c;
+		c = t;
+		exponent = exp2[lane];
+	    }
+	    const int64_t gap = exponent - (exp1[lane] < exp2[lane] ? exp1[lane] : exp2[lane]);
+	    AVXMPFR_COUNT_GAP(gap);
+	    c = avxmpfr_shift_padded504(c, gap);
+
+	    __m512i result = avx_add_512i(a, c, &exponent);
+	    _mm512_store_si512((void *) (block_rop + lane * 8), result);
+	    exp_rop[lane] = exponent;
+	    sign_rop[lane] = sign;
+	}
+    }
+    mpfr_clear(fallback);
+}
+
+// SoA layout, one number per AVX512 lane so that the carries run down the limb planes instead of across lanes
+static void add_soa(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    const int L = rop->limbs;
+    const __m512i pad_mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i max_gap = _mm512_set1_epi64(63 * L);
+
+    // The smaller operand of each lane is staged here so it can be gathered from a single base
+    uint64_t small[8 * AVXMPFR_BLOCK] __attribute__((aligned(64)));
+    __m512i big[8];
+
+    // Results of lanes that go through mpfr, computed before rop is written in case it is also an operand
+    mpfr_t fallback[AVXMPFR_BLOCK];
+    for (int l = 0; l < AVXMPFR_BLOCK; l++)
+	mpfr_init2(fallback[l], rop->precision);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(rop->count); b++)
+    {
+	const uint64_t *block1 = avxmpfr_block(op1, b);
+	const uint64_t *block2 = avxmpfr_block(op2, b);
+	uint64_t *block_rop = avxmpfr_block(rop, b);
+
+	const int64_t *e1 = avxmpfr_block_exp(op1, b);
+	const int64_t *e2 = avxmpfr_block_exp(op2, b);
+	const int8_t *s1 = avxmpfr_block_sign(op1, b);
+	const int8_t *s2 = avxmpfr_block_sign(op2, b);
+	__m512i exp1 = _mm512_load_si512((const void *) e1);
+	__m512i exp2 = _mm512_load_si512((const void *) e2);
+
+	// Lanes with different signs go through mpfr
+	int8_t sign[AVXMPFR_BLOCK];
+	int pending = 0;
+	for (int l = 0; l < AVXMPFR_BLOCK; l++)
+	{
+	    sign[l] = sum_sign(s1, s2, e1, e2, l);
+	    if (needs_fallback(s1, s2, e1, e2, l) && b * AVXMPFR_BLOCK + l < rop->count)
+	    {
+		add_fallback(fallback[l], op1, op2, b * AVXMPFR_BLOCK + l);
+		pending |= 1 << l;
+	    }
+	}
+
+	// Lanes where op2 has the bigger exponent swap roles
+	__mmask8 swap = _mm512_cmpgt_epi64_mask(exp2, exp1);
+	__m512i exponent = _mm512_max_epi64(exp1, exp2);
+	__m512i gap = _mm512_min_epi64(_mm512_abs_epi64(_mm512_sub_epi64(exp1, exp2)), max_gap);
+	AVXMPFR_STATS_ONLY(for (int l = 0; l < AVXMPFR_BLOCK; l++) AVXMPFR_COUNT_GAP(gap[l]);)
+
+	for (int k = 0; k < L; k++)
+	{
+	    __m512i a = _mm512_load_si512((const void *) (block1 + k * AVXMPFR_BLOCK));
+	    __m512i c = _mm512_load_si512((const void *) (block2 + k * AVXMPFR_BLOCK));
+	    big[k] = _mm512_mask_blend_epi64(swap, a, c);
+	    _mm512_store_si512((void *) (small + k * AVXMPFR_BLOCK), _mm512_mask_blend_epi64(swap, c, a));
+	}
+
+	// gap = 63 * q + r per lane, 1041 / 2^16 is exact enough for 1 / 63 up to 8 * 63
+	__m512i q = _mm512_srli_epi64(_mm512_mul_epu32(gap, _mm512_set1_epi64(1041)), 16);
+	__m512i r = _mm512_sub_epi64(gap, _mm512_mul_epu32(q, _mm512_set1_epi64(63)));
+	__m512i r_complement = _mm512_sub_epi64(_mm512_set1_epi64(63), r);
+
+	// Add from the least significant plane up, carries move one plane per step
+	__m512i carry = _mm512_setzero_si512();
+	__m512i sum[8];
+	for (int k = L - 1; k >= 0; k--)
+	{
+	    // Alligned limb k of the smaller operand is (small[k - q] >> r) | (small[k - q - 1] << (63 - r))
+	    __m512i source = _mm512_sub_epi64(_mm512_set1_epi64(k), q);
+	    __mmask8 valid = _mm512_cmpge_epi64_mask(source, _mm512_setzero_si512());
+	    __mmask8 valid_next = _mm512_cmpgt_epi64_mask(source, _mm512_setzero_si512());
+	    __m512i index = _mm512_add_epi64(_mm512_slli_epi64(source, 3), lane);
+
+	    __m512i whole = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), valid, index, small, 8);
+	    __m512i next = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), valid_next,
+							_mm512_sub_epi64(index, _mm512_set1_epi64(AVXMPFR_BLOCK)), small, 8);
+	    __m512i alligned = _mm512_or_si512(_mm512_srlv_epi64(whole, r), _mm512_and_si512(_mm512_sllv_epi64(next, r_complement), pad_mask));
+	    alligned = _mm512_and_si512(alligned, pad_mask);
+
+	    __m512i s = _mm512_add_epi64(_mm512_add_epi64(big[k], alligned), carry);
+	    carry = _mm512_srli_epi64(s, 63);
+	    sum[k] = _mm512_and_si512(s, pad_mask);
+	}
+
+	// A carry out of the most significant plane needs normalising, truncating like avx_add()
+	__mmask8 normalise = _mm512_test_epi64_mask(carry, carry);
+	if (normalise)
+	{
+	    for (int k = L - 1; k > 0; k--)
+	    {
+		__m512i shifted = _mm512_or_si512(_mm512_srli_epi64(sum[k], 1), _mm512_slli_epi64(_mm512_and_si512(sum[k - 1], _mm512_set1_epi64(1)), 62));
+		sum[k] = _mm512_mask_mov_epi64(sum[k], normalise, shifted);
+	    }
+	    sum[0] = _mm512_mask_mov_epi64(sum[0], normalise, _mm512_or_si512(_mm512_srli_epi64(sum[0], 1), _mm512_slli_epi64(carry, 62)));
+	    exponent = _mm512_mask_add_epi64(exponent, normalise, exponent, _mm512_set1_epi64(1));
+	}
+
+	for (int k = 0; k < L; k++)
+	    _mm512_store_si512((void *) (block_rop + k * AVXMPFR_BLOCK), sum[k]);
+	_mm512_store_si512((void *) avxmpfr_block_exp(rop, b), exponent);
+
+	memcpy(avxmpfr_block_sign(rop, b), sign, AVXMPFR_BLOCK);
+
+	for (int l = 0; l < AVXMPFR_BLOCK; l++)
+	{
+	    if (pending & (1 << l))
+		avxmpfr_array_set(rop, b * AVXMPFR_BLOCK + l, fallback[l]);
+	}
+    }
+
+    for (int l = 0; l < AVXMPFR_BLOCK; l++)
+	mpfr_clear(fallback[l]);
+}
+
+void avxmpfr_add_array(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    /*
+	rop is the resultant array
+	op1 and op2 are the operand arrays
+	All three must have the same precision, layout and count. rop may be the same as op1 or op2.
+    */
+
+    AVXMPFR_COUNT(batched, rop->count);
+
+    if (rop->layout == AVXMPFR_LAYOUT_SOA)
+	add_soa(rop, op1, op2);
+    else if (rop->precision == PRECISION_256)
+	add_native252(rop, op1, op2);
+    else
+	add_native504(rop, op1, op2);
+}
@@ -0,0 +1,799 @@
+// avxmpfr_blas.c
+
+/*
+    Level 1 and 2 BLAS over packed arrays (see avxmpfr_array.c): avxmpfr_dot(), avxmpfr_asum(), avxmpfr_nrm2(),
+    avxmpfr_axpy(), avxmpfr_scal() and avxmpfr_gemv(). The threads, the accumulators and the rounding into packed
+    arrays are shared with the prefix sums of avxmpfr_scan.c through avxmpfr_blas.h.
+
+    The reductions are exact until the very end. Every term (a product x_i * y_i, an |x_i| or a square x_i^2) is added
+    into a fixed point accumulator in two's complement, wide enough to hold all of them without losing a bit: a first
+    pass over the exponent lines of the blocks finds the smallest and the largest term, the accumulator spans both plus
+    headroom for the carries. The products come from mpn_mul_n(), the accumulation is AVX512: a product is shifted to
+    its bit offset 8 limbs at a time and added (or subtracted) with the mask carry lookahead of avxmpn.c. The sum is
+    rounded once into rop, with any rounding mode, so the result is correctly rounded and does not depend on the order
+    of the terms or on the number of threads. avxmpfr_nrm2() takes mpfr_sqrt() of the exact sum of squares.
+
+    avxmpfr_axpy() and avxmpfr_scal() round every element once, like mpfr_fma() and mpfr_mul() to the array precision.
+    They keep a computation on packed arrays rather than speed it up: element by element there is no work to share,
+    and unpacking, multiplying and rounding cost about what mpfr does. Against the mpfr_fma() / mpfr_mul() loop over
+    mpfr_t arrays, comparison_blas measures avxmpfr_axpy() at 0.81x - 0.97x and avxmpfr_scal() at 0.87x - 1.1x.
+    Handing the elements to mpfr instead would add an unpacking and a packing to each of them and be slower still.
+    Arrays that only ever go through axpy are better kept as mpfr_t.
+    avxmpfr_gemv() accumulates each A_i . x exactly and finishes with one mpfr_fmma() per row. A is walked in blocks of
+    AVXMPFR_BLAS_ROWS rows by AVXMPFR_BLAS_PANEL columns, the panel of x is unpacked once per block of rows into a
+    staging buffer that stays in L1 while the rows stream past.
+
+    Exponent spans wider than AVXMPFR_BLAS_MAX_LIMBS limbs (values of wildly different magnitudes) are summed with
+    mpfr_sum() instead, with the same results. An exact zero sum is +0, -0 under MPFR_RNDD.
+
+    avxmpfr_blas_set_threads() splits the calls over that many threads once each gets AVXMPFR_BLAS_THREAD_MIN values
+    (AVXMPFR_BLAS_SCAN_THREAD_MIN for the scans). Reductions keep an accumulator per thread and add them up exactly at
+    the end.
+*/
+
+#include "avxmpfr_blas.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLAS_AXPY_LIMBS 64	// Widest local accumulator of avxmpfr_axpy(), larger gaps go through mpfr_fma()
+
+static int blas_threads = 1;
+
+void avxmpfr_blas_set_threads(int threads)
+{
+    blas_threads = threads > 0 ? threads : 1;
+}
+
+
+/* Threads */
+
+typedef struct
+{
+    blas_work work;
+    void *job;
+    int part;
+    uint64_t first;
+    uint64_t last;
+    mpfr_exp_t emin;
+    mpfr_exp_t emax;
+} blas_task;
+
+static void *blas_task_main(void *arg)
+{
+    blas_task *task = arg;
+
+    // The exponent range is per thread in MPFR, workers take the one of the caller
+    mpfr_set_emin(task->emin);
+    mpfr_set_emax(task->emax);
+    task->work(task->job, task->part, task->first, task->last);
+    return NULL;
+}
+
+// Number of threads for total values, per_thread each at least, at most rows / AVXMPFR_BLOCK parts when splitting rows
+int blas_parts(uint64_t total, uint64_t rows, uint64_t per_thread)
+{
+    uint64_t parts = blas_threads;
+    if (parts > total / per_thread)
+	parts = total / per_thread;
+    if (parts > avxmpfr_array_blocks(rows))
+	parts = avxmpfr_array_blocks(rows);
+    return parts > 0 ? parts : 1;
+}
+
+// Run work over [0, count) in parts, split on block boundaries, part 0 on the calling thread
+void blas_run(blas_work work, void *job, int parts, uint64_t count)
+{
+    if (parts == 1)
+    {
+	work(job, 0, 0, count);
+	return;
+    }
+
+    blas_task tasks[parts];
+    pthread_t threads[parts];
+    int started[parts];
+    const uint64_t blocks = avxmpfr_array_blocks(count);
+
+    for (int p = 0; p < parts; p++)
+    {
+	const uint64_t last = blocks * (p + 1) / parts * AVXMPFR_BLOCK;
+	tasks[p] = (blas_task) {work, job, p, blocks * p / parts * AVXMPFR_BLOCK, last < count ? last : count,
+				mpfr_get_emin(), mpfr_get_emax()};
+	started[p] = p > 0 && pthread_create(&threads[p], NULL, blas_task_main, &tasks[p]) == 0;
+    }
+
+    // Parts that did not get a thread run here too
+    for (int p = 0; p < parts; p++)
+	if (!started[p])
+	    work(job, p, tasks[p].first, tasks[p].last);
+
+    for (int p = 1; p < parts; p++)
+	if (started[p])
+	    pthread_join(threads[p], NULL);
+}
+
+
+/* Exact fixed point accumulators */
+
+// Smallest and largest exponent of the nonzero x_i, or of the products x_i y_i. Returns 0 if every term is zero
+int blas_term_bounds(const avxmpfr_array *x, const avxmpfr_array *y, int64_t *lo, int64_t *hi)
+{
+    const __m512i zero = _mm512_set1_epi64(AVXMPFR_EXP_ZERO);
+    __m512i low = _mm512_set1_epi64(INT64_MAX);
+    __m512i high = _mm512_set1_epi64(INT64_MIN);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(x->count); b++)
+    {
+	const uint64_t rest = x->count - b * AVXMPFR_BLOCK;
+	__mmask8 live = rest >= AVXMPFR_BLOCK ? 0xFF : (__mmask8) ((1 << rest) - 1);
+
+	__m512i e = _mm512_load_si512(avxmpfr_block_exp(x, b));
+	live &= _mm512_cmpneq_epi64_mask(e, zero);
+	if (y != NULL)
+	{
+	    const __m512i f = _mm512_load_si512(avxmpfr_block_exp(y, b));
+	    live &= _mm512_cmpneq_epi64_mask(f, zero);
+	    e = _mm512_add_epi64(e, f);
+	}
+	low = _mm512_mask_min_epi64(low, live, low, e);
+	high = _mm512_mask_max_epi64(high, live, high, e);
+    }
+
+    *lo = _mm512_reduce_min_epi64(low);
+    *hi = _mm512_reduce_max_epi64(high);
+    return *lo <= *hi;
+}
+
+// Limbs of an accumulator for terms of n limbs with exponents in [lo, hi], its bit 0 weighing 2^low. 0 if too wide
+int64_t blas_acc_size(int64_t lo, int64_t hi, int n, mpfr_exp_t *low)
+{
+    *low = lo - n * GMP_NUMB_BITS;
+    const int64_t size = acc_limbs(hi - *low);
+    return size <= AVXMPFR_BLAS_MAX_LIMBS ? size : 0;
+}
+
+// Zeroed, 64 byte aligned accumulator limbs, a multiple of 8. NULL if they cannot be allocated, the callers then
+// take the same path as for spans too wide for an accumulator
+uint64_t *blas_acc_alloc(int64_t limbs)
+{
+    uint64_t *acc = aligned_alloc(64, limbs * sizeof(uint64_t));
+    if (acc != NULL)
+	memset(acc, 0, limbs * sizeof(uint64_t));
+    return acc;
+}
+
+// Round the exact sum acc * 2^low into rop, acc is negated in place if negative
+static int acc_round(mpfr_t rop, uint64_t *acc, int64_t size, mpfr_exp_t low, mpfr_rnd_t rnd)
+{
+    int sign = 1;
+    if (acc[size - 1] >> (GMP_NUMB_BITS - 1))
+    {
+	mpn_neg(acc, acc, size);
+	sign = -1;
+    }
+
+    if (mpn_zero_p(acc, size))
+    {
+	mpfr_set_zero(rop, rnd == MPFR_RNDD ? -1 : 1);
+	return 0;
+    }
+    return avxmpfr_round_limbs(rop, sign, acc, size, low, rnd);
+}
+
+// Widest exponent range, for exact intermediate values. Returns the caller's range through emin / emax
+void blas_range_extend(mpfr_exp_t *emin, mpfr_exp_t *emax)
+{
+    *emin = mpfr_get_emin();
+    *emax = mpfr_get_emax();
+    mpfr_set_emin(mpfr_get_emin_min());
+    mpfr_set_emax(mpfr_get_emax_max());
+}
+
+int blas_range_restore(mpfr_t rop, int ternary, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    mpfr_set_emin(emin);
+    mpfr_set_emax(emax);
+    return mpfr_check_range(rop, ternary, rnd);
+}
+
+// Sum of alpha times the terms of kind, plus extra, with mpfr_sum(). For exponent spans too wide for an accumulator
+static int sum_fallback(mpfr_t rop, int kind, mpfr_srcptr alpha, const avxmpfr_array *x, uint64_t x_first,
+			const avxmpfr_array *y, uint64_t n, mpfr_srcptr extra, mpfr_rnd_t rnd)
+{
+    mpfr_t *terms = malloc((n + 1) * sizeof(mpfr_t));
+    mpfr_ptr *pointers = malloc((n + 1) * sizeof(mpfr_ptr));
+    mpfr_exp_t emin, emax;
+    mpfr_t b;
+
+    blas_range_extend(&emin, &emax);
+    mpfr_init2(b, x->precision);
+
+    // Every term is exact
+    for (uint64_t j = 0; j < n; j++)
+    {
+	mpfr_init2(terms[j], 2 * x->precision + (alpha != NULL ? mpfr_get_prec(alpha) : 0));
+	avxmpfr_array_get(terms[j], x, x_first + j, MPFR_RNDN);
+	if (kind == BLAS_ABS)
+	    mpfr_abs(terms[j], terms[j], MPFR_RNDN);
+	else if (kind == BLAS_SQUARE)
+	    mpfr_sqr(terms[j], terms[j], MPFR_RNDN);
+	else
+	{
+	    avxmpfr_array_get(b, y, j, MPFR_RNDN);
+	    mpfr_mul(terms[j], terms[j], b, MPFR_RNDN);
+	}
+	if (alpha != NULL)
+	    mpfr_mul(terms[j], terms[j], alpha, MPFR_RNDN);
+	pointers[j] = terms[j];
+    }
+    if (extra != NULL)
+	pointers[n] = (mpfr_ptr) extra;
+
+    int ternary = mpfr_sum(rop, pointers, n + (extra != NULL), rnd);
+
+    for (uint64_t j = 0; j < n; j++)
+	mpfr_clear(terms[j]);
+    mpfr_clear(b);
+    free(terms);
+    free(pointers);
+    return blas_range_restore(rop, ternary, rnd, emin, emax);
+}
+
+
+/* Reductions */
+
+void blas_reduce_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    const reduce_job *job = arg;
+    const int L = job->x->limbs;
+    uint64_t *acc = job->acc + part * job->size;
+    mp_limb_t a[8 + 2 * BLAS_FRAME] = {0}, b[8], p[16 + 2 * BLAS_FRAME] = {0};
+    mp_limb_t *term = p + BLAS_FRAME;
+    int sa, sb;
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	const int64_t ea = load_value(job->x, i, a + BLAS_FRAME, &sa);
+	if (ea == AVXMPFR_EXP_ZERO)
+	    continue;
+
+	if (job->kind == BLAS_ABS || (job->kind == BLAS_SUM && sa > 0))
+	    acc_add(acc, job->size, a + BLAS_FRAME, L, ea - L * GMP_NUMB_BITS - job->low, 0);
+	else if (job->kind == BLAS_SUM)
+	    acc_add(acc, job->size, a + BLAS_FRAME, L, ea - L * GMP_NUMB_BITS - job->low, 1);
+	else if (job->kind == BLAS_SQUARE)
+	{
+	    mpn_sqr(term, a + BLAS_FRAME, L);
+	    acc_add(acc, job->size, term, 2 * L, 2 * ea - 2 * L * GMP_NUMB_BITS - job->low, 0);
+	}
+	else
+	{
+	    const int64_t eb = load_value(job->y, i, b, &sb);
+	    if (eb == AVXMPFR_EXP_ZERO)
+		continue;
+	    mpn_mul_n(term, a + BLAS_FRAME, b, L);
+	    if (sa != sb)
+		acc_add(acc, job->size, term, 2 * L, ea + eb - 2 * L * GMP_NUMB_BITS - job->low, 1);
+	    else
+		acc_add(acc, job->size, term, 2 * L, ea + eb - 2 * L * GMP_NUMB_BITS - job->low, 0);
+	}
+    }
+}
+
+// Exact sum of the terms of kind into a fresh accumulator, returns it (NULL if too wide) with its size and low
+static uint64_t *reduce(int kind, const avxmpfr_array *x, const avxmpfr_array *y, int64_t lo, int64_t hi,
+			int64_t *size, mpfr_exp_t *low)
+{
+    const int n = (kind == BLAS_ABS ? 1 : 2) * x->limbs;
+    *size = blas_acc_size(lo, hi, n, low);
+    if (*size == 0)
+	return NULL;
+
+    const int parts = blas_parts(x->count, x->count, AVXMPFR_BLAS_THREAD_MIN);
+    reduce_job job = {x, y, kind, *low, *size, blas_acc_alloc(parts * *size)};
+    if (job.acc == NULL)
+	return NULL;
+    blas_run(blas_reduce_part, &job, parts, x->count);
+
+    // Two's complement, the per thread sums add up modulo the size
+    for (int p = 1; p < parts; p++)
+	mpn_add_n(job.acc, job.acc, job.acc + p * *size, *size);
+    return job.acc;
+}
+
+static int reduce_round(mpfr_t rop, int kind, const avxmpfr_array *x, const avxmpfr_array *y, mpfr_rnd_t rnd)
+{
+    int64_t lo, hi, size;
+    mpfr_exp_t low;
+
+    if (!blas_term_bounds(x, y, &lo, &hi))
+    {
+	mpfr_set_zero(rop, 1);
+	return 0;
+    }
+
+    uint64_t *acc = reduce(kind, x, y, lo, hi, &size, &low);
+    if (acc == NULL)
+	return sum_fallback(rop, kind, NULL, x, 0, y, x->count, NULL, rnd);
+
+    const int ternary = acc_round(rop, acc, size, low, rnd);
+    free(acc);
+    return ternary;
+}
+
+int avxmpfr_dot(mpfr_t rop, const avxmpfr_array *x, const avxmpfr_array *y, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the sum of x_i * y_i, rounded once with rnd
+	x and y are packed arrays of the same precision and count
+
+	Returns the ternary value, as mpfr does
+    */
+
+    return reduce_round(rop, BLAS_DOT, x, y, rnd);
+}
+
+int avxmpfr_asum(mpfr_t rop, const avxmpfr_array *x, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the sum of |x_i|, rounded once with rnd. Returns the ternary value
+    */
+
+    return reduce_round(rop, BLAS_ABS, x, NULL, rnd);
+}
+
+int avxmpfr_nrm2(mpfr_t rop, const avxmpfr_array *x, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the square root of the sum of x_i^2, rounded once with rnd. Returns the ternary value
+    */
+
+    int64_t lo, hi, size;
+    mpfr_exp_t low, emin, emax;
+    mpfr_t sum;
+    int ternary;
+
+    if (!blas_term_bounds(x, x, &lo, &hi))
+    {
+	mpfr_set_zero(rop, 1);
+	return 0;
+    }
+
+    uint64_t *acc = reduce(BLAS_SQUARE, x, NULL, lo, hi, &size, &low);
+    blas_range_extend(&emin, &emax);
+    if (acc != NULL)
+    {
+	// The exact sum, then a single rounding in mpfr_sqrt()
+	mpfr_init2(sum, size * GMP_NUMB_BITS);
+	acc_round(sum, acc, size, low, MPFR_RNDN);
+	free(acc);
+    }
+    else
+    {
+	// Rounding to odd on 2 p + 2 bits keeps the sum on the same side of every square of a p + 1 bit number
+	mpfr_init2(sum, 2 * mpfr_get_prec(rop) + 2);
+	if (sum_fallback(sum, BLAS_SQUARE, NULL, x, 0, NULL, x->count, NULL, MPFR_RNDZ) != 0)
+	    sum->_mpfr_d[0] |= (mp_limb_t) 1 << ((-mpfr_get_prec(sum)) & (GMP_NUMB_BITS - 1));
+    }
+
+    ternary = mpfr_sqrt(rop, sum, rnd);
+    mpfr_clear(sum);
+    return blas_range_restore(rop, ternary, rnd, emin, emax);
+}
+
+
+/* Elementwise */
+
+typedef struct
+{
+    avxmpfr_array *y;
+    const avxmpfr_array *x;
+    mpfr_srcptr alpha;
+    mpfr_rnd_t rnd;
+    int failed;
+} scale_job;
+
+// avxmpfr_round_up_p() without a branch on the data, the bits are 0 or 1
+static inline int round_up(int sign, int lsb, int round_bit, int sticky, mpfr_rnd_t rnd)
+{
+    const int inexact = round_bit | sticky;
+    if (rnd == MPFR_RNDN)
+	return round_bit & (sticky | lsb);
+    if (rnd == MPFR_RNDA)
+	return inexact;
+    if (rnd == MPFR_RNDU)
+	return inexact & (sign > 0);
+    if (rnd == MPFR_RNDD)
+	return inexact & (sign < 0);
+    return 0;
+}
+
+// Round sign * src * 2^exp (n limbs) to the array precision straight into the padded lanes of value index, without
+// an mpfr_t in between. An exact zero is +0, -0 under MPFR_RNDD. emin / emax are the exponent range of the caller.
+// Returns -1 if the result overflowed
+int blas_store_rounded(avxmpfr_array *array, uint64_t index, int sign, const mp_limb_t *src, int n, int64_t exp,
+		       mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    const uint64_t b = index / AVXMPFR_BLOCK;
+    const int lane = index % AVXMPFR_BLOCK;
+    const int L = array->limbs;
+
+    while (n > 0 && src[n - 1] == 0)
+	n--;
+
+    if (n == 0)
+    {
+	store_lanes(array, b, lane, _mm512_setzero_si512());
+	avxmpfr_block_exp(array, b)[lane] = AVXMPFR_EXP_ZERO;
+	avxmpfr_block_sign(array, b)[lane] = rnd == MPFR_RNDD ? -1 : 1;
+	return 0;
+    }
+
+    // The top L limbs with the leading bit at the very top, the rest only matters as sticky bits
+    const int shift = __builtin_clzl(src[n - 1]);
+    #define SRC(j) ((j) >= 0 ? src[j] : 0)
+    mp_limb_t top[8], rest = 0;
+    for (int j = 0; j < L; j++)
+	top[j] = (SRC(n - L + j) << shift) | ((SRC(n - L + j - 1) >> 1) >> (GMP_NUMB_BITS - 1 - shift));
+    if (n - L - 1 >= 0)
+	rest = src[n - L - 1] << shift;
+    for (int j = 0; j < n - L - 1; j++)
+	rest |= src[j];
+    #undef SRC
+
+    // 63 L bits are kept, the L bits under them in top[0] hold the round bit
+    const mp_limb_t ulp = (mp_limb_t) 1 << L;
+    const int round_bit = (top[0] >> (L - 1)) & 1;
+    const int sticky = ((top[0] & ((ulp >> 1) - 1)) | rest) != 0;
+    int64_t e = exp + (int64_t) n * GMP_NUMB_BITS - shift;
+
+    // Adding zero rather than branching on the rounding, which goes either way at random
+    top[0] &= ~(ulp - 1);
+    const mp_limb_t up = round_up(sign, (top[0] & ulp) != 0, round_bit, sticky, rnd);
+    if (mpn_add_1(top, top, L, ulp & -up))
+    {
+	// Rounded up to the next power of two
+	top[L - 1] = (mp_limb_t) 1 << (GMP_NUMB_BITS - 1);
+	e++;
+    }
+
+    if (e < emin || e > emax)
+    {
+	// Overflow and underflow the mpfr way
+	mpfr_t result;
+	mpfr_init2(result, array->precision);
+	avxmpfr_round_limbs(result, sign, src, n, exp, rnd);
+	const int failed = avxmpfr_array_set(array, index, result);
+	mpfr_clear(result);
+	return failed;
+    }
+
+    store_lanes(array, b, lane, avxmpfr_window_to_lanes8(_mm512_maskz_expandloadu_epi64((__mmask8) (0xFF << (8 - L)), top), L));
+    avxmpfr_block_exp(array, b)[lane] = e;
+    avxmpfr_block_sign(array, b)[lane] = sign;
+    return 0;
+}
+
+// Store a zero of the given sign as value index
+void blas_store_zero(avxmpfr_array *array, uint64_t index, int sign)
+{
+    mpfr_t zero;
+    mpfr_init2(zero, MPFR_PREC_MIN);
+    mpfr_set_zero(zero, sign);
+    avxmpfr_array_set(array, index, zero);
+    mpfr_clear(zero);
+}
+
+// The exact product of alpha and the L limbs of d
+static inline void alpha_mul(mp_limb_t *p, mpfr_srcptr alpha, int na, const mp_limb_t *d, int L)
+{
+    if (na == L)
+	mpn_mul_n(p, alpha->_mpfr_d, d, L);
+    else if (na > L)
+	mpn_mul(p, alpha->_mpfr_d, na, d, L);
+    else
+	mpn_mul(p, d, L, alpha->_mpfr_d, na);
+}
+
+static void scal_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    scale_job *job = arg;
+    avxmpfr_array *x = job->y;
+    const int L = x->limbs;
+    const int na = (mpfr_get_prec(job->alpha) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const int sa = mpfr_signbit(job->alpha) ? -1 : 1;
+    mp_limb_t d[8], p[na + L];
+    const mpfr_exp_t emin = mpfr_get_emin(), emax = mpfr_get_emax();
+    int sx;
+    (void) part;
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	const int64_t ex = load_value(x, i, d, &sx);
+
+	if (ex == AVXMPFR_EXP_ZERO || mpfr_zero_p(job->alpha))
+	{
+	    if (ex == AVXMPFR_EXP_ZERO)
+		sx = avxmpfr_block_sign(x, i / AVXMPFR_BLOCK)[i % AVXMPFR_BLOCK];
+	    blas_store_zero(x, i, sa * sx);
+	    continue;
+	}
+
+	alpha_mul(p, job->alpha, na, d, L);
+	if (blas_store_rounded(x, i, sa * sx, p, na + L, job->alpha->_mpfr_exp + ex - (na + L) * GMP_NUMB_BITS, job->rnd,
+			       emin, emax))
+	    job->failed = 1;
+    }
+}
+
+// sp * p * 2^(ep - np 64) + sb * b * 2^(eb - L 64) rounded once into value i of y, neither of them zero. p and b are
+// framed for acc_add(), mpfr_add() on views of the limbs takes the gaps too wide for a local accumulator
+int blas_add_one(avxmpfr_array *y, uint64_t i, mp_limb_t *p, int np, int64_t ep, int sp, mp_limb_t *b, int64_t eb,
+		 int sb, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    const int L = y->limbs;
+    const mpfr_exp_t low = (ep - np * GMP_NUMB_BITS < eb - L * GMP_NUMB_BITS) ? ep - np * GMP_NUMB_BITS
+									       : eb - L * GMP_NUMB_BITS;
+    const int64_t size = acc_limbs((ep > eb ? ep : eb) - low);
+
+    if (size > BLAS_AXPY_LIMBS)
+    {
+	// A view needs the top bit set, a product may have it one bit lower
+	const int shift = __builtin_clzl(p[np - 1]);
+	if (shift > 0)
+	    mpn_lshift(p, p, np, shift);
+	__mpfr_struct x = {np * GMP_NUMB_BITS, sp, ep - shift, p};
+	__mpfr_struct old = {L * GMP_NUMB_BITS, sb, eb, b};
+	mpfr_t result;
+	mpfr_init2(result, y->precision);
+	mpfr_add(result, &x, &old, rnd);
+	const int failed = avxmpfr_array_set(y, i, result);
+	mpfr_clear(result);
+	return failed;
+    }
+
+    uint64_t acc[BLAS_AXPY_LIMBS] __attribute__((aligned(64)));
+    memset(acc, 0, size * sizeof(uint64_t));
+    if (sp < 0)
+	acc_add(acc, size, p, np, ep - np * GMP_NUMB_BITS - low, 1);
+    else
+	acc_add(acc, size, p, np, ep - np * GMP_NUMB_BITS - low, 0);
+    if (sb < 0)
+	acc_add(acc, size, b, L, eb - L * GMP_NUMB_BITS - low, 1);
+    else
+	acc_add(acc, size, b, L, eb - L * GMP_NUMB_BITS - low, 0);
+
+    int sign = 1;
+    if (acc[size - 1] >> (GMP_NUMB_BITS - 1))
+    {
+	mpn_neg(acc, acc, size);
+	sign = -1;
+    }
+    return blas_store_rounded(y, i, sign, acc, size, low, rnd, emin, emax);
+}
+
+// y_i + alpha x_i rounded once into value i of y. dx has L limbs, dy is framed for acc_add()
+static int axpy_one(avxmpfr_array *y, uint64_t i, mpfr_srcptr alpha, int na, mp_limb_t *dx, int64_t ex, int sx,
+		    mp_limb_t *dy, int64_t ey, int sy, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    const int L = y->limbs;
+    mp_limb_t frame[na + L + 2 * BLAS_FRAME];
+    memset(frame, 0, sizeof(frame));
+    alpha_mul(frame + BLAS_FRAME, alpha, na, dx, L);
+    return blas_add_one(y, i, frame + BLAS_FRAME, na + L, alpha->_mpfr_exp + ex, (mpfr_signbit(alpha) ? -1 : 1) * sx,
+			dy, ey, sy, rnd, emin, emax);
+}
+
+static void axpy_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    scale_job *job = arg;
+    const int L = job->y->limbs;
+    const int na = (mpfr_get_prec(job->alpha) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const int sa = mpfr_signbit(job->alpha) ? -1 : 1;
+    mp_limb_t dx[8], dy[8 + 2 * BLAS_FRAME] = {0}, p[na + L];
+    const mpfr_exp_t emin = mpfr_get_emin(), emax = mpfr_get_emax();
+    int sx, sy;
+    (void) part;
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	const int64_t ex = load_value(job->x, i, dx, &sx);
+	const int64_t ey = load_value(job->y, i, dy + BLAS_FRAME, &sy);
+	int failed;
+
+	if (ex == AVXMPFR_EXP_ZERO || mpfr_zero_p(job->alpha))
+	{
+	    // Nothing to add, but the sum of two zeros follows the rounding mode as in mpfr
+	    if (ey != AVXMPFR_EXP_ZERO)
+		continue;
+	    const int sp = sa * avxmpfr_block_sign(job->x, i / AVXMPFR_BLOCK)[i % AVXMPFR_BLOCK];
+	    sy = avxmpfr_block_sign(job->y, i / AVXMPFR_BLOCK)[i % AVXMPFR_BLOCK];
+	    blas_store_zero(job->y, i, sp == sy ? sy : (job->rnd == MPFR_RNDD ? -1 : 1));
+	    continue;
+	}
+
+	if (ey == AVXMPFR_EXP_ZERO)
+	{
+	    alpha_mul(p, job->alpha, na, dx, L);
+	    failed = blas_store_rounded(job->y, i, sa * sx, p, na + L,
+					job->alpha->_mpfr_exp + ex - (na + L) * GMP_NUMB_BITS, job->rnd, emin, emax);
+	}
+	else
+	    failed = axpy_one(job->y, i, job->alpha, na, dx, ex, sx, dy + BLAS_FRAME, ey, sy, job->rnd, emin, emax);
+
+	if (failed)
+	    job->failed = 1;
+    }
+}
+
+int avxmpfr_scal(avxmpfr_array *x, mpfr_t alpha, mpfr_rnd_t rnd)
+{
+    /*
+	x_i becomes alpha * x_i, each rounded once to the array precision with rnd
+	alpha may have any precision
+
+	Returns 0, or -1 if alpha is NaN or infinite or a product overflowed (those values are left as they were)
+    */
+
+    if (mpfr_nan_p(alpha) || mpfr_inf_p(alpha))
+	return -1;
+
+    scale_job job = {x, x, alpha, rnd, 0};
+    blas_run(scal_part, &job, blas_parts(x->count, x->count, AVXMPFR_BLAS_THREAD_MIN), x->count);
+    return job.failed ? -1 : 0;
+}
+
+int avxmpfr_axpy(avxmpfr_array *y, mpfr_t alpha, const avxmpfr_array *x, mpfr_rnd_t rnd)
+{
+    /*
+	y_i becomes alpha * x_i + y_i, each rounded once to the array precision with rnd (as mpfr_fma() would)
+	x and y are packed arrays of the same precision and count, alpha may have any precision
+
+	Returns 0, or -1 if alpha is NaN or infinite or a result overflowed (those values are left as they were)
+    */
+
+    if (mpfr_nan_p(alpha) || mpfr_inf_p(alpha))
+	return -1;
+
+    scale_job job = {y, x, alpha, rnd, 0};
+    blas_run(axpy_part, &job, blas_parts(y->count, y->count, AVXMPFR_BLAS_THREAD_MIN), y->count);
+    return job.failed ? -1 : 0;
+}
+
+
+/* Matrix vector product */
+
+typedef struct
+{
+    const avxmpfr_array *A;
+    const avxmpfr_array *x;
+    uint64_t columns;
+    mpfr_exp_t low;
+    int64_t size;
+    uint64_t *acc;	// size limbs for each row
+} gemv_job;
+
+static void gemv_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    const gemv_job *job = arg;
+    const int L = job->A->limbs;
+    const uint64_t n = job->columns;
+    mp_limb_t *staged = aligned_alloc(64, AVXMPFR_BLAS_PANEL * 8 * sizeof(mp_limb_t));
+    int64_t staged_exp[AVXMPFR_BLAS_PANEL];
+    int staged_sign[AVXMPFR_BLAS_PANEL];
+    mp_limb_t a[8], p[16 + 2 * BLAS_FRAME] = {0};
+    mp_limb_t *term = p + BLAS_FRAME;
+    int sa;
+    (void) part;
+
+    for (uint64_t i0 = first; i0 < last; i0 += AVXMPFR_BLAS_ROWS)
+    {
+	const uint64_t i1 = i0 + AVXMPFR_BLAS_ROWS < last ? i0 + AVXMPFR_BLAS_ROWS : last;
+
+	for (uint64_t j0 = 0; j0 < n; j0 += AVXMPFR_BLAS_PANEL)
+	{
+	    const uint64_t j1 = j0 + AVXMPFR_BLAS_PANEL < n ? j0 + AVXMPFR_BLAS_PANEL : n;
+
+	    // Unpack the panel of x once for the whole block of rows
+	    for (uint64_t j = j0; j < j1; j++)
+		staged_exp[j - j0] = load_value(job->x, j, staged + (j - j0) * L, &staged_sign[j - j0]);
+
+	    for (uint64_t i = i0; i < i1; i++)
+	    {
+		uint64_t *acc = job->acc + i * job->size;
+
+		for (uint64_t j = j0; j < j1; j++)
+		{
+		    const int64_t ex = staged_exp[j - j0];
+		    if (ex == AVXMPFR_EXP_ZERO)
+			continue;
+		    const int64_t ea = load_value(job->A, i * n + j, a, &sa);
+		    if (ea == AVXMPFR_EXP_ZERO)
+			continue;
+
+		    mpn_mul_n(term, a, staged + (j - j0) * L, L);
+		    if (sa != staged_sign[j - j0])
+			acc_add(acc, job->size, term, 2 * L, ea + ex - 2 * L * GMP_NUMB_BITS - job->low, 1);
+		    else
+			acc_add(acc, job->size, term, 2 * L, ea + ex - 2 * L * GMP_NUMB_BITS - job->low, 0);
+		}
+	    }
+	}
+    }
+
+    free(staged);
+}
+
+int avxmpfr_gemv(avxmpfr_array *y, mpfr_t alpha, const avxmpfr_array *A, uint64_t rows, uint64_t columns,
+		 const avxmpfr_array *x, mpfr_t beta, mpfr_rnd_t rnd)
+{
+    /*
+	y becomes alpha * A x + beta * y, each y_i rounded once to the array precision with rnd
+	A holds rows * columns values row by row, x holds columns values and y rows values, all of one precision
+	alpha and beta may have any precision
+
+	Returns 0, or -1 if alpha or beta is NaN or infinite or a result overflowed (those values are left as they were)
+    */
+
+    if (mpfr_nan_p(alpha) || mpfr_inf_p(alpha) || mpfr_nan_p(beta) || mpfr_inf_p(beta))
+	return -1;
+
+    int64_t lo_A, hi_A, lo_x, hi_x, size = 0;
+    mpfr_exp_t low = 0, emin, emax;
+    int failed = 0;
+    const int nonzero = blas_term_bounds(A, NULL, &lo_A, &hi_A) && blas_term_bounds(x, NULL, &lo_x, &hi_x);
+
+    // Every row shares one geometry, from the extreme products
+    uint64_t *acc = NULL;
+    if (nonzero && (size = blas_acc_size(lo_A + lo_x, hi_A + hi_x, 2 * A->limbs, &low)) > 0)
+    {
+	// Rows go through sum_fallback() below if the accumulators cannot be allocated
+	if ((acc = blas_acc_alloc(rows * size)) != NULL)
+	{
+	    gemv_job job = {A, x, columns, low, size, acc};
+	    blas_run(gemv_part, &job, blas_parts(rows * columns, rows, AVXMPFR_BLAS_THREAD_MIN), rows);
+	}
+    }
+
+    mpfr_t dot, old, result;
+    mpfr_init2(dot, size > 0 ? size * GMP_NUMB_BITS : MPFR_PREC_MIN);
+    mpfr_init2(old, y->precision);
+    mpfr_init2(result, y->precision);
+
+    for (uint64_t i = 0; i < rows; i++)
+    {
+	int ternary;
+	avxmpfr_array_get(old, y, i, MPFR_RNDN);
+
+	if (nonzero && acc == NULL)
+	{
+	    mpfr_t extra;
+	    mpfr_init2(extra, mpfr_get_prec(beta) + y->precision);
+	    mpfr_mul(extra, beta, old, MPFR_RNDN);
+	    ternary = sum_fallback(result, BLAS_DOT, alpha, A, i * columns, x, columns, extra, rnd);
+	    mpfr_clear(extra);
+	}
+	else
+	{
+	    // The exact row sum, then one rounding for alpha * dot + beta * y_i
+	    blas_range_extend(&emin, &emax);
+	    if (acc != NULL)
+		acc_round(dot, acc + i * size, size, low, MPFR_RNDN);
+	    else
+		mpfr_set_zero(dot, 1);
+	    ternary = mpfr_fmma(result, alpha, dot, beta, old, rnd);
+	    ternary = blas_range_restore(result, ternary, rnd, emin, emax);
+	}
+	(void) ternary;
+
+	if (avxmpfr_array_set(y, i, result) != 0)
+	    failed = 1;
+    }
+
+    mpfr_clear(dot);
+    mpfr_clear(old);
+    mpfr_clear(result);
+    free(acc);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,135 @@
+// avxmpfr_blas.h
+
+/*
+    The parts of avxmpfr_blas.c that the prefix sums of avxmpfr_scan.c share: the threads, the exact fixed point
+    accumulators and the rounding of limbs straight into packed arrays. Internal, not part of avxmpfr_utilities.h.
+*/
+
+#ifndef AVXMPFR_BLAS_H
+#define AVXMPFR_BLAS_H
+
+#include "avxmpfr_windows.h"
+
+#define BLAS_SPARE 2		// Accumulator limbs above the terms, for the carries of up to 2^64 terms and the sign
+#define BLAS_FRAME 8		// Zero limbs on either side of a term handed to acc_add()
+
+enum { BLAS_DOT, BLAS_ABS, BLAS_SQUARE, BLAS_SUM };
+
+// Work on the values [first, last) as part part of a call split over threads
+typedef void (*blas_work)(void *job, int part, uint64_t first, uint64_t last);
+
+typedef struct
+{
+    const avxmpfr_array *x;
+    const avxmpfr_array *y;
+    int kind;
+    mpfr_exp_t low;
+    int64_t size;
+    uint64_t *acc;	// size limbs for each part
+} reduce_job;
+
+
+/* Packed values */
+
+// The padded lanes of value lane of block b in one register, lane k in element k
+static inline __m512i load_lanes(const avxmpfr_array *array, uint64_t b, int lane)
+{
+    const __mmask8 live = (__mmask8) ((1 << array->limbs) - 1);
+    const uint64_t *block = avxmpfr_block(array, b);
+    if (array->layout == AVXMPFR_LAYOUT_SOA)
+	return _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), live,
+					   _mm512_set_epi64(56, 48, 40, 32, 24, 16, 8, 0), block + lane, 8);
+    return _mm512_maskz_loadu_epi64(live, block + lane * array->limbs);
+}
+
+static inline void store_lanes(avxmpfr_array *array, uint64_t b, int lane, __m512i lanes)
+{
+    const __mmask8 live = (__mmask8) ((1 << array->limbs) - 1);
+    uint64_t *block = avxmpfr_block(array, b);
+    if (array->layout == AVXMPFR_LAYOUT_SOA)
+	_mm512_mask_i64scatter_epi64(block + lane, live, _mm512_set_epi64(56, 48, 40, 32, 24, 16, 8, 0), lanes, 8);
+    else
+	_mm512_mask_storeu_epi64(block + lane * array->limbs, live, lanes);
+}
+
+// Load value index into d (array->limbs limbs, top bit set) and its sign, returns the exponent or AVXMPFR_EXP_ZERO
+static inline int64_t load_value(const avxmpfr_array *array, uint64_t index, mp_limb_t *d, int *sign)
+{
+    const uint64_t b = index / AVXMPFR_BLOCK;
+    const int lane = index % AVXMPFR_BLOCK;
+    const int64_t exp = avxmpfr_block_exp(array, b)[lane];
+
+    if (exp == AVXMPFR_EXP_ZERO)
+	return exp;
+
+    *sign = avxmpfr_block_sign(array, b)[lane];
+    avxmpfr_unpack_lanes8(d, load_lanes(array, b, lane), array->limbs, array->limbs);
+    return exp;
+}
+
+
+/* Exact fixed point accumulators */
+
+// Limbs of an accumulator for terms spanning bits, whole lines of 8 so that acc_add() stays inside
+static inline int64_t acc_limbs(int64_t bits)
+{
+    return (bits / GMP_NUMB_BITS + 1 + BLAS_SPARE + 7) & ~7;
+}
+
+// Add (subtract) the n limb natural p, shifted up by off bits, into the size limbs of acc. The 8 limbs on either side
+// of p must be readable zeros. acc is 64 byte aligned and only ever touched a whole line at a time, so each load gets
+// its data forwarded from the store of the previous term, whatever the offsets of the two.
+static inline void acc_add(uint64_t *acc, int64_t size, const mp_limb_t *p, int n, int64_t off, const int subtract)
+{
+    const int64_t q = off / GMP_NUMB_BITS;
+    const int t = q % 8;
+    const __m512i left = _mm512_set1_epi64(off % GMP_NUMB_BITS);
+    const __m512i right = _mm512_set1_epi64(GMP_NUMB_BITS - off % GMP_NUMB_BITS);	// 64 shifts everything out
+    uint64_t *line = acc + q - t;
+    unsigned carry = 0;
+
+    // n + 1 limbs once shifted, lane j of a line takes limb k + j which holds the top bits of p[k + j - 1]
+    for (int k = -t; k <= n; k += 8, line += 8)
+    {
+	const __m512i s = _mm512_or_si512(_mm512_sllv_epi64(_mm512_loadu_si512(p + k), left),
+					  _mm512_srlv_epi64(_mm512_loadu_si512(p + k - 1), right));
+	__m512i r;
+	carry = avxmpn_block_aors(_mm512_load_si512(line), s, carry, &r, subtract) >> 8;
+	_mm512_store_si512(line, r);
+    }
+
+    // The carry (borrow) out of the last line moves on through the limbs above
+    for (; carry && line < acc + size; line++)
+	carry = subtract ? (*line)-- == 0 : ++(*line) == 0;
+}
+
+
+/* avxmpfr_blas.c */
+
+// Number of threads for total values, per_thread each at least, at most rows / AVXMPFR_BLOCK parts when splitting rows
+int blas_parts(uint64_t total, uint64_t rows, uint64_t per_thread);
+// Run work over [0, count) in parts, split on block boundaries, part 0 on the calling thread
+void blas_run(blas_work work, void *job, int parts, uint64_t count);
+
+// Smallest and largest exponent of the nonzero x_i, or of the products x_i y_i. Returns 0 if every term is zero
+int blas_term_bounds(const avxmpfr_array *x, const avxmpfr_array *y, int64_t *lo, int64_t *hi);
+// Limbs of an accumulator for terms of n limbs with exponents in [lo, hi], its bit 0 weighing 2^low. 0 if too wide
+int64_t blas_acc_size(int64_t lo, int64_t hi, int n, mpfr_exp_t *low);
+// Zeroed, 64 byte aligned accumulator limbs, a multiple of 8. NULL if they cannot be allocated
+uint64_t *blas_acc_alloc(int64_t limbs);
+// Add the terms [first, last) of a reduce_job into the accumulator of part
+void blas_reduce_part(void *arg, int part, uint64_t first, uint64_t last);
+
+// Widest exponent range for exact intermediate values, then back to the caller's one through mpfr_check_range()
+void blas_range_extend(mpfr_exp_t *emin, mpfr_exp_t *emax);
+int blas_range_restore(mpfr_t rop, int ternary, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax);
+
+// Round sign * src * 2^exp (n limbs) into value index of array, -1 if it overflowed. Or store a zero of the given sign
+int blas_store_rounded(avxmpfr_array *array, uint64_t index, int sign, const mp_limb_t *src, int n, int64_t exp,
+		       mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax);
+void blas_store_zero(avxmpfr_array *array, uint64_t index, int sign);
+// sp * p * 2^(ep - np 64) + sb * b * 2^(eb - L 64) rounded once into value i of y, p and b framed for acc_add()
+int blas_add_one(avxmpfr_array *y, uint64_t i, mp_limb_t *p, int np, int64_t ep, int sp, mp_limb_t *b, int64_t eb,
+		 int sb, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax);
+
+#endif // AVXMPFR_BLAS_H
@@ -0,0 +1,364 @@
+// avxmpfr_bucket.c
+
+/*
+    Batched addition of packed arrays with the pairs scheduled by exponent gap, avxmpfr_add_array_bucketed().
+
+    The per pair loop of avxmpfr_add_array() branches on the data twice: avxmpfr_shift_padded252() /
+    avxmpfr_shift_padded504() take a different path for every kind of gap, and the carry loop of avx_add() /
+    avx_add_512i() runs as many times as the carries of that pair need. On a batch where these change from one pair to
+    the next most of those branches are mispredicted.
+
+    Here the pairs of each tile of BUCKET_TILE values are classified first, without branches, into lists of indices:
+	BUCKET_EQUAL	equal exponents, nothing to allign
+	BUCKET_SMALL	a gap below 63 bits, a bit shift with the top of the lane above
+	BUCKET_LIMB	a gap of whole lanes, a lane permute only
+	BUCKET_SPLIT	any other gap within the lanes, a lane permute and a bit shift
+	BUCKET_FAR	a gap past the lanes (or one operand zero), the sum is the bigger operand
+	BUCKET_FALLBACK	different signs, handed to mpfr_add()
+    and then every list goes through a loop specialised for its class, each sum written back at its own index.
+    Whether a sum carries is not known before the add, so instead of a class the carries get a branch free
+    resolution in every loop: the lanes that overflow (generate) and the lanes that are all ones (propagate) are
+    turned into masks and a carry lookahead gives every lane its carry in, as in avxmpn.c. The normalisation is a
+    blend with the sum shifted right by one.
+
+    The results are those of avxmpfr_add_array(): the smaller operand is truncated when alligned and the sum when
+    normalised, pairs with different signs go through mpfr_add() with MPFR_RNDZ. Arrays in the SoA layout are handed
+    to avxmpfr_add_array(), whose lanes already run without branches.
+*/
+
+#include "avxmpfr_utilities.h"
+
+#define BUCKET_TILE 256		// Values classified at a time, the index lists stay in the L1 cache
+
+#define BUCKET_EQUAL 0
+#define BUCKET_SMALL 1
+#define BUCKET_LIMB 2
+#define BUCKET_SPLIT 3
+#define BUCKET_FAR 4
+#define BUCKET_FALLBACK 5
+#define BUCKET_CLASSES 6
+
+#define FORCE_INLINE static inline __attribute__((always_inline))
+
+// Bits 0 .. 7 of each byte in the opposite order
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+static const uint8_t reverse8[256] = {R6(0), R6(2), R6(1), R6(3)};
+#undef R2
+#undef R4
+#undef R6
+
+// Carry lookahead with the least significant lane in bit 0, bit k of the result is the carry into lane k
+FORCE_INLINE unsigned lookahead(unsigned generate, unsigned propagate)
+{
+    return ((generate << 1) + propagate) ^ propagate;
+}
+
+// Where value i of an array of L limb values keeps its limbs, exponent and sign, L being a constant so that the
+// block size is one too
+typedef struct
+{
+    uint64_t *limbs;
+    int64_t *exp;
+    int8_t *sign;
+} bucket_value;
+
+FORCE_INLINE bucket_value value_at(uint64_t *blocks, uint64_t i, const int L)
+{
+    uint64_t *block = blocks + (i / AVXMPFR_BLOCK) * avxmpfr_block_words(L);
+    const int lane = i % AVXMPFR_BLOCK;
+    return (bucket_value) {block + lane * L, (int64_t *) (block + AVXMPFR_BLOCK * L) + lane,
+			   (int8_t *) (block + AVXMPFR_BLOCK * L + AVXMPFR_BLOCK) + lane};
+}
+
+
+/* 252 bits, AVX2 */
+
+// Lane k takes lane k - q, lanes below q become zero
+FORCE_INLINE __m256i lanes252(__m256i y, int q)
+{
+    const __m256i index = _mm256_sub_epi32(_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_epi32(2 * q));
+    return _mm256_and_si256(_mm256_permutevar8x32_epi32(y, index), _mm256_cmpgt_epi32(index, _mm256_set1_epi32(-1)));
+}
+
+// whole shifted right by r bits, the bits of next (whole moved one lane further) coming in at the top
+FORCE_INLINE __m256i bits252(__m256i whole, __m256i next, int r)
+{
+    const __m256i low = _mm256_srl_epi64(whole, _mm_cvtsi32_si128(r));
+    const __m256i high = _mm256_sll_epi64(next, _mm_cvtsi32_si128(63 - r));
+    return _mm256_and_si256(_mm256_or_si256(low, high), _mm256_set1_epi64x(AVXMPFR_PAD_MASK));
+}
+
+// Resolve the carries of the lane sums s and normalise, truncating like avx_add()
+FORCE_INLINE __m256i carry252(__m256i s, mpfr_exp_t *exponent)
+{
+    const __m256i mask = _mm256_set1_epi64x(AVXMPFR_PAD_MASK);
+    const __m256i one = _mm256_set1_epi64x(1);
+
+    const unsigned generate = reverse8[_mm256_movemask_pd(_mm256_castsi256_pd(s))] >> 4;
+    s = _mm256_and_si256(s, mask);
+    const unsigned propagate = reverse8[_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(s, mask)))] >> 4;
+    const unsigned carry = lookahead(generate, propagate);
+
+    // Lane k takes bit 3 - k of carry, bit 4 is the carry out of lane 0
+    const __m256i carry_in = _mm256_and_si256(_mm256_srlv_epi64(_mm256_set1_epi64x(carry), _mm256_set_epi64x(0, 1, 2, 3)), one);
+    s = _mm256_and_si256(_mm256_add_epi64(s, carry_in), mask);
+
+    const int64_t normalise = carry >> 4;
+    const __m256i down = _mm256_permute4x64_epi64(s, _MM_SHUFFLE(2, 1, 0, 0));
+    __m256i top = _mm256_slli_epi64(_mm256_and_si256(down, one), 62);
+    top = _mm256_blend_epi32(top, _mm256_set1_epi64x(((int64_t) 1) << 62), 0x03);
+    const __m256i shifted = _mm256_or_si256(_mm256_srli_epi64(s, 1), top);
+    *exponent += normalise;
+    AVXMPFR_COUNT(normalisations, normalise);
+    return _mm256_blendv_epi8(s, shifted, _mm256_set1_epi64x(-normalise));
+}
+
+// The pairs of list, all of the class kind, first the index of the tile
+FORCE_INLINE void run252(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t first,
+			 const uint32_t *list, int count, const int kind)
+{
+    // Read once, the sign stores could otherwise alias the array structs
+    uint64_t *const blocks1 = op1->blocks, *const blocks2 = op2->blocks, *const blocks_rop = rop->blocks;
+
+    for (int t = 0; t < count; t++)
+    {
+	const bucket_value w1 = value_at(blocks1, first + list[t], 4);
+	const bucket_value w2 = value_at(blocks2, first + list[t], 4);
+	const bucket_value w3 = value_at(blocks_rop, first + list[t], 4);
+	const int64_t e1 = *w1.exp, e2 = *w2.exp;
+	const int64_t swap = e2 > e1;
+	mpfr_exp_t exponent = e1 + ((e2 - e1) & -swap);
+	const int64_t gap = ((e1 - e2) ^ -swap) + swap;
+	const int8_t sign = *w1.sign ^ ((*w1.sign ^ *w2.sign) & -swap);
+
+	// The bigger operand in x, with a blend as a branch on swap would be mispredicted half the time. Equal exponents
+	// add v1 and v2 straight away
+	const __m256i v1 = _mm256_load_si256((const __m256i *) w1.limbs);
+	const __m256i v2 = _mm256_load_si256((const __m256i *) w2.limbs);
+	const __m256i pick = _mm256_set1_epi64x(-swap);
+	const __m256i x = _mm256_blendv_epi8(v1, v2, pick);
+	const __m256i y = _mm256_blendv_epi8(v2, v1, pick);
+	__m256i result;
+	if (kind == BUCKET_EQUAL)
+	    result = carry252(_mm256_add_epi64(v1, v2), &exponent);
+	else if (kind == BUCKET_SMALL)
+	    result = carry252(_mm256_add_epi64(x, bits252(y, lanes252(y, 1), gap)), &exponent);
+	else if (kind == BUCKET_LIMB)
+	    result = carry252(_mm256_add_epi64(x, lanes252(y, gap / 63)), &exponent);
+	else if (kind == BUCKET_SPLIT)
+	{
+	    const int q = gap / 63;
+	    result = carry252(_mm256_add_epi64(x, bits252(lanes252(y, q), lanes252(y, q + 1), gap - 63 * q)), &exponent);
+	}
+	else
+	    result = x;
+
+	_mm256_store_si256((__m256i *) w3.limbs, result);
+	*w3.exp = exponent;
+	*w3.sign = sign;
+    }
+}
+
+
+/* 504 bits, AVX512 */
+
+FORCE_INLINE __m512i lanes504(__m512i y, int q)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm512_maskz_permutexvar_epi64((__mmask8) (0xFF << q), _mm512_sub_epi64(lane, _mm512_set1_epi64(q)), y);
+}
+
+FORCE_INLINE __m512i bits504(__m512i whole, __m512i next, int r)
+{
+    const __m512i low = _mm512_srl_epi64(whole, _mm_cvtsi32_si128(r));
+    const __m512i high = _mm512_sll_epi64(next, _mm_cvtsi32_si128(63 - r));
+    return _mm512_and_si512(_mm512_or_si512(low, high), _mm512_set1_epi64(AVXMPFR_PAD_MASK));
+}
+
+FORCE_INLINE __m512i carry504(__m512i s, mpfr_exp_t *exponent)
+{
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    const __m512i one = _mm512_set1_epi64(1);
+
+    const unsigned generate = reverse8[_mm512_test_epi64_mask(s, _mm512_set1_epi64(~AVXMPFR_PAD_MASK))];
+    s = _mm512_and_si512(s, mask);
+    const unsigned propagate = reverse8[_mm512_cmpeq_epi64_mask(s, mask)];
+    const unsigned carry = lookahead(generate, propagate);
+
+    // Lane k takes bit 7 - k of carry, bit 8 is the carry out of lane 0
+    s = _mm512_and_si512(_mm512_mask_add_epi64(s, (__mmask8) reverse8[carry & 0xFF], s, one), mask);
+
+    const int64_t normalise = carry >> 8;
+    const __m512i down = _mm512_maskz_permutexvar_epi64(0xFE, _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0), s);
+    __m512i shifted = _mm512_or_si512(_mm512_srli_epi64(s, 1), _mm512_slli_epi64(_mm512_and_si512(down, one), 62));
+    shifted = _mm512_mask_or_epi64(shifted, 0x01, shifted, _mm512_set1_epi64(((int64_t) 1) << 62));
+    *exponent += normalise;
+    AVXMPFR_COUNT(normalisations, normalise);
+    return _mm512_mask_blend_epi64((__mmask8) -normalise, s, shifted);
+}
+
+FORCE_INLINE void run504(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t first,
+			 const uint32_t *list, int count, const int kind)
+{
+    // Read once, the sign stores could otherwise alias the array structs
+    uint64_t *const blocks1 = op1->blocks, *const blocks2 = op2->blocks, *const blocks_rop = rop->blocks;
+
+    for (int t = 0; t < count; t++)
+    {
+	const bucket_value w1 = value_at(blocks1, first + list[t], 8);
+	const bucket_value w2 = value_at(blocks2, first + list[t], 8);
+	const bucket_value w3 = value_at(blocks_rop, first + list[t], 8);
+	const int64_t e1 = *w1.exp, e2 = *w2.exp;
+	const int64_t swap = e2 > e1;
+	mpfr_exp_t exponent = e1 + ((e2 - e1) & -swap);
+	const int64_t gap = ((e1 - e2) ^ -swap) + swap;
+	const int8_t sign = *w1.sign ^ ((*w1.sign ^ *w2.sign) & -swap);
+
+	// The bigger operand in x, with a blend as a branch on swap would be mispredicted half the time. Equal exponents
+	// add v1 and v2 straight away
+	const __m512i v1 = _mm512_load_si512((const void *) w1.limbs);
+	const __m512i v2 = _mm512_load_si512((const void *) w2.limbs);
+	const __mmask8 pick = (__mmask8) -swap;
+	const __m512i x = _mm512_mask_blend_epi64(pick, v1, v2);
+	const __m512i y = _mm512_mask_blend_epi64(pick, v2, v1);
+	__m512i result;
+	if (kind == BUCKET_EQUAL)
+	    result = carry504(_mm512_add_epi64(v1, v2), &exponent);
+	else if (kind == BUCKET_SMALL)
+	    result = carry504(_mm512_add_epi64(x, bits504(y, lanes504(y, 1), gap)), &exponent);
+	else if (kind == BUCKET_LIMB)
+	    result = carry504(_mm512_add_epi64(x, lanes504(y, gap / 63)), &exponent);
+	else if (kind == BUCKET_SPLIT)
+	{
+	    const int q = gap / 63;
+	    result = carry504(_mm512_add_epi64(x, bits504(lanes504(y, q), lanes504(y, q + 1), gap - 63 * q)), &exponent);
+	}
+	else
+	    result = x;
+
+	_mm512_store_si512((void *) w3.limbs, result);
+	*w3.exp = exponent;
+	*w3.sign = sign;
+    }
+}
+
+
+/* Scheduling */
+
+// Append the indices of the lanes set in m to list, its length in *count
+FORCE_INLINE void append(uint32_t *list, int *count, __m256i index, __mmask8 m)
+{
+    _mm512_storeu_si512((void *) (list + *count), _mm512_maskz_compress_epi32((__mmask16) m, _mm512_castsi256_si512(index)));
+    *count += __builtin_popcount(m);
+}
+
+// Sort the pairs first .. first + count - 1 into lists by class, a block of AVXMPFR_BLOCK pairs at a time with masks
+static void classify(const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t first, int count,
+		     uint32_t lists[BUCKET_CLASSES][BUCKET_TILE + 16], int counts[BUCKET_CLASSES], const int L)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i c63 = _mm512_set1_epi64(63);
+
+    for (int k = 0; k < BUCKET_CLASSES; k++)
+	counts[k] = 0;
+
+    for (int t = 0; t < count; t += AVXMPFR_BLOCK)
+    {
+	const uint64_t b = (first + t) / AVXMPFR_BLOCK;
+	const __mmask8 valid = (count - t >= AVXMPFR_BLOCK) ? 0xFF : (__mmask8) ((1 << (count - t)) - 1);
+	const __m512i e1 = _mm512_load_si512((const void *) avxmpfr_block_exp(op1, b));
+	const __m512i e2 = _mm512_load_si512((const void *) avxmpfr_block_exp(op2, b));
+	const __m512i s1 = _mm512_cvtepi8_epi64(_mm_loadl_epi64((const __m128i *) avxmpfr_block_sign(op1, b)));
+	const __m512i s2 = _mm512_cvtepi8_epi64(_mm_loadl_epi64((const __m128i *) avxmpfr_block_sign(op2, b)));
+
+	// Different signs go through mpfr unless exactly one operand is zero, the sum then being the other one
+	const __mmask8 zeros = _mm512_cmpeq_epi64_mask(e1, _mm512_set1_epi64(AVXMPFR_EXP_ZERO))
+			       ^ _mm512_cmpeq_epi64_mask(e2, _mm512_set1_epi64(AVXMPFR_EXP_ZERO));
+	const __mmask8 fallback = _mm512_cmpneq_epi64_mask(s1, s2) & ~zeros & valid;
+	const __mmask8 regular = valid & ~fallback;
+
+	// gap = 63 * q + r, 1041 / 2^16 is exact enough for 1 / 63 within the lanes
+	const __m512i gap = _mm512_abs_epi64(_mm512_sub_epi64(e1, e2));
+	const __m512i q = _mm512_srli_epi64(_mm512_mul_epu32(gap, _mm512_set1_epi64(1041)), 16);
+	const __m512i r = _mm512_sub_epi64(gap, _mm512_mul_epu32(q, c63));
+	const __mmask8 within = _mm512_cmplt_epi64_mask(gap, _mm512_set1_epi64(63 * L)) & regular;
+	const __mmask8 lanes = _mm512_cmpge_epi64_mask(gap, c63) & within;
+	const __mmask8 exact = _mm512_cmpeq_epi64_mask(r, zero);
+	AVXMPFR_STATS_ONLY(for (int l = 0; l < AVXMPFR_BLOCK; l++) if ((regular >> l) & 1) AVXMPFR_COUNT_GAP(gap[l]);)
+
+	const __m256i index = _mm512_cvtepi64_epi32(_mm512_add_epi64(lane, _mm512_set1_epi64(t)));
+	append(lists[BUCKET_EQUAL], &counts[BUCKET_EQUAL], index, _mm512_cmpeq_epi64_mask(gap, zero) & regular);
+	append(lists[BUCKET_SMALL], &counts[BUCKET_SMALL], index, _mm512_cmpgt_epi64_mask(gap, zero) & within & ~lanes);
+	append(lists[BUCKET_LIMB], &counts[BUCKET_LIMB], index, lanes & exact);
+	append(lists[BUCKET_SPLIT], &counts[BUCKET_SPLIT], index, lanes & ~exact);
+	append(lists[BUCKET_FAR], &counts[BUCKET_FAR], index, regular & ~within);
+	append(lists[BUCKET_FALLBACK], &counts[BUCKET_FALLBACK], index, fallback);
+    }
+}
+
+// The pairs of a list the kernels do not handle, with mpfr
+static void run_fallback(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t first,
+			 const uint32_t *list, int count, mpfr_t a, mpfr_t b)
+{
+    for (int t = 0; t < count; t++)
+    {
+	avxmpfr_array_get(a, op1, first + list[t], MPFR_RNDZ);
+	avxmpfr_array_get(b, op2, first + list[t], MPFR_RNDZ);
+	mpfr_add(a, a, b, MPFR_RNDZ);
+	avxmpfr_array_set(rop, first + list[t], a);
+    }
+    AVXMPFR_COUNT(fallbacks, count);
+}
+
+void avxmpfr_add_array_bucketed(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    /*
+	rop is the resultant array
+	op1 and op2 are the operand arrays
+	All three must have the same precision, layout and count. rop may be the same as op1 or op2.
+    */
+
+    if (rop->layout == AVXMPFR_LAYOUT_SOA)
+    {
+	avxmpfr_add_array(rop, op1, op2);
+	return;
+    }
+    AVXMPFR_COUNT(batched, rop->count);
+
+    const int L = rop->limbs;
+    uint32_t lists[BUCKET_CLASSES][BUCKET_TILE + 16];	// Room for the full width stores of append()
+    int counts[BUCKET_CLASSES];
+    mpfr_t a, b;
+    mpfr_inits2(rop->precision, a, b, (mpfr_ptr) 0);
+
+    for (uint64_t first = 0; first < rop->count; first += BUCKET_TILE)
+    {
+	const int count = (rop->count - first < BUCKET_TILE) ? rop->count - first : BUCKET_TILE;
+
+	// Constant limb counts and classes, so that every loop is compiled for its own case
+	if (L == 4)
+	{
+	    classify(op1, op2, first, count, lists, counts, 4);
+	    run252(rop, op1, op2, first, lists[BUCKET_EQUAL], counts[BUCKET_EQUAL], BUCKET_EQUAL);
+	    run252(rop, op1, op2, first, lists[BUCKET_SMALL], counts[BUCKET_SMALL], BUCKET_SMALL);
+	    run252(rop, op1, op2, first, lists[BUCKET_LIMB], counts[BUCKET_LIMB], BUCKET_LIMB);
+	    run252(rop, op1, op2, first, lists[BUCKET_SPLIT], counts[BUCKET_SPLIT], BUCKET_SPLIT);
+	    run252(rop, op1, op2, first, lists[BUCKET_FAR], counts[BUCKET_FAR], BUCKET_FAR);
+	}
+	else
+	{
+	    classify(op1, op2, first, count, lists, counts, 8);
+	    run504(rop, op1, op2, first, lists[BUCKET_EQUAL], counts[BUCKET_EQUAL], BUCKET_EQUAL);
+	    run504(rop, op1, op2, first, lists[BUCKET_SMALL], counts[BUCKET_SMALL], BUCKET_SMALL);
+	    run504(rop, op1, op2, first, lists[BUCKET_LIMB], counts[BUCKET_LIMB], BUCKET_LIMB);
+	    run504(rop, op1, op2, first, lists[BUCKET_SPLIT], counts[BUCKET_SPLIT], BUCKET_SPLIT);
+	    run504(rop, op1, op2, first, lists[BUCKET_FAR], counts[BUCKET_FAR], BUCKET_FAR);
+	}
+	run_fallback(rop, op1, op2, first, lists[BUCKET_FALLBACK], counts[BUCKET_FALLBACK], a, b);
+    }
+
+    mpfr_clears(a, b, (mpfr_ptr) 0);
+}
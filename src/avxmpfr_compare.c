@@ -0,0 +1,372 @@
+// avxmpfr_compare.c
+
+/*
+    Comparison, minimum, maximum and sorting of packed arrays (see avxmpfr_array.c) without going back to mpfr_t.
+
+    avxmpfr_cmp_vec() compares two arrays value by value, one block of AVXMPFR_BLOCK values per AVX512 register: the
+    signs first, then the exponents, then the padded limbs from the most significant one down, stopping as soon as
+    every lane is decided. In the native layout the limbs are gathered so that lane l always holds value l. Zeros
+    compare equal whatever their sign, like mpfr_cmp(). avxmpfr_min_vec() and avxmpfr_max_vec() pick each value from
+    one operand or the other with the same masks, the minimum of -0 and +0 being -0 as with mpfr_min().
+
+    avxmpfr_sort_array() turns every value into an unsigned key of limbs + 1 words that orders like the value:
+	word 0 is 2^63 + (exp - AVXMPFR_EXP_ZERO), then come the padded limbs, all complemented for negative values.
+    The keys are sorted by a most significant byte first radix sort. A byte that is the same over a whole bucket, such
+    as the sign and the top of the exponent of values of similar magnitude, costs a histogram and no moves. Buckets
+    of at most SORT_SMALL keys are finished by insertion sort, comparing 8 key words at a time. The keys hold the
+    whole value, so the sorted array is rebuilt from them directly. -0 sorts just before +0.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SORT_SMALL 24				// Largest bucket finished by insertion sort
+#define KEY_TOP ((uint64_t) 1 << 63)		// Word 0 of the key of +0, ~KEY_TOP is that of -0
+
+
+/* Block loads */
+
+// Word index of padded limb k of each value in a native block
+static inline __m512i native_index(int limbs, int k)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm512_add_epi64(_mm512_mul_epu32(lane, _mm512_set1_epi64(limbs)), _mm512_set1_epi64(k));
+}
+
+// Padded limb k of the values of a block, lane l holding value l
+static inline __m512i load_limb(const avxmpfr_array *array, const uint64_t *block, int k)
+{
+    if (array->layout == AVXMPFR_LAYOUT_SOA)
+	return _mm512_load_si512((const void *) (block + k * AVXMPFR_BLOCK));
+    return _mm512_i64gather_epi64(native_index(array->limbs, k), block, 8);
+}
+
+static inline void store_limb(const avxmpfr_array *array, uint64_t *block, int k, __m512i limb)
+{
+    if (array->layout == AVXMPFR_LAYOUT_SOA)
+	_mm512_store_si512((void *) (block + k * AVXMPFR_BLOCK), limb);
+    else
+	_mm512_i64scatter_epi64(block, native_index(array->limbs, k), limb, 8);
+}
+
+static inline __m512i load_signs(const avxmpfr_array *array, uint64_t block)
+{
+    return _mm512_cvtepi8_epi64(_mm_loadl_epi64((const __m128i *) avxmpfr_block_sign(array, block)));
+}
+
+static inline __m512i load_exps(const avxmpfr_array *array, uint64_t block)
+{
+    return _mm512_load_si512((const void *) avxmpfr_block_exp(array, block));
+}
+
+// Lanes of block holding one of the count values
+static inline __mmask8 valid_lanes(uint64_t count, uint64_t block)
+{
+    const uint64_t left = count - block * AVXMPFR_BLOCK;
+    return left >= AVXMPFR_BLOCK ? 0xFF : (__mmask8) ((1 << left) - 1);
+}
+
+
+/* Comparison */
+
+// mpfr_cmp() of the values of block b of op1 and op2, -1, 0 or 1 per lane
+static inline __m512i block_cmp(const avxmpfr_array *op1, const avxmpfr_array *op2, uint64_t b)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i zero_exp = _mm512_set1_epi64(AVXMPFR_EXP_ZERO);
+    const uint64_t *block1 = avxmpfr_block(op1, b);
+    const uint64_t *block2 = avxmpfr_block(op2, b);
+    const __m512i exp1 = load_exps(op1, b);
+    const __m512i exp2 = load_exps(op2, b);
+
+    // Zeros count as sign 0, so the signs alone decide unless both are the same and nonzero
+    const __m512i sign1 = _mm512_mask_mov_epi64(load_signs(op1, b), _mm512_cmpeq_epi64_mask(exp1, zero_exp), zero);
+    const __m512i sign2 = _mm512_mask_mov_epi64(load_signs(op2, b), _mm512_cmpeq_epi64_mask(exp2, zero_exp), zero);
+    __mmask8 greater = _mm512_cmpgt_epi64_mask(sign1, sign2);
+    __mmask8 less = _mm512_cmplt_epi64_mask(sign1, sign2);
+    __mmask8 open = _mm512_mask_cmpeq_epi64_mask(_mm512_cmpneq_epi64_mask(sign1, zero), sign1, sign2);
+    const __mmask8 negative = _mm512_cmplt_epi64_mask(sign1, zero);
+
+    // Then the magnitudes, exponent first
+    __mmask8 above = _mm512_mask_cmpgt_epi64_mask(open, exp1, exp2);
+    __mmask8 below = _mm512_mask_cmplt_epi64_mask(open, exp1, exp2);
+    open = _mm512_mask_cmpeq_epi64_mask(open, exp1, exp2);
+
+    for (int k = 0; k < op1->limbs && open; k++)
+    {
+	const __m512i a = load_limb(op1, block1, k);
+	const __m512i c = load_limb(op2, block2, k);
+	above |= _mm512_mask_cmpgt_epu64_mask(open, a, c);
+	below |= _mm512_mask_cmplt_epu64_mask(open, a, c);
+	open = _mm512_mask_cmpeq_epi64_mask(open, a, c);
+    }
+
+    // A bigger magnitude is greater for positive values and less for negative ones
+    greater |= (above & (__mmask8) ~negative) | (below & negative);
+    less |= (below & (__mmask8) ~negative) | (above & negative);
+    return _mm512_mask_mov_epi64(_mm512_maskz_mov_epi64(greater, _mm512_set1_epi64(1)), less, _mm512_set1_epi64(-1));
+}
+
+void avxmpfr_cmp_vec(int8_t *result, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    /*
+	result receives op1->count values, result[i] is the sign of op1[i] - op2[i] as given by mpfr_cmp()
+	op1 and op2 have the same precision and count, their layouts may differ
+    */
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(op1->count); b++)
+	_mm512_mask_cvtepi64_storeu_epi8(result + b * AVXMPFR_BLOCK, valid_lanes(op1->count, b), block_cmp(op1, op2, b));
+}
+
+// rop[i] = min or max of op1[i] and op2[i], picking whole values with masks
+static void select_vec(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2, int maximum)
+{
+    const int L = rop->limbs;
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i zero_exp = _mm512_set1_epi64(AVXMPFR_EXP_ZERO);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(rop->count); b++)
+    {
+	const __m512i order = block_cmp(op1, op2, b);
+	const __m512i exp1 = load_exps(op1, b), exp2 = load_exps(op2, b);
+	const __m512i sign1 = load_signs(op1, b), sign2 = load_signs(op2, b);
+
+	// Lanes taking op2: where it is smaller (bigger), and for two zeros where it is -0 (+0)
+	const __mmask8 zeros = _mm512_mask_cmpeq_epi64_mask(_mm512_cmpeq_epi64_mask(exp1, zero_exp), exp2, zero_exp);
+	const __mmask8 take = maximum
+	    ? _mm512_cmplt_epi64_mask(order, zero) | _mm512_mask_cmpgt_epi64_mask(zeros, sign2, sign1)
+	    : _mm512_cmpgt_epi64_mask(order, zero) | _mm512_mask_cmplt_epi64_mask(zeros, sign2, sign1);
+
+	// The same choice for every limb word of the block, 8 * L <= 64 words
+	const uint64_t lane_words = rop->layout == AVXMPFR_LAYOUT_SOA ? (uint64_t) 0x0101010101010101 >> (64 - AVXMPFR_BLOCK * L)
+								      : (((uint64_t) 1 << L) - 1);
+	uint64_t words = 0;
+	for (int l = 0; l < AVXMPFR_BLOCK; l++)
+	{
+	    if (take & (1 << l))
+		words |= lane_words << (rop->layout == AVXMPFR_LAYOUT_SOA ? l : l * L);
+	}
+
+	const uint64_t *block1 = avxmpfr_block(op1, b);
+	const uint64_t *block2 = avxmpfr_block(op2, b);
+	uint64_t *block_rop = avxmpfr_block(rop, b);
+	for (int w = 0; w < AVXMPFR_BLOCK * L; w += 8)
+	{
+	    const __m512i a = _mm512_load_si512((const void *) (block1 + w));
+	    const __m512i c = _mm512_load_si512((const void *) (block2 + w));
+	    _mm512_store_si512((void *) (block_rop + w), _mm512_mask_blend_epi64((__mmask8) (words >> w), a, c));
+	}
+	_mm512_store_si512((void *) avxmpfr_block_exp(rop, b), _mm512_mask_blend_epi64(take, exp1, exp2));
+	_mm512_mask_cvtepi64_storeu_epi8(avxmpfr_block_sign(rop, b), 0xFF, _mm512_mask_blend_epi64(take, sign1, sign2));
+    }
+}
+
+void avxmpfr_min_vec(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    /*
+	rop[i] = min(op1[i], op2[i]) like mpfr_min(), op1[i] when they are equal
+	All three have the same precision, layout and count, rop may be op1 or op2
+    */
+
+    select_vec(rop, op1, op2, 0);
+}
+
+void avxmpfr_max_vec(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2)
+{
+    /*
+	rop[i] = max(op1[i], op2[i]) like mpfr_max(), op1[i] when they are equal
+	All three have the same precision, layout and count, rop may be op1 or op2
+    */
+
+    select_vec(rop, op1, op2, 1);
+}
+
+
+/* Sorting */
+
+static inline unsigned key_byte(const uint64_t *key, int byte)
+{
+    return (key[byte >> 3] >> (56 - 8 * (byte & 7))) & 0xFF;
+}
+
+// -1, 0 or 1 as key a orders before, with or after key b, comparing words at a time
+static inline int key_cmp(const uint64_t *a, const uint64_t *b, int words)
+{
+    for (int w = 0; w < words; w += 8)
+    {
+	const __mmask8 valid = words - w >= 8 ? 0xFF : (__mmask8) ((1 << (words - w)) - 1);
+	const __mmask8 differ = _mm512_mask_cmpneq_epu64_mask(valid, _mm512_maskz_loadu_epi64(valid, a + w),
+							      _mm512_maskz_loadu_epi64(valid, b + w));
+	if (differ)
+	{
+	    const int k = w + __builtin_ctz(differ);
+	    return a[k] < b[k] ? -1 : 1;
+	}
+    }
+    return 0;
+}
+
+static void insertion_sort(uint64_t *keys, size_t n, int K, int skip)
+{
+    /*
+	Sort n keys of K words, their first skip words are known to be equal
+    */
+
+    uint64_t held[9];
+    for (size_t i = 1; i < n; i++)
+    {
+	size_t j = i;
+	if (key_cmp(keys + (j - 1) * K + skip, keys + j * K + skip, K - skip) <= 0)
+	    continue;
+
+	memcpy(held, keys + i * K, K * sizeof(uint64_t));
+	while (j > 0 && key_cmp(keys + (j - 1) * K + skip, held + skip, K - skip) > 0)
+	{
+	    memcpy(keys + j * K, keys + (j - 1) * K, K * sizeof(uint64_t));
+	    j--;
+	}
+	memcpy(keys + j * K, held, K * sizeof(uint64_t));
+    }
+}
+
+static void radix_sort(uint64_t *keys, uint64_t *scratch, size_t n, int K, int byte)
+{
+    /*
+	Sort n keys of K words whose bytes before byte are all equal, scratch holds at least n keys
+    */
+
+    for (; n > SORT_SMALL && byte < 8 * K; byte++)
+    {
+	size_t count[256] = {0};
+	for (size_t i = 0; i < n; i++)
+	    count[key_byte(keys + i * K, byte)]++;
+
+	// A byte shared by the whole bucket splits nothing
+	if (count[key_byte(keys, byte)] == n)
+	    continue;
+
+	size_t start[256];
+	size_t offset = 0;
+	for (int d = 0; d < 256; d++)
+	{
+	    start[d] = offset;
+	    offset += count[d];
+	}
+	for (size_t i = 0; i < n; i++)
+	    memcpy(scratch + (start[key_byte(keys + i * K, byte)]++) * K, keys + i * K, K * sizeof(uint64_t));
+	memcpy(keys, scratch, n * K * sizeof(uint64_t));
+
+	// start[d] is now the end of bucket d
+	for (int d = 0; d < 256; d++)
+	{
+	    if (count[d] > 1)
+		radix_sort(keys + (start[d] - count[d]) * K, scratch, count[d], K, byte + 1);
+	}
+	return;
+    }
+
+    if (n <= SORT_SMALL)
+	insertion_sort(keys, n, K, byte / 8);
+}
+
+// Keys of every value of array, limbs + 1 words each
+static void extract_keys(const avxmpfr_array *array, uint64_t *keys)
+{
+    const int K = array->limbs + 1;
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i stride = _mm512_mul_epu32(lane, _mm512_set1_epi64(K));
+    const __m512i top = _mm512_set1_epi64(KEY_TOP - AVXMPFR_EXP_ZERO);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(array->count); b++)
+    {
+	const __mmask8 valid = valid_lanes(array->count, b);
+	const uint64_t *block = avxmpfr_block(array, b);
+	uint64_t *out = keys + b * AVXMPFR_BLOCK * K;
+
+	// All ones for negative values, -0 included
+	const __m512i flip = _mm512_maskz_mov_epi64(_mm512_cmplt_epi64_mask(load_signs(array, b), _mm512_setzero_si512()),
+						    _mm512_set1_epi64(-1));
+
+	_mm512_mask_i64scatter_epi64(out, valid, stride, _mm512_xor_si512(_mm512_add_epi64(load_exps(array, b), top), flip), 8);
+	for (int k = 0; k < array->limbs; k++)
+	    _mm512_mask_i64scatter_epi64(out + k + 1, valid, stride, _mm512_xor_si512(load_limb(array, block, k), flip), 8);
+    }
+}
+
+// Write the first count keys back as values, the rest of the blocks of array up to array->count become +0
+static void rebuild_values(avxmpfr_array *array, const uint64_t *keys, uint64_t count)
+{
+    const int K = array->limbs + 1;
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i stride = _mm512_mul_epu32(lane, _mm512_set1_epi64(K));
+    const __m512i top = _mm512_set1_epi64(KEY_TOP - AVXMPFR_EXP_ZERO);
+
+    for (uint64_t b = 0; b < avxmpfr_array_blocks(array->count); b++)
+    {
+	const __mmask8 valid = b * AVXMPFR_BLOCK < count ? valid_lanes(count, b) : 0;
+	uint64_t *block = avxmpfr_block(array, b);
+	const uint64_t *in = keys + b * AVXMPFR_BLOCK * K;
+
+	// Lanes past count read the key of +0
+	const __m512i word = _mm512_mask_i64gather_epi64(_mm512_set1_epi64(KEY_TOP), valid, stride, in, 8);
+	const __mmask8 negative = _mm512_cmplt_epu64_mask(word, _mm512_set1_epi64(KEY_TOP));
+	const __m512i flip = _mm512_maskz_mov_epi64(negative, _mm512_set1_epi64(-1));
+
+	_mm512_store_si512((void *) avxmpfr_block_exp(array, b), _mm512_sub_epi64(_mm512_xor_si512(word, flip), top));
+	_mm512_mask_cvtepi64_storeu_epi8(avxmpfr_block_sign(array, b), 0xFF,
+					 _mm512_mask_mov_epi64(_mm512_set1_epi64(1), negative, _mm512_set1_epi64(-1)));
+	for (int k = 0; k < array->limbs; k++)
+	{
+	    const __m512i limb = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), valid, stride, in + k + 1, 8);
+	    store_limb(array, block, k, _mm512_xor_si512(limb, flip));
+	}
+    }
+}
+
+int avxmpfr_sort_array(avxmpfr_array *array, int unique)
+{
+    /*
+	Sort the values of array in increasing order, in place
+	unique set drops repeated values (+0 and -0 being the same), array->count is lowered to what is left and the
+	freed positions at the end become +0
+
+	Returns 0 on success and -1 if the keys could not be allocated
+    */
+
+    const int K = array->limbs + 1;
+    const size_t bytes = avxmpfr_array_blocks(array->count) * AVXMPFR_BLOCK * K * sizeof(uint64_t);
+    uint64_t *keys = aligned_alloc(64, bytes > 0 ? bytes : 64);
+    uint64_t *scratch = aligned_alloc(64, bytes > 0 ? bytes : 64);
+    if (keys == NULL || scratch == NULL)
+    {
+	free(keys);
+	free(scratch);
+	return -1;
+    }
+
+    extract_keys(array, keys);
+    radix_sort(keys, scratch, array->count, K, 0);
+
+    uint64_t count = array->count;
+    if (unique && count > 0)
+    {
+	count = 1;
+	for (uint64_t i = 1; i < array->count; i++)
+	{
+	    const uint64_t *last = keys + (count - 1) * K, *key = keys + i * K;
+	    const int zeros = last[0] == ~KEY_TOP && key[0] == KEY_TOP;
+	    if (zeros || key_cmp(last, key, K) == 0)
+		continue;
+	    memcpy(keys + count * K, key, K * sizeof(uint64_t));
+	    count++;
+	}
+    }
+
+    rebuild_values(array, keys, count);
+    array->count = count;
+
+    free(keys);
+    free(scratch);
+    return 0;
+}
@@ -0,0 +1,1075 @@
+// avxmpfr_elementary.c
+
+/*
+    Batched exp, log and sin / cos: avxmpfr_exp_vec(), avxmpfr_log_vec() and avxmpfr_sincos_vec(), correctly rounded
+    like mpfr_exp(), mpfr_log() and mpfr_sin_cos(), for precisions up to PRECISION_512.
+
+    Eight arguments go through the kernels together, one per AVX512 lane, as signed fixed point numbers of N digits
+    of 28 bits: digit j of the eight numbers shares a vector, the top digit holds the signed integer part and F =
+    28 (N - 1) bits follow the point. 28 bit digits let _mm512_mul_epi32() form the partial products and up to 2^8 of
+    them add up in a 64 bit column without overflowing, so a product is a loop of vector multiplies and adds, column
+    by column from the three under the point that can still carry into it, with the carries taken on the way.
+
+    exp: x = k log(2) + r with |r| <= log(2) / 2, then exp(r / 2^s) from its Taylor series and s squarings. The series
+    goes by Horner's rule with coefficients 1/j! held as digits, each step on only the digits its term still needs.
+    log: x = m 2^e with m in [sqrt(1/2), sqrt(2)), Newton steps y += m exp(-y) - 1 from the double precision log(m),
+    each doubling the correct bits and run on only as many digits as it needs, then e log(2) + y.
+    sin / cos: x = k pi / 2 + r with |r| <= pi / 4, both Taylor series at r / 2^8, eight doublings, then the quadrant.
+
+    The reductions x - k c and e log(2) + y are vector too, with log(2) and pi / 2 held to two digits beyond the widest
+    F so that their multiples by |k| < 2^31 stay exact to F bits; only the conversions in and out are scalar. A kernel
+    result is off by less than 2^(s + 10 - F) (exp, log) or 2^(2 s + 10 - F) (sin, cos), N is chosen so that F is at
+    least the precision plus 48 bits, and a result is only rounded if mpfr_can_round() says the bound decides the
+    rounding. NaNs, infinities, zeros, arguments too large to reduce this way, results near the ends of the exponent
+    range, precisions beyond PRECISION_512 and the rare cases where the bound does not decide (results right next to
+    a rounding boundary, or tiny ones that lost their relative precision in fixed point) go through mpfr itself.
+    Every result is the correctly rounded one.
+
+    Polynomials: avxmpfr_poly_eval_vec() takes eight points at a time through Horner's rule (or Estrin's scheme) in
+    floating point vectors, each lane a magnitude of N digits in [1/2, 1) with its own exponent and sign, aligned and
+    normalised with per lane digit and bit shifts. The coefficients are converted once per call and broadcast at each
+    step. Every operation truncates at F bits, so the result is within (degree + 2) 2^(-prec - 46) sum |c_j x^j| of
+    p(x) before its one rounding; it is not correctly rounded, since cancellation can leave fewer good bits than the
+    precision.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#define ELEM_DIGIT_BITS 28
+#define ELEM_DIGIT_MASK ((1 << ELEM_DIGIT_BITS) - 1)
+#define ELEM_MAX_DIGITS 21	// F = 560 at PRECISION_512
+#define ELEM_GUARD 48		// Bits of F beyond the precision
+#define ELEM_LIMBS (ELEM_MAX_DIGITS * ELEM_DIGIT_BITS / GMP_NUMB_BITS + 2)
+#define ELEM_TERMS 64		// Taylor coefficients 1/j! kept
+#define ELEM_CONST_BITS (ELEM_MAX_DIGITS * ELEM_DIGIT_BITS + 128)
+#define ELEM_EXP_MAX 30		// Exponent of the largest argument of exp reduced here, |k| < 2^31
+#define ELEM_TRIG_MAX 20	// Same for sin / cos
+#define ELEM_TRIG_HALVINGS 8
+
+static int64_t inv_factorial[ELEM_TERMS][ELEM_MAX_DIGITS];	// 1/j!
+static int64_t alt_factorial[ELEM_TERMS][ELEM_MAX_DIGITS];	// (-1)^(j/2) / j!, the coefficients of cos and sin
+static int64_t minus_one[ELEM_MAX_DIGITS];
+static int64_t log2_digits[ELEM_MAX_DIGITS + 2];		// log(2) and pi / 2 to two more digits, for the reductions
+static int64_t half_pi_digits[ELEM_MAX_DIGITS + 2];
+static pthread_once_t constants_once = PTHREAD_ONCE_INIT;
+
+
+/* Conversions */
+
+// Digits of the fixed point value |v| 2^scale with N digits, truncated. The value has to be under 2^62
+static void magnitude_digits(int64_t *digits, mpfr_srcptr v, mpfr_exp_t scale, int N)
+{
+    const int F = ELEM_DIGIT_BITS * (N - 1);
+    mp_limb_t a[ELEM_LIMBS] = {0};
+
+    if (!mpfr_zero_p(v))
+    {
+	// Limb i of the significand lands at bit pos of a
+	const int limbs = (mpfr_get_prec(v) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	for (int i = 0; i < limbs; i++)
+	{
+	    const int64_t pos = mpfr_get_exp(v) + scale + F - (int64_t) (limbs - i) * GMP_NUMB_BITS;
+	    const mp_limb_t limb = v->_mpfr_d[i];
+	    if (pos <= -GMP_NUMB_BITS || pos >= ELEM_LIMBS * GMP_NUMB_BITS)
+		continue;
+	    if (pos < 0)
+	    {
+		a[0] |= limb >> -pos;
+		continue;
+	    }
+	    a[pos / GMP_NUMB_BITS] |= limb << (pos % GMP_NUMB_BITS);
+	    if (pos % GMP_NUMB_BITS && pos / GMP_NUMB_BITS + 1 < ELEM_LIMBS)
+		a[pos / GMP_NUMB_BITS + 1] |= limb >> (GMP_NUMB_BITS - pos % GMP_NUMB_BITS);
+	}
+    }
+
+    for (int j = 0; j < N; j++)
+    {
+	const int q = j * ELEM_DIGIT_BITS / GMP_NUMB_BITS, r = j * ELEM_DIGIT_BITS % GMP_NUMB_BITS;
+	mp_limb_t bits = a[q] >> r;
+	if (r > 0 && q + 1 < ELEM_LIMBS)
+	    bits |= a[q + 1] << (GMP_NUMB_BITS - r);
+	digits[j] = j < N - 1 ? (int64_t) (bits & ELEM_DIGIT_MASK) : (int64_t) bits;
+    }
+}
+
+// The same with the sign of v, negative values in two's complement
+static void to_digits(int64_t *digits, mpfr_srcptr v, mpfr_exp_t scale, int N)
+{
+    magnitude_digits(digits, v, scale, N);
+    if (!mpfr_zero_p(v) && mpfr_signbit(v))
+    {
+	int64_t carry = 0;
+	for (int j = 0; j < N - 1; j++)
+	{
+	    const int64_t t = carry - digits[j];
+	    digits[j] = t & ELEM_DIGIT_MASK;
+	    carry = t >> ELEM_DIGIT_BITS;
+	}
+	digits[N - 1] = carry - digits[N - 1];
+    }
+}
+
+// rop = sign d 2^scale rounded with rnd, for the N non-negative normalised digits d, returns the ternary value
+static int round_digits(mpfr_t rop, int sign, const int64_t *d, int N, mpfr_exp_t scale, mpfr_rnd_t rnd)
+{
+    mp_limb_t a[ELEM_LIMBS] = {0};
+    for (int j = 0; j < N; j++)
+    {
+	const int q = j * ELEM_DIGIT_BITS / GMP_NUMB_BITS, r = j * ELEM_DIGIT_BITS % GMP_NUMB_BITS;
+	a[q] |= (mp_limb_t) d[j] << r;
+	if (r > 0)
+	    a[q + 1] |= (mp_limb_t) d[j] >> (GMP_NUMB_BITS - r);
+    }
+    return avxmpfr_round_limbs(rop, sign, a, ELEM_LIMBS, scale - ELEM_DIGIT_BITS * (N - 1), rnd);
+}
+
+// t becomes the value of the N digits, exactly
+static void from_digits(mpfr_t t, const int64_t *digits, int N)
+{
+    int64_t d[ELEM_MAX_DIGITS], carry = 0;
+    const int sign = digits[N - 1] < 0 ? -1 : 1;
+
+    for (int j = 0; j < N; j++)
+    {
+	const int64_t t = carry + sign * digits[j];
+	d[j] = j < N - 1 ? t & ELEM_DIGIT_MASK : t;
+	carry = t >> ELEM_DIGIT_BITS;
+    }
+    round_digits(t, sign, d, N, 0, MPFR_RNDN);
+}
+
+static void constants_init(void)
+{
+    mpfr_t t;
+    mpfr_init2(t, ELEM_CONST_BITS);
+    mpfr_const_log2(t, MPFR_RNDN);
+    to_digits(log2_digits, t, 0, ELEM_MAX_DIGITS + 2);
+    mpfr_const_pi(t, MPFR_RNDN);
+    to_digits(half_pi_digits, t, -1, ELEM_MAX_DIGITS + 2);
+
+    mpfr_set_ui(t, 1, MPFR_RNDN);
+    for (int j = 0; j < ELEM_TERMS; j++)
+    {
+	if (j > 0)
+	    mpfr_div_ui(t, t, j, MPFR_RNDN);
+	to_digits(inv_factorial[j], t, 0, ELEM_MAX_DIGITS);
+	if (j / 2 % 2)
+	    mpfr_neg(t, t, MPFR_RNDN);
+	to_digits(alt_factorial[j], t, 0, ELEM_MAX_DIGITS);
+	mpfr_abs(t, t, MPFR_RNDN);
+    }
+    minus_one[ELEM_MAX_DIGITS - 1] = -1;
+    mpfr_clear(t);
+}
+
+// Digits for the precision, F = 28 (N - 1) is at least precision + ELEM_GUARD, and 4 digits at least for the products
+static inline int elem_digits(mpfr_prec_t precision)
+{
+    const int N = (precision + ELEM_GUARD + ELEM_DIGIT_BITS - 1) / ELEM_DIGIT_BITS + 1;
+    return N > 4 ? N : 4;
+}
+
+// Taylor terms up to x^n / n! for |x| < 2^-bits, the first one left out under 2^-(F + 4)
+static int elem_terms(int F, double bits)
+{
+    double log2_factorial = 0;
+    int n = 1;
+    while (n < ELEM_TERMS - 1 && (n + 1) * bits + log2_factorial + log2(n + 1) < F + 4)
+	log2_factorial += log2(++n);
+    return n;
+}
+
+// 1 if t, off by less than 2^(EXP(t) - err), rounds to precision the same way as the exact value in the mode rnd and
+// lands inside the exponent range, 0 to leave the value to mpfr
+static int elem_decided(mpfr_srcptr t, mpfr_exp_t err, mpfr_prec_t precision, mpfr_rnd_t rnd)
+{
+    if (!mpfr_regular_p(t) || mpfr_get_exp(t) <= mpfr_get_emin() + 1 || mpfr_get_exp(t) >= mpfr_get_emax() - 1)
+	return 0;
+    return mpfr_can_round(t, err, MPFR_RNDN, MPFR_RNDZ, precision + (rnd == MPFR_RNDN));
+}
+
+
+/* Fixed point vectors, eight numbers of N digits */
+
+static inline __m512i digit_mask(void)
+{
+    return _mm512_set1_epi64(ELEM_DIGIT_MASK);
+}
+
+// Digits back in [0, 2^28), the top one takes the carry
+static inline void fix_norm(__m512i *a, int N)
+{
+    __m512i carry = _mm512_setzero_si512();
+    for (int j = 0; j < N - 1; j++)
+    {
+	const __m512i t = _mm512_add_epi64(a[j], carry);
+	a[j] = _mm512_and_si512(t, digit_mask());
+	carry = _mm512_srai_epi64(t, ELEM_DIGIT_BITS);
+    }
+    a[N - 1] = _mm512_add_epi64(a[N - 1], carry);
+}
+
+// The constant c (ELEM_MAX_DIGITS digits) on N digits
+static inline void fix_broadcast(__m512i *r, const int64_t *c, int N)
+{
+    for (int j = 0; j < N; j++)
+	r[j] = _mm512_set1_epi64(c[ELEM_MAX_DIGITS - N + j]);
+}
+
+static inline void fix_sub_const(__m512i *a, const int64_t *c, int N)
+{
+    for (int j = 0; j < N; j++)
+	a[j] = _mm512_sub_epi64(a[j], _mm512_set1_epi64(c[ELEM_MAX_DIGITS - N + j]));
+    fix_norm(a, N);
+}
+
+static inline void fix_neg(__m512i *r, const __m512i *a, int N)
+{
+    for (int j = 0; j < N; j++)
+	r[j] = _mm512_sub_epi64(_mm512_setzero_si512(), a[j]);
+    fix_norm(r, N);
+}
+
+// r = a / 2^s for 0 < s < 28, truncated. r may be a
+static inline void fix_shift(__m512i *r, const __m512i *a, int s, int N)
+{
+    const __m128i right = _mm_cvtsi32_si128(s), left = _mm_cvtsi32_si128(ELEM_DIGIT_BITS - s);
+    for (int j = 0; j < N - 1; j++)
+	r[j] = _mm512_or_si512(_mm512_srl_epi64(a[j], right), _mm512_and_si512(_mm512_sll_epi64(a[j + 1], left), digit_mask()));
+    r[N - 1] = _mm512_sra_epi64(a[N - 1], right);
+}
+
+// a = a - k c for k under 2^31 in size and c with two digits more than ELEM_MAX_DIGITS, the products taken down to
+// two digits under the last of a and truncated there
+static inline void fix_sub_multiple(__m512i *a, __m512i k, const int64_t *c, int N)
+{
+    __m512i t[ELEM_MAX_DIGITS + 2];
+    for (int j = 0; j < N + 2; j++)
+	t[j] = _mm512_sub_epi64(j >= 2 ? a[j - 2] : _mm512_setzero_si512(),
+				_mm512_mul_epi32(k, _mm512_set1_epi64(c[ELEM_MAX_DIGITS - N + j])));
+    fix_norm(t, N + 2);
+    for (int j = 0; j < N; j++)
+	a[j] = t[j + 2];
+}
+
+// Digits of a wider number, the new ones at the bottom zero
+static inline void fix_widen(__m512i *a, int from, int to)
+{
+    for (int j = to - 1; j >= 0; j--)
+	a[j] = j >= to - from ? a[j - (to - from)] : _mm512_setzero_si512();
+}
+
+// Columns N - 3 and up of a product, in order, doubled if twice, each with the carry of the one under it and the
+// digit of c (ELEM_MAX_DIGITS digits, or none) at its place, into the digits of r. Leaving out the columns under
+// N - 3 is off by less than N^2 2^-(F + 28). The carry only comes in once a column is summed, so the columns overlap
+// and just the carries run in sequence
+#define FIX_PRODUCT(column_sum)									\
+    __m512i carry = _mm512_setzero_si512();							\
+    _Pragma("GCC unroll 48")									\
+    for (int k = N - 3; k <= 2 * N - 2; k++)							\
+    {												\
+	const int first = k - N + 1 > 0 ? k - N + 1 : 0;					\
+	__m512i sum = _mm512_setzero_si512();							\
+	column_sum;										\
+	if (twice)										\
+	    sum = _mm512_add_epi64(sum, sum);							\
+	if (c && k >= N - 1)									\
+	    sum = _mm512_add_epi64(sum, _mm512_set1_epi64(c[ELEM_MAX_DIGITS - 2 * N + 1 + k]));	\
+	sum = _mm512_add_epi64(sum, carry);							\
+	if (k == 2 * N - 2)									\
+	    r[N - 1] = sum;									\
+	else											\
+	{											\
+	    if (k >= N - 1)									\
+		r[k - N + 1] = _mm512_and_si512(sum, digit_mask());				\
+	    carry = _mm512_srai_epi64(sum, ELEM_DIGIT_BITS);					\
+	}											\
+    }
+
+// r = a b (2 a b if twice) + c, normalised inputs, truncated. A column k is only read once the digits under
+// k - N + 1 are done with, so r may be a or b
+static inline __attribute__((always_inline)) void fix_mul_n(__m512i *r, const __m512i *a, const __m512i *b,
+							    const int64_t *c, int twice, int N)
+{
+    FIX_PRODUCT(
+	_Pragma("GCC unroll 24")
+	for (int i = first; i <= k && i < N; i++)
+	    sum = _mm512_add_epi64(sum, _mm512_mul_epi32(a[i], b[k - i]));
+    )
+}
+
+// The same for a = b, each cross product once and doubled
+static inline __attribute__((always_inline)) void fix_sqr_n(__m512i *r, const __m512i *a, const int64_t *c,
+							    int twice, int N)
+{
+    FIX_PRODUCT(
+	__m512i cross = _mm512_setzero_si512();
+	_Pragma("GCC unroll 24")
+	for (int i = first; i < k - i; i++)
+	    cross = _mm512_add_epi64(cross, _mm512_mul_epi32(a[i], a[k - i]));
+	sum = _mm512_add_epi64(sum, _mm512_add_epi64(cross, cross));
+	if (k % 2 == 0)
+	    sum = _mm512_add_epi64(sum, _mm512_mul_epi32(a[k / 2], a[k / 2]));
+    )
+}
+
+// Unrolled for each N
+#define ELEM_EACH_DIGITS(f) f(4) f(5) f(6) f(7) f(8) f(9) f(10) f(11) f(12) f(13) f(14) f(15) f(16) f(17) f(18) \
+			    f(19) f(20) f(21)
+#define FIX_PRODUCT_CASE(n)								\
+    case n:										\
+	if (a == b)									\
+	    fix_sqr_n(r, a, c, twice, n);						\
+	else										\
+	    fix_mul_n(r, a, b, c, twice, n);						\
+	break;
+
+static void fix_product(__m512i *r, const __m512i *a, const __m512i *b, const int64_t *c, int twice, int N)
+{
+    switch (N)
+    {
+	ELEM_EACH_DIGITS(FIX_PRODUCT_CASE)
+    }
+}
+
+static inline void fix_mul(__m512i *r, const __m512i *a, const __m512i *b, int N)
+{
+    fix_product(r, a, b, NULL, 0, N);
+}
+
+// Digits a term of x^j still needs, |x| < 2^-bits, when it gets N at j = 0
+static inline int horner_digits(int N, int j, double bits)
+{
+    const int dropped = (int) (j * bits - 8) / ELEM_DIGIT_BITS;
+    return N - dropped > 4 ? N - dropped : 4;
+}
+
+// r = sum c[first + step j] x^j for j = 0 to terms, |x| < 2^-bits, by Horner's rule with each step on the digits
+// its term needs. r may not be x
+static void fix_horner(__m512i *r, const __m512i *x, int64_t (*c)[ELEM_MAX_DIGITS], int first, int step,
+		       int terms, double bits, int N)
+{
+    int used = horner_digits(N, terms, bits);
+    fix_broadcast(r + N - used, c[first + step * terms], used);
+    for (int j = terms - 1; j >= 0; j--)
+    {
+	const int digits = horner_digits(N, j, bits);
+	for (int i = N - digits; i < N - used; i++)
+	    r[i] = _mm512_setzero_si512();
+	used = digits;
+	fix_product(r + N - used, r + N - used, x + N - used, c[first + step * j], 0, used);
+    }
+}
+
+
+/* Kernels */
+
+// Shift for the exp kernel, more squarings the more digits
+static inline int exp_halvings(int N)
+{
+    return (ELEM_DIGIT_BITS * (N - 1) + 16) / 32;
+}
+
+// r = exp(x) for |x| < 2^-1.5, x is overwritten
+static void exp_kernel(__m512i *r, __m512i *x, int N)
+{
+    const int s = exp_halvings(N);
+    const int terms = elem_terms(ELEM_DIGIT_BITS * (N - 1), s + 1.5);
+
+    fix_shift(x, x, s, N);
+    fix_horner(r, x, inv_factorial, 0, 1, terms, s + 1.5, N);
+    for (int i = 0; i < s; i++)
+	fix_product(r, r, r, NULL, 0, N);
+}
+
+// sn = sin(x) and cs = cos(x) for |x| < 2^-0.34, x is overwritten
+static void sincos_kernel(__m512i *sn, __m512i *cs, __m512i *x, int N)
+{
+    const int s = ELEM_TRIG_HALVINGS;
+    const int terms = elem_terms(ELEM_DIGIT_BITS * (N - 1), s + 0.34);
+    __m512i z[ELEM_MAX_DIGITS], t[ELEM_MAX_DIGITS];
+
+    // Both series in x^2
+    fix_shift(x, x, s, N);
+    fix_product(z, x, x, NULL, 0, N);
+    fix_horner(cs, z, alt_factorial, 0, 2, terms / 2, 2 * (s + 0.34), N);
+    fix_horner(t, z, alt_factorial, 1, 2, (terms - 1) / 2, 2 * (s + 0.34), N);
+    fix_mul(sn, t, x, N);
+
+    // sin(2a) = 2 sin(a) cos(a), cos(2a) = 2 cos(a)^2 - 1
+    for (int i = 0; i < s; i++)
+    {
+	fix_product(sn, sn, cs, NULL, 1, N);
+	fix_product(cs, cs, cs, minus_one, 1, N);
+    }
+}
+
+
+/* Floating point vectors, for the polynomials */
+
+#define POLY_EXP_ZERO (-((int64_t) 1 << 61))	// Exponent of zero, far enough down to align away
+#define POLY_MAX_EXP ((int64_t) 1 << 40)	// Largest exponent of an input, degree times it still fits
+#define POLY_MAX_DEGREE ((size_t) 1 << 20)
+#define POLY_MIN_DEGREE 3			// Lower ones are quicker in mpfr than through the conversions
+
+static int poly_scheme = AVXMPFR_POLY_AUTO;
+
+// Eight numbers (-1)^negative m 2^exp, the magnitude m on N digits in [1/2, 1) (the top digit 0), or m = 0 with exp
+// POLY_EXP_ZERO
+typedef struct
+{
+    __m512i d[ELEM_MAX_DIGITS];
+    __m512i exp;
+    __mmask8 negative;
+} vfloat;
+
+// Each lane of a moved the number of digits in q (at most N) down, or up, zeros coming in
+static inline void fix_digits_down(__m512i *a, __m512i q, int N)
+{
+    for (int b = 1; b <= N; b <<= 1)
+    {
+	const __mmask8 move = _mm512_test_epi64_mask(q, _mm512_set1_epi64(b));
+	for (int j = 0; j < N; j++)
+	    a[j] = _mm512_mask_mov_epi64(a[j], move, j + b < N ? a[j + b] : _mm512_setzero_si512());
+    }
+}
+
+static inline void fix_digits_up(__m512i *a, __m512i q, int N)
+{
+    for (int b = 1; b <= N; b <<= 1)
+    {
+	const __mmask8 move = _mm512_test_epi64_mask(q, _mm512_set1_epi64(b));
+	for (int j = N - 1; j >= 0; j--)
+	    a[j] = _mm512_mask_mov_epi64(a[j], move, j >= b ? a[j - b] : _mm512_setzero_si512());
+    }
+}
+
+// Each lane of a shifted the number of bits in r (under 28) down, or up
+static inline void fix_bits_down(__m512i *a, __m512i r, int N)
+{
+    const __m512i l = _mm512_sub_epi64(_mm512_set1_epi64(ELEM_DIGIT_BITS), r);
+    for (int j = 0; j < N - 1; j++)
+	a[j] = _mm512_or_si512(_mm512_srlv_epi64(a[j], r), _mm512_and_si512(_mm512_sllv_epi64(a[j + 1], l), digit_mask()));
+    a[N - 1] = _mm512_srlv_epi64(a[N - 1], r);
+}
+
+static inline void fix_bits_up(__m512i *a, __m512i r, int N)
+{
+    const __m512i l = _mm512_sub_epi64(_mm512_set1_epi64(ELEM_DIGIT_BITS), r);
+    for (int j = N - 1; j > 0; j--)
+	a[j] = _mm512_or_si512(_mm512_and_si512(_mm512_sllv_epi64(a[j], r), digit_mask()), _mm512_srlv_epi64(a[j - 1], l));
+    a[0] = _mm512_and_si512(_mm512_sllv_epi64(a[0], r), digit_mask());
+}
+
+// v back to a magnitude in [1/2, 1) from one in [0, 2) on normalised digits. The leading bit of each lane comes from
+// the exponent of its leading digit converted to double (without AVX512DQ: or'ed into the significand of 2^52)
+static inline void vfloat_normalise(vfloat *v, int N)
+{
+    const __m512i zero = _mm512_setzero_si512();
+
+    // [1, 2), one bit down
+    const __mmask8 over = _mm512_test_epi64_mask(v->d[N - 1], v->d[N - 1]);
+    if (over)
+    {
+	fix_bits_down(v->d, _mm512_maskz_mov_epi64(over, _mm512_set1_epi64(1)), N);
+	v->exp = _mm512_mask_add_epi64(v->exp, over, v->exp, _mm512_set1_epi64(1));
+    }
+
+    __m512i lead = zero, top = zero;
+    __mmask8 nonzero = 0;
+    for (int j = 0; j < N - 1; j++)
+    {
+	const __mmask8 m = _mm512_test_epi64_mask(v->d[j], v->d[j]);
+	lead = _mm512_mask_mov_epi64(lead, m, _mm512_set1_epi64(j));
+	top = _mm512_mask_mov_epi64(top, m, v->d[j]);
+	nonzero |= m;
+    }
+    const __m512i magic = _mm512_set1_epi64(0x4330000000000000);
+    const __m512d top_d = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(top, magic)), _mm512_castsi512_pd(magic));
+    const __m512i log2_top = _mm512_sub_epi64(_mm512_srli_epi64(_mm512_castpd_si512(top_d), 52), _mm512_set1_epi64(1023));
+
+    const __m512i q = _mm512_maskz_sub_epi64(nonzero, _mm512_set1_epi64(N - 2), lead);
+    const __m512i r = _mm512_maskz_sub_epi64(nonzero, _mm512_set1_epi64(ELEM_DIGIT_BITS - 1), log2_top);
+    if (_mm512_test_epi64_mask(_mm512_or_si512(q, r), _mm512_or_si512(q, r)))
+    {
+	fix_digits_up(v->d, q, N);
+	fix_bits_up(v->d, r, N);
+	v->exp = _mm512_sub_epi64(v->exp, _mm512_add_epi64(_mm512_mul_epu32(q, _mm512_set1_epi64(ELEM_DIGIT_BITS)), r));
+    }
+    v->exp = _mm512_mask_mov_epi64(_mm512_set1_epi64(POLY_EXP_ZERO), nonzero, v->exp);
+    v->negative &= nonzero;
+}
+
+// r = a b, truncated. r may be a or b
+static inline void vfloat_mul(vfloat *r, const vfloat *a, const vfloat *b, int N)
+{
+    r->negative = a->negative ^ b->negative;
+    r->exp = _mm512_add_epi64(a->exp, b->exp);
+    fix_product(r->d, a->d, b->d, NULL, 0, N);
+    vfloat_normalise(r, N);
+}
+
+// r = a + b, the smaller one truncated as it is aligned. r may be a or b
+static inline void vfloat_add(vfloat *r, const vfloat *a, const vfloat *b, int N)
+{
+    const __mmask8 swap = _mm512_cmplt_epi64_mask(a->exp, b->exp);
+    const __mmask8 big_negative = (a->negative & ~swap) | (b->negative & swap);
+    const __mmask8 subtract = big_negative ^ ((b->negative & ~swap) | (a->negative & swap));
+    const __m512i big_exp = _mm512_max_epi64(a->exp, b->exp);
+    __m512i small[ELEM_MAX_DIGITS];
+
+    // The gap split into digits and bits, q = gap / 28 as (gap 2341) >> 16, exact up to 28 (ELEM_MAX_DIGITS + 1)
+    const __m512i gap = _mm512_min_epu64(_mm512_sub_epi64(big_exp, _mm512_min_epi64(a->exp, b->exp)),
+					 _mm512_set1_epi64(ELEM_DIGIT_BITS * N));
+    const __m512i q = _mm512_srli_epi64(_mm512_mul_epu32(gap, _mm512_set1_epi64(2341)), 16);
+    const __m512i bits = _mm512_sub_epi64(gap, _mm512_mul_epu32(q, _mm512_set1_epi64(ELEM_DIGIT_BITS)));
+
+    for (int j = 0; j < N; j++)
+    {
+	small[j] = _mm512_mask_mov_epi64(b->d[j], swap, a->d[j]);
+	r->d[j] = _mm512_mask_mov_epi64(a->d[j], swap, b->d[j]);
+    }
+    fix_digits_down(small, q, N);
+    fix_bits_down(small, bits, N);
+    for (int j = 0; j < N; j++)
+	r->d[j] = _mm512_mask_sub_epi64(_mm512_add_epi64(r->d[j], small[j]), subtract, r->d[j], small[j]);
+    fix_norm(r->d, N);
+
+    // Equal exponents can leave the smaller magnitude on top
+    const __mmask8 flip = _mm512_cmplt_epi64_mask(r->d[N - 1], _mm512_setzero_si512());
+    if (flip)
+    {
+	for (int j = 0; j < N; j++)
+	    r->d[j] = _mm512_mask_sub_epi64(r->d[j], flip, _mm512_setzero_si512(), r->d[j]);
+	fix_norm(r->d, N);
+    }
+    r->negative = big_negative ^ flip;
+    r->exp = big_exp;
+    vfloat_normalise(r, N);
+}
+
+// A coefficient for every lane
+typedef struct
+{
+    int64_t d[ELEM_MAX_DIGITS];
+    int64_t exp;
+    int negative;
+} poly_coefficient;
+
+static inline void vfloat_broadcast(vfloat *r, const poly_coefficient *c, int N)
+{
+    for (int j = 0; j < N; j++)
+	r->d[j] = _mm512_set1_epi64(c->d[j]);
+    r->exp = _mm512_set1_epi64(c->exp);
+    r->negative = c->negative ? 0xFF : 0;
+}
+
+// r = p(x) by Horner's rule
+static void poly_horner(vfloat *r, const vfloat *x, const poly_coefficient *c, size_t degree, int N)
+{
+    vfloat term;
+    vfloat_broadcast(r, c + degree, N);
+    for (size_t j = degree; j-- > 0;)
+    {
+	vfloat_mul(r, r, x, N);
+	vfloat_broadcast(&term, c + j, N);
+	vfloat_add(r, r, &term, N);
+    }
+}
+
+// r = p(x) by Estrin's scheme: pairs c[2i] + c[2i + 1] x, then pairs of those with x^2, x^4 and so on. scratch holds
+// degree / 2 + 1 values
+static void poly_estrin(vfloat *r, const vfloat *x, const poly_coefficient *c, size_t degree, vfloat *scratch, int N)
+{
+    vfloat power = *x, term;
+    size_t m = (degree + 2) / 2;
+    for (size_t i = 0; i < m; i++)
+    {
+	vfloat_broadcast(&scratch[i], c + 2 * i, N);
+	if (2 * i + 1 <= degree)
+	{
+	    vfloat_broadcast(&term, c + 2 * i + 1, N);
+	    vfloat_mul(&term, &term, x, N);
+	    vfloat_add(&scratch[i], &scratch[i], &term, N);
+	}
+    }
+    for (; m > 1; m = (m + 1) / 2)
+    {
+	vfloat_mul(&power, &power, &power, N);
+	for (size_t i = 0; i < m / 2; i++)
+	{
+	    vfloat_mul(&term, &scratch[2 * i + 1], &power, N);
+	    vfloat_add(&scratch[i], &scratch[2 * i], &term, N);
+	}
+	if (m % 2)
+	    scratch[m / 2] = scratch[m - 1];
+    }
+    *r = scratch[0];
+}
+
+
+/* Staging, the digits of eight numbers one lane each */
+
+typedef struct
+{
+    int64_t d[ELEM_MAX_DIGITS][AVXMPFR_BLOCK] __attribute__((aligned(64)));
+} elem_stage;
+
+static inline void stage_set(elem_stage *stage, int lane, const int64_t *digits, int N)
+{
+    for (int j = 0; j < N; j++)
+	stage->d[j][lane] = digits[j];
+}
+
+static inline void stage_get(int64_t *digits, const elem_stage *stage, int lane, int N)
+{
+    for (int j = 0; j < N; j++)
+	digits[j] = stage->d[j][lane];
+}
+
+static inline void stage_load(__m512i *a, const elem_stage *stage, int N)
+{
+    for (int j = 0; j < N; j++)
+	a[j] = _mm512_load_si512(stage->d[j]);
+}
+
+static inline void stage_store(elem_stage *stage, const __m512i *a, int N)
+{
+    for (int j = 0; j < N; j++)
+	_mm512_store_si512(stage->d[j], a[j]);
+}
+
+
+/* Batched functions */
+
+void avxmpfr_exp_vec(mpfr_t *rop, mpfr_t *op, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	rop[i] becomes exp(op[i]) correctly rounded with rnd, as mpfr_exp() does
+	rop and op are arrays of n numbers, rop[i] may be op[i]
+    */
+
+    pthread_once(&constants_once, constants_init);
+
+    elem_stage stage = {0};
+    __m512i x[ELEM_MAX_DIGITS], r[ELEM_MAX_DIGITS];
+    int64_t digits[ELEM_MAX_DIGITS], k[AVXMPFR_BLOCK] __attribute__((aligned(64)));
+    mpfr_t t;
+    mpfr_init2(t, ELEM_CONST_BITS);
+
+    for (size_t first = 0; first < n; first += AVXMPFR_BLOCK)
+    {
+	const int count = n - first < AVXMPFR_BLOCK ? n - first : AVXMPFR_BLOCK;
+	mpfr_prec_t precision = 0;
+	int live = 0;
+
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    k[lane] = 0;
+	    if (lane >= count)
+		continue;
+	    mpfr_srcptr a = op[first + lane];
+	    if (!mpfr_regular_p(a) || mpfr_get_exp(a) > ELEM_EXP_MAX || mpfr_get_prec(rop[first + lane]) > PRECISION_512)
+		continue;
+	    k[lane] = lround(mpfr_get_d(a, MPFR_RNDN) / M_LN2);
+	    if (k[lane] <= mpfr_get_emin() + 2 || k[lane] >= mpfr_get_emax() - 2)
+		continue;
+	    live |= 1 << lane;
+	    if (mpfr_get_prec(rop[first + lane]) > precision)
+		precision = mpfr_get_prec(rop[first + lane]);
+	}
+	if (!live)
+	{
+	    for (int lane = 0; lane < count; lane++)
+		mpfr_exp(rop[first + lane], op[first + lane], rnd);
+	    continue;
+	}
+
+	const int N = elem_digits(precision);
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    if (live >> lane & 1)
+		to_digits(digits, op[first + lane], 0, N);
+	    else
+		memset(digits, 0, sizeof(digits));
+	    stage_set(&stage, lane, digits, N);
+	}
+
+	// r = x - k log(2), exp(r)
+	stage_load(x, &stage, N);
+	fix_sub_multiple(x, _mm512_load_si512(k), log2_digits, N);
+	exp_kernel(r, x, N);
+	stage_store(&stage, r, N);
+
+	const int margin = exp_halvings(N) + 10;
+	for (int lane = 0; lane < count; lane++)
+	{
+	    const size_t i = first + lane;
+	    if (live >> lane & 1)
+	    {
+		// The bound is on exp(r), before the scaling by 2^k
+		stage_get(digits, &stage, lane, N);
+		from_digits(t, digits, N);
+		const mpfr_exp_t err = mpfr_get_exp(t) + ELEM_DIGIT_BITS * (N - 1) - margin;
+		mpfr_mul_2si(t, t, k[lane], MPFR_RNDN);
+		if (elem_decided(t, err, mpfr_get_prec(rop[i]), rnd))
+		{
+		    mpfr_set(rop[i], t, rnd);
+		    continue;
+		}
+	    }
+	    mpfr_exp(rop[i], op[i], rnd);
+	}
+    }
+
+    mpfr_clear(t);
+}
+
+void avxmpfr_log_vec(mpfr_t *rop, mpfr_t *op, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	rop[i] becomes log(op[i]) correctly rounded with rnd, as mpfr_log() does
+	rop and op are arrays of n numbers, rop[i] may be op[i]
+    */
+
+    pthread_once(&constants_once, constants_init);
+
+    elem_stage stage = {0}, mantissa = {0};
+    __m512i m[ELEM_MAX_DIGITS], y[ELEM_MAX_DIGITS], e[ELEM_MAX_DIGITS], p[ELEM_MAX_DIGITS];
+    int64_t digits[ELEM_MAX_DIGITS], scale[AVXMPFR_BLOCK] __attribute__((aligned(64)));
+    double start[AVXMPFR_BLOCK];
+    mpfr_t t, guess;
+    mpfr_init2(t, ELEM_CONST_BITS);
+    mpfr_init2(guess, 53);
+
+    for (size_t first = 0; first < n; first += AVXMPFR_BLOCK)
+    {
+	const int count = n - first < AVXMPFR_BLOCK ? n - first : AVXMPFR_BLOCK;
+	mpfr_prec_t precision = 0;
+	int live = 0;
+
+	// x = m 2^e, m in [sqrt(1/2), sqrt(2)). 1 itself (log exactly 0) goes to mpfr
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    scale[lane] = 0;
+	    if (lane >= count)
+		continue;
+	    mpfr_srcptr a = op[first + lane];
+	    if (!mpfr_regular_p(a) || mpfr_signbit(a) || mpfr_get_prec(rop[first + lane]) > PRECISION_512
+		|| labs(mpfr_get_exp(a)) >= 1L << 30 || mpfr_cmp_ui(a, 1) == 0)
+		continue;
+	    long exponent;
+	    double d = mpfr_get_d_2exp(&exponent, a, MPFR_RNDN);
+	    if (d < M_SQRT1_2)
+	    {
+		d *= 2;
+		exponent--;
+	    }
+	    scale[lane] = exponent;
+	    start[lane] = log(d);
+	    live |= 1 << lane;
+	    if (mpfr_get_prec(rop[first + lane]) > precision)
+		precision = mpfr_get_prec(rop[first + lane]);
+	}
+	if (!live)
+	{
+	    for (int lane = 0; lane < count; lane++)
+		mpfr_log(rop[first + lane], op[first + lane], rnd);
+	    continue;
+	}
+
+	const int N = elem_digits(precision);
+	const int F = ELEM_DIGIT_BITS * (N - 1);
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    if (live >> lane & 1)
+	    {
+		to_digits(digits, op[first + lane], -scale[lane], N);
+		stage_set(&mantissa, lane, digits, N);
+		mpfr_set_d(guess, start[lane], MPFR_RNDN);
+		to_digits(digits, guess, 0, N);
+	    }
+	    else
+	    {
+		memset(digits, 0, sizeof(digits));
+		stage_set(&mantissa, lane, digits, N);
+	    }
+	    stage_set(&stage, lane, digits, N);
+	}
+
+	// Newton on exp(y) = m: a step from bits correct bits gives min(2 bits - 1, F' - s' - 10) on F' bits
+	stage_load(m, &mantissa, N);
+	stage_load(y, &stage, N);
+	int bits = 50, used = N;
+	for (;;)
+	{
+	    int step = (2 * bits + 20 + ELEM_DIGIT_BITS - 1) / ELEM_DIGIT_BITS + 1;
+	    if (step > N)
+		step = N;
+
+	    // y on step digits, the top ones of the full width the first time and widened after
+	    if (used == N && step < N)
+	    {
+		for (int j = 0; j < step; j++)
+		    y[j] = y[j + N - step];
+	    }
+	    else if (step > used)
+		fix_widen(y, used, step);
+	    used = step;
+
+	    fix_neg(e, y, step);
+	    exp_kernel(p, e, step);
+	    fix_mul(p, p, m + N - step, step);
+	    for (int j = 0; j < step; j++)
+		y[j] = _mm512_add_epi64(y[j], p[j]);
+	    fix_sub_const(y, inv_factorial[0], step);
+
+	    const int gained = ELEM_DIGIT_BITS * (step - 1) - exp_halvings(step) - 10;
+	    bits = 2 * bits - 1 < gained ? 2 * bits - 1 : gained;
+	    if (step == N && bits >= F - exp_halvings(N) - 10)
+		break;
+	}
+
+	// e log(2) + y
+	fix_sub_multiple(y, _mm512_sub_epi64(_mm512_setzero_si512(), _mm512_load_si512(scale)), log2_digits, N);
+	stage_store(&stage, y, N);
+
+	const int margin = exp_halvings(N) + 11;
+	for (int lane = 0; lane < count; lane++)
+	{
+	    const size_t i = first + lane;
+	    if (live >> lane & 1)
+	    {
+		stage_get(digits, &stage, lane, N);
+		from_digits(t, digits, N);
+		if (elem_decided(t, mpfr_get_exp(t) + F - margin, mpfr_get_prec(rop[i]), rnd))
+		{
+		    mpfr_set(rop[i], t, rnd);
+		    continue;
+		}
+	    }
+	    mpfr_log(rop[i], op[i], rnd);
+	}
+    }
+
+    mpfr_clear(t);
+    mpfr_clear(guess);
+}
+
+void avxmpfr_sincos_vec(mpfr_t *sop, mpfr_t *cop, mpfr_t *op, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	sop[i] becomes sin(op[i]) and cop[i] cos(op[i]), both correctly rounded with rnd, as mpfr_sin_cos() does
+	sop, cop and op are arrays of n numbers, sop[i] or cop[i] may be op[i] but not each other
+    */
+
+    pthread_once(&constants_once, constants_init);
+
+    elem_stage sines = {0}, cosines = {0};
+    __m512i x[ELEM_MAX_DIGITS], sn[ELEM_MAX_DIGITS], cs[ELEM_MAX_DIGITS];
+    int64_t digits[ELEM_MAX_DIGITS], k[AVXMPFR_BLOCK] __attribute__((aligned(64)));
+    mpfr_t ts, tc;
+    mpfr_init2(ts, ELEM_CONST_BITS);
+    mpfr_init2(tc, ELEM_CONST_BITS);
+
+    for (size_t first = 0; first < n; first += AVXMPFR_BLOCK)
+    {
+	const int count = n - first < AVXMPFR_BLOCK ? n - first : AVXMPFR_BLOCK;
+	mpfr_prec_t precision = 0;
+	int live = 0;
+
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    k[lane] = 0;
+	    if (lane >= count)
+		continue;
+	    const size_t i = first + lane;
+	    const mpfr_prec_t widest = mpfr_get_prec(sop[i]) > mpfr_get_prec(cop[i]) ? mpfr_get_prec(sop[i])
+										     : mpfr_get_prec(cop[i]);
+	    if (!mpfr_regular_p(op[i]) || mpfr_get_exp(op[i]) > ELEM_TRIG_MAX || widest > PRECISION_512)
+		continue;
+	    k[lane] = lround(mpfr_get_d(op[i], MPFR_RNDN) / M_PI_2);
+	    live |= 1 << lane;
+	    if (widest > precision)
+		precision = widest;
+	}
+	if (!live)
+	{
+	    for (int lane = 0; lane < count; lane++)
+		mpfr_sin_cos(sop[first + lane], cop[first + lane], op[first + lane], rnd);
+	    continue;
+	}
+
+	const int N = elem_digits(precision);
+	const int F = ELEM_DIGIT_BITS * (N - 1);
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    if (live >> lane & 1)
+		to_digits(digits, op[first + lane], 0, N);
+	    else
+		memset(digits, 0, sizeof(digits));
+	    stage_set(&sines, lane, digits, N);
+	}
+
+	// r = x - k pi / 2, sin(r) and cos(r)
+	stage_load(x, &sines, N);
+	fix_sub_multiple(x, _mm512_load_si512(k), half_pi_digits, N);
+	sincos_kernel(sn, cs, x, N);
+	stage_store(&sines, sn, N);
+	stage_store(&cosines, cs, N);
+
+	const int margin = 2 * ELEM_TRIG_HALVINGS + 10;
+	for (int lane = 0; lane < count; lane++)
+	{
+	    const size_t i = first + lane;
+	    if (live >> lane & 1)
+	    {
+		// The quadrant: sin(x) is sin(r), cos(r), -sin(r), -cos(r) for k = 0, 1, 2, 3 mod 4, cos(x) one ahead
+		const int quadrant = k[lane] & 3;
+		stage_get(digits, quadrant % 2 ? &cosines : &sines, lane, N);
+		from_digits(ts, digits, N);
+		stage_get(digits, quadrant % 2 ? &sines : &cosines, lane, N);
+		from_digits(tc, digits, N);
+		if (quadrant >= 2)
+		    mpfr_neg(ts, ts, MPFR_RNDN);
+		if (quadrant == 1 || quadrant == 2)
+		    mpfr_neg(tc, tc, MPFR_RNDN);
+
+		if (elem_decided(ts, mpfr_get_exp(ts) + F - margin, mpfr_get_prec(sop[i]), rnd)
+		    && elem_decided(tc, mpfr_get_exp(tc) + F - margin, mpfr_get_prec(cop[i]), rnd))
+		{
+		    mpfr_set(sop[i], ts, rnd);
+		    mpfr_set(cop[i], tc, rnd);
+		    continue;
+		}
+	    }
+	    mpfr_sin_cos(sop[i], cop[i], op[i], rnd);
+	}
+    }
+
+    mpfr_clear(ts);
+    mpfr_clear(tc);
+}
+
+// Horner's rule in mpfr in sum, for the points the vectors do not take
+static void poly_mpfr(mpfr_t rop, mpfr_t *coeffs, size_t degree, mpfr_srcptr x, mpfr_t sum, mpfr_rnd_t rnd)
+{
+    mpfr_set(sum, coeffs[degree], MPFR_RNDN);
+    for (size_t j = degree; j-- > 0;)
+	mpfr_fma(sum, sum, x, coeffs[j], MPFR_RNDN);
+    mpfr_set(rop, sum, rnd);
+}
+
+void avxmpfr_poly_set_scheme(int scheme)
+{
+    poly_scheme = scheme;
+}
+
+void avxmpfr_poly_eval_vec(mpfr_t *rop, mpfr_t *coeffs, size_t degree, mpfr_t *x, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	rop[i] becomes p(x[i]) = coeffs[0] + coeffs[1] x[i] + ... + coeffs[degree] x[i]^degree
+	rop and x are arrays of n numbers, rop[i] may be x[i], coeffs has degree + 1
+
+	p is evaluated on F >= prec + 48 bits for the widest rop and rounded once with rnd, so that
+	|rop[i] - p(x[i])| <= ulp(rop[i]) + (degree + 2) 2^(-prec - 46) sum |coeffs[j] x[i]^j|, by Horner's rule or
+	Estrin's scheme as avxmpfr_poly_set_scheme() says
+    */
+
+    mpfr_prec_t precision = 0;
+    for (size_t i = 0; i < n; i++)
+	if (mpfr_get_prec(rop[i]) > precision)
+	    precision = mpfr_get_prec(rop[i]);
+    const int N = elem_digits(precision);
+
+    // Coefficients the vectors cannot take, and low degrees, send every point to mpfr
+    int vector = precision <= PRECISION_512 && degree >= POLY_MIN_DEGREE && degree <= POLY_MAX_DEGREE;
+    for (size_t j = 0; j <= degree && vector; j++)
+	vector = mpfr_number_p(coeffs[j]) && (mpfr_zero_p(coeffs[j]) || labs(mpfr_get_exp(coeffs[j])) < POLY_MAX_EXP);
+    mpfr_t sum;
+    mpfr_init2(sum, precision + ELEM_GUARD);
+    if (!vector)
+    {
+	for (size_t i = 0; i < n; i++)
+	    poly_mpfr(rop[i], coeffs, degree, x[i], sum, rnd);
+	mpfr_clear(sum);
+	return;
+    }
+
+    // Estrin's scheme has the shorter dependency chain, but the eight lanes already keep the vector units busy and it
+    // takes half as many multiplications again, so it gains nothing measurable here and AVXMPFR_POLY_AUTO stays with
+    // Horner's rule
+    const int estrin = poly_scheme == AVXMPFR_POLY_ESTRIN;
+
+    poly_coefficient *c = malloc((degree + 1) * sizeof(poly_coefficient));
+    vfloat *scratch = estrin ? aligned_alloc(64, (degree / 2 + 1) * sizeof(vfloat)) : NULL;
+    for (size_t j = 0; j <= degree; j++)
+    {
+	magnitude_digits(c[j].d, coeffs[j], mpfr_zero_p(coeffs[j]) ? 0 : -mpfr_get_exp(coeffs[j]), N);
+	c[j].exp = mpfr_zero_p(coeffs[j]) ? POLY_EXP_ZERO : mpfr_get_exp(coeffs[j]);
+	c[j].negative = !mpfr_zero_p(coeffs[j]) && mpfr_signbit(coeffs[j]);
+    }
+
+    elem_stage stage = {0};
+    int64_t digits[ELEM_MAX_DIGITS], exp[AVXMPFR_BLOCK] __attribute__((aligned(64)));
+    vfloat point, result;
+
+    for (size_t first = 0; first < n; first += AVXMPFR_BLOCK)
+    {
+	const int count = n - first < AVXMPFR_BLOCK ? n - first : AVXMPFR_BLOCK;
+	int live = 0, negative = 0;
+
+	for (int lane = 0; lane < AVXMPFR_BLOCK; lane++)
+	{
+	    mpfr_srcptr a = x[first + (lane < count ? lane : 0)];
+	    exp[lane] = POLY_EXP_ZERO;
+	    memset(digits, 0, sizeof(digits));
+	    if (lane < count && mpfr_number_p(a) && (mpfr_zero_p(a) || labs(mpfr_get_exp(a)) < POLY_MAX_EXP))
+	    {
+		live |= 1 << lane;
+		if (!mpfr_zero_p(a))
+		{
+		    magnitude_digits(digits, a, -mpfr_get_exp(a), N);
+		    exp[lane] = mpfr_get_exp(a);
+		    negative |= mpfr_signbit(a) ? 1 << lane : 0;
+		}
+	    }
+	    stage_set(&stage, lane, digits, N);
+	}
+
+	if (live)
+	{
+	    stage_load(point.d, &stage, N);
+	    point.exp = _mm512_load_si512(exp);
+	    point.negative = negative;
+	    if (estrin)
+		poly_estrin(&result, &point, c, degree, scratch, N);
+	    else
+		poly_horner(&result, &point, c, degree, N);
+	    stage_store(&stage, result.d, N);
+	    _mm512_store_si512(exp, result.exp);
+	}
+
+	for (int lane = 0; lane < count; lane++)
+	{
+	    const size_t i = first + lane;
+	    if (!(live >> lane & 1))
+		poly_mpfr(rop[i], coeffs, degree, x[i], sum, rnd);
+	    else if (exp[lane] == POLY_EXP_ZERO)
+		mpfr_set_zero(rop[i], rnd == MPFR_RNDD ? -1 : 1);
+	    else
+	    {
+		stage_get(digits, &stage, lane, N);
+		round_digits(rop[i], result.negative >> lane & 1 ? -1 : 1, digits, N, exp[lane], rnd);
+	    }
+	}
+    }
+
+    mpfr_clear(sum);
+    free(c);
+    free(scratch);
+}
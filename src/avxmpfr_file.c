@@ -0,0 +1,232 @@
+// avxmpfr_file.c
+
+/*
+    On-disk container for packed arrays (see avxmpfr_array.c), read back with mmap so nothing is parsed or copied.
+
+    A file is a 64 byte header followed, at AVXMPFR_FILE_DATA_OFFSET, by the blocks of the array exactly as they are
+    laid out in memory. Since the data offset is page aligned the mapped blocks keep their 64 byte alignment, so the
+    view handed out by avxmpfr_file_open() can go straight into avxmpfr_add_array().
+
+    The writer streams whole blocks out with write(), so results can be written chunk by chunk while a larger
+    computation is still running. The value count in the header is only filled in by avxmpfr_writer_close().
+
+    Files are stored in the byte order of the machine that wrote them, a mismatch is rejected when opening.
+    All functions return 0 on success and -1 with errno set on failure.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AVXMPFR_FILE_MAGIC "AVXMPFR"
+#define AVXMPFR_FILE_VERSION 1
+#define AVXMPFR_FILE_BYTE_ORDER 0x01020304
+#define AVXMPFR_FILE_DATA_OFFSET 4096
+
+typedef struct
+{
+    char magic[8];		// "AVXMPFR\0"
+    uint32_t version;
+    uint32_t byte_order;	// AVXMPFR_FILE_BYTE_ORDER as written by the producer
+    uint16_t precision;		// PRECISION_256 or PRECISION_512
+    uint16_t limbs;		// Padded limbs per value
+    uint32_t layout;		// AVXMPFR_LAYOUT_NATIVE or AVXMPFR_LAYOUT_SOA
+    uint64_t count;		// Number of values
+    uint64_t block_words;	// 64 bit words per block, as a consistency check
+    uint64_t data_offset;	// Offset of the first block
+    uint8_t reserved[16];
+} avxmpfr_file_header;
+
+_Static_assert(sizeof(avxmpfr_file_header) == 64, "avxmpfr file header must be 64 bytes");
+
+// Write all of buffer, retrying short writes
+static int write_all(int fd, const void *buffer, size_t size)
+{
+    const char *p = buffer;
+    while (size > 0)
+    {
+	ssize_t written = write(fd, p, size);
+	if (written < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	p += written;
+	size -= written;
+    }
+    return 0;
+}
+
+static void fill_header(avxmpfr_file_header *header, uint16_t precision, uint32_t layout, uint64_t count)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, AVXMPFR_FILE_MAGIC, sizeof(AVXMPFR_FILE_MAGIC));
+    header->version = AVXMPFR_FILE_VERSION;
+    header->byte_order = AVXMPFR_FILE_BYTE_ORDER;
+    header->precision = precision;
+    header->limbs = (precision + 62) / 63;
+    header->layout = layout;
+    header->count = count;
+    header->block_words = avxmpfr_block_words(header->limbs);
+    header->data_offset = AVXMPFR_FILE_DATA_OFFSET;
+}
+
+
+/* Reading */
+
+// Undo a partly opened file with error in errno, a later avxmpfr_file_close() then does nothing
+static int open_failed(avxmpfr_file *file, int error)
+{
+    avxmpfr_file_close(file);
+    errno = error;
+    return -1;
+}
+
+int avxmpfr_file_open(avxmpfr_file *file, const char *path)
+{
+    /*
+	Map the file at path read only. file->array is a view of the values that stays valid until avxmpfr_file_close().
+    */
+
+    file->map = NULL;
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0)
+	return -1;
+
+    struct stat st;
+    if (fstat(file->fd, &st) < 0)
+	return open_failed(file, errno);
+    if ((size_t) st.st_size < AVXMPFR_FILE_DATA_OFFSET)
+	return open_failed(file, EINVAL);
+
+    file->map_size = st.st_size;
+    file->map = mmap(NULL, file->map_size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (file->map == MAP_FAILED)
+    {
+	file->map = NULL;
+	return open_failed(file, errno);
+    }
+
+    // Check the header describes something this build can use. The count comes from the file, so the blocks are
+    // compared with what fits after the data offset instead of multiplying it out
+    const avxmpfr_file_header *header = file->map;
+    uint16_t limbs = (header->precision + 62) / 63;
+    if (memcmp(header->magic, AVXMPFR_FILE_MAGIC, sizeof(AVXMPFR_FILE_MAGIC)) != 0
+	|| header->version != AVXMPFR_FILE_VERSION
+	|| header->byte_order != AVXMPFR_FILE_BYTE_ORDER
+	|| (header->precision != PRECISION_256 && header->precision != PRECISION_512)
+	|| (header->layout != AVXMPFR_LAYOUT_NATIVE && header->layout != AVXMPFR_LAYOUT_SOA)
+	|| header->limbs != limbs
+	|| header->block_words != avxmpfr_block_words(limbs)
+	|| header->data_offset % 64 != 0
+	|| header->data_offset > file->map_size
+	|| header->count / AVXMPFR_BLOCK + (header->count % AVXMPFR_BLOCK != 0)
+	   > (file->map_size - header->data_offset) / (header->block_words * sizeof(uint64_t)))
+	return open_failed(file, EINVAL);
+
+    // The values are normally consumed front to back, let the kernel read ahead aggressively
+    madvise(file->map, file->map_size, MADV_SEQUENTIAL);
+
+    file->array.precision = header->precision;
+    file->array.limbs = header->limbs;
+    file->array.layout = header->layout;
+    file->array.count = header->count;
+    file->array.blocks = (uint64_t *) ((char *) file->map + header->data_offset);
+    return 0;
+}
+
+void avxmpfr_file_close(avxmpfr_file *file)
+{
+    /*
+	Unmap the file, safe to call again and after a failed avxmpfr_file_open()
+    */
+
+    if (file->map != NULL)
+	munmap(file->map, file->map_size);
+    if (file->fd >= 0)
+	close(file->fd);
+    file->map = NULL;
+    file->fd = -1;
+}
+
+
+/* Writing */
+
+int avxmpfr_writer_open(avxmpfr_writer *writer, const char *path, uint16_t precision, uint32_t layout)
+{
+    /*
+	Create (or truncate) the file at path for values of the given precision and layout
+    */
+
+    writer->precision = precision;
+    writer->layout = layout;
+    writer->count = 0;
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0)
+	return -1;
+
+    // Header with a zero count, padded up to the data offset
+    char first_page[AVXMPFR_FILE_DATA_OFFSET] = {0};
+    fill_header((avxmpfr_file_header *) first_page, precision, layout, 0);
+    if (write_all(writer->fd, first_page, sizeof(first_page)) < 0)
+    {
+	const int error = errno;
+	close(writer->fd);
+	writer->fd = -1;
+	errno = error;
+	return -1;
+    }
+
+    posix_fadvise(writer->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+}
+
+int avxmpfr_writer_append(avxmpfr_writer *writer, const avxmpfr_array *array)
+{
+    /*
+	Append the values of array, which must match the precision and layout of the writer.
+	Only the last append may end part way through a block.
+    */
+
+    if (array->precision != writer->precision || array->layout != writer->layout || writer->count % AVXMPFR_BLOCK != 0)
+    {
+	errno = EINVAL;
+	return -1;
+    }
+
+    size_t bytes = avxmpfr_array_blocks(array->count) * avxmpfr_block_words(array->limbs) * sizeof(uint64_t);
+    if (write_all(writer->fd, array->blocks, bytes) < 0)
+	return -1;
+
+    writer->count += array->count;
+    return 0;
+}
+
+int avxmpfr_writer_close(avxmpfr_writer *writer)
+{
+    /*
+	Fill in the final count and close the file
+    */
+
+    if (writer->fd < 0)
+    {
+	errno = EBADF;
+	return -1;
+    }
+
+    avxmpfr_file_header header;
+    fill_header(&header, writer->precision, writer->layout, writer->count);
+
+    int status = 0;
+    if (pwrite(writer->fd, &header, sizeof(header), 0) != sizeof(header))
+	status = -1;
+    if (close(writer->fd) < 0)
+	status = -1;
+    writer->fd = -1;
+    return status;
+}
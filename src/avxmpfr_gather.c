@@ -0,0 +1,177 @@
+// avxmpfr_gather.c
+
+/*
+    Batched addition over arrays of pointers, rop[i] = op1[i] + op2[i] with each mpfr_t wherever the caller keeps it.
+
+    In real code the operands sit inside larger structs and every _mpfr_d limb block is somewhere else on the heap.
+    A loop adding them one by one stalls twice per operand on a working set bigger than the cache: once on the mpfr_t
+    itself, to learn where its limbs are, and once on the limbs. Neither miss can start before the previous addition
+    is done with, so the SIMD work waits on memory the whole time.
+
+    Here the work goes through a pipeline of chunks of GATHER_CHUNK values, every stage a fixed distance ahead of the
+    one after it:
+	the mpfr_t structs of rop, op1 and op2 are prefetched GATHER_STRUCT_AHEAD values ahead
+	their limb blocks are prefetched GATHER_LIMBS_AHEAD values ahead, the structs having arrived by then so the
+	_mpfr_d pointers can be read without stalling
+	a chunk is gathered into a staging buffer in the padded lane layout of avx_add() / avx_add_512i(), with the
+	exponents and signs next to it, every value repacked with a masked load, two permutes and shifts
+	the staged chunk is alligned and added from the buffer, nothing but registers and the buffer being touched
+	the sums are scattered back into the limbs of rop the same way, their blocks having been prefetched for
+	writing with the operands
+    The misses of a whole chunk are then in flight at the same time instead of one after the other.
+
+    The additions follow avxmpfr_add_scalar_vec(): the smaller operand is truncated when alligned and the sum when
+    normalised, pairs with different signs, zeros, NaNs, infinities, a sum beyond the exponent range or any of rop[i],
+    op1[i] and op2[i] not of the precision passed go through mpfr_add() with rnd. The operands are not modified.
+    rop[i] may be op1[i] or op2[i], but not an operand of another index.
+*/
+
+#include "avxmpfr_utilities.h"
+
+#define GATHER_CHUNK 16		// Values gathered, added and scattered at a time
+#define GATHER_LIMBS_AHEAD 16	// Distance of the limb prefetches ...
+#define GATHER_STRUCT_AHEAD 32	// ... and of the mpfr_t prefetches, far enough that the structs arrive first
+
+// A chunk in the padded layout, the bigger operand of each pair in big
+typedef struct
+{
+    uint64_t big[GATHER_CHUNK][8] __attribute__((aligned(64)));
+    uint64_t small[GATHER_CHUNK][8] __attribute__((aligned(64)));
+    int64_t gap[GATHER_CHUNK];
+    mpfr_exp_t exp[GATHER_CHUNK];	// Exponent of the sum
+    int sign[GATHER_CHUNK];
+    int fallback[GATHER_CHUNK];		// 1 for the pairs left to mpfr_add()
+} gather_stage;
+
+// Issue the prefetches due while value i is gathered, the first and last limb in case a block straddles two lines
+static inline void gather_prefetch(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t n, size_t i, int L)
+{
+    if (i + GATHER_STRUCT_AHEAD < n)
+    {
+	_mm_prefetch((const char *) rop[i + GATHER_STRUCT_AHEAD], _MM_HINT_T0);
+	_mm_prefetch((const char *) op1[i + GATHER_STRUCT_AHEAD], _MM_HINT_T0);
+	_mm_prefetch((const char *) op2[i + GATHER_STRUCT_AHEAD], _MM_HINT_T0);
+    }
+    if (i + GATHER_LIMBS_AHEAD < n)
+    {
+	const size_t j = i + GATHER_LIMBS_AHEAD;
+	_mm_prefetch((const char *) op1[j]->_mpfr_d, _MM_HINT_T0);
+	_mm_prefetch((const char *) (op1[j]->_mpfr_d + L - 1), _MM_HINT_T0);
+	_mm_prefetch((const char *) op2[j]->_mpfr_d, _MM_HINT_T0);
+	_mm_prefetch((const char *) (op2[j]->_mpfr_d + L - 1), _MM_HINT_T0);
+	__builtin_prefetch(rop[j]->_mpfr_d, 1, 3);
+	__builtin_prefetch(rop[j]->_mpfr_d + L - 1, 1, 3);
+    }
+}
+
+// Gather the values first .. first + count - 1 into stage, L padded lanes each
+static inline void gather_chunk(gather_stage *stage, mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t n,
+				size_t first, int count, int L, mpfr_prec_t precision)
+{
+    for (int k = 0; k < count; k++)
+    {
+	const size_t i = first + k;
+	gather_prefetch(rop, op1, op2, n, i, L);
+
+	mpfr_ptr a = op1[i], b = op2[i];
+	stage->fallback[k] = !mpfr_regular_p(a) || !mpfr_regular_p(b) || mpfr_signbit(a) != mpfr_signbit(b)
+			     || mpfr_get_prec(a) != precision || mpfr_get_prec(b) != precision
+			     || mpfr_get_prec(rop[i]) != precision;
+	if (stage->fallback[k])
+	    continue;
+
+	if (b->_mpfr_exp > a->_mpfr_exp)
+	{
+	    mpfr_ptr t = a;
+	    a = b;
+	    b = t;
+	}
+	_mm512_store_si512((void *) stage->big[k], avxmpfr_pack_lanes8(L, a));
+	_mm512_store_si512((void *) stage->small[k], avxmpfr_pack_lanes8(L, b));
+	stage->gap[k] = a->_mpfr_exp - b->_mpfr_exp;
+	stage->exp[k] = a->_mpfr_exp;
+	stage->sign[k] = a->_mpfr_sign;
+	AVXMPFR_COUNT_GAP(stage->gap[k]);
+    }
+}
+
+// Allign and add the staged pairs, the sums replacing big
+static inline void gather_add252(gather_stage *stage, int count)
+{
+    for (int k = 0; k < count; k++)
+	if (!stage->fallback[k])
+	{
+	    const __m256i x = _mm256_load_si256((const __m256i *) stage->big[k]);
+	    const __m256i y = avxmpfr_shift_padded252(_mm256_load_si256((const __m256i *) stage->small[k]), stage->gap[k]);
+	    _mm256_store_si256((__m256i *) stage->big[k], avx_add(x, y, &stage->exp[k]));
+	}
+}
+
+static inline void gather_add504(gather_stage *stage, int count)
+{
+    for (int k = 0; k < count; k++)
+	if (!stage->fallback[k])
+	{
+	    const __m512i x = _mm512_load_si512((const void *) stage->big[k]);
+	    const __m512i y = avxmpfr_shift_padded504(_mm512_load_si512((const void *) stage->small[k]), stage->gap[k]);
+	    _mm512_store_si512((void *) stage->big[k], avx_add_512i(x, y, &stage->exp[k]));
+	}
+}
+
+// Scatter the sums of the chunk back into rop, computing the rest with mpfr_add()
+static inline void scatter_chunk(const gather_stage *stage, mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t first,
+				 int count, int L, mpfr_exp_t emax, mpfr_rnd_t rnd)
+{
+    for (int k = 0; k < count; k++)
+    {
+	const size_t i = first + k;
+	if (stage->fallback[k] || stage->exp[k] > emax)
+	{
+	    mpfr_add(rop[i], op1[i], op2[i], rnd);
+	    continue;
+	}
+	avxmpfr_unpack_lanes8(rop[i]->_mpfr_d, _mm512_load_si512((const void *) stage->big[k]), L, L);
+	rop[i]->_mpfr_sign = stage->sign[k];
+	rop[i]->_mpfr_exp = stage->exp[k];
+    }
+}
+
+void avxmpfr_add_ptr_vec(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t n, mpfr_rnd_t rnd, const uint16_t PRECISION)
+{
+    /*
+	rop is the array of n pointers to the resultant operands
+	op1 and op2 are the arrays of n pointers to the operands, not modified
+	rnd is the rounding mode, only used for the pairs handed to mpfr_add()
+	PRECISION is the precision of rop[i], op1[i] and op2[i] (Either PRECISION_256 / PRECISION_512), the values
+	    of another precision go through mpfr_add()
+    */
+
+    const int L = (PRECISION == PRECISION_256) ? 4 : 8;
+    const mpfr_exp_t emax = mpfr_get_emax();
+    gather_stage stage;
+
+    // Start the structs and limbs of the first values on their way
+    for (size_t i = 0; i < n && i < GATHER_STRUCT_AHEAD; i++)
+    {
+	_mm_prefetch((const char *) rop[i], _MM_HINT_T0);
+	_mm_prefetch((const char *) op1[i], _MM_HINT_T0);
+	_mm_prefetch((const char *) op2[i], _MM_HINT_T0);
+    }
+    for (size_t i = 0; i < n && i < GATHER_LIMBS_AHEAD; i++)
+    {
+	_mm_prefetch((const char *) op1[i]->_mpfr_d, _MM_HINT_T0);
+	_mm_prefetch((const char *) op2[i]->_mpfr_d, _MM_HINT_T0);
+	__builtin_prefetch(rop[i]->_mpfr_d, 1, 3);
+    }
+
+    for (size_t first = 0; first < n; first += GATHER_CHUNK)
+    {
+	const int count = (n - first < GATHER_CHUNK) ? n - first : GATHER_CHUNK;
+	gather_chunk(&stage, rop, op1, op2, n, first, count, L, PRECISION);
+	if (L == 4)
+	    gather_add252(&stage, count);
+	else
+	    gather_add504(&stage, count);
+	scatter_chunk(&stage, rop, op1, op2, first, count, L, emax, rnd);
+    }
+}
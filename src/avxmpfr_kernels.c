@@ -0,0 +1,363 @@
+// avxmpfr_kernels.c
+
+/*
+    Addition kernels for any precision from 2 to 64 padded limbs, written once and specialised by the preprocessor.
+
+    avx_add() / avx_add_512i() and avxmpfr_pad252() / avxmpfr_pad504() are hand written for exactly 4 and 8 limbs.
+    Here the kernel is generic code taking the number of padded 63 bit limbs L and the instruction set as arguments.
+    FOR_EACH_LIMBS() then stamps out one function per (L, instruction set) pair with both as constants, so the
+    compiler inlines, unrolls and keeps the limbs in registers for each of them. Adding a size means adding a number
+    to FOR_EACH_LIMBS().
+
+    Every specialisation:
+	packs both operands into L padded limbs with avxmpfr_pack_lanes(), without modifying them
+	alligns the smaller operand by shifting it right, truncating what falls off
+	adds the limbs in vectors of 4 (AVX2) or 8 (AVX512) with the same carry loop as avx_add(), carries crossing
+	from one vector to the next
+	normalises with truncation on a carry out of the most significant limb, and truncates to mpfr_get_prec(rop)
+
+    Up to 8 limbs the AVX512 specialisations skip the scalar loops: the operands are packed with
+    avxmpfr_pack_lanes8(), alligned with avxmpfr_shift_padded504() and unpacked into rop with avxmpfr_unpack_lanes8(),
+    all in one zmm register.
+
+    A precision p uses L = ceil(p / 63) padded limbs. avxmpfr_kernel_lookup() returns the specialisation for a
+    precision and instruction set. avxmpfr_add_prec() only uses the kernels where comparison_kernels measures them
+    faster than mpfr_add(), the AVX512 ones for AVXMPFR_KERNEL_FAST_MIN_LIMBS to AVXMPFR_KERNEL_FAST_MAX_LIMBS limbs:
+    only 8 limbs (442 to 504 bits), at about 1.2x. From 3 to 7 limbs they are level with mpfr_add() within the noise,
+    the fixed cost of packing being about what mpfr_add() takes for the whole addition. Past 8 limbs the operands no
+    longer fit one register and the scalar packing and the carry loop make them up to 2x slower. The AVX2 ones lose at
+    every size. Precisions up to PRECISION_128 go to avxmpfr_add_128(), the rest to mpfr_add().
+
+    The file is compiled twice. The normal build holds the AVX512 specialisations and the registry. The AVX2 ones are
+    built from the same source with -DAVXMPFR_KERNELS_AVX2 and without -mavx512f into avxmpfr_kernels_avx2.o (see
+    the Makefile). Compiled next to the AVX512 ones the compiler is free to use zmm and mask registers in them, and
+    they would fault on processors that only have AVX2.
+
+    Like avxmpfr_add() the result is truncated, which for operands of at most 63 * L bits is exactly mpfr_add() with
+    MPFR_RNDZ: the operands fit the padded limbs whole, and truncating the alligned smaller one cannot change the
+    truncated sum. Every other rounding mode, operands wider than 63 * L bits, operands with different signs, zeros,
+    NaNs, infinities and results beyond the exponent range go through mpfr_add() with rnd instead, so every kernel
+    returns what mpfr_add() does.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <string.h>
+
+#define KERNEL_MAX_LIMBS (AVXMPFR_KERNEL_MAX_LIMBS + 8)	// Room to round up to whole vectors
+
+#define FORCE_INLINE static inline __attribute__((always_inline))
+
+
+/* Generic parts */
+
+// out = in shifted right by gap bits over L padded limbs, truncating what falls off the least significant limb
+FORCE_INLINE void shift_limbs(uint64_t *out, const uint64_t *in, const int L, int64_t gap)
+{
+    if (gap >= 63 * (int64_t) L)
+    {
+	memset(out, 0, L * sizeof(uint64_t));
+	return;
+    }
+
+    const int q = gap / 63;
+    const int r = gap % 63;
+
+    // Split so the compiler sees straight loops it can vectorise
+    for (int k = 0; k < q; k++)
+	out[k] = 0;
+    if (r == 0)
+    {
+	for (int k = q; k < L; k++)
+	    out[k] = in[k - q];
+	return;
+    }
+    out[q] = in[0] >> r;
+    for (int k = q + 1; k < L; k++)
+	out[k] = ((in[k - q] >> r) | (in[k - q - 1] << (63 - r))) & AVXMPFR_PAD_MASK;
+}
+
+// s = a + b over V vectors of 4 limbs, returns 1 if it carried out of the top limb and had to normalise
+FORCE_INLINE int add_limbs_avx2(uint64_t *s, const uint64_t *a, const uint64_t *b, const int V)
+{
+    const __m256i mask = _mm256_set1_epi64x(AVXMPFR_PAD_MASK);
+    __m256i sum[KERNEL_MAX_LIMBS / 4];
+    __m256i carry[KERNEL_MAX_LIMBS / 4 + 1];
+    int normalise = 0;
+    AVXMPFR_STATS_ONLY(int carry_iterations = 0;)
+
+    for (int v = 0; v < V; v++)
+	sum[v] = _mm256_add_epi64(_mm256_load_si256((const __m256i *) (a + 4 * v)), _mm256_load_si256((const __m256i *) (b + 4 * v)));
+
+    carry[V] = _mm256_setzero_si256();
+    for (;;)
+    {
+	AVXMPFR_STATS_ONLY(carry_iterations++;)
+	__m256i any = _mm256_setzero_si256();
+	for (int v = 0; v < V; v++)
+	{
+	    carry[v] = _mm256_srli_epi64(sum[v], 63);
+	    sum[v] = _mm256_and_si256(sum[v], mask);
+	    any = _mm256_or_si256(any, carry[v]);
+	}
+	if (_mm256_testz_si256(any, any))
+	    break;
+
+	normalise |= _mm256_cvtsi256_si32(carry[0]);
+
+	// Each carry moves one limb towards the most significant end, the last limb takes the next vector's first
+	for (int v = 0; v < V; v++)
+	{
+	    __m256i moved = _mm256_blend_epi32(_mm256_permute4x64_epi64(carry[v], _MM_SHUFFLE(0, 3, 2, 1)),
+					       _mm256_permute4x64_epi64(carry[v + 1], _MM_SHUFFLE(0, 0, 0, 0)), 0xC0);
+	    sum[v] = _mm256_add_epi64(sum[v], moved);
+	}
+    }
+    AVXMPFR_COUNT_CARRY(carry_iterations);
+
+    if (normalise)
+    {
+	// Shift right by one across limbs, the carry becomes the top bit of the first limb
+	__m256i previous = _mm256_set1_epi64x(1);
+	for (int v = 0; v < V; v++)
+	{
+	    __m256i down = _mm256_blend_epi32(_mm256_permute4x64_epi64(sum[v], _MM_SHUFFLE(2, 1, 0, 3)),
+					      _mm256_permute4x64_epi64(previous, _MM_SHUFFLE(3, 3, 3, 3)), 0x03);
+	    previous = sum[v];
+	    sum[v] = _mm256_or_si256(_mm256_srli_epi64(sum[v], 1), _mm256_slli_epi64(_mm256_and_si256(down, _mm256_set1_epi64x(1)), 62));
+	}
+	AVXMPFR_COUNT(normalisations, 1);
+    }
+
+    for (int v = 0; v < V; v++)
+	_mm256_store_si256((__m256i *) (s + 4 * v), sum[v]);
+    return normalise;
+}
+
+#ifndef AVXMPFR_KERNELS_AVX2
+// s = a + b over V vectors of 8 limbs
+FORCE_INLINE int add_limbs_avx512(uint64_t *s, const uint64_t *a, const uint64_t *b, const int V)
+{
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    __m512i sum[KERNEL_MAX_LIMBS / 8];
+    __m512i carry[KERNEL_MAX_LIMBS / 8 + 1];
+    int normalise = 0;
+    AVXMPFR_STATS_ONLY(int carry_iterations = 0;)
+
+    for (int v = 0; v < V; v++)
+	sum[v] = _mm512_add_epi64(_mm512_load_si512((const void *) (a + 8 * v)), _mm512_load_si512((const void *) (b + 8 * v)));
+
+    carry[V] = _mm512_setzero_si512();
+    for (;;)
+    {
+	AVXMPFR_STATS_ONLY(carry_iterations++;)
+	__mmask8 any = 0;
+	for (int v = 0; v < V; v++)
+	{
+	    carry[v] = _mm512_srli_epi64(sum[v], 63);
+	    sum[v] = _mm512_and_si512(sum[v], mask);
+	    any |= _mm512_test_epi64_mask(carry[v], carry[v]);
+	}
+	if (any == 0)
+	    break;
+
+	normalise |= _mm_cvtsi128_si32(_mm512_castsi512_si128(carry[0]));
+
+	// valignq moves every limb down one place, pulling in the first limb of the next vector
+	for (int v = 0; v < V; v++)
+	    sum[v] = _mm512_add_epi64(sum[v], _mm512_alignr_epi64(carry[v + 1], carry[v], 1));
+    }
+    AVXMPFR_COUNT_CARRY(carry_iterations);
+
+    if (normalise)
+    {
+	__m512i previous = _mm512_set1_epi64(1);
+	for (int v = 0; v < V; v++)
+	{
+	    __m512i down = _mm512_alignr_epi64(sum[v], previous, 7);
+	    previous = sum[v];
+	    sum[v] = _mm512_or_si512(_mm512_srli_epi64(sum[v], 1), _mm512_slli_epi64(_mm512_and_si512(down, _mm512_set1_epi64(1)), 62));
+	}
+	AVXMPFR_COUNT(normalisations, 1);
+    }
+
+    for (int v = 0; v < V; v++)
+	_mm512_store_si512((void *) (s + 8 * v), sum[v]);
+    return normalise;
+}
+#endif
+
+// The whole addition for L padded limbs with the given instruction set
+FORCE_INLINE void add_generic(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const int L, const int isa)
+{
+    // Only the top 63 * L bits of an operand are packed, wider ones would lose the bits that decide the truncation
+    if (rnd != MPFR_RNDZ || !mpfr_regular_p(op1) || !mpfr_regular_p(op2) || mpfr_signbit(op1) != mpfr_signbit(op2)
+	|| mpfr_get_prec(op1) > 63 * L || mpfr_get_prec(op2) > 63 * L)
+    {
+	mpfr_add(rop, op1, op2, rnd);
+	return;
+    }
+
+    const int W = (isa == AVXMPFR_ISA_AVX512) ? 8 : 4;
+    const int V = (L + W - 1) / W;
+    uint64_t a[KERNEL_MAX_LIMBS] __attribute__((aligned(64)));
+    uint64_t b[KERNEL_MAX_LIMBS] __attribute__((aligned(64)));
+    uint64_t unshifted[KERNEL_MAX_LIMBS];
+
+    // Make op1 the operand with the bigger exponent
+    if (op2->_mpfr_exp > op1->_mpfr_exp)
+    {
+	mpfr_ptr t = op1;
+	op1 = op2;
+	op2 = t;
+    }
+    const int64_t gap = op1->_mpfr_exp - op2->_mpfr_exp;
+    AVXMPFR_COUNT_GAP(gap);
+
+#ifndef AVXMPFR_KERNELS_AVX2
+    // Up to 8 limbs the operands are packed and alligned in registers
+    if (isa == AVXMPFR_ISA_AVX512 && L <= 8)
+    {
+	_mm512_store_si512((void *) a, avxmpfr_pack_lanes8(L, op1));
+	_mm512_store_si512((void *) b, _mm512_maskz_mov_epi64((__mmask8) ((1 << L) - 1), avxmpfr_shift_padded504(avxmpfr_pack_lanes8(L, op2), gap)));
+    }
+    else
+#endif
+    {
+	avxmpfr_pack_lanes(a, 1, L, op1);
+	avxmpfr_pack_lanes(unshifted, 1, L, op2);
+	shift_limbs(b, unshifted, L, gap);
+	for (int k = L; k < V * W; k++)
+	    a[k] = b[k] = 0;
+    }
+
+    mpfr_exp_t exponent = op1->_mpfr_exp;
+#ifdef AVXMPFR_KERNELS_AVX2
+    exponent += add_limbs_avx2(a, a, b, V);
+#else
+    if (isa == AVXMPFR_ISA_AVX512)
+	exponent += add_limbs_avx512(a, a, b, V);
+    else
+	exponent += add_limbs_avx2(a, a, b, V);
+#endif
+
+    if (exponent > mpfr_get_emax())
+    {
+	mpfr_add(rop, op1, op2, rnd);
+	return;
+    }
+
+    // Keep the top limbs that rop has room for, and clear its bits below the precision
+    const mpfr_prec_t precision = mpfr_get_prec(rop);
+    const mp_size_t n = (precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+#ifndef AVXMPFR_KERNELS_AVX2
+    if (isa == AVXMPFR_ISA_AVX512 && L <= 8)
+	avxmpfr_unpack_lanes8(rop->_mpfr_d, _mm512_load_si512((const void *) a), L, n);
+    else
+#endif
+    {
+	mp_limb_t d[KERNEL_MAX_LIMBS];
+	avxmpfr_unpack_lanes(d, a, 1, L);
+	for (mp_size_t i = 0; i < n; i++)
+	    rop->_mpfr_d[i] = d[L - n + i];
+    }
+    rop->_mpfr_d[0] &= ~((((mp_limb_t) 1) << (n * GMP_NUMB_BITS - precision)) - 1);
+
+    rop->_mpfr_sign = op1->_mpfr_sign;
+    rop->_mpfr_exp = exponent;
+}
+
+
+/* Specialisations */
+
+#define FOR_EACH_LIMBS(X) \
+    X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) X(16) X(17) X(18) X(19) X(20) \
+    X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) X(32) X(33) X(34) X(35) X(36) X(37) X(38) \
+    X(39) X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) X(48) X(49) X(50) X(51) X(52) X(53) X(54) X(55) X(56) \
+    X(57) X(58) X(59) X(60) X(61) X(62) X(63) X(64)
+
+#ifdef AVXMPFR_KERNELS_AVX2
+
+#define DEFINE_KERNELS(L) \
+    static void add_##L##_avx2(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd) \
+    { \
+	add_generic(rop, op1, op2, rnd, L, AVXMPFR_ISA_AVX2); \
+    }
+
+#define KERNEL_ENTRY(L) [L] = add_##L##_avx2,
+
+FOR_EACH_LIMBS(DEFINE_KERNELS)
+
+const avxmpfr_kernel avxmpfr_kernels_avx2[AVXMPFR_KERNEL_MAX_LIMBS + 1] = {
+    FOR_EACH_LIMBS(KERNEL_ENTRY)
+};
+
+#else
+
+#define DEFINE_KERNELS(L) \
+    static void add_##L##_avx512(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd) \
+    { \
+	add_generic(rop, op1, op2, rnd, L, AVXMPFR_ISA_AVX512); \
+    }
+
+#define KERNEL_ENTRY(L) [L] = add_##L##_avx512,
+
+FOR_EACH_LIMBS(DEFINE_KERNELS)
+
+extern const avxmpfr_kernel avxmpfr_kernels_avx2[AVXMPFR_KERNEL_MAX_LIMBS + 1];	// avxmpfr_kernels_avx2.o
+static const avxmpfr_kernel kernels_avx512[AVXMPFR_KERNEL_MAX_LIMBS + 1] = {
+    FOR_EACH_LIMBS(KERNEL_ENTRY)
+};
+
+
+/* Registry */
+
+int avxmpfr_kernel_best_isa(void)
+{
+    static int isa = -1;
+    if (isa < 0)
+	isa = __builtin_cpu_supports("avx512f") ? AVXMPFR_ISA_AVX512 : AVXMPFR_ISA_AVX2;
+    return isa;
+}
+
+avxmpfr_kernel avxmpfr_kernel_lookup(mpfr_prec_t precision, int isa)
+{
+    /*
+	Return the specialisation for numbers of the given precision, or NULL if there is none
+    */
+
+    const mpfr_prec_t limbs = (precision + 62) / 63;
+    if (limbs < AVXMPFR_KERNEL_MIN_LIMBS || limbs > AVXMPFR_KERNEL_MAX_LIMBS || (isa != AVXMPFR_ISA_AVX2 && isa != AVXMPFR_ISA_AVX512))
+	return NULL;
+    return (isa == AVXMPFR_ISA_AVX512) ? kernels_avx512[limbs] : avxmpfr_kernels_avx2[limbs];
+}
+
+void avxmpfr_add_prec(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    /*
+	rop is resultant operand, its precision picks the kernel
+	op1 and op2 are the operands, not modified. Those wider than the kernel picked go through mpfr_add()
+	rnd is the rounding mode, honoured on every path: only MPFR_RNDZ is added by avxmpfr_add_128() or the kernels,
+	the other modes go through mpfr_add()
+    */
+
+    if (rnd != MPFR_RNDZ)
+    {
+	mpfr_add(rop, op1, op2, rnd);
+	return;
+    }
+
+    if (mpfr_get_prec(rop) <= PRECISION_128)
+    {
+	avxmpfr_add_128(rop, op1, op2, rnd);
+	return;
+    }
+
+    const mpfr_prec_t limbs = (mpfr_get_prec(rop) + 62) / 63;
+    if (limbs >= AVXMPFR_KERNEL_FAST_MIN_LIMBS && limbs <= AVXMPFR_KERNEL_FAST_MAX_LIMBS
+	&& avxmpfr_kernel_best_isa() == AVXMPFR_ISA_AVX512)
+	kernels_avx512[limbs](rop, op1, op2, rnd);
+    else
+	mpfr_add(rop, op1, op2, rnd);
+}
+
+#endif
@@ -0,0 +1,282 @@
+// avxmpfr_lazy.c
+
+/*
+    Lazily normalised accumulators, for sums where every result only feeds the next addition.
+
+    avx_add() resolves every carry and normalises its result straight away. An avxmpfr_lazy keeps its value in the
+    padded layout instead, and uses the headroom of every 63 bit lane: after adding (or subtracting) the lanes of an
+    operand, bit 63 of each lane moves into a carry counter of the same lane rather than into its neighbour. No carry
+    crosses a lane until the value is read, or until the counters could overflow after AVXMPFR_LAZY_MAX_OPS additions,
+    so every addition is the same few AVX512 instructions whatever the carries do.
+
+    The lanes are laid out as one headroom lane, the value and then guard lanes, 8 lanes in all up to PRECISION_256
+    and 16 up to PRECISION_512. The first operand added lands in lane 1, so the sum can grow by 63 bits before the
+    exponent has to move; an operand with a larger exponent than that resolves the carries and shifts the lanes down
+    (a normalisation). Reading the value resolves the carries on a copy and rounds it once into rop with rnd.
+
+    Operands may have any sign and at most the precision of the accumulator. Operands shifted by less than the guard
+    lanes are added exactly, so the result is the exact sum rounded once. Bits shifted out below the last lane only
+    leave a flag telling on which side of the lanes the exact sum lies. With one side flagged the result is correctly
+    rounded unless the exact sum is within n units of the last lane of a rounding boundary. With both (dropped bits
+    from additions and from subtractions) the side is unknown, the lanes are rounded as if exact and the result is
+    faithful (its ternary value is that of the lanes). NaNs and infinities follow
+    the MPFR rules, an exact zero is +0 (-0 with MPFR_RNDD).
+
+    Every addition packs its operand straight from the limbs into registers, already shifted to the lanes. The gain
+    only shows on long chains: in comparison_lazy an addition costs 1.0 to 1.3 times less than mpfr_add() from 100
+    additions on and up to 2.5 times less from 1000 on, but a chain of 10 runs at 0.5 to 0.85 times the speed of
+    mpfr_add(), reading the value back costing as much as a few additions.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <string.h>
+
+#define LAZY_BELOW 1	// Flagged in sticky: the lanes are below the exact sum in magnitude
+#define LAZY_ABOVE 2	// ... above it
+
+// Shift x (x_lanes padded lanes) right by gap bits into out (out_lanes lanes), returns 1 if set bits were dropped
+static int lazy_shift(uint64_t *out, int out_lanes, const uint64_t *x, int x_lanes, int64_t gap)
+{
+    uint64_t lost = 0;
+
+    if (gap >= 63 * (int64_t) (out_lanes + 1))
+    {
+	for (int j = 0; j < x_lanes; j++)
+	    lost |= x[j];
+	memset(out, 0, out_lanes * sizeof(uint64_t));
+	return lost != 0;
+    }
+
+    const int q = gap / 63;
+    const int r = gap % 63;
+
+    // Lane k takes the low bits of x[k - q] and the top of x[k - q - 1], a shift by 63 drops the latter
+    for (int k = 0; k < out_lanes; k++)
+    {
+	const uint64_t high = (k - q >= 0 && k - q < x_lanes) ? x[k - q] : 0;
+	const uint64_t low = (k - q - 1 >= 0 && k - q - 1 < x_lanes) ? x[k - q - 1] : 0;
+	out[k] = ((high >> r) | (low << (63 - r))) & AVXMPFR_PAD_MASK;
+    }
+
+    for (int j = 0; j < x_lanes; j++)
+    {
+	if (j + q >= out_lanes)
+	    lost |= x[j];
+	else if (j + q + 1 == out_lanes)
+	    lost |= x[j] & ((((uint64_t) 1) << r) - 1);
+    }
+    return lost != 0;
+}
+
+// Let the carries ripple through the lanes once, returns the integer above lane 0
+static uint64_t lazy_resolve(avxmpfr_lazy *acc)
+{
+    int64_t carry = 0;
+
+    for (int k = acc->lanes - 1; k >= 0; k--)
+    {
+	// The digit is below 2^63 and |carry| below 2^62, the sum is within a lane of either side
+	const uint64_t sum = acc->digits[k] + (uint64_t) carry;
+	const int64_t out = carry >= 0 ? (int64_t) (sum >> 63) : ((int64_t) sum >> 63);
+	acc->digits[k] = sum & AVXMPFR_PAD_MASK;
+	carry = acc->carries[k] + out;
+	acc->carries[k] = 0;
+    }
+    acc->ops = 0;
+
+    if (carry >= 0)
+	return carry;
+
+    // The subtractions won, take the magnitude and flip the sign, along with the side of the dropped bits
+    uint64_t one = 1;
+    for (int k = acc->lanes - 1; k >= 0; k--)
+    {
+	const uint64_t digit = (AVXMPFR_PAD_MASK - acc->digits[k]) + one;
+	one = digit >> 63;
+	acc->digits[k] = digit & AVXMPFR_PAD_MASK;
+    }
+    acc->sign = -acc->sign;
+    acc->sticky = ((acc->sticky & LAZY_BELOW) << 1) | ((acc->sticky & LAZY_ABOVE) >> 1);
+    return (uint64_t) (-(carry + 1)) + one;
+}
+
+// Resolve the carries and move lane 0 to exponent exp (or above, if the integer part needs it)
+static void lazy_rescale(avxmpfr_lazy *acc, mpfr_exp_t exp)
+{
+    const uint64_t top = lazy_resolve(acc);
+
+    if (top == 0 && exp == acc->exp)
+	return;
+
+    // The integer part on top of the lanes, at exponent acc->exp + 63
+    uint64_t wide[AVXMPFR_LAZY_LANES + 1];
+    wide[0] = top;
+    memcpy(wide + 1, acc->digits, acc->lanes * sizeof(uint64_t));
+
+    if (top == 0)
+	acc->sticky |= lazy_shift(acc->digits, acc->lanes, wide + 1, acc->lanes, exp - acc->exp) * LAZY_BELOW;
+    else
+    {
+	if (exp < acc->exp + 63)
+	    exp = acc->exp + 63;
+	acc->sticky |= lazy_shift(acc->digits, acc->lanes, wide, acc->lanes + 1, exp - acc->exp - 63) * LAZY_BELOW;
+    }
+
+    acc->exp = exp;
+    AVXMPFR_COUNT(normalisations, 1);
+}
+
+static void lazy_accumulate(avxmpfr_lazy *acc, const mpfr_t op, int negate)
+{
+    if (mpfr_zero_p(op))
+	return;
+
+    if (!mpfr_regular_p(op))
+    {
+	const int inf = (mpfr_signbit(op) ^ negate) ? -1 : 1;
+	if (mpfr_nan_p(op) || acc->special == 2 || acc->special == -inf)
+	    acc->special = 2;
+	else
+	    acc->special = inf;
+	return;
+    }
+
+    const int sign = (mpfr_signbit(op) ^ negate) ? -1 : 1;
+    if (acc->sign == 0)
+    {
+	acc->sign = sign;
+	acc->exp = op->_mpfr_exp + 63;
+    }
+    else if (op->_mpfr_exp > acc->exp)
+	lazy_rescale(acc, op->_mpfr_exp + 63);
+    else if (acc->ops == AVXMPFR_LAZY_MAX_OPS)
+	lazy_rescale(acc, acc->exp);
+
+    // The term goes straight from the limbs of op into registers, shifted to the lanes of the accumulator
+    __m512i term[AVXMPFR_LAZY_LANES / 8];
+    const int64_t gap = acc->exp - op->_mpfr_exp;
+    const mp_size_t op_limbs = (mpfr_get_prec(op) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const int lost = avxmpfr_pack_shifted(term, acc->lanes, op, op_limbs, gap);
+    AVXMPFR_COUNT_GAP(gap);
+
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    if (sign == acc->sign)
+    {
+	// Lanes below 2^63 plus a term below 2^63 cannot overflow, bit 63 is the carry
+	for (int v = 0; v < acc->lanes; v += 8)
+	{
+	    __m512i digits = _mm512_add_epi64(_mm512_load_si512(acc->digits + v), term[v / 8]);
+	    __m512i carries = _mm512_add_epi64(_mm512_load_si512(acc->carries + v), _mm512_srli_epi64(digits, 63));
+	    _mm512_store_si512(acc->digits + v, _mm512_and_si512(digits, mask));
+	    _mm512_store_si512(acc->carries + v, carries);
+	}
+    }
+    else
+    {
+	for (int v = 0; v < acc->lanes; v += 8)
+	{
+	    __m512i digits = _mm512_sub_epi64(_mm512_load_si512(acc->digits + v), term[v / 8]);
+	    __m512i carries = _mm512_add_epi64(_mm512_load_si512(acc->carries + v), _mm512_srai_epi64(digits, 63));
+	    _mm512_store_si512(acc->digits + v, _mm512_and_si512(digits, mask));
+	    _mm512_store_si512(acc->carries + v, carries);
+	}
+    }
+
+    acc->sticky |= lost * (sign == acc->sign ? LAZY_BELOW : LAZY_ABOVE);
+    acc->ops++;
+}
+
+
+/* Public interface */
+
+int avxmpfr_lazy_init(avxmpfr_lazy *acc, mpfr_prec_t precision)
+{
+    /*
+	acc is the accumulator to set to zero
+	precision is the largest precision of the operands, at most PRECISION_512
+	Returns -1 if the precision is not supported
+    */
+
+    if (precision < MPFR_PREC_MIN || precision > PRECISION_512)
+	return -1;
+
+    memset(acc, 0, sizeof(avxmpfr_lazy));
+    acc->precision = precision;
+    acc->lanes = precision <= PRECISION_256 ? 8 : 16;
+    return 0;
+}
+
+void avxmpfr_lazy_set(avxmpfr_lazy *acc, const mpfr_t op)
+{
+    avxmpfr_lazy_init(acc, acc->precision);
+    lazy_accumulate(acc, op, 0);
+}
+
+void avxmpfr_lazy_add(avxmpfr_lazy *acc, const mpfr_t op)
+{
+    lazy_accumulate(acc, op, 0);
+}
+
+void avxmpfr_lazy_sub(avxmpfr_lazy *acc, const mpfr_t op)
+{
+    lazy_accumulate(acc, op, 1);
+}
+
+void avxmpfr_lazy_normalise(avxmpfr_lazy *acc)
+{
+    /*
+	Resolve every carry now, the value is unchanged
+    */
+
+    if (acc->sign != 0)
+	lazy_rescale(acc, acc->exp);
+}
+
+int avxmpfr_lazy_get(mpfr_t rop, const avxmpfr_lazy *acc, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the resultant operand, rounded once from the exact lanes with rnd
+	acc is the accumulator, left as it is
+	Returns the ternary value of the rounding
+    */
+
+    if (acc->special == 2)
+    {
+	mpfr_set_nan(rop);
+	return 0;
+    }
+    if (acc->special != 0)
+    {
+	mpfr_set_inf(rop, acc->special);
+	return 0;
+    }
+
+    avxmpfr_lazy copy = *acc;
+    mp_limb_t d[AVXMPFR_LAZY_LANES + 1];
+    d[copy.lanes] = copy.sign != 0 ? lazy_resolve(&copy) : 0;
+    avxmpfr_unpack_lanes(d, copy.digits, 1, copy.lanes);
+
+    int zero = 1;
+    for (int k = 0; k <= copy.lanes; k++)
+	zero &= d[k] == 0;
+    if (zero && copy.sticky == 0)
+    {
+	mpfr_set_zero(rop, rnd == MPFR_RNDD ? -1 : 1);
+	return 0;
+    }
+
+    // The lanes hold the value times 2^(63 lanes - exp), d holds it times 2^(64 lanes - exp): the low bits of d are
+    // clear and stand in for the dropped bits. With bits dropped on both sides the lanes are rounded as they are,
+    // nudging them either way could take the result past a neighbour of the exact sum
+    if (copy.sticky == LAZY_ABOVE && zero)
+    {
+	copy.sign = -copy.sign;
+	d[0] = 1;
+    }
+    else if (copy.sticky == LAZY_ABOVE)
+	mpn_sub_1(d, d, copy.lanes + 1, 1);
+    else if (copy.sticky == LAZY_BELOW)
+	d[0] |= 1;
+
+    return avxmpfr_round_limbs(rop, copy.sign, d, copy.lanes + 1, copy.exp - 64 * copy.lanes, rnd);
+}
@@ -0,0 +1,75 @@
+// avxmpfr_mixed.c
+
+/*
+    Correctly rounded addition and subtraction of operands of differing precisions, avxmpfr_add_mixed() and
+    avxmpfr_sub_mixed(), for code that accumulates PRECISION_256 values into PRECISION_512 results or mixes the two
+    and would otherwise widen every operand with mpfr_set() before calling avxmpfr_add_512().
+
+    rop, op1 and op2 may each have any precision up to PRECISION_512. Both operands are loaded as they are into the
+    top limbs of a window of 8 limbs (see avxmpfr_windows.h), a shorter operand leaving zeros under it, so nothing has
+    to be widened. The smaller operand is shifted down by the exponent gap within the register, whatever falls off the
+    window only counting as a sticky bit, the two are added with a carry lookahead over the lanes, normalised and
+    rounded once to mpfr_get_prec(rop) with rnd. The 8 bits the window holds past the widest precision are enough for
+    that to give the value, the sign of zero and the ternary value of mpfr_add() / mpfr_sub().
+
+    The windows are only taken when rop is wider than an operand and no narrower than the other, the accumulation
+    they are for, where they measured 1.04x - 1.17x against mpfr_add(). Three equal precisions (0.74x at 252 bits,
+    mpfr_add() has a path of its own for them) and a rop narrower than an operand (0.84x - 0.94x) go to mpfr_add() /
+    mpfr_sub() as they are, and so do NaNs, infinities, zeros, precisions above PRECISION_512 and sums that could
+    leave the exponent range. Callers that only ever mix those should call mpfr_add() directly. rop may be op1 or
+    op2, the operands are not modified.
+*/
+
+#include "avxmpfr_windows.h"
+
+static int mixed_aors(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, int negate)
+{
+    const mpfr_prec_t precision = mpfr_get_prec(rop);
+    if ((mpfr_get_prec(op1) == precision && mpfr_get_prec(op2) == precision)
+	|| mpfr_get_prec(op1) > precision || mpfr_get_prec(op2) > precision || precision > PRECISION_512
+	|| !mpfr_regular_p(op1) || !mpfr_regular_p(op2)
+	|| !exponents_fit(op1->_mpfr_exp > op2->_mpfr_exp ? op1->_mpfr_exp : op2->_mpfr_exp,
+			  op1->_mpfr_exp < op2->_mpfr_exp ? op1->_mpfr_exp : op2->_mpfr_exp, 8))
+	return negate ? mpfr_sub(rop, op1, op2, rnd) : mpfr_add(rop, op1, op2, rnd);
+
+    const int sign2 = negate ? -op2->_mpfr_sign : op2->_mpfr_sign;
+    AVXMPFR_COUNT_GAP(op1->_mpfr_exp > op2->_mpfr_exp ? op1->_mpfr_exp - op2->_mpfr_exp
+						       : op2->_mpfr_exp - op1->_mpfr_exp);
+
+    // Everything is read before rop is written
+    windows w;
+    __m512i a, b;
+    int ternary;
+    windows_prepare(8, &w, &a, &b, window_load(op1), &op1->_mpfr_exp, &op1->_mpfr_sign, window_load(op2),
+		    &op2->_mpfr_exp, &sign2);
+    const __m512i x = windows_round(8, &w, windows_aors(8, &w, a, b), precision, &rnd, &ternary);
+    window_store(rop, x, &w, rnd);
+
+    if (ternary != 0)
+	mpfr_set_inexflag();
+    return ternary;
+}
+
+int avxmpfr_add_mixed(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the resultant operand, rounded to its own precision
+	op1 and op2 are the operands, each of its own precision and not modified
+	rnd is the rounding mode, MPFR_RNDN, Z, U, D or A
+	Returns the ternary value of mpfr_add()
+    */
+
+    return mixed_aors(rop, op1, op2, rnd, 0);
+}
+
+int avxmpfr_sub_mixed(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the resultant operand op1 - op2, rounded to its own precision
+	op1 and op2 are the operands, each of its own precision and not modified
+	rnd is the rounding mode, MPFR_RNDN, Z, U, D or A
+	Returns the ternary value of mpfr_sub()
+    */
+
+    return mixed_aors(rop, op1, op2, rnd, 1);
+}
@@ -0,0 +1,179 @@
+// avxmpfr_multi.c
+
+/*
+    Addition of up to AVXMPFR_MULTI_MAX independent pairs at once, avxmpfr_add_multi(), for callers holding a few
+    additions at a time.
+
+    Each avxmpfr_add() runs a chain of dependent steps (add, extract the carries, test them, move them a lane up, add
+    again) to completion before the next call starts, and the core spends most of it waiting on the latency of the
+    previous step. Here the pairs go through the steps together: the lanes of every pair are packed into AVX512
+    registers, two PRECISION_256 values per register (one in each 256 bit half) or one PRECISION_512 value per
+    register, and every step of the carry loop is issued for all the registers before the next step. The carries of
+    all of them are tested with one mask, so the loop runs as many times as the slowest pair needs and never branches
+    per pair. The allignment and normalisation are per lane masks and blends, the same for every pair:
+	a value's lanes are numbered from 0 (most significant) within its group of L lanes
+	the smaller operand is shifted by permuting lane k - q into lane k, masked where that leaves the group, then
+	shifting bits by the rest of the gap with per lane shift counts
+	a carry moves to lane k - 1 of the same group, a carry out of lane 0 marks the value for normalisation
+	marked values are blended with their sum shifted right by one across the group
+
+    The additions follow avxmpfr_add(): the smaller operand is truncated when alligned and the sum when normalised,
+    pairs with different signs, zeros, NaNs, infinities or a sum beyond the exponent range go through mpfr_add() with
+    rnd. The operands are not modified, rop[i] may be op1[i] or op2[i].
+*/
+
+#include "avxmpfr_utilities.h"
+
+#define MULTI_REGISTERS AVXMPFR_MULTI_MAX	// Registers for AVXMPFR_MULTI_MAX values of PRECISION_512
+
+#define FORCE_INLINE static inline __attribute__((always_inline))
+
+// y shifted right by the gap q * 63 + r of each group, position the lane number within the group
+FORCE_INLINE __m512i multi_shift(__m512i y, __m512i lane, __m512i position, __m512i q, __m512i r)
+{
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i whole = _mm512_maskz_permutexvar_epi64(_mm512_cmpge_epi64_mask(position, q), _mm512_sub_epi64(lane, q), y);
+    const __m512i q1 = _mm512_add_epi64(q, one);
+    const __m512i next = _mm512_maskz_permutexvar_epi64(_mm512_cmpge_epi64_mask(position, q1), _mm512_sub_epi64(lane, q1), y);
+    const __m512i bits = _mm512_or_si512(_mm512_srlv_epi64(whole, r), _mm512_sllv_epi64(next, _mm512_sub_epi64(_mm512_set1_epi64(63), r)));
+    return _mm512_and_si512(bits, _mm512_set1_epi64(AVXMPFR_PAD_MASK));
+}
+
+// The pairs of op1 / op2 in groups of L lanes, R registers of 8 / L groups each. Values beyond count and the ones
+// left to mpfr_add() add zeros
+FORCE_INLINE void add_multi(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, int count, mpfr_rnd_t rnd, const int L, const int R)
+{
+    const int G = 8 / L;
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i position = _mm512_and_si512(lane, _mm512_set1_epi64(L - 1));
+    const __mmask8 top = (L == 4) ? 0x11 : 0x01;		// Lane 0 of each group
+    const __mmask8 moves = (L == 4) ? 0x77 : 0x7F;		// Lanes taking a carry from the one below
+
+    uint64_t x[MULTI_REGISTERS * 8] __attribute__((aligned(64))) = {0};
+    uint64_t y[MULTI_REGISTERS * 8] __attribute__((aligned(64))) = {0};
+    int64_t q[MULTI_REGISTERS * 8] __attribute__((aligned(64)));
+    int64_t r[MULTI_REGISTERS * 8] __attribute__((aligned(64)));
+    mpfr_ptr big[AVXMPFR_MULTI_MAX];
+    int fallback[AVXMPFR_MULTI_MAX];
+
+    // Pack every pair, the bigger exponent in x
+    for (int j = 0; j < R * G; j++)
+    {
+	int64_t gap = 0;
+	fallback[j] = j >= count || !mpfr_regular_p(op1[j]) || !mpfr_regular_p(op2[j]) || mpfr_signbit(op1[j]) != mpfr_signbit(op2[j]);
+	if (!fallback[j])
+	{
+	    const int swap = op2[j]->_mpfr_exp > op1[j]->_mpfr_exp;
+	    big[j] = swap ? op2[j] : op1[j];
+	    mpfr_ptr small = swap ? op1[j] : op2[j];
+	    gap = big[j]->_mpfr_exp - small->_mpfr_exp;
+	    AVXMPFR_COUNT_GAP(gap);
+	    avxmpfr_pack_lanes(x + L * j, 1, L, big[j]);
+	    avxmpfr_pack_lanes(y + L * j, 1, L, small);
+	}
+	if (gap > 63 * L)
+	    gap = 63 * L;
+	for (int k = 0; k < L; k++)
+	{
+	    q[L * j + k] = gap / 63;
+	    r[L * j + k] = gap % 63;
+	}
+    }
+
+    // Allign and add every register
+    __m512i sum[MULTI_REGISTERS];
+    for (int v = 0; v < R; v++)
+    {
+	const __m512i shifted = multi_shift(_mm512_load_si512((const void *) (y + 8 * v)), lane, position,
+					    _mm512_load_si512((const void *) (q + 8 * v)), _mm512_load_si512((const void *) (r + 8 * v)));
+	sum[v] = _mm512_add_epi64(_mm512_load_si512((const void *) (x + 8 * v)), shifted);
+    }
+
+    // The carry loop of all the registers at once, until none of them carries
+    __mmask8 normalise[MULTI_REGISTERS] = {0};
+    AVXMPFR_STATS_ONLY(int carry_iterations = 0;)
+    for (;;)
+    {
+	AVXMPFR_STATS_ONLY(carry_iterations++;)
+	__m512i carry[MULTI_REGISTERS];
+	__mmask8 any = 0;
+	for (int v = 0; v < R; v++)
+	{
+	    carry[v] = _mm512_srli_epi64(sum[v], 63);
+	    sum[v] = _mm512_and_si512(sum[v], mask);
+	    const __mmask8 carried = _mm512_test_epi64_mask(carry[v], carry[v]);
+	    normalise[v] |= carried & top;
+	    any |= carried;
+	}
+	if (any == 0)
+	    break;
+	for (int v = 0; v < R; v++)
+	    sum[v] = _mm512_add_epi64(sum[v], _mm512_maskz_permutexvar_epi64(moves, _mm512_add_epi64(lane, _mm512_set1_epi64(1)), carry[v]));
+    }
+    AVXMPFR_COUNT_CARRY(carry_iterations);
+
+    // Shift the marked groups right by one, lane 0 taking the carry
+    for (int v = 0; v < R; v++)
+    {
+	if (normalise[v] == 0)
+	    continue;
+	const __m512i down = _mm512_maskz_permutexvar_epi64(~top, _mm512_sub_epi64(lane, _mm512_set1_epi64(1)), sum[v]);
+	__m512i shifted = _mm512_or_si512(_mm512_srli_epi64(sum[v], 1), _mm512_slli_epi64(_mm512_and_si512(down, _mm512_set1_epi64(1)), 62));
+	shifted = _mm512_mask_or_epi64(shifted, top, shifted, _mm512_set1_epi64(((uint64_t) 1) << 62));
+	const __mmask8 groups = (L == 4) ? (__mmask8) (((normalise[v] & 0x01) ? 0x0F : 0) | ((normalise[v] & 0x10) ? 0xF0 : 0)) : 0xFF;
+	sum[v] = _mm512_mask_blend_epi64(groups, sum[v], shifted);
+	AVXMPFR_COUNT(normalisations, __builtin_popcount(normalise[v]));
+    }
+
+    // Unpack into rop
+    for (int v = 0; v < R; v++)
+	_mm512_store_si512((void *) (x + 8 * v), sum[v]);
+    const mpfr_exp_t emax = mpfr_get_emax();
+    for (int j = 0; j < count; j++)
+    {
+	const int carried = (normalise[j / G] >> (L * (j % G))) & 1;
+	if (fallback[j] || big[j]->_mpfr_exp + carried > emax)
+	{
+	    mpfr_add(rop[j], op1[j], op2[j], rnd);
+	    continue;
+	}
+	rop[j]->_mpfr_sign = big[j]->_mpfr_sign;
+	rop[j]->_mpfr_exp = big[j]->_mpfr_exp + carried;
+	avxmpfr_unpack_lanes(rop[j]->_mpfr_d, x + L * j, 1, L);
+    }
+}
+
+int avxmpfr_add_multi(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, int count, mpfr_rnd_t rnd, const uint16_t PRECISION)
+{
+    /*
+	rop is the array of count resultant operands
+	op1 and op2 are the arrays of count operands, not modified
+	count is the number of pairs, 1 to AVXMPFR_MULTI_MAX
+	rnd is the rounding mode, only used for the pairs handed to mpfr_add()
+	PRECISION is the precision of every rop[i], op1[i] and op2[i] (Either PRECISION_256 / PRECISION_512)
+
+	Returns 0, or -1 without touching rop if count or PRECISION is invalid
+    */
+
+    if (count < 1 || count > AVXMPFR_MULTI_MAX || (PRECISION != PRECISION_256 && PRECISION != PRECISION_512))
+	return -1;
+
+    // Constant group and register counts, so each case keeps its registers and unrolls its loops
+    if (PRECISION == PRECISION_256)
+    {
+	if (count <= 2)
+	    add_multi(rop, op1, op2, count, rnd, 4, 1);
+	else
+	    add_multi(rop, op1, op2, count, rnd, 4, 2);
+    }
+    else
+	switch (count)
+	{
+	    case 1: add_multi(rop, op1, op2, count, rnd, 8, 1); break;
+	    case 2: add_multi(rop, op1, op2, count, rnd, 8, 2); break;
+	    case 3: add_multi(rop, op1, op2, count, rnd, 8, 3); break;
+	    default: add_multi(rop, op1, op2, count, rnd, 8, 4); break;
+	}
+    return 0;
+}
@@ -0,0 +1,377 @@
+// avxmpfr_queue.c
+
+/*
+    Asynchronous submission of single additions, coalesced into batches for avxmpfr_add_array().
+
+    Threads that only ever have a handful of additions at hand never fill a batch of their own. Instead they fill in an
+    avxmpfr_request, push it onto a queue and carry on, checking or waiting on the request later. Worker threads drain
+    the queue, group the requests by precision and run every group through a packed array (see avxmpfr_array.c).
+
+    Each worker owns a bounded ring of request pointers with a single consumer and any number of producers (Vyukov's
+    bounded queue: every slot carries a sequence number, producers claim a slot with one compare and swap on the
+    tail). A submitting thread always uses the same ring, picked round robin the first time it submits.
+
+    A worker flushes its pending batch once it holds flush_size requests, or once the oldest pending request has been
+    waiting flush_deadline_ns. A deadline of 0 flushes whatever has been drained as soon as the ring runs empty.
+
+    Every result is mpfr_add() / mpfr_sub() with the rnd of its request. The packed arrays truncate, which is
+    MPFR_RNDZ, so only MPFR_RNDZ requests are batched. Requests in any other rounding mode, and those the packed
+    arrays cannot hold (precisions other than PRECISION_256 / PRECISION_512, rop of a different precision, NaNs and
+    infinities), are computed with mpfr_add() / mpfr_sub() by the worker one at a time.
+    The operands of a request must stay alive and unmodified until it is done.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE_CACHE_LINE 64
+#define QUEUE_IDLE_SPINS 64		// Empty polls before a worker starts sleeping
+#define QUEUE_IDLE_SLEEP_NS 20000	// Sleep of an idle worker
+
+typedef struct
+{
+    _Atomic uint64_t sequence;
+    avxmpfr_request *request;
+} queue_slot;
+
+typedef struct
+{
+    struct avxmpfr_queue *queue;
+    pthread_t thread;
+
+    // Ring, the tail is shared by every producer so it sits on a line of its own
+    queue_slot *slots;
+    uint64_t mask;
+    _Alignas(QUEUE_CACHE_LINE) _Atomic uint64_t tail;
+    _Alignas(QUEUE_CACHE_LINE) uint64_t head;
+
+    // Batch being collected, and the packed arrays for each precision
+    avxmpfr_request **batch;
+    avxmpfr_request **group[2];
+    avxmpfr_array op1[2];
+    avxmpfr_array op2[2];
+} queue_worker;
+
+struct avxmpfr_queue
+{
+    avxmpfr_queue_config config;
+    queue_worker *workers;
+    _Atomic int stop;
+    _Atomic unsigned next_ring;
+};
+
+static __thread int thread_ring = -1;	// Ring of the calling thread, modulo the number of workers
+
+
+/* Ring */
+
+static int ring_push(queue_worker *worker, avxmpfr_request *request)
+{
+    uint64_t pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+
+    for (;;)
+    {
+	queue_slot *slot = &worker->slots[pos & worker->mask];
+	uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+	int64_t diff = (int64_t) (sequence - pos);
+
+	if (diff == 0)
+	{
+	    if (atomic_compare_exchange_weak_explicit(&worker->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+	    {
+		slot->request = request;
+		atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+		return 0;
+	    }
+	}
+	else if (diff < 0)
+	    return -1;		// Full
+	else
+	    pos = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+    }
+}
+
+static avxmpfr_request *ring_pop(queue_worker *worker)
+{
+    queue_slot *slot = &worker->slots[worker->head & worker->mask];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != worker->head + 1)
+	return NULL;
+
+    avxmpfr_request *request = slot->request;
+    atomic_store_explicit(&slot->sequence, worker->head + worker->mask + 1, memory_order_release);
+    worker->head++;
+    return request;
+}
+
+
+/* Batches */
+
+static void complete(avxmpfr_request *request)
+{
+    atomic_store_explicit(&request->done, 1, memory_order_release);
+}
+
+// Return the packed array group of a request, or -1 if it has to go through mpfr
+static int request_group(const avxmpfr_request *request)
+{
+    const mpfr_prec_t precision = mpfr_get_prec(request->rop);
+    if (request->rnd != MPFR_RNDZ || (precision != PRECISION_256 && precision != PRECISION_512)
+	|| mpfr_get_prec(request->op1) != precision || mpfr_get_prec(request->op2) != precision
+	|| mpfr_nan_p(request->op1) || mpfr_inf_p(request->op1)
+	|| mpfr_nan_p(request->op2) || mpfr_inf_p(request->op2))
+	return -1;
+    return precision == PRECISION_512;
+}
+
+static void run_batch(queue_worker *worker, size_t count)
+{
+    size_t group_count[2] = {0, 0};
+
+    // Pack every request into the arrays of its group
+    for (size_t i = 0; i < count; i++)
+    {
+	avxmpfr_request *request = worker->batch[i];
+	int g = request_group(request);
+
+	if (g < 0)
+	{
+	    if (request->negate)
+		mpfr_sub(request->rop, request->op1, request->op2, request->rnd);
+	    else
+		mpfr_add(request->rop, request->op1, request->op2, request->rnd);
+	    complete(request);
+	    continue;
+	}
+
+	size_t j = group_count[g]++;
+	worker->group[g][j] = request;
+	avxmpfr_array_set(&worker->op1[g], j, request->op1);
+	avxmpfr_array_set(&worker->op2[g], j, request->op2);
+	if (request->negate)
+	    avxmpfr_block_sign(&worker->op2[g], j / AVXMPFR_BLOCK)[j % AVXMPFR_BLOCK] *= -1;
+    }
+
+    for (int g = 0; g < 2; g++)
+    {
+	if (group_count[g] == 0)
+	    continue;
+
+	avxmpfr_array *sums = &worker->op1[g];
+	sums->count = group_count[g];
+	worker->op2[g].count = group_count[g];
+	avxmpfr_add_array(sums, sums, &worker->op2[g]);
+
+	for (size_t j = 0; j < group_count[g]; j++)
+	{
+	    avxmpfr_request *request = worker->group[g][j];
+	    avxmpfr_array_get(request->rop, sums, j, request->rnd);
+	    complete(request);
+	}
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    queue_worker *worker = arg;
+    const avxmpfr_queue_config *config = &worker->queue->config;
+    size_t count = 0;
+    uint64_t oldest = 0;
+    int idle = 0;
+
+    for (;;)
+    {
+	avxmpfr_request *request;
+	while (count < config->flush_size && (request = ring_pop(worker)) != NULL)
+	{
+	    if (count == 0)
+		oldest = avxmpfr_now_ns();
+	    worker->batch[count++] = request;
+	}
+
+	if (count > 0 && (count == config->flush_size || avxmpfr_now_ns() - oldest >= config->flush_deadline_ns))
+	{
+	    run_batch(worker, count);
+	    count = 0;
+	    idle = 0;
+	    continue;
+	}
+
+	// The ring was found empty and nothing is left pending. A request pushed between that pop and the stop flag
+	// is only seen by popping again after the flag
+	if (count == 0 && atomic_load_explicit(&worker->queue->stop, memory_order_acquire))
+	{
+	    if ((request = ring_pop(worker)) == NULL)
+		break;
+	    oldest = avxmpfr_now_ns();
+	    worker->batch[count++] = request;
+	    continue;
+	}
+
+	if (count > 0 || idle++ < QUEUE_IDLE_SPINS)
+	    sched_yield();
+	else
+	{
+	    struct timespec pause = {0, QUEUE_IDLE_SLEEP_NS};
+	    nanosleep(&pause, NULL);
+	}
+    }
+
+    return NULL;
+}
+
+
+/* Public interface */
+
+void avxmpfr_queue_config_init(avxmpfr_queue_config *config)
+{
+    config->workers = 1;
+    config->ring_size = 4096;
+    config->flush_size = 64;
+    config->flush_deadline_ns = 20000;
+}
+
+// Stop and join the first started workers, then free everything the queue holds. Unallocated pointers are NULL
+static void queue_free(avxmpfr_queue *queue, int started)
+{
+    atomic_store_explicit(&queue->stop, 1, memory_order_release);
+
+    if (queue->workers != NULL)
+    {
+	for (int w = 0; w < queue->config.workers; w++)
+	{
+	    queue_worker *worker = &queue->workers[w];
+	    if (w < started)
+		pthread_join(worker->thread, NULL);
+
+	    for (int g = 0; g < 2; g++)
+	    {
+		avxmpfr_array_clear(&worker->op1[g]);
+		avxmpfr_array_clear(&worker->op2[g]);
+		free(worker->group[g]);
+	    }
+	    free(worker->batch);
+	    free(worker->slots);
+	}
+    }
+
+    free(queue->workers);
+    free(queue);
+}
+
+avxmpfr_queue *avxmpfr_queue_create(const avxmpfr_queue_config *config)
+{
+    /*
+	Start config->workers workers. config->ring_size is rounded up to a power of two.
+	Returns NULL if the configuration is invalid or an allocation or thread fails, with nothing left running.
+    */
+
+    // Sizes whose rounding or allocation would overflow are as invalid as empty ones
+    if (config->workers < 1 || config->flush_size < 1 || config->flush_size > SIZE_MAX / 128
+	|| config->ring_size > SIZE_MAX / 2 / sizeof(queue_slot))
+	return NULL;
+
+    avxmpfr_queue *queue = calloc(1, sizeof(avxmpfr_queue));
+    if (queue == NULL)
+	return NULL;
+    queue->config = *config;
+
+    uint64_t ring_size = 2;
+    while (ring_size < config->ring_size)
+	ring_size <<= 1;
+
+    // Zeroed, so that queue_free() can tell what was allocated
+    queue->workers = aligned_alloc(QUEUE_CACHE_LINE, config->workers * sizeof(queue_worker));
+    if (queue->workers == NULL)
+    {
+	free(queue);
+	return NULL;
+    }
+    memset(queue->workers, 0, config->workers * sizeof(queue_worker));
+
+    for (int w = 0; w < config->workers; w++)
+    {
+	queue_worker *worker = &queue->workers[w];
+	worker->queue = queue;
+	worker->slots = malloc(ring_size * sizeof(queue_slot));
+	worker->batch = malloc(config->flush_size * sizeof(avxmpfr_request *));
+	int failed = worker->slots == NULL || worker->batch == NULL;
+	for (int g = 0; g < 2; g++)
+	{
+	    const uint16_t precision = g ? PRECISION_512 : PRECISION_256;
+	    worker->group[g] = malloc(config->flush_size * sizeof(avxmpfr_request *));
+	    failed |= worker->group[g] == NULL;
+	    failed |= avxmpfr_array_init(&worker->op1[g], precision, AVXMPFR_LAYOUT_NATIVE, config->flush_size) < 0;
+	    failed |= avxmpfr_array_init(&worker->op2[g], precision, AVXMPFR_LAYOUT_NATIVE, config->flush_size) < 0;
+	}
+	if (failed)
+	{
+	    queue_free(queue, w);
+	    return NULL;
+	}
+
+	worker->mask = ring_size - 1;
+	atomic_init(&worker->tail, 0);
+	worker->head = 0;
+	for (uint64_t i = 0; i < ring_size; i++)
+	    atomic_init(&worker->slots[i].sequence, i);
+
+	if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+	{
+	    queue_free(queue, w);
+	    return NULL;
+	}
+    }
+
+    return queue;
+}
+
+void avxmpfr_queue_destroy(avxmpfr_queue *queue)
+{
+    /*
+	Finish every request submitted so far, then stop the workers and free the queue
+    */
+
+    queue_free(queue, queue->config.workers);
+}
+
+static void submit(avxmpfr_queue *queue, avxmpfr_request *request, mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, int negate)
+{
+    request->rop = rop;
+    request->op1 = op1;
+    request->op2 = op2;
+    request->rnd = rnd;
+    request->negate = negate;
+    atomic_store_explicit(&request->done, 0, memory_order_relaxed);
+
+    if (thread_ring < 0)
+	thread_ring = atomic_fetch_add_explicit(&queue->next_ring, 1, memory_order_relaxed) & 0x7FFFFFFF;
+
+    // A full ring pushes back on the producer
+    while (ring_push(&queue->workers[thread_ring % queue->config.workers], request) < 0)
+	sched_yield();
+}
+
+void avxmpfr_add_async(avxmpfr_queue *queue, avxmpfr_request *request, mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    submit(queue, request, rop, op1, op2, rnd, 0);
+}
+
+void avxmpfr_sub_async(avxmpfr_queue *queue, avxmpfr_request *request, mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd)
+{
+    submit(queue, request, rop, op1, op2, rnd, 1);
+}
+
+int avxmpfr_request_done(avxmpfr_request *request)
+{
+    return atomic_load_explicit(&request->done, memory_order_acquire);
+}
+
+void avxmpfr_request_wait(avxmpfr_request *request)
+{
+    while (!avxmpfr_request_done(request))
+	sched_yield();
+}
@@ -0,0 +1,208 @@
+// avxmpfr_random.c
+
+/*
+    Bulk random numbers: avxmpfr_urandom_vec() fills arrays of mpfr_t straight in limb form, for benchmarks and Monte
+    Carlo code that would otherwise build operands bit by bit through strings or call mpfr_urandomb() per value.
+
+    The bits come from Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011), a
+    counter based generator: block g of a stream is the 128 bit encryption of the counter (g, stream) under the key
+    seed, ten rounds of two 32 x 32 bit multiplies and some xors. Nothing carries from one block to the next, so the
+    AVX512 path runs sixteen counters at a time (two vectors of eight, one counter per 64 bit lane, interleaved so the
+    multiplies of one hide the latency of the other) and any block can be drawn on its own.
+
+    Each value takes the next limbs + 1 words of 64 bits of its stream, rounded up to whole blocks, word 2 k and 2 k + 1
+    being the low and high halves of block k. Words 0 .. limbs - 1 are the limbs, least significant first, and the last
+    word draws the sign and exponent. The values are therefore fixed by the seed, the stream and their position in it:
+    splitting a call in two gives the same numbers, and threads given the same seed and different streams draw
+    independent sequences without sharing any state.
+
+    AVXMPFR_RANDOM_UNIFORM gives what mpfr_urandomb() gives, k / 2^prec for k uniform in [0, 2^prec), normalised.
+    AVXMPFR_RANDOM_EXPONENTS gives a uniformly random significand with its top bit set, a random sign and an exponent
+    uniform in [low, high), so that the exponent gap between any two values is under high - low; the operands of the
+    addition benchmarks, with a gap of exactly g when one array is drawn in [e, e + 1) and the other in [e + g,
+    e + g + 1).
+*/
+
+#include "avxmpfr_utilities.h"
+#include <string.h>
+
+#define PHILOX_M0 0xD2511F53
+#define PHILOX_M1 0xCD9E8D57
+#define PHILOX_W0 0x9E3779B9	// Key schedule, the golden ratio
+#define PHILOX_W1 0xBB67AE85	// ... and sqrt(3) - 1
+#define PHILOX_ROUNDS 10
+#define RANDOM_CHUNK 256	// Blocks drawn at a time, 4 KiB
+
+// Draw on the blocks [first, last) of a stream into words as they are laid out for the values
+typedef struct
+{
+    uint64_t words[2 * RANDOM_CHUNK] __attribute__((aligned(64)));
+    uint64_t first;		// Block in words[0]
+    uint64_t last;		// One past the last block drawn
+    uint64_t next;		// Next block to hand out
+} random_buffer;
+
+// Ten rounds over the counters of the eight lanes of c[0] and of c[1], one 32 bit word in the low half of each 64 bit
+// lane
+static inline void philox_rounds(__m512i c[2][4], uint64_t seed)
+{
+    const __m512i m0 = _mm512_set1_epi64(PHILOX_M0), m1 = _mm512_set1_epi64(PHILOX_M1);
+    const __m512i low = _mm512_set1_epi64(0xFFFFFFFF);
+    uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+
+    for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+	const __m512i key0 = _mm512_set1_epi64(k0), key1 = _mm512_set1_epi64(k1);
+	for (int v = 0; v < 2; v++)
+	{
+	    const __m512i p0 = _mm512_mul_epu32(c[v][0], m0), p1 = _mm512_mul_epu32(c[v][2], m1);
+	    c[v][0] = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c[v][1]), key0);
+	    c[v][1] = _mm512_and_si512(p1, low);
+	    c[v][2] = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c[v][3]), key1);
+	    c[v][3] = _mm512_and_si512(p0, low);
+	}
+	k0 += PHILOX_W0;
+	k1 += PHILOX_W1;
+    }
+}
+
+// Blocks first .. first + 15 of the stream into words[0 .. 31]
+static inline void philox_16(uint64_t *words, uint64_t first, uint64_t stream, uint64_t seed)
+{
+    const __m512i low = _mm512_set1_epi64(0xFFFFFFFF);
+    const __m512i lanes = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i even = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0), odd = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+    __m512i c[2][4];
+
+    for (int v = 0; v < 2; v++)
+    {
+	const __m512i g = _mm512_add_epi64(_mm512_set1_epi64(first + 8 * v), lanes);
+	c[v][0] = _mm512_and_si512(g, low);
+	c[v][1] = _mm512_srli_epi64(g, 32);
+	c[v][2] = _mm512_set1_epi64(stream & 0xFFFFFFFF);
+	c[v][3] = _mm512_set1_epi64(stream >> 32);
+    }
+    philox_rounds(c, seed);
+
+    // Words 2 k and 2 k + 1 of block k, lane k of the two halves
+    for (int v = 0; v < 2; v++)
+    {
+	const __m512i w0 = _mm512_or_si512(c[v][0], _mm512_slli_epi64(c[v][1], 32));
+	const __m512i w1 = _mm512_or_si512(c[v][2], _mm512_slli_epi64(c[v][3], 32));
+	_mm512_store_si512(words + 16 * v, _mm512_permutex2var_epi64(w0, even, w1));
+	_mm512_store_si512(words + 16 * v + 8, _mm512_permutex2var_epi64(w0, odd, w1));
+    }
+}
+
+// The next count words of the stream into d, in whole blocks (count even)
+static void random_take(random_buffer *buffer, const avxmpfr_random *state, uint64_t *d, uint64_t count)
+{
+    while (count > 0)
+    {
+	if (buffer->next == buffer->last)
+	{
+	    buffer->first = buffer->last = buffer->next;
+	    for (int k = 0; k < RANDOM_CHUNK; k += 16)
+		philox_16(buffer->words + 2 * k, buffer->first + k, state->stream, state->seed);
+	    buffer->last += RANDOM_CHUNK;
+	}
+
+	uint64_t take = 2 * (buffer->last - buffer->next);
+	if (take > count)
+	    take = count;
+	memcpy(d, buffer->words + 2 * (buffer->next - buffer->first), take * sizeof(uint64_t));
+	buffer->next += take / 2;
+	d += take;
+	count -= take;
+    }
+}
+
+void avxmpfr_random_init(avxmpfr_random *state, uint64_t seed, uint64_t stream)
+{
+    state->seed = seed;
+    state->stream = stream;
+    state->counter = 0;
+}
+
+int avxmpfr_urandom_vec(mpfr_t *rop, size_t n, avxmpfr_random *state, int distribution, mpfr_exp_t low, mpfr_exp_t high)
+{
+    /*
+	rop is an array of n initialised numbers of any precisions, each one set to a random value
+	state is the seed, stream and position to draw from, advanced past the blocks used
+	distribution is AVXMPFR_RANDOM_UNIFORM or AVXMPFR_RANDOM_EXPONENTS
+	low and high bound the exponents of AVXMPFR_RANDOM_EXPONENTS, with 0 < high - low <= 2^32 and [low, high)
+	inside the exponent range, they are ignored for AVXMPFR_RANDOM_UNIFORM
+
+	Returns 0, or -1 without touching rop or state if the distribution or the exponents are invalid
+    */
+
+    if (distribution != AVXMPFR_RANDOM_UNIFORM && distribution != AVXMPFR_RANDOM_EXPONENTS)
+	return -1;
+    if (distribution == AVXMPFR_RANDOM_EXPONENTS
+	&& (high <= low || (uint64_t) (high - low) > ((uint64_t) 1 << 32) || low < mpfr_get_emin() || high - 1 > mpfr_get_emax()))
+	return -1;
+
+    random_buffer buffer;
+    buffer.first = buffer.last = buffer.next = state->counter;
+    uint64_t spill[2];
+
+    for (size_t i = 0; i < n; i++)
+    {
+	const mpfr_prec_t precision = mpfr_get_prec(rop[i]);
+	const mp_size_t limbs = (precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	mp_limb_t *d = rop[i]->_mpfr_d;
+
+	// The limbs straight from the buffer when it holds them all, else through spill for the block holding the last word
+	const uint64_t blocks = limbs / 2 + 1;
+	uint64_t extra;
+	if (buffer.last - buffer.next >= blocks)
+	{
+	    const uint64_t *w = buffer.words + 2 * (buffer.next - buffer.first);
+	    for (mp_size_t j = 0; j < limbs; j++)
+		d[j] = w[j];
+	    extra = w[limbs];
+	    buffer.next += blocks;
+	}
+	else
+	{
+	    random_take(&buffer, state, d, limbs & ~1);
+	    random_take(&buffer, state, spill, 2);
+	    if (limbs & 1)
+		d[limbs - 1] = spill[0];
+	    extra = spill[limbs & 1];
+	}
+	d[0] &= ~((((mp_limb_t) 1) << (limbs * GMP_NUMB_BITS - precision)) - 1);
+
+	if (distribution == AVXMPFR_RANDOM_EXPONENTS)
+	{
+	    d[limbs - 1] |= ((mp_limb_t) 1) << (GMP_NUMB_BITS - 1);
+	    rop[i]->_mpfr_sign = extra >> 63 ? -1 : 1;
+	    rop[i]->_mpfr_exp = low + (mpfr_exp_t) (((extra & 0xFFFFFFFF) * (uint64_t) (high - low)) >> 32);
+	    continue;
+	}
+
+	// Uniform, shifted up past its leading zeros
+	mp_size_t top = limbs - 1;
+	while (top >= 0 && d[top] == 0)
+	    top--;
+	const int bits = top < 0 ? 0 : __builtin_clzl(d[top]);
+	const mpfr_exp_t exp = -(mpfr_exp_t) (limbs - 1 - top) * GMP_NUMB_BITS - bits;
+	if (top < 0 || exp < mpfr_get_emin())
+	{
+	    mpfr_set_zero(rop[i], 1);
+	    continue;
+	}
+	if (top < limbs - 1)
+	{
+	    memmove(d + limbs - 1 - top, d, (top + 1) * sizeof(mp_limb_t));
+	    memset(d, 0, (limbs - 1 - top) * sizeof(mp_limb_t));
+	}
+	if (bits)
+	    mpn_lshift(d, d, limbs, bits);
+	rop[i]->_mpfr_sign = 1;
+	rop[i]->_mpfr_exp = exp;
+    }
+
+    state->counter = buffer.next;
+    return 0;
+}
@@ -0,0 +1,152 @@
+// avxmpfr_round.c
+
+/*
+    Correct rounding of a raw limb array straight into the limbs of an mpfr_t.
+
+    The AVX kernels and the batched routines build their results as plain GMP naturals (least significant limb first)
+    together with a binary exponent. Rather than going through mpfr_set_z_2exp() every time, this writes the top
+    mpfr_get_prec(rop) bits directly into rop->_mpfr_d and applies the rounding mode using the round and sticky bits.
+
+    The ternary value returned follows the MPFR convention (negative, zero or positive when the result is smaller,
+    equal or larger than the exact value).
+*/
+
+#include "avxmpfr_utilities.h"
+
+// Return bit number pos of a limb array
+static inline int limb_test_bit(const mp_limb_t *limbs, mpfr_prec_t pos)
+{
+    return (limbs[pos / GMP_NUMB_BITS] >> (pos % GMP_NUMB_BITS)) & 1;
+}
+
+// Return 1 if any bit strictly below bit number pos is set
+static inline int limb_any_below(const mp_limb_t *limbs, mpfr_prec_t pos)
+{
+    mp_size_t whole = pos / GMP_NUMB_BITS;
+
+    for (mp_size_t i = 0; i < whole; i++)
+    {
+	if (limbs[i] != 0)
+	    return 1;
+    }
+
+    int rest = pos % GMP_NUMB_BITS;
+    return rest != 0 && (limbs[whole] & ((((mp_limb_t) 1) << rest) - 1)) != 0;
+}
+
+// Decide if the truncated magnitude has to be incremented by one ulp
+int avxmpfr_round_up_p(int sign, int lsb, int round_bit, int sticky, mpfr_rnd_t rnd)
+{
+    switch (rnd)
+    {
+	case MPFR_RNDN:
+	    return round_bit && (sticky || lsb);
+	case MPFR_RNDU:
+	    return sign > 0 && (round_bit || sticky);
+	case MPFR_RNDD:
+	    return sign < 0 && (round_bit || sticky);
+	case MPFR_RNDA:
+	    return round_bit || sticky;
+	default:	// MPFR_RNDZ and MPFR_RNDF truncate, just like avx_add()
+	    return 0;
+    }
+}
+
+int avxmpfr_round_limbs(mpfr_t rop, int sign, const mp_limb_t *src, mp_size_t n, mpfr_exp_t exp, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the resultant operand, its limbs must not overlap src
+	sign is +1 or -1
+	src is the natural number to round, n limbs long and least significant limb first
+	exp is the binary exponent so that the exact value is sign * src * 2^exp
+	rnd is the rounding mode
+    */
+
+    // Skip any leading zero limbs
+    while (n > 0 && src[n - 1] == 0)
+	n--;
+
+    if (n == 0)
+    {
+	mpfr_set_zero(rop, sign);
+	return 0;
+    }
+
+    const mpfr_prec_t precision = mpfr_get_prec(rop);
+    const mp_size_t rop_limbs = (precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const int unused_bits = rop_limbs * GMP_NUMB_BITS - precision;
+    mp_limb_t *rop_d = rop->_mpfr_d;
+
+    // Number of significant bits in src
+    const mpfr_prec_t bits = (mpfr_prec_t) n * GMP_NUMB_BITS - __builtin_clzl(src[n - 1]);
+
+    // Extract the round and sticky bits before the shift throws them away
+    int round_bit = 0;
+    int sticky = 0;
+    if (bits > precision)
+    {
+	round_bit = limb_test_bit(src, bits - precision - 1);
+	sticky = limb_any_below(src, bits - precision - 1);
+    }
+
+    // Move the most significant bit to the top of rop_d[rop_limbs - 1]
+    mpfr_prec_t shift = bits - (mpfr_prec_t) rop_limbs * GMP_NUMB_BITS;
+    if (shift <= 0)
+    {
+	mp_size_t limb_shift = (-shift) / GMP_NUMB_BITS;
+	int bit_shift = (-shift) % GMP_NUMB_BITS;
+
+	for (mp_size_t i = 0; i < limb_shift; i++)
+	    rop_d[i] = 0;
+
+	if (bit_shift)
+	    mpn_lshift(rop_d + limb_shift, src, rop_limbs - limb_shift, bit_shift);
+	else
+	    mpn_copyi(rop_d + limb_shift, src, rop_limbs - limb_shift);
+    }
+    else
+    {
+	mp_size_t limb_shift = shift / GMP_NUMB_BITS;
+	int bit_shift = shift % GMP_NUMB_BITS;
+
+	if (bit_shift)
+	{
+	    // The shifted value spans rop_limbs limbs, but may be read from one more
+	    mpn_rshift(rop_d, src + limb_shift, rop_limbs, bit_shift);
+	    if (limb_shift + rop_limbs < n)
+		rop_d[rop_limbs - 1] |= src[limb_shift + rop_limbs] << (GMP_NUMB_BITS - bit_shift);
+	}
+	else
+	    mpn_copyi(rop_d, src + limb_shift, rop_limbs);
+    }
+
+    // Clear the bits below the precision, they have already been captured in round_bit and sticky
+    const mp_limb_t ulp = ((mp_limb_t) 1) << unused_bits;
+    rop_d[0] &= ~(ulp - 1);
+
+    mpfr_exp_t rop_exp = exp + bits;
+    int ternary = 0;
+
+    if (round_bit || sticky)
+    {
+	int up = avxmpfr_round_up_p(sign, (rop_d[0] & ulp) != 0, round_bit, sticky, rnd);
+
+	if (up && mpn_add_1(rop_d, rop_d, rop_limbs, ulp))
+	{
+	    // Rounded up to the next power of two
+	    rop_d[rop_limbs - 1] = (((mp_limb_t) 1) << (GMP_NUMB_BITS - 1));
+	    rop_exp++;
+	}
+
+	ternary = up ? sign : -sign;
+    }
+
+    rop->_mpfr_sign = sign;
+    rop->_mpfr_exp = rop_exp;
+
+    // Let MPFR handle overflow and underflow
+    if (rop_exp < mpfr_get_emin() || rop_exp > mpfr_get_emax())
+	return mpfr_check_range(rop, ternary, rnd);
+
+    return ternary;
+}
@@ -0,0 +1,170 @@
+// avxmpfr_scalar.c
+
+/*
+    Adding one fixed value to a whole array, rop[i] = op[i] + c.
+
+    Calling avxmpfr_add() in a loop pads c again for every element, and the allignment shifts c in place as well.
+    Here c is packed into the padded layout once and stays in a register for the whole array. Whenever c has to be
+    alligned to a bigger op[i], the shifted copy is kept, so each exponent gap below AVXMPFR_SCALAR_CACHE is only
+    shifted once. Every element then costs a pack of op[i], the SIMD addition and an unpack into rop[i].
+
+    The addition follows avxmpfr_add(), the smaller operand is truncated when alligned and the sum is truncated when
+    normalised, which for operands of one sign is exactly mpfr_add() with MPFR_RNDZ. So the vector path is only taken
+    for MPFR_RNDZ, any other rounding mode sends the whole array to mpfr_add() and every element rounds the same way
+    whatever its value. Elements the vector path cannot take (different signs, zeros, NaNs, infinities, or a sum
+    beyond the exponent range) are handed to mpfr_add() as well.
+
+    op and c are not modified. rop may be op, but c must not be one of the rop[i].
+*/
+
+#include "avxmpfr_utilities.h"
+
+#define AVXMPFR_SCALAR_CACHE 64	// Exponent gaps that keep a shifted copy of c
+
+// Return 1 if op + c has to go through mpfr_add()
+static inline int scalar_needs_fallback(mpfr_t op, mpfr_t c)
+{
+    return !mpfr_regular_p(op) || mpfr_signbit(op) != mpfr_signbit(c);
+}
+
+// Store a truncated sum in rop, falling back to mpfr_add() if the exponent left the current range
+static inline void scalar_store(mpfr_t rop, mpfr_t op, mpfr_t c, const uint64_t *lanes, int L, mpfr_exp_t exponent, mpfr_rnd_t rnd)
+{
+    if (exponent > mpfr_get_emax())
+    {
+	mpfr_add(rop, op, c, rnd);
+	return;
+    }
+
+    avxmpfr_unpack_lanes(rop->_mpfr_d, lanes, 1, L);
+    rop->_mpfr_sign = c->_mpfr_sign;
+    rop->_mpfr_exp = exponent;
+}
+
+// 252 bits with AVX2 and avx_add()
+static void add_scalar252(mpfr_t *rop, mpfr_t *op, mpfr_t c, size_t n, mpfr_rnd_t rnd)
+{
+    uint64_t c_lanes[4] __attribute__((aligned(32)));
+    avxmpfr_pack_lanes(c_lanes, 1, 4, c);
+    const __m256i c_avx = _mm256_load_si256((const __m256i *) c_lanes);
+    const mpfr_exp_t c_exp = c->_mpfr_exp;
+
+    __m256i shifted[AVXMPFR_SCALAR_CACHE];
+    uint64_t cached = 0;	// Bit g is set once shifted[g] holds c shifted right by g
+
+    for (size_t i = 0; i < n; i++)
+    {
+	if (scalar_needs_fallback(op[i], c))
+	{
+	    mpfr_add(rop[i], op[i], c, rnd);
+	    continue;
+	}
+
+	uint64_t lanes[4] __attribute__((aligned(32)));
+	avxmpfr_pack_lanes(lanes, 1, 4, op[i]);
+	__m256i x = _mm256_load_si256((const __m256i *) lanes);
+	mpfr_exp_t exponent = op[i]->_mpfr_exp;
+	const int64_t gap = exponent - c_exp;
+	AVXMPFR_COUNT_GAP(gap < 0 ? -gap : gap);
+
+	__m256i addend;
+	if (gap < 0)
+	{
+	    // c is the bigger one, allign op[i] to it
+	    x = avxmpfr_shift_padded252(x, -gap);
+	    exponent = c_exp;
+	    addend = c_avx;
+	}
+	else if (gap < AVXMPFR_SCALAR_CACHE)
+	{
+	    if (!(cached & ((uint64_t) 1 << gap)))
+	    {
+		shifted[gap] = avxmpfr_shift_padded252(c_avx, gap);
+		cached |= (uint64_t) 1 << gap;
+	    }
+	    addend = shifted[gap];
+	}
+	else
+	    addend = avxmpfr_shift_padded252(c_avx, gap);
+
+	__m256i result = avx_add(x, addend, &exponent);
+	_mm256_store_si256((__m256i *) lanes, result);
+	scalar_store(rop[i], op[i], c, lanes, 4, exponent, rnd);
+    }
+}
+
+// 504 bits with AVX512 and avx_add_512i()
+static void add_scalar504(mpfr_t *rop, mpfr_t *op, mpfr_t c, size_t n, mpfr_rnd_t rnd)
+{
+    uint64_t c_lanes[8] __attribute__((aligned(64)));
+    avxmpfr_pack_lanes(c_lanes, 1, 8, c);
+    const __m512i c_avx = _mm512_load_si512((const void *) c_lanes);
+    const mpfr_exp_t c_exp = c->_mpfr_exp;
+
+    __m512i shifted[AVXMPFR_SCALAR_CACHE];
+    uint64_t cached = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+	if (scalar_needs_fallback(op[i], c))
+	{
+	    mpfr_add(rop[i], op[i], c, rnd);
+	    continue;
+	}
+
+	uint64_t lanes[8] __attribute__((aligned(64)));
+	avxmpfr_pack_lanes(lanes, 1, 8, op[i]);
+	__m512i x = _mm512_load_si512((const void *) lanes);
+	mpfr_exp_t exponent = op[i]->_mpfr_exp;
+	const int64_t gap = exponent - c_exp;
+	AVXMPFR_COUNT_GAP(gap < 0 ? -gap : gap);
+
+	__m512i addend;
+	if (gap < 0)
+	{
+	    x = avxmpfr_shift_padded504(x, -gap);
+	    exponent = c_exp;
+	    addend = c_avx;
+	}
+	else if (gap < AVXMPFR_SCALAR_CACHE)
+	{
+	    if (!(cached & ((uint64_t) 1 << gap)))
+	    {
+		shifted[gap] = avxmpfr_shift_padded504(c_avx, gap);
+		cached |= (uint64_t) 1 << gap;
+	    }
+	    addend = shifted[gap];
+	}
+	else
+	    addend = avxmpfr_shift_padded504(c_avx, gap);
+
+	__m512i result = avx_add_512i(x, addend, &exponent);
+	_mm512_store_si512((void *) lanes, result);
+	scalar_store(rop[i], op[i], c, lanes, 8, exponent, rnd);
+    }
+}
+
+void avxmpfr_add_scalar_vec(mpfr_t *rop, mpfr_t *op, mpfr_t c, size_t n, mpfr_rnd_t rnd, const uint16_t PRECISION)
+{
+    /*
+	rop is the array of n resultant operands
+	op is the array of n operands
+	c is the value added to every operand
+	rnd is the rounding mode, every rop[i] is op[i] + c rounded with it as by mpfr_add(). Only MPFR_RNDZ is
+	    vectorised, other modes call mpfr_add() on every element
+	PRECISION is the precision of c and of every rop[i] and op[i] (Either PRECISION_256 / PRECISION_512)
+    */
+
+    // Nothing to vectorise, mpfr_add() already handles every case exactly
+    if (!mpfr_regular_p(c) || rnd != MPFR_RNDZ)
+    {
+	for (size_t i = 0; i < n; i++)
+	    mpfr_add(rop[i], op[i], c, rnd);
+	return;
+    }
+
+    if (PRECISION == PRECISION_256)
+	add_scalar252(rop, op, c, n, rnd);
+    else
+	add_scalar504(rop, op, c, n, rnd);
+}
@@ -0,0 +1,474 @@
+// avxmpfr_scan.c
+
+/*
+    Prefix sums over packed arrays (see avxmpfr_array.c): avxmpfr_inclusive_scan() and avxmpfr_exclusive_scan(), on
+    the threads and accumulators of avxmpfr_blas.c.
+
+    The scans take two passes over the parts of the array: the sum of every part, then each part again starting from
+    the sum of the parts before it. In exact mode the running sum is an accumulator and every prefix is rounded from
+    it on its own, so no addition waits on the rounding of the previous one and the results do not depend on the
+    number of threads. An accumulator of a single line stays in a register. In rounded mode the running sum is
+    rounded after every addition, which is the plain loop on one thread, and the parts add the rounded sum of the
+    parts before them in a third pass. It stays in a window of avxmpfr_windows.h from one addition to the next
+    instead of going through rop.
+
+    A call is split over the threads of avxmpfr_blas_set_threads() only once each gets AVXMPFR_BLAS_SCAN_THREAD_MIN
+    values, eight times the threshold of the reductions: every part reads the array two or three times where the
+    single thread reads it once. With 4096 values per thread, comparison_scan measured 65536 values at PRECISION_512
+    at 0.36x - 0.58x of the mpfr_add() loop on 2 to 8 threads. Whether larger batches gain from threads is unmeasured,
+    the machine the threshold was set on has a single core.
+*/
+
+#include "avxmpfr_blas.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLAS_SCAN_MAX_BITS ((mpfr_prec_t) 1 << 26)	// Widest running sum of an exact scan too wide for an accumulator
+
+typedef struct
+{
+    avxmpfr_array *rop;
+    const avxmpfr_array *x;
+    int exclusive;
+    mpfr_rnd_t rnd;
+    mpfr_exp_t low;
+    int64_t size;
+    uint64_t *acc;	// Exact mode, size limbs for each part: its sum, then the sum of the parts before it
+    uint64_t *scratch;	// size limbs for each part, to negate a negative prefix into
+    mpfr_t *total;	// Rounded mode, the sum of each part, then the rounded sum of the parts before it
+    int failed;
+} scan_job;
+
+// Value index of array in the top lanes of a window of 8 limbs (see avxmpfr_windows.h), zero for a zero. Returns the
+// exponent and the sign through sign
+static inline int64_t scan_window_load(const avxmpfr_array *array, uint64_t index, __m512i *x, int *sign)
+{
+    const uint64_t b = index / AVXMPFR_BLOCK;
+    const int lane = index % AVXMPFR_BLOCK;
+    *sign = avxmpfr_block_sign(array, b)[lane];
+    *x = avxmpfr_lanes_to_window8(load_lanes(array, b, lane), array->limbs);
+    return avxmpfr_block_exp(array, b)[lane];
+}
+
+// The rounded window x, or a zero, into value index of array
+static inline void scan_window_store(avxmpfr_array *array, uint64_t index, __m512i x, int64_t exp, int sign)
+{
+    const uint64_t b = index / AVXMPFR_BLOCK;
+    const int lane = index % AVXMPFR_BLOCK;
+    store_lanes(array, b, lane, avxmpfr_window_to_lanes8(x, array->limbs));
+    avxmpfr_block_exp(array, b)[lane] = exp;
+    avxmpfr_block_sign(array, b)[lane] = sign;
+}
+
+// Round the exact prefix in acc into value i of rop
+static inline int scan_store(avxmpfr_array *rop, uint64_t i, const uint64_t *acc, uint64_t *scratch, int64_t size,
+			     mpfr_exp_t low, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    if (acc[size - 1] >> (GMP_NUMB_BITS - 1))
+    {
+	mpn_neg(scratch, acc, size);
+	return blas_store_rounded(rop, i, -1, scratch, size, low, rnd, emin, emax);
+    }
+    return blas_store_rounded(rop, i, 1, acc, size, low, rnd, emin, emax);
+}
+
+// Round the exact prefix in the line sum, bit 0 weighing 2^low, into value i of rop: negated if negative, normalised
+// and rounded with the windows. The line holds every bit of it, so nothing is lost below the window
+static inline void scan_line_store(avxmpfr_array *rop, uint64_t i, __m512i sum, mpfr_exp_t low, mpfr_rnd_t rnd)
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+    windows w;
+    w.lost = 0;
+    w.sign[0] = 1;
+
+    if (_mm512_cmplt_epi64_mask(sum, _mm512_setzero_si512()) & 0x80)
+    {
+	sum = _mm512_xor_si512(sum, ones);
+	sum = _mm512_mask_sub_epi64(sum, (__mmask8) lookahead(0, _mm512_cmpeq_epi64_mask(sum, ones), 1), sum, ones);
+	w.sign[0] = -1;
+    }
+
+    const __mmask8 nonzero = _mm512_test_epi64_mask(sum, sum);
+    if (nonzero == 0)
+    {
+	scan_window_store(rop, i, sum, AVXMPFR_EXP_ZERO, rnd == MPFR_RNDD ? -1 : 1);
+	return;
+    }
+
+    const int top = 31 - __builtin_clz(nonzero);
+    const int lanes = 7 - top, bits = __builtin_clzl(lane_value(sum, top));
+    sum = part_shift(8, sum, _mm512_set1_epi64(lanes), _mm512_set1_epi64(bits));
+    w.exp[0] = low + 8 * GMP_NUMB_BITS - lanes * GMP_NUMB_BITS - bits;
+
+    int ternary;
+    sum = windows_round(8, &w, sum, rop->precision, &rnd, &ternary);
+    scan_window_store(rop, i, sum, w.exp[0], w.sign[0]);
+}
+
+// scan_exact_part() for an accumulator of a single line, the running sum kept in a register. Each value is shifted
+// to its offset in the line as a window
+static void scan_exact_line(scan_job *job, const uint64_t *acc, uint64_t first, uint64_t last)
+{
+    __m512i sum = _mm512_load_si512(acc), x;
+    int sx;
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	// Loaded before the store, rop may be x
+	const int64_t ex = scan_window_load(job->x, i, &x, &sx);
+
+	if (job->exclusive)
+	    scan_line_store(job->rop, i, sum, job->low, job->rnd);
+	if (ex != AVXMPFR_EXP_ZERO)
+	{
+	    // Bit 0 of the window weighs 2^(ex - 512), the value lies inside the line
+	    const int64_t off = ex - 8 * GMP_NUMB_BITS - job->low;
+	    x = part_shift(8, x, _mm512_set1_epi64((off - (off & 63)) / 64), _mm512_set1_epi64(off & 63));
+	    if (sx > 0)
+		avxmpn_block_aors(sum, x, 0, &sum, 0);
+	    else
+		avxmpn_block_aors(sum, x, 0, &sum, 1);
+	}
+	if (!job->exclusive)
+	    scan_line_store(job->rop, i, sum, job->low, job->rnd);
+    }
+}
+
+// Second pass of an exact scan, acc starts out as the sum of the values before first. Every prefix is rounded on its
+// own, nothing waits on a rounding
+static void scan_exact_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    scan_job *job = arg;
+    const int L = job->x->limbs;
+    uint64_t *acc = job->acc + part * job->size;
+    uint64_t *scratch = job->scratch + part * job->size;
+    const mpfr_exp_t emin = mpfr_get_emin(), emax = mpfr_get_emax();
+    mp_limb_t a[8 + 2 * BLAS_FRAME] = {0};
+    int failed = 0, sa;
+
+    // Every prefix of a single line has an exponent in [low + 1, low + 512], one more once rounded up
+    if (job->size == 8 && job->low + 1 >= emin && job->low + 8 * GMP_NUMB_BITS + 1 <= emax)
+    {
+	scan_exact_line(job, acc, first, last);
+	return;
+    }
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	// Loaded before the store, rop may be x
+	const int64_t ea = load_value(job->x, i, a + BLAS_FRAME, &sa);
+
+	if (job->exclusive)
+	    failed |= scan_store(job->rop, i, acc, scratch, job->size, job->low, job->rnd, emin, emax);
+	if (ea != AVXMPFR_EXP_ZERO)
+	{
+	    if (sa > 0)
+		acc_add(acc, job->size, a + BLAS_FRAME, L, ea - L * GMP_NUMB_BITS - job->low, 0);
+	    else
+		acc_add(acc, job->size, a + BLAS_FRAME, L, ea - L * GMP_NUMB_BITS - job->low, 1);
+	}
+	if (!job->exclusive)
+	    failed |= scan_store(job->rop, i, acc, scratch, job->size, job->low, job->rnd, emin, emax);
+    }
+
+    if (failed)
+	job->failed = 1;
+}
+
+// Round the running sum of scan_wide() into value i of rop, in the caller's exponent range emin / emax
+static int scan_wide_store(avxmpfr_array *rop, uint64_t i, mpfr_srcptr sum, mpfr_t out, mpfr_rnd_t rnd,
+			   mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    if (mpfr_zero_p(sum))
+	mpfr_set_zero(out, rnd == MPFR_RNDD ? -1 : 1);
+    else
+    {
+	blas_range_restore(out, mpfr_set(out, sum, rnd), rnd, emin, emax);
+	blas_range_extend(&emin, &emax);
+    }
+    return avxmpfr_array_set(rop, i, out);
+}
+
+// Exact scan of values spanning more than an accumulator, one running mpfr_t of the whole width
+static int scan_wide(avxmpfr_array *rop, const avxmpfr_array *x, int exclusive, int64_t lo, int64_t hi, mpfr_rnd_t rnd)
+{
+    const mpfr_prec_t width = hi - lo + (x->limbs + BLAS_SPARE) * GMP_NUMB_BITS;
+    if (width > BLAS_SCAN_MAX_BITS)
+	return -1;
+
+    mpfr_t sum, value, out;
+    mpfr_exp_t emin, emax;
+    int failed = 0;
+    mpfr_init2(sum, width);
+    mpfr_init2(value, x->precision);
+    mpfr_init2(out, x->precision);
+    mpfr_set_zero(sum, 1);
+    blas_range_extend(&emin, &emax);
+
+    for (uint64_t i = 0; i < x->count; i++)
+    {
+	avxmpfr_array_get(value, x, i, MPFR_RNDN);
+	if (exclusive)
+	    failed |= scan_wide_store(rop, i, sum, out, rnd, emin, emax);
+	mpfr_add(sum, sum, value, MPFR_RNDN);	// Exact, width covers every partial sum
+	if (!exclusive)
+	    failed |= scan_wide_store(rop, i, sum, out, rnd, emin, emax);
+    }
+
+    mpfr_set_emin(emin);
+    mpfr_set_emax(emax);
+    mpfr_clear(sum);
+    mpfr_clear(value);
+    mpfr_clear(out);
+    return failed ? -1 : 0;
+}
+
+static int scan_exact(avxmpfr_array *rop, const avxmpfr_array *x, int exclusive, mpfr_rnd_t rnd)
+{
+    int64_t lo, hi, size;
+    mpfr_exp_t low;
+
+    // An accumulator of at least a line keeps an all zero array simple
+    if (!blas_term_bounds(x, NULL, &lo, &hi))
+	lo = hi = 0;
+    if ((size = blas_acc_size(lo, hi, x->limbs, &low)) == 0)
+	return scan_wide(rop, x, exclusive, lo, hi, rnd);
+
+    // First pass, the exact sum of every part
+    const int parts = blas_parts(x->count, x->count, AVXMPFR_BLAS_SCAN_THREAD_MIN);
+    uint64_t *acc = blas_acc_alloc(2 * parts * size);
+    if (acc == NULL)
+	return scan_wide(rop, x, exclusive, lo, hi, rnd);
+    reduce_job sums = {x, NULL, BLAS_SUM, low, size, acc};
+    if (parts > 1)
+	blas_run(blas_reduce_part, &sums, parts, x->count);
+
+    // Each part starts from the sum of the ones before it, two's complement adds up modulo the size
+    for (int p = parts - 1; p > 0; p--)
+	mpn_copyi(acc + p * size, acc + (p - 1) * size, size);
+    mpn_zero(acc, size);
+    for (int p = 2; p < parts; p++)
+	mpn_add_n(acc + p * size, acc + p * size, acc + (p - 1) * size, size);
+
+    scan_job job = {rop, x, exclusive, rnd, low, size, acc, acc + parts * size, NULL, 0};
+    blas_run(scan_exact_part, &job, parts, x->count);
+    free(acc);
+    return job.failed ? -1 : 0;
+}
+
+// Value from of array into value to, as it is
+static inline void copy_value(avxmpfr_array *array, uint64_t to, uint64_t from)
+{
+    const int L = array->limbs;
+    const size_t stride = array->layout == AVXMPFR_LAYOUT_SOA ? AVXMPFR_BLOCK : 1;
+    const uint64_t *src = avxmpfr_block(array, from / AVXMPFR_BLOCK)
+			  + (from % AVXMPFR_BLOCK) * (array->layout == AVXMPFR_LAYOUT_SOA ? 1 : L);
+    uint64_t *dst = avxmpfr_block(array, to / AVXMPFR_BLOCK)
+		    + (to % AVXMPFR_BLOCK) * (array->layout == AVXMPFR_LAYOUT_SOA ? 1 : L);
+
+    for (int k = 0; k < L; k++)
+	dst[k * stride] = src[k * stride];
+    avxmpfr_block_exp(array, to / AVXMPFR_BLOCK)[to % AVXMPFR_BLOCK] =
+	avxmpfr_block_exp(array, from / AVXMPFR_BLOCK)[from % AVXMPFR_BLOCK];
+    avxmpfr_block_sign(array, to / AVXMPFR_BLOCK)[to % AVXMPFR_BLOCK] =
+	avxmpfr_block_sign(array, from / AVXMPFR_BLOCK)[from % AVXMPFR_BLOCK];
+}
+
+// a + b rounded into value i of rop as mpfr_add() would, zeros included. a and b have L limbs, framed for acc_add()
+static inline int scan_add(avxmpfr_array *rop, uint64_t i, mp_limb_t *a, int64_t ea, int sa, mp_limb_t *b, int64_t eb,
+			   int sb, mpfr_rnd_t rnd, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    const int L = rop->limbs;
+
+    if (ea == AVXMPFR_EXP_ZERO && eb == AVXMPFR_EXP_ZERO)
+    {
+	blas_store_zero(rop, i, sa == sb ? sa : (rnd == MPFR_RNDD ? -1 : 1));
+	return 0;
+    }
+    if (ea == AVXMPFR_EXP_ZERO)
+	return blas_store_rounded(rop, i, sb, b, L, eb - L * GMP_NUMB_BITS, rnd, emin, emax);	// Exact
+    if (eb == AVXMPFR_EXP_ZERO)
+	return blas_store_rounded(rop, i, sa, a, L, ea - L * GMP_NUMB_BITS, rnd, emin, emax);
+    return blas_add_one(rop, i, a, L, ea, sa, b, eb, sb, rnd, emin, emax);
+}
+
+// load_value() with the sign of zeros too
+static inline int64_t scan_load(const avxmpfr_array *array, uint64_t index, mp_limb_t *d, int *sign)
+{
+    const int64_t exp = load_value(array, index, d, sign);
+    if (exp == AVXMPFR_EXP_ZERO)
+	*sign = avxmpfr_block_sign(array, index / AVXMPFR_BLOCK)[index % AVXMPFR_BLOCK];
+    return exp;
+}
+
+// First pass of a rounded scan, the running sum of the part rounded after every addition as a plain loop would. It
+// stays in a window from one addition to the next and is only read back from rop after a sum the windows cannot
+// take, one that could leave the exponent range. Exclusive scans shift the part up by one at the end and leave its
+// first value to scan_offset_part()
+static void scan_rounded_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    scan_job *job = arg;
+    const mpfr_exp_t emin = mpfr_get_emin(), emax = mpfr_get_emax();
+    const mpfr_rnd_t rnd = job->rnd;
+    mp_limb_t a[8 + 2 * BLAS_FRAME] = {0}, b[8 + 2 * BLAS_FRAME] = {0};
+    int failed = 0, sa, sb, s, sx;
+    __m512i sum, x;
+
+    if (first == last)
+	return;
+
+    // The running sum starts as x_first, as it is
+    if (job->rop != job->x)
+    {
+	const int64_t ea = scan_load(job->x, first, a + BLAS_FRAME, &sa);
+	failed |= scan_add(job->rop, first, a + BLAS_FRAME, ea, sa, b + BLAS_FRAME, AVXMPFR_EXP_ZERO, sa, rnd, emin,
+			   emax);
+    }
+    int64_t e = scan_window_load(job->rop, first, &sum, &s);
+
+    for (uint64_t i = first + 1; i < last; i++)
+    {
+	const int64_t ex = scan_window_load(job->x, i, &x, &sx);
+
+	if (e == AVXMPFR_EXP_ZERO || ex == AVXMPFR_EXP_ZERO)
+	{
+	    // Adding a zero is exact, two zeros of different signs give +0 (-0 rounding downwards)
+	    if (e == AVXMPFR_EXP_ZERO && ex == AVXMPFR_EXP_ZERO)
+		s = s == sx ? s : (rnd == MPFR_RNDD ? -1 : 1);
+	    else if (e == AVXMPFR_EXP_ZERO)
+	    {
+		sum = x;
+		e = ex;
+		s = sx;
+	    }
+	}
+	else if (exponents_fit_in(e > ex ? e : ex, e < ex ? e : ex, 8, emin, emax))
+	{
+	    windows w;
+	    __m512i p, q;
+	    int ternary;
+	    windows_prepare(8, &w, &p, &q, sum, &e, &s, x, &ex, &sx);
+	    sum = windows_round(8, &w, windows_aors(8, &w, p, q), job->x->precision, &rnd, &ternary);
+	    e = w.exp[0];
+	    s = w.sign[0];
+	    if (w.zero)
+	    {
+		sum = _mm512_setzero_si512();
+		e = AVXMPFR_EXP_ZERO;
+		s = rnd == MPFR_RNDD ? -1 : 1;
+	    }
+	}
+	else
+	{
+	    const int64_t ea = scan_load(job->x, i, a + BLAS_FRAME, &sa);
+	    const int64_t eb = scan_load(job->rop, i - 1, b + BLAS_FRAME, &sb);
+	    failed |= scan_add(job->rop, i, a + BLAS_FRAME, ea, sa, b + BLAS_FRAME, eb, sb, rnd, emin, emax);
+	    e = scan_window_load(job->rop, i, &sum, &s);
+	    continue;
+	}
+	scan_window_store(job->rop, i, sum, e, s);
+    }
+
+    avxmpfr_array_get(job->total[part], job->rop, last - 1, MPFR_RNDN);
+    if (job->exclusive)
+    {
+	for (uint64_t i = last - 1; i > first; i--)
+	    copy_value(job->rop, i, i - 1);
+	if (part == 0)
+	    blas_store_zero(job->rop, 0, 1);
+    }
+
+    if (failed)
+	job->failed = 1;
+}
+
+// Third pass of a rounded scan, adding the sum of the parts before (part 0 has nothing to do)
+static void scan_offset_part(void *arg, int part, uint64_t first, uint64_t last)
+{
+    scan_job *job = arg;
+    mpfr_srcptr offset = job->total[part];
+    const mpfr_exp_t emin = mpfr_get_emin(), emax = mpfr_get_emax();
+    const int L = job->x->limbs;
+    mp_limb_t a[8 + 2 * BLAS_FRAME] = {0}, b[8 + 2 * BLAS_FRAME] = {0};
+    int failed = 0, sa;
+
+    if (part == 0)
+	return;
+
+    // The offset has the precision of the array, its limbs are those of an unpacked value
+    const int64_t eb = mpfr_zero_p(offset) ? AVXMPFR_EXP_ZERO : mpfr_get_exp(offset);
+    const int sb = mpfr_signbit(offset) ? -1 : 1;
+    if (eb != AVXMPFR_EXP_ZERO)
+	memcpy(b + BLAS_FRAME, offset->_mpfr_d, L * sizeof(mp_limb_t));
+
+    for (uint64_t i = first; i < last; i++)
+    {
+	if (job->exclusive && i == first)
+	    failed |= scan_add(job->rop, i, a + BLAS_FRAME, AVXMPFR_EXP_ZERO, sb, b + BLAS_FRAME, eb, sb, job->rnd, emin,
+			       emax);
+	else
+	{
+	    const int64_t ea = scan_load(job->rop, i, a + BLAS_FRAME, &sa);
+	    failed |= scan_add(job->rop, i, a + BLAS_FRAME, ea, sa, b + BLAS_FRAME, eb, sb, job->rnd, emin, emax);
+	}
+    }
+
+    if (failed)
+	job->failed = 1;
+}
+
+static int scan_rounded(avxmpfr_array *rop, const avxmpfr_array *x, int exclusive, mpfr_rnd_t rnd)
+{
+    const int parts = blas_parts(x->count, x->count, AVXMPFR_BLAS_SCAN_THREAD_MIN);
+    mpfr_t total[parts];
+    for (int p = 0; p < parts; p++)
+	mpfr_init2(total[p], x->precision);
+
+    scan_job job = {rop, x, exclusive, rnd, 0, 0, NULL, NULL, total, 0};
+    blas_run(scan_rounded_part, &job, parts, x->count);
+
+    // The rounded sum of the parts before each one, then added to all of its values
+    for (int p = 1; p < parts - 1; p++)
+	mpfr_add(total[p], total[p - 1], total[p], rnd);
+    for (int p = parts - 1; p > 0; p--)
+	mpfr_swap(total[p], total[p - 1]);
+    if (parts > 1)
+	blas_run(scan_offset_part, &job, parts, x->count);
+
+    for (int p = 0; p < parts; p++)
+	mpfr_clear(total[p]);
+    return job.failed ? -1 : 0;
+}
+
+int avxmpfr_inclusive_scan(avxmpfr_array *rop, const avxmpfr_array *x, mpfr_rnd_t rnd, int exact)
+{
+    /*
+	rop_i becomes x_0 + ... + x_i
+	rop and x are packed arrays of the same precision and count, rop may be x
+
+	exact != 0 rounds every exact prefix sum once with rnd, the same bits whatever the number of threads (an exact
+	zero is +0, -0 under MPFR_RNDD). exact == 0 rounds after every addition: with one thread exactly the loop of
+	mpfr_add(), with more each part adds the rounded sum of the parts before it, so the last bits depend on the
+	number of threads
+
+	Returns 0, or -1 if a sum overflowed, or (leaving rop as it was) if an exact scan spans more than 2^26 bits
+    */
+
+    if (x->count == 0)
+	return 0;
+    return exact ? scan_exact(rop, x, 0, rnd) : scan_rounded(rop, x, 0, rnd);
+}
+
+int avxmpfr_exclusive_scan(avxmpfr_array *rop, const avxmpfr_array *x, mpfr_rnd_t rnd, int exact)
+{
+    /*
+	rop_i becomes x_0 + ... + x_(i-1), rop_0 the empty sum +0 (-0 under MPFR_RNDD when exact)
+	Everything else as avxmpfr_inclusive_scan()
+    */
+
+    if (x->count == 0)
+	return 0;
+    return exact ? scan_exact(rop, x, 1, rnd) : scan_rounded(rop, x, 1, rnd);
+}
+
+
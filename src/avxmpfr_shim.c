@@ -0,0 +1,262 @@
+// avxmpfr_shim.c
+
+/*
+    Interposition of mpfr_add() and mpfr_sub(), for programs that cannot be changed to call avxmpfr themselves.
+
+    The shim is a call counter: it makes no call faster, its point is to find the call sites worth porting. Eligible
+    calls are not routed to avxmpfr_add_prec() or the kernels of avxmpfr_kernels.c either, even at PRECISION_256 and
+    PRECISION_512: those truncate without telling whether anything was dropped, and the shim has to return the
+    ternary value and raise the inexact flag as MPFR does. Working those out costs as much as the addition.
+
+    Built as libavxmpfr_shim.so (make libavxmpfr_shim.so) it exports mpfr_add() and mpfr_sub() and can be loaded
+    ahead of MPFR with LD_PRELOAD. The real functions are looked up with dlsym(RTLD_NEXT) when the library loads.
+    Compiled with -DAVXMPFR_SHIM_WRAP it defines __wrap_mpfr_add() and __wrap_mpfr_sub() instead, for linking with
+    -Wl,--wrap=mpfr_add,--wrap=mpfr_sub, and forwards to __real_mpfr_add() / __real_mpfr_sub().
+
+    A call is eligible when both operands are regular numbers, every precision is at most PRECISION_512 and the
+    rounding mode is one of MPFR_RNDN, Z, U, D or A. By default eligible calls are only counted and every call is
+    forwarded: one call at a time there is nothing to vectorise across, and the path below measures at 0.4x to 0.7x of
+    MPFR (comparison_shim), even with the counters and checks stripped out. The hit rate then tells which call sites
+    are worth moving to the batched interfaces (avxmpfr_add_array(), avxmpfr_add_ptr_vec()). The check costs a few
+    comparisons and one relaxed atomic add per counter.
+
+    With AVXMPFR_SHIM_TAKE_OVER set in the environment, or after avxmpfr_shim_take_over(1), eligible calls whose
+    result cannot leave the exponent range are computed here instead, bit for bit like MPFR but slower (see above).
+    The operand with the bigger exponent is copied to the top of a window one limb wider than every precision
+    involved, the other one is shifted into it by the exponent gap, and the two are added or subtracted with one mpn
+    call. Any bits shifted out are folded into the lowest bit of the window, which lies below the round bit of rop:
+    the window then rounds like the exact result, and avxmpfr_round_limbs() gives the value, ternary value and
+    inexact flag of MPFR. A subtraction cancelling more than two bits has an exponent gap of at most one, and then
+    nothing was shifted out. Everything else, MPFR_RNDF included since MPFR is free to pick either neighbour, is
+    always forwarded.
+
+    Eligible and other calls are counted with one relaxed atomic add per call. avxmpfr_shim_report() prints them, and
+    so does unloading the library when AVXMPFR_SHIM_STATS is set in the environment.
+*/
+
+#define _GNU_SOURCE
+#include "avxmpfr_utilities.h"
+#include <dlfcn.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define SHIM_LIMBS ((PRECISION_512 + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS + 2)	// Widest window and the carry out of it
+
+typedef int (*mpfr_aors)(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd);
+
+typedef struct
+{
+    const char *name;
+    _Atomic uint64_t hits;	// Eligible calls
+    _Atomic uint64_t misses;	// The others
+} shim_counter;
+
+static shim_counter add_counter = {"mpfr_add", 0, 0};
+static shim_counter sub_counter = {"mpfr_sub", 0, 0};
+static _Atomic int take_over = 0;
+
+__attribute__((constructor)) static void shim_options(void)
+{
+    if (getenv("AVXMPFR_SHIM_TAKE_OVER") != NULL)
+	atomic_store_explicit(&take_over, 1, memory_order_relaxed);
+}
+
+#ifdef AVXMPFR_SHIM_WRAP
+int __real_mpfr_add(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd);
+int __real_mpfr_sub(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd);
+#define real_add __real_mpfr_add
+#define real_sub __real_mpfr_sub
+#else
+static mpfr_aors real_add;
+static mpfr_aors real_sub;
+
+__attribute__((constructor)) static void shim_load(void)
+{
+    // Through void * since ISO C has no conversion from the object pointer dlsym() returns to a function pointer
+    *(void **) &real_add = dlsym(RTLD_NEXT, "mpfr_add");
+    *(void **) &real_sub = dlsym(RTLD_NEXT, "mpfr_sub");
+    if (real_add == NULL || real_sub == NULL)
+    {
+	fprintf(stderr, "avxmpfr_shim: mpfr_add() / mpfr_sub() not found after the shim\n");
+	abort();
+    }
+}
+#endif
+
+// 1 if the call has operands and a rounding mode the shim can compute with the same result as MPFR
+static inline int shim_eligible(mpfr_srcptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)
+{
+    return mpfr_regular_p(op1) && mpfr_regular_p(op2) && (unsigned) rnd <= MPFR_RNDA
+	   && mpfr_get_prec(rop) <= PRECISION_512 && mpfr_get_prec(op1) <= PRECISION_512
+	   && mpfr_get_prec(op2) <= PRECISION_512;
+}
+
+// 1 if no result of an eligible call can leave the exponent range
+static inline int shim_in_range(mpfr_srcptr op1, mpfr_srcptr op2)
+{
+    // A sum is below 2^(max + 1), rounded up it may reach it. A nonzero difference is a multiple of the smaller ulp
+    const mpfr_exp_t max = op1->_mpfr_exp > op2->_mpfr_exp ? op1->_mpfr_exp : op2->_mpfr_exp;
+    const mpfr_exp_t min = op1->_mpfr_exp < op2->_mpfr_exp ? op1->_mpfr_exp : op2->_mpfr_exp;
+    return max + 2 <= mpfr_get_emax() && min - PRECISION_512 >= mpfr_get_emin();
+}
+
+// op1 + op2, or op1 - op2 if negate, of an eligible call into rop
+static inline int shim_direct(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd, int negate)
+{
+    int sign1 = op1->_mpfr_sign;
+    int sign2 = negate ? -op2->_mpfr_sign : op2->_mpfr_sign;
+
+    // Make op1 the operand with the bigger exponent
+    if (op2->_mpfr_exp > op1->_mpfr_exp)
+    {
+	mpfr_srcptr t = op1;
+	op1 = op2;
+	op2 = t;
+	const int s = sign1;
+	sign1 = sign2;
+	sign2 = s;
+    }
+    const mpfr_exp_t gap = op1->_mpfr_exp - op2->_mpfr_exp;
+
+    const mp_size_t n1 = (mpfr_get_prec(op1) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const mp_size_t n2 = (mpfr_get_prec(op2) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    mp_size_t window = (mpfr_get_prec(rop) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    if (n1 > window)
+	window = n1;
+    if (n2 > window)
+	window = n2;
+    window++;
+
+    // Both operands at the top of the window
+    mp_limb_t x[SHIM_LIMBS], y[SHIM_LIMBS], unshifted[SHIM_LIMBS];
+    for (mp_size_t i = 0; i < window - n1; i++)
+	x[i] = 0;
+    mpn_copyi(x + window - n1, op1->_mpfr_d, n1);
+    for (mp_size_t i = 0; i < window - n2; i++)
+	unshifted[i] = 0;
+    mpn_copyi(unshifted + window - n2, op2->_mpfr_d, n2);
+
+    // op2 shifted right by the gap, sticky if any of its bits fell off the window
+    int sticky;
+    if (gap >= (mpfr_exp_t) window * GMP_NUMB_BITS)
+    {
+	for (mp_size_t i = 0; i < window; i++)
+	    y[i] = 0;
+	sticky = 1;
+    }
+    else
+    {
+	const mp_size_t q = gap / GMP_NUMB_BITS;
+	const int r = gap % GMP_NUMB_BITS;
+	sticky = (q > 0 && !mpn_zero_p(unshifted, q)) || (r && (unshifted[q] & ((((mp_limb_t) 1) << r) - 1)));
+	if (r)
+	    mpn_rshift(y, unshifted + q, window - q, r);
+	else
+	    mpn_copyi(y, unshifted + q, window - q);
+	for (mp_size_t i = window - q; i < window; i++)
+	    y[i] = 0;
+    }
+
+    // The exact result lies strictly between x and x + 1 (low bit of the window) when sticky, x | 1 rounds the same
+    mp_size_t n = window;
+    if (sign1 == sign2)
+	x[n++] = mpn_add_n(x, x, y, window);
+    else
+    {
+	if (mpn_sub_n(x, x, y, window))
+	{
+	    // Only with equal exponents, where nothing was shifted out
+	    mpn_neg(x, x, window);
+	    sign1 = sign2;
+	}
+	else if (sticky)
+	    mpn_sub_1(x, x, window, 1);
+
+	if (!sticky && mpn_zero_p(x, window))
+	{
+	    mpfr_set_zero(rop, rnd == MPFR_RNDD ? -1 : 1);
+	    return 0;
+	}
+    }
+    x[0] |= sticky;
+
+    return avxmpfr_round_limbs(rop, sign1, x, n, op1->_mpfr_exp - (mpfr_exp_t) window * GMP_NUMB_BITS, rnd);
+}
+
+static inline int shim_aors(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd, int negate,
+			    mpfr_aors real, shim_counter *counter)
+{
+    if (!shim_eligible(rop, op1, op2, rnd))
+    {
+	atomic_fetch_add_explicit(&counter->misses, 1, memory_order_relaxed);
+	return real(rop, op1, op2, rnd);
+    }
+
+    atomic_fetch_add_explicit(&counter->hits, 1, memory_order_relaxed);
+    if (!atomic_load_explicit(&take_over, memory_order_relaxed) || !shim_in_range(op1, op2))
+	return real(rop, op1, op2, rnd);
+
+    const int ternary = shim_direct(rop, op1, op2, rnd, negate);
+    if (ternary != 0)
+	mpfr_set_inexflag();
+    return ternary;
+}
+
+#ifdef AVXMPFR_SHIM_WRAP
+int __wrap_mpfr_add(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)
+#else
+int mpfr_add(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)
+#endif
+{
+    return shim_aors(rop, op1, op2, rnd, 0, real_add, &add_counter);
+}
+
+#ifdef AVXMPFR_SHIM_WRAP
+int __wrap_mpfr_sub(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)
+#else
+int mpfr_sub(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)
+#endif
+{
+    return shim_aors(rop, op1, op2, rnd, 1, real_sub, &sub_counter);
+}
+
+
+/* Settings and hit rate */
+
+void avxmpfr_shim_take_over(int enable)
+{
+    /*
+	enable is 1 to compute eligible calls in the shim, 0 to forward every call (the default)
+    */
+
+    atomic_store_explicit(&take_over, enable != 0, memory_order_relaxed);
+}
+
+void avxmpfr_shim_stats(uint64_t *calls, uint64_t *hits)
+{
+    /*
+	calls and hits receive the totals of both functions since the library was loaded, hits being the eligible calls
+    */
+
+    *hits = atomic_load(&add_counter.hits) + atomic_load(&sub_counter.hits);
+    *calls = *hits + atomic_load(&add_counter.misses) + atomic_load(&sub_counter.misses);
+}
+
+void avxmpfr_shim_report(FILE *stream)
+{
+    const shim_counter *counters[2] = {&add_counter, &sub_counter};
+
+    fprintf(stream, "\navxmpfr shim (%s)\t%12s %12s %10s\n", atomic_load(&take_over) ? "taking over" : "forwarding",
+	    "calls", "eligible", "hit rate");
+    for (int i = 0; i < 2; i++)
+    {
+	const uint64_t hits = atomic_load(&counters[i]->hits), calls = hits + atomic_load(&counters[i]->misses);
+	fprintf(stream, "%-16s\t%12lu %12lu %9.2f%%\n", counters[i]->name, calls, hits, calls ? 100.0 * hits / calls : 0.0);
+    }
+}
+
+__attribute__((destructor)) static void shim_unload(void)
+{
+    if (getenv("AVXMPFR_SHIM_STATS") != NULL)
+	avxmpfr_shim_report(stderr);
+}
@@ -0,0 +1,163 @@
+// avxmpfr_stats.c
+
+/*
+    Optional instrumentation of the hot path, to see where the cycles of an addition actually go.
+
+    Built with -DAVXMPFR_INSTRUMENT (make <target> INSTRUMENT=1) the kernels record:
+	rdtsc cycles per stage of avxmpfr_add() / avxmpfr_add_512() (see the AVXMPFR_STAGE_* macros)
+	a histogram of the carry loop iterations in avx_add() / avx_add_512i(), and how often they normalise
+	a log2 histogram of the exponent gaps met while alligning
+	how many of the values summed by avxmpfr_add_array() fell back to mpfr_add()
+
+    Without it the AVXMPFR_TIMER_* / AVXMPFR_COUNT* macros expand to nothing, so there is no cost at all.
+
+    Counters are per thread and never shared, so recording needs no atomics. Each thread allocates its counters on
+    first use and links them into a registry, they are never freed so the totals survive the thread exiting.
+    avxmpfr_stats_collect() and avxmpfr_stats_reset() read and write other threads' counters without synchronisation,
+    call them while no additions are running.
+*/
+
+#include "avxmpfr_utilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef AVXMPFR_INSTRUMENT
+#include <pthread.h>
+
+__thread avxmpfr_stats *avxmpfr_thread_stats = NULL;
+
+static avxmpfr_stats *registry = NULL;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+avxmpfr_stats *avxmpfr_stats_register(void)
+{
+    avxmpfr_stats *stats = calloc(1, sizeof(avxmpfr_stats));
+    if (stats == NULL)
+	abort();
+
+    pthread_mutex_lock(&registry_lock);
+    stats->next = registry;
+    registry = stats;
+    pthread_mutex_unlock(&registry_lock);
+
+    avxmpfr_thread_stats = stats;
+    return stats;
+}
+#endif
+
+int avxmpfr_stats_collect(avxmpfr_stats *total)
+{
+    /*
+	Sum the counters of every thread into total, returns the number of threads that recorded anything
+    */
+
+    memset(total, 0, sizeof(*total));
+    int threads = 0;
+
+#ifdef AVXMPFR_INSTRUMENT
+    pthread_mutex_lock(&registry_lock);
+    for (const avxmpfr_stats *stats = registry; stats != NULL; stats = stats->next)
+    {
+	for (int i = 0; i < AVXMPFR_STAGES; i++)
+	{
+	    total->stage_cycles[i] += stats->stage_cycles[i];
+	    total->stage_calls[i] += stats->stage_calls[i];
+	}
+	for (int i = 0; i < AVXMPFR_CARRY_BUCKETS; i++)
+	    total->carry_iterations[i] += stats->carry_iterations[i];
+	for (int i = 0; i < AVXMPFR_GAP_BUCKETS; i++)
+	    total->gaps[i] += stats->gaps[i];
+	total->kernel_calls += stats->kernel_calls;
+	total->normalisations += stats->normalisations;
+	total->batched += stats->batched;
+	total->fallbacks += stats->fallbacks;
+	threads++;
+    }
+    pthread_mutex_unlock(&registry_lock);
+#endif
+
+    return threads;
+}
+
+void avxmpfr_stats_reset(void)
+{
+#ifdef AVXMPFR_INSTRUMENT
+    pthread_mutex_lock(&registry_lock);
+    for (avxmpfr_stats *stats = registry; stats != NULL; stats = stats->next)
+    {
+	avxmpfr_stats *next = stats->next;
+	memset(stats, 0, sizeof(*stats));
+	stats->next = next;
+    }
+    pthread_mutex_unlock(&registry_lock);
+#endif
+}
+
+#ifdef AVXMPFR_INSTRUMENT
+// Percentage of part in whole, 0 when there is nothing to compare against
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+#endif
+
+void avxmpfr_stats_dump(FILE *stream)
+{
+    /*
+	Print the breakdown of everything recorded so far by all threads
+    */
+
+#ifndef AVXMPFR_INSTRUMENT
+    fprintf(stream, "\navxmpfr instrumentation is compiled out, rebuild with INSTRUMENT=1 for a breakdown\n");
+#else
+    static const char *stage_names[AVXMPFR_STAGES] = {
+	"alignment", "padding", "add (load, avx_add(), store)", "  of which normalisation", "unpadding", "total"
+    };
+
+    avxmpfr_stats total;
+    int threads = avxmpfr_stats_collect(&total);
+    const uint64_t total_cycles = total.stage_cycles[AVXMPFR_STAGE_TOTAL];
+
+    fprintf(stream, "\navxmpfr instrumentation (%d thread%s)\n", threads, threads == 1 ? "" : "s");
+
+    fprintf(stream, "\n%-32s %12s %14s %10s\n", "Stage", "calls", "cycles/call", "share");
+    for (int i = 0; i < AVXMPFR_STAGES; i++)
+    {
+	const uint64_t calls = total.stage_calls[i];
+	fprintf(stream, "%-32s %12lu %14.1f %9.1f%%\n", stage_names[i], calls,
+		calls ? (double) total.stage_cycles[i] / calls : 0.0, percent(total.stage_cycles[i], total_cycles));
+    }
+
+    fprintf(stream, "\nCarry loop iterations over %lu kernel calls\n", total.kernel_calls);
+    for (int i = 0; i < AVXMPFR_CARRY_BUCKETS; i++)
+    {
+	if (total.carry_iterations[i])
+	    fprintf(stream, "  %2d%-12s %12lu %9.2f%%\n", i, i == AVXMPFR_CARRY_BUCKETS - 1 ? "+" : " ",
+		    total.carry_iterations[i], percent(total.carry_iterations[i], total.kernel_calls));
+    }
+    fprintf(stream, "Normalisation rate:\t%lu (%.2f%%)\n", total.normalisations,
+	    percent(total.normalisations, total.kernel_calls));
+
+    uint64_t gap_total = 0;
+    for (int i = 0; i < AVXMPFR_GAP_BUCKETS; i++)
+	gap_total += total.gaps[i];
+
+    fprintf(stream, "\nExponent gaps over %lu alignments\n", gap_total);
+    for (int i = 0; i < AVXMPFR_GAP_BUCKETS; i++)
+    {
+	if (total.gaps[i] == 0)
+	    continue;
+	char label[32];
+	if (i == 0)
+	    snprintf(label, sizeof(label), "0");
+	else if (i == AVXMPFR_GAP_BUCKETS - 1)
+	    snprintf(label, sizeof(label), ">= %lu", 1UL << (i - 1));
+	else
+	    snprintf(label, sizeof(label), "[%lu, %lu)", 1UL << (i - 1), 1UL << i);
+	fprintf(stream, "  %-14s %12lu %9.2f%%\n", label, total.gaps[i], percent(total.gaps[i], gap_total));
+    }
+
+    fprintf(stream, "\nBatched fallbacks to mpfr_add():\t%lu / %lu (%.2f%%)\n", total.fallbacks, total.batched,
+	    percent(total.fallbacks, total.batched));
+#endif
+}
@@ -0,0 +1,610 @@
+// avxmpfr_strconv.c
+
+/*
+    Batched decimal and binary string conversion for fixed precision mpfr_t arrays.
+
+    Parsing writes the limbs, exponent and sign of each mpfr_t directly, so a batch of numbers can go straight from text
+    into avxmpfr_add() without going through mpfr_set_str() one value at a time.
+	Decimal digits are converted 16 at a time with SSE (8 digit halves combined at the end).
+	Long mantissas use divide-and-conquer radix conversion with a table of 10^(16 * 2^k) shared by the whole batch.
+	The result is correctly rounded in every MPFR rounding mode by rounding the exact rational value.
+
+    Printing goes the other way. The correctly rounded digit integer is split by the same power table down to
+    64 bit chunks of 16 digits, each of which is turned into ASCII with SSE.
+
+    The accepted syntax is a subset of mpfr_set_str(): [+-]digits[.digits][(e|E)[+-]digits], with 'p'/'P' also accepted
+    as the exponent marker in base 2. Anything else (inf, nan, '@' exponents, other bases) is forwarded to mpfr_set_str().
+*/
+
+#include "avxmpfr_utilities.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Digits converted per SIMD step, and the largest decimal exponent handled without falling back to MPFR
+#define STRCONV_CHUNK 16
+#define STRCONV_MAX_EXP 100000
+
+// Below this many 16 digit chunks plain multiply-accumulate beats divide-and-conquer
+#define STRCONV_DC_THRESHOLD 8
+
+// Levels in the 10^(16 * 2^k) power table, enough for mantissas of 16 * 2^15 digits
+#define STRCONV_LEVELS 16
+
+// Powers of ten shared across a batch
+typedef struct
+{
+    mpz_t chunk[STRCONV_LEVELS];	// chunk[k] = 10^(16 * 2^k)
+    int chunk_levels;
+    mpz_t scratch;			// Any other power of ten, recomputed on demand
+} strconv_powers;
+
+static void powers_init(strconv_powers *powers)
+{
+    mpz_init_set_ui(powers->chunk[0], 10000000000000000UL);
+    powers->chunk_levels = 1;
+    mpz_init(powers->scratch);
+}
+
+static void powers_clear(strconv_powers *powers)
+{
+    for (int k = 0; k < powers->chunk_levels; k++)
+	mpz_clear(powers->chunk[k]);
+    mpz_clear(powers->scratch);
+}
+
+// Return 10^(16 * 2^level), growing the table by squaring if needed
+static mpz_srcptr powers_chunk(strconv_powers *powers, int level)
+{
+    while (powers->chunk_levels <= level)
+    {
+	mpz_init(powers->chunk[powers->chunk_levels]);
+	mpz_mul(powers->chunk[powers->chunk_levels], powers->chunk[powers->chunk_levels - 1], powers->chunk[powers->chunk_levels - 1]);
+	powers->chunk_levels++;
+    }
+    return powers->chunk[level];
+}
+
+
+/* SIMD digit conversion */
+
+// Convert 16 ASCII digits into their value using SSSE3/SSE4.1 multiply-add steps
+static inline uint64_t parse_16digits(const char *digits)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *) digits);
+    chunk = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+
+    // Pairs of digits into 8 x 16 bit values
+    const __m128i mul_10 = _mm_set_epi8(1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10);
+    chunk = _mm_maddubs_epi16(chunk, mul_10);
+
+    // Pairs of pairs into 4 x 32 bit values
+    const __m128i mul_100 = _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100);
+    chunk = _mm_madd_epi16(chunk, mul_100);
+
+    // Groups of 4 digits into 2 x 32 bit values of 8 digits
+    chunk = _mm_packus_epi32(chunk, chunk);
+    const __m128i mul_10000 = _mm_set_epi16(1, 10000, 1, 10000, 1, 10000, 1, 10000);
+    chunk = _mm_madd_epi16(chunk, mul_10000);
+
+    uint64_t high = (uint32_t) _mm_cvtsi128_si32(chunk);
+    uint64_t low = (uint32_t) _mm_extract_epi32(chunk, 1);
+    return high * 100000000UL + low;
+}
+
+// Convert a value below 10^8 into 8 x 16 bit digits using SSE2 multiply-high reciprocals
+static inline __m128i format_8digits(uint32_t value)
+{
+    // abcdefgh -> abcd, efgh
+    const __m128i abcdefgh = _mm_cvtsi32_si128(value);
+    const __m128i abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, _mm_set1_epi32(0xD1B71759)), 45);
+    const __m128i efgh = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+
+    // Spread abcd into the first 4 x 16 bit lanes and efgh into the next 4, pre-multiplied by 4
+    __m128i v = _mm_unpacklo_epi16(abcd, efgh);
+    v = _mm_slli_epi64(v, 2);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+
+    // Divide by 1000, 100, 10, 1 giving a, ab, abc, abcd, e, ef, efg, efgh
+    const __m128i div_powers = _mm_set_epi16((short) 32768, 13108, 5243, 8389, (short) 32768, 13108, 5243, 8389);
+    const __m128i shift_powers = _mm_set_epi16((short) (1 << 15), 1 << 13, 1 << 11, 1 << 7, (short) (1 << 15), 1 << 13, 1 << 11, 1 << 7);
+    v = _mm_mulhi_epu16(_mm_mulhi_epu16(v, div_powers), shift_powers);
+
+    // Subtract 10 times the lane before to leave a single digit per lane
+    const __m128i tens = _mm_slli_epi64(_mm_mullo_epi16(v, _mm_set1_epi16(10)), 16);
+    return _mm_sub_epi16(v, tens);
+}
+
+// Write a value below 10^16 as exactly 16 ASCII digits
+static inline void format_16digits(char *out, uint64_t value)
+{
+    __m128i high = format_8digits((uint32_t) (value / 100000000UL));
+    __m128i low = format_8digits((uint32_t) (value % 100000000UL));
+    __m128i digits = _mm_add_epi8(_mm_packus_epi16(high, low), _mm_set1_epi8('0'));
+    _mm_storeu_si128((__m128i *) out, digits);
+}
+
+// Convert 16 ASCII binary digits into a 16 bit value, first character most significant
+static inline uint32_t parse_16bits(const char *digits)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *) digits);
+
+    // Reverse the bytes so that movemask puts the last character in bit 0
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    chunk = _mm_shuffle_epi8(chunk, reverse);
+
+    // '1' (0x31) shifted left by 7 has its top bit set, '0' (0x30) does not
+    return (uint32_t) _mm_movemask_epi8(_mm_slli_epi16(chunk, 7));
+}
+
+
+/* Radix conversion */
+
+// Convert a run of decimal digits, a multiple of 16 long, into rop
+static void digits_to_mpz(mpz_t rop, const char *digits, size_t chunks, strconv_powers *powers)
+{
+    if (chunks <= STRCONV_DC_THRESHOLD)
+    {
+	// Multiply-accumulate 16 digits at a time
+	mpz_set_ui(rop, parse_16digits(digits));
+	for (size_t i = 1; i < chunks; i++)
+	{
+	    mpz_mul_ui(rop, rop, 10000000000000000UL);
+	    mpz_add_ui(rop, rop, parse_16digits(digits + i * STRCONV_CHUNK));
+	}
+	return;
+    }
+
+    // Split so that the low part is a power of two number of chunks, then value = high * 10^(16 * low_chunks) + low
+    int level = 63 - __builtin_clzl(chunks - 1);
+    size_t low_chunks = ((size_t) 1) << level;
+    size_t high_chunks = chunks - low_chunks;
+
+    mpz_t low;
+    mpz_init(low);
+    digits_to_mpz(rop, digits, high_chunks, powers);
+    digits_to_mpz(low, digits + high_chunks * STRCONV_CHUNK, low_chunks, powers);
+
+    mpz_mul(rop, rop, powers_chunk(powers, level));
+    mpz_add(rop, rop, low);
+    mpz_clear(low);
+}
+
+// Write op (below 10^(16 * chunks)) as exactly 16 * chunks ASCII digits, including leading zeros
+static void mpz_to_digits(char *out, mpz_srcptr op, size_t chunks, strconv_powers *powers)
+{
+    if (chunks == 1)
+    {
+	format_16digits(out, mpz_get_ui(op));
+	return;
+    }
+
+    int level = 63 - __builtin_clzl(chunks - 1);
+    size_t low_chunks = ((size_t) 1) << level;
+
+    mpz_t high, low;
+    mpz_inits(high, low, NULL);
+    mpz_tdiv_qr(high, low, op, powers_chunk(powers, level));
+
+    mpz_to_digits(out, high, chunks - low_chunks, powers);
+    mpz_to_digits(out + (chunks - low_chunks) * STRCONV_CHUNK, low, low_chunks, powers);
+    mpz_clears(high, low, NULL);
+}
+
+// Return 10^exponent, reusing the power table when possible
+static mpz_srcptr powers_ten(strconv_powers *powers, unsigned long exponent)
+{
+    if (exponent % STRCONV_CHUNK == 0 && __builtin_popcountl(exponent / STRCONV_CHUNK) == 1)
+	return powers_chunk(powers, __builtin_ctzl(exponent / STRCONV_CHUNK));
+
+    mpz_ui_pow_ui(powers->scratch, 10, exponent);
+    return powers->scratch;
+}
+
+
+/* Parsing */
+
+// Scan [+-]digits[.digits][exponent], copying the mantissa digits without the point into digits
+// Returns 0 if the string is not in the fast path syntax
+static int scan_number(const char *str, int base, int *sign, char *digits, size_t *n_digits, long *exponent)
+{
+    const char *p = str;
+    *sign = 1;
+    if (*p == '-' || *p == '+')
+    {
+	*sign = (*p == '-') ? -1 : 1;
+	p++;
+    }
+
+    const char top = (base == 2) ? '1' : '9';
+    size_t count = 0;
+    long fraction_digits = 0;
+    int seen_point = 0;
+    int seen_digit = 0;
+
+    for (;; p++)
+    {
+	if (*p >= '0' && *p <= top)
+	{
+	    seen_digit = 1;
+	    // Leading zeros carry no information
+	    if (count == 0 && *p == '0')
+	    {
+		fraction_digits += seen_point;
+		continue;
+	    }
+	    digits[count++] = *p;
+	    fraction_digits += seen_point;
+	}
+	else if (*p == '.' && !seen_point)
+	    seen_point = 1;
+	else
+	    break;
+    }
+
+    if (!seen_digit)
+	return 0;
+
+    long explicit_exp = 0;
+    if (*p == 'e' || *p == 'E' || (base == 2 && (*p == 'p' || *p == 'P')))
+    {
+	p++;
+	int exp_sign = 1;
+	if (*p == '-' || *p == '+')
+	{
+	    exp_sign = (*p == '-') ? -1 : 1;
+	    p++;
+	}
+	if (*p < '0' || *p > '9')
+	    return 0;
+	while (*p >= '0' && *p <= '9')
+	{
+	    explicit_exp = explicit_exp * 10 + (*p - '0');
+	    if (explicit_exp > STRCONV_MAX_EXP)
+		return 0;
+	    p++;
+	}
+	explicit_exp *= exp_sign;
+    }
+
+    if (*p != '\0')
+	return 0;
+
+    *n_digits = count;
+    *exponent = explicit_exp - fraction_digits;
+    return 1;
+}
+
+// Pack binary digits into limbs, least significant limb first
+static mp_size_t binary_digits_to_limbs(mp_limb_t *limbs, const char *digits, size_t n_digits)
+{
+    mp_size_t n = (n_digits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    for (mp_size_t i = 0; i < n; i++)
+	limbs[i] = 0;
+
+    // Walk backwards from the least significant digit, 16 digits per step
+    size_t bit = 0;
+    size_t end = n_digits;
+    while (end >= STRCONV_CHUNK)
+    {
+	mp_limb_t chunk = parse_16bits(digits + end - STRCONV_CHUNK);
+	limbs[bit / GMP_NUMB_BITS] |= chunk << (bit % GMP_NUMB_BITS);
+	bit += STRCONV_CHUNK;
+	end -= STRCONV_CHUNK;
+    }
+    while (end > 0)
+    {
+	end--;
+	limbs[bit / GMP_NUMB_BITS] |= ((mp_limb_t) (digits[end] - '0')) << (bit % GMP_NUMB_BITS);
+	bit++;
+    }
+    return n;
+}
+
+// Correctly round digits * 10^exponent into rop
+static int round_decimal(mpfr_t rop, int sign, mpz_t mantissa, long exponent, mpfr_rnd_t rnd, strconv_powers *powers)
+{
+    if (exponent >= 0)
+    {
+	mpz_mul(mantissa, mantissa, powers_ten(powers, exponent));
+	return avxmpfr_round_limbs(rop, sign, mantissa->_mp_d, mantissa->_mp_size, 0, rnd);
+    }
+
+    // Divide with enough quotient bits for the round bit, then fold the remainder into a sticky bit
+    mpz_srcptr denominator = powers_ten(powers, -exponent);
+    long shift = mpfr_get_prec(rop) + 2 + (long) mpz_sizeinbase(denominator, 2) - (long) mpz_sizeinbase(mantissa, 2) + 1;
+    if (shift < 0)
+	shift = 0;
+
+    mpz_t remainder;
+    mpz_init(remainder);
+    mpz_mul_2exp(mantissa, mantissa, shift);
+    mpz_tdiv_qr(mantissa, remainder, mantissa, denominator);
+    if (mpz_sgn(remainder) != 0)
+	mpz_setbit(mantissa, 0);
+    mpz_clear(remainder);
+
+    return avxmpfr_round_limbs(rop, sign, mantissa->_mp_d, mantissa->_mp_size, -shift, rnd);
+}
+
+void avxmpfr_set_str_vec(mpfr_t *rop, const char *const *str, size_t n, int base, mpfr_rnd_t rnd)
+{
+    /*
+	rop is the array of resultant operands, each already initialised to its precision
+	str is the array of n strings to parse
+	base is 10 or 2, any other base is handed to mpfr_set_str()
+	rnd is the rounding mode
+    */
+
+    strconv_powers powers;
+    powers_init(&powers);
+
+    mpz_t mantissa;
+    mpz_init(mantissa);
+
+    // Digit buffer, front padded with '0' to a whole number of chunks
+    size_t buffer_size = 0;
+    char *buffer = NULL;
+
+    for (size_t i = 0; i < n; i++)
+    {
+	size_t length = strlen(str[i]);
+	if (length + STRCONV_CHUNK > buffer_size)
+	{
+	    buffer_size = 2 * (length + STRCONV_CHUNK);
+	    buffer = realloc(buffer, buffer_size);
+	}
+
+	int sign;
+	size_t n_digits;
+	long exponent;
+	if ((base != 10 && base != 2) || !scan_number(str[i], base, &sign, buffer + STRCONV_CHUNK, &n_digits, &exponent))
+	{
+	    mpfr_set_str(rop[i], str[i], base, rnd);
+	    continue;
+	}
+
+	if (n_digits == 0)
+	{
+	    mpfr_set_zero(rop[i], sign);
+	    continue;
+	}
+
+	if (base == 2)
+	{
+	    mpz_realloc2(mantissa, n_digits);
+	    mp_size_t limbs = binary_digits_to_limbs(mantissa->_mp_d, buffer + STRCONV_CHUNK, n_digits);
+	    avxmpfr_round_limbs(rop[i], sign, mantissa->_mp_d, limbs, exponent, rnd);
+	    continue;
+	}
+
+	// Move the digits so that they end on a chunk boundary and pad the front with zeros
+	size_t chunks = (n_digits + STRCONV_CHUNK - 1) / STRCONV_CHUNK;
+	size_t pad = chunks * STRCONV_CHUNK - n_digits;
+	char *digits = buffer + STRCONV_CHUNK - pad;
+	memset(digits, '0', pad);
+
+	digits_to_mpz(mantissa, digits, chunks, &powers);
+	round_decimal(rop[i], sign, mantissa, exponent, rnd, &powers);
+    }
+
+    free(buffer);
+    mpz_clear(mantissa);
+    powers_clear(&powers);
+}
+
+
+/* Printing */
+
+// Write the exponent part in the same form as mpfr_printf() "%Re" / "%Rb"
+static char *write_exponent(char *out, char marker, long exponent, int min_digits)
+{
+    *out++ = marker;
+    *out++ = exponent < 0 ? '-' : '+';
+    unsigned long magnitude = exponent < 0 ? -exponent : exponent;
+
+    char reversed[24];
+    int count = 0;
+    do
+    {
+	reversed[count++] = '0' + magnitude % 10;
+	magnitude /= 10;
+    } while (magnitude);
+
+    while (count < min_digits)
+	reversed[count++] = '0';
+    while (count)
+	*out++ = reversed[--count];
+
+    *out = '\0';
+    return out;
+}
+
+// Write value (exactly n_digits digits long) as d.ddd
+static char *write_mantissa(char *out, const char *digits, size_t n_digits)
+{
+    *out++ = digits[0];
+    if (n_digits > 1)
+    {
+	*out++ = '.';
+	memcpy(out, digits + 1, n_digits - 1);
+	out += n_digits - 1;
+    }
+    return out;
+}
+
+// Handle NaN, infinities and zero the way mpfr_printf() does, returns 0 for regular numbers
+static int format_special(char *out, mpfr_srcptr op, size_t n_digits, char marker)
+{
+    if (mpfr_regular_p(op))
+	return 0;
+
+    if (mpfr_nan_p(op))
+    {
+	strcpy(out, "nan");
+	return 1;
+    }
+
+    if (mpfr_signbit(op))
+	*out++ = '-';
+
+    if (mpfr_inf_p(op))
+    {
+	strcpy(out, "inf");
+	return 1;
+    }
+
+    // Zero
+    *out++ = '0';
+    if (n_digits > 1)
+    {
+	*out++ = '.';
+	memset(out, '0', n_digits - 1);
+	out += n_digits - 1;
+    }
+    write_exponent(out, marker, 0, marker == 'e' ? 2 : 1);
+    return 1;
+}
+
+// Round sign * numerator / denominator to an integer in the given rounding mode
+static void round_quotient(mpz_t rop, mpz_srcptr numerator, mpz_srcptr denominator, int sign, mpfr_rnd_t rnd)
+{
+    mpz_t remainder;
+    mpz_init(remainder);
+    mpz_tdiv_qr(rop, remainder, numerator, denominator);
+
+    if (mpz_sgn(remainder) != 0)
+    {
+	// Compare twice the remainder with the denominator for the round bit and sticky bit
+	mpz_mul_2exp(remainder, remainder, 1);
+	int cmp = mpz_cmp(remainder, denominator);
+	int round_bit = cmp >= 0;
+	int sticky = cmp != 0;
+
+	if (avxmpfr_round_up_p(sign, mpz_odd_p(rop), round_bit, sticky, rnd))
+	    mpz_add_ui(rop, rop, 1);
+    }
+    mpz_clear(remainder);
+}
+
+void avxmpfr_get_str_vec(char **str, size_t n_digits, int base, mpfr_t *op, size_t n, mpfr_rnd_t rnd)
+{
+    /*
+	str is the array of output buffers, each at least avxmpfr_get_str_size(n_digits) bytes
+	n_digits is the number of significant digits to print, at least 1
+	base is 10 ("d.ddde+XX" like "%.*Re") or 2 ("1.bbbp+X" like "%.*Rb")
+	op is the array of n numbers to print
+	rnd is the rounding mode
+    */
+
+    strconv_powers powers;
+    powers_init(&powers);
+
+    mpz_t mantissa, scale, divisor, digit_value;
+    mpz_inits(mantissa, scale, divisor, digit_value, NULL);
+
+    size_t chunks = (n_digits + STRCONV_CHUNK - 1) / STRCONV_CHUNK;
+    char *buffer = malloc(chunks * STRCONV_CHUNK + 1);
+    const char marker = (base == 2) ? 'p' : 'e';
+
+    for (size_t i = 0; i < n; i++)
+    {
+	char *out = str[i];
+	if (format_special(out, op[i], n_digits, marker))
+	    continue;
+
+	int sign = mpfr_signbit(op[i]) ? -1 : 1;
+	if (sign < 0)
+	    *out++ = '-';
+
+	// The exact value is mantissa * 2^exp2 with the mantissa taken straight from the limbs
+	mpfr_prec_t precision = mpfr_get_prec(op[i]);
+	mp_size_t limbs = (precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	mpz_realloc2(mantissa, limbs * GMP_NUMB_BITS);
+	mpn_copyi(mantissa->_mp_d, op[i]->_mpfr_d, limbs);
+	mantissa->_mp_size = limbs;
+	long exp2 = op[i]->_mpfr_exp - limbs * GMP_NUMB_BITS;
+
+	if (base == 2)
+	{
+	    // Digits are the mantissa bits, rounding is only needed when fewer digits than bits are asked for
+	    long drop = (long) limbs * GMP_NUMB_BITS - (long) n_digits;
+	    if (drop > 0)
+	    {
+		mpz_set_ui(scale, 1);
+		mpz_mul_2exp(scale, scale, drop);
+		round_quotient(digit_value, mantissa, scale, sign, rnd);
+	    }
+	    else
+		mpz_mul_2exp(digit_value, mantissa, -drop);
+
+	    // Rounding up may carry into a new leading bit
+	    long point_exp = op[i]->_mpfr_exp - 1;
+	    if (mpz_sizeinbase(digit_value, 2) > n_digits)
+	    {
+		mpz_tdiv_q_2exp(digit_value, digit_value, 1);
+		point_exp++;
+	    }
+
+	    for (size_t d = 0; d < n_digits; d++)
+		buffer[d] = '0' + mpz_tstbit(digit_value, n_digits - 1 - d);
+
+	    out = write_mantissa(out, buffer, n_digits);
+	    write_exponent(out, marker, point_exp, 1);
+	    continue;
+	}
+
+	// Estimate the decimal exponent with 78913 / 2^18 ~ log10(2), it is corrected below if off by one
+	long dec_exp = ((long) (op[i]->_mpfr_exp - 1) * 78913) >> 18;
+
+	for (;;)
+	{
+	    // digit_value = round(|op| * 10^(n_digits - 1 - dec_exp))
+	    long ten_exp = (long) n_digits - 1 - dec_exp;
+	    mpz_set(scale, mantissa);
+	    mpz_set_ui(divisor, 1);
+
+	    if (ten_exp >= 0)
+		mpz_mul(scale, scale, powers_ten(&powers, ten_exp));
+	    else
+		mpz_set(divisor, powers_ten(&powers, -ten_exp));
+
+	    if (exp2 >= 0)
+		mpz_mul_2exp(scale, scale, exp2);
+	    else
+		mpz_mul_2exp(divisor, divisor, -exp2);
+
+	    round_quotient(digit_value, scale, divisor, sign, rnd);
+
+	    // Estimate was low by one, or rounding carried into a new digit
+	    if (mpz_cmp(digit_value, powers_ten(&powers, n_digits)) >= 0)
+	    {
+		dec_exp++;
+		continue;
+	    }
+
+	    // Estimate was high by one
+	    if (mpz_cmp(digit_value, powers_ten(&powers, n_digits - 1)) < 0)
+	    {
+		dec_exp--;
+		continue;
+	    }
+	    break;
+	}
+
+	mpz_to_digits(buffer, digit_value, chunks, &powers);
+	out = write_mantissa(out, buffer + chunks * STRCONV_CHUNK - n_digits, n_digits);
+	write_exponent(out, marker, dec_exp, 2);
+    }
+
+    free(buffer);
+    mpz_clears(mantissa, scale, divisor, digit_value, NULL);
+    powers_clear(&powers);
+}
+
+// Buffer size needed by avxmpfr_get_str_vec() for n_digits significant digits
+size_t avxmpfr_get_str_size(size_t n_digits)
+{
+    // Sign, point, exponent marker, exponent sign, up to 20 exponent digits and the terminator
+    return n_digits + 32;
+}
@@ -16,13 +16,484 @@
 #include <stdio.h>
 #include <mpfr.h>
 #include <stdint.h>
+#include <time.h>
 #include <immintrin.h>
 
+#ifdef __cplusplus
+extern "C" {
+#define AVXMPFR_ATOMIC volatile		// C++ code only touches requests through the functions below
+#else
+#define AVXMPFR_ATOMIC _Atomic
+#endif
+
 // Lets define some macros 
 #define PRECISION_512 504 
 #define PRECISION_256 252
+#define PRECISION_128 126
+
+// Packed arrays, see avxmpfr_array.c for the block layout
+#define AVXMPFR_BLOCK 8				// Values per block
+#define AVXMPFR_LAYOUT_NATIVE 0			// Padded limbs of each value together, in AVX lane order
+#define AVXMPFR_LAYOUT_SOA 1			// Padded limb planes, one value per AVX512 lane
+#define AVXMPFR_EXP_ZERO (-((int64_t) 1 << 62))	// Exponent stored for zeros
+
+typedef struct
+{
+    uint16_t precision;		// PRECISION_256 or PRECISION_512
+    uint16_t limbs;		// Padded 63 bit limbs per value
+    uint32_t layout;		// AVXMPFR_LAYOUT_NATIVE or AVXMPFR_LAYOUT_SOA
+    uint64_t count;		// Number of values
+    uint64_t *blocks;		// 64 byte aligned blocks of AVXMPFR_BLOCK values
+} avxmpfr_array;
+
+// Number of blocks holding count values
+static inline uint64_t avxmpfr_array_blocks(uint64_t count)
+{
+    return (count + AVXMPFR_BLOCK - 1) / AVXMPFR_BLOCK;
+}
+
+// Size of a block in 64 bit words: the limbs, a line of exponents and a line holding the signs
+static inline uint64_t avxmpfr_block_words(uint16_t limbs)
+{
+    return AVXMPFR_BLOCK * limbs + 2 * AVXMPFR_BLOCK;
+}
+
+static inline uint64_t *avxmpfr_block(const avxmpfr_array *array, uint64_t block)
+{
+    return array->blocks + block * avxmpfr_block_words(array->limbs);
+}
+
+static inline int64_t *avxmpfr_block_exp(const avxmpfr_array *array, uint64_t block)
+{
+    return (int64_t *) (avxmpfr_block(array, block) + AVXMPFR_BLOCK * array->limbs);
+}
+
+static inline int8_t *avxmpfr_block_sign(const avxmpfr_array *array, uint64_t block)
+{
+    return (int8_t *) (avxmpfr_block(array, block) + AVXMPFR_BLOCK * array->limbs + AVXMPFR_BLOCK);
+}
+
+// Padded lanes, the 63 bit AVX limb layout shared by the batched routines
+#define AVXMPFR_PAD_MASK 0x7FFFFFFFFFFFFFFF
+
+// Pack the top L * 63 bits of the regular number op into L padded lanes, lane k (most significant first) at
+// lanes[k * stride]. Precision beyond L * 63 bits is truncated, missing low limbs read as zero.
+static inline void avxmpfr_pack_lanes(uint64_t *lanes, size_t stride, int L, const mpfr_t op)
+{
+    // Line the mpfr limbs up with the L limbs of the lanes
+    const mp_size_t op_limbs = (mpfr_get_prec(op) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    #define LIMB(j) ((j) >= L || (j) + op_limbs - L < 0 ? 0 : op->_mpfr_d[(j) + op_limbs - L])
+
+    // Padded lane k holds the 63 bits starting (k + 1) bits into mpfr limb L - 1 - k, lane 63 is just the low
+    // 63 bits of limb L - 63 (shifting that limb by 64 would be undefined)
+    for (int k = 0; k < L; k++)
+    {
+	uint64_t lane_value = (k < 63) ? LIMB(L - 1 - k) >> (k + 1) : 0;
+	if (k > 0)
+	    lane_value |= LIMB(L - k) << (63 - k);
+	lanes[k * stride] = lane_value & AVXMPFR_PAD_MASK;
+    }
+    #undef LIMB
+}
+
+// The reverse of avxmpfr_pack_lanes(), mpfr limb L - 1 - k of d takes lane k and the top bits of lane k + 1. Lane 63
+// only fills the low 63 bits of limb L - 64, whose top bit lies past the last lane
+static inline void avxmpfr_unpack_lanes(mp_limb_t *d, const uint64_t *lanes, size_t stride, int L)
+{
+    for (int k = 0; k < L; k++)
+    {
+	if (k == 63)
+	{
+	    d[L - 1 - k] = 0;
+	    continue;
+	}
+	uint64_t lane_value = lanes[k * stride];
+	uint64_t next_value = (k + 1 < L) ? lanes[(k + 1) * stride] : 0;
+	d[L - 1 - k] = (lane_value << (k + 1)) | (next_value >> (62 - k));
+    }
+}
+
+#ifdef __AVX512F__
+// avxmpfr_pack_lanes() for L <= 8 in one register, lane k in element k and elements L and up zero. The mpfr limbs
+// are read with one masked load, lined up with two permutes and shifted with per element shift counts.
+static inline __m512i avxmpfr_pack_lanes8(int L, const mpfr_t op)
+{
+    const mp_size_t op_limbs = (mpfr_get_prec(op) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    const int c = op_limbs < L ? op_limbs : L;		// Limbs that reach the lanes, the top c of op
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i limbs = _mm512_maskz_loadu_epi64((__mmask8) ((1 << c) - 1), op->_mpfr_d + (op_limbs - c));
+
+    // Lane k takes the top bits of limb c - 1 - k and the low bits of limb c - k (see avxmpfr_pack_lanes())
+    __m512i high = _mm512_maskz_permutexvar_epi64((__mmask8) ((1 << c) - 1), _mm512_sub_epi64(_mm512_set1_epi64(c - 1), lane), limbs);
+    __m512i low = _mm512_maskz_permutexvar_epi64((__mmask8) (((1 << (c + 1)) - 2) & ((1 << L) - 1)), _mm512_sub_epi64(_mm512_set1_epi64(c), lane), limbs);
+    high = _mm512_srlv_epi64(high, _mm512_add_epi64(lane, _mm512_set1_epi64(1)));
+    low = _mm512_sllv_epi64(low, _mm512_sub_epi64(_mm512_set1_epi64(63), lane));
+    return _mm512_and_si512(_mm512_or_si512(high, low), _mm512_set1_epi64(AVXMPFR_PAD_MASK));
+}
+
+// avxmpfr_unpack_lanes() for L <= 8 straight into the n <= L most significant limbs d[0 .. n - 1], d[i] taking lane
+// n - 1 - i and the top bits of lane n - i
+static inline void avxmpfr_unpack_lanes8(mp_limb_t *d, __m512i lanes, int L, int n)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    __m512i high = _mm512_permutexvar_epi64(_mm512_sub_epi64(_mm512_set1_epi64(n - 1), lane), lanes);
+    __m512i low = _mm512_maskz_permutexvar_epi64((__mmask8) (n == L ? 0xFE : 0xFF), _mm512_sub_epi64(_mm512_set1_epi64(n), lane), lanes);
+    high = _mm512_sllv_epi64(high, _mm512_sub_epi64(_mm512_set1_epi64(n), lane));
+    low = _mm512_srlv_epi64(low, _mm512_add_epi64(lane, _mm512_set1_epi64(63 - n)));
+    _mm512_mask_storeu_epi64(d, (__mmask8) ((1 << n) - 1), _mm512_or_si512(high, low));
+}
+
+// The L <= 8 padded lanes in lanes as the limbs of a window of 8 (see avxmpfr_windows.h), the most significant limb in
+// element 7 and zeros under the value: avxmpfr_unpack_lanes8() lined up at the top of a register
+static inline __m512i avxmpfr_lanes_to_window8(__m512i lanes, int L)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    __m512i high = _mm512_maskz_permutexvar_epi64((__mmask8) (0xFF << (8 - L)), _mm512_sub_epi64(_mm512_set1_epi64(7), lane), lanes);
+    __m512i low = _mm512_maskz_permutexvar_epi64((__mmask8) (0xFF << (9 - L)), _mm512_sub_epi64(_mm512_set1_epi64(8), lane), lanes);
+    high = _mm512_sllv_epi64(high, _mm512_sub_epi64(_mm512_set1_epi64(8), lane));
+    low = _mm512_srlv_epi64(low, _mm512_add_epi64(lane, _mm512_set1_epi64(55)));
+    return _mm512_or_si512(high, low);
+}
+
+// The reverse, the top L limbs of the window x as L padded lanes: avxmpfr_pack_lanes8() of a value in a register
+static inline __m512i avxmpfr_window_to_lanes8(__m512i x, int L)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    __m512i high = _mm512_maskz_permutexvar_epi64((__mmask8) ((1 << L) - 1), _mm512_sub_epi64(_mm512_set1_epi64(7), lane), x);
+    __m512i low = _mm512_maskz_permutexvar_epi64((__mmask8) ((1 << L) - 2), _mm512_sub_epi64(_mm512_set1_epi64(8), lane), x);
+    high = _mm512_srlv_epi64(high, _mm512_add_epi64(lane, _mm512_set1_epi64(1)));
+    low = _mm512_sllv_epi64(low, _mm512_sub_epi64(_mm512_set1_epi64(63), lane));
+    return _mm512_and_si512(_mm512_or_si512(high, low), _mm512_set1_epi64(AVXMPFR_PAD_MASK));
+}
+
+// One block of 8 full limbs, r = a +- b +- carry, with the mask carry lookahead described in avxmpn.c. Bit k of the
+// result is the carry (borrow) into lane k, bit 8 the carry out. Shared by avxmpn.c and avxmpfr_blas.c
+static inline unsigned avxmpn_block_aors(__m512i a, __m512i b, unsigned carry, __m512i *r, const int subtract)
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+    __m512i sum;
+    unsigned generate, propagate;
+
+    if (subtract)
+    {
+	sum = _mm512_sub_epi64(a, b);
+	generate = _mm512_cmplt_epu64_mask(a, b);
+	propagate = _mm512_cmpeq_epi64_mask(sum, _mm512_setzero_si512());
+    }
+    else
+    {
+	sum = _mm512_add_epi64(a, b);
+	generate = _mm512_cmplt_epu64_mask(sum, a);
+	propagate = _mm512_cmpeq_epi64_mask(sum, ones);
+    }
+
+    // A lane cannot both generate and propagate, so X + P never carries past bit 8
+    const unsigned lookahead = ((generate << 1) | carry) + propagate;
+    const __mmask8 take = (__mmask8) (lookahead ^ propagate);
+
+    // Adding or subtracting one is subtracting or adding all ones
+    *r = subtract ? _mm512_mask_add_epi64(sum, take, sum, ones) : _mm512_mask_sub_epi64(sum, take, sum, ones);
+    return lookahead ^ propagate;
+}
+
+// avxmpfr_pack_lanes() of the regular number op, of op_limbs limbs, into L <= 64 lanes shifted right by gap bits, in
+// the (L + 7) / 8 registers of out (lane k in element k % 8 of out[k / 8], the lanes past L zero). Returns 1 if any set
+// bit fell off the last lane. Lane k is packed lane k - q shifted by r (gap = 63 q + r): the limbs are read 8 at a
+// time with a masked load and reversed with a permute, the bits moving between lanes are taken with valignq
+static inline int avxmpfr_pack_shifted(__m512i *out, int L, const mpfr_t op, mp_size_t op_limbs, int64_t gap)
+{
+    const int V = (L + 7) / 8;
+    if (gap >= 63 * (int64_t) L)
+    {
+	for (int v = 0; v < V; v++)
+	    out[v] = _mm512_setzero_si512();
+	return 1;
+    }
+
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i mask = _mm512_set1_epi64(AVXMPFR_PAD_MASK);
+    const mp_limb_t *d = op->_mpfr_d;
+    const int q = gap / 63;
+    const int r = gap % 63;
+
+    __m512i previous = _mm512_setzero_si512();		// Limbs of the register before, for lane k - 1
+    __m512i previous_packed = _mm512_setzero_si512();	// Lanes of the register before, before the shift by r
+    for (int v = 0; v < V; v++)
+    {
+	// Element e takes limb op_limbs - 1 - j of op, j = 8 v + e - q, when 0 <= j < op_limbs and the lane exists
+	const __mmask8 exists = (__mmask8) (L - 8 * v >= 8 ? 0xFF : (1 << (L - 8 * v)) - 1);
+	const __m512i j = _mm512_add_epi64(lane, _mm512_set1_epi64(8 * v - q));
+	const __mmask8 valid = _mm512_cmpge_epi64_mask(j, _mm512_setzero_si512())
+			       & _mm512_cmplt_epi64_mask(j, _mm512_set1_epi64(op_limbs)) & exists;
+	const mp_size_t base = op_limbs - 8 - 8 * v + q;
+	const mp_size_t first = base < 0 ? 0 : base;
+	const __mmask8 in_op = first >= op_limbs ? 0 : (__mmask8) (op_limbs - first >= 8 ? 0xFF : (1 << (op_limbs - first)) - 1);
+	const __m512i loaded = _mm512_maskz_loadu_epi64(in_op, d + (first < op_limbs ? first : 0));
+	const __m512i high = _mm512_maskz_permutexvar_epi64(valid, _mm512_sub_epi64(_mm512_set1_epi64(base - first + 7), lane), loaded);
+	const __m512i low = _mm512_alignr_epi64(high, previous, 7);
+	previous = high;
+
+	// Packed lane j, then the shift by r across the lanes
+	__m512i packed = _mm512_or_si512(_mm512_srlv_epi64(high, _mm512_add_epi64(j, _mm512_set1_epi64(1))),
+					 _mm512_sllv_epi64(low, _mm512_sub_epi64(_mm512_set1_epi64(63), j)));
+	packed = _mm512_maskz_and_epi64(exists, packed, mask);
+	out[v] = _mm512_and_si512(_mm512_or_si512(_mm512_srl_epi64(packed, _mm_cvtsi32_si128(r)),
+						  _mm512_sll_epi64(_mm512_alignr_epi64(packed, previous_packed, 7), _mm_cvtsi32_si128(63 - r))),
+				  mask);
+	previous_packed = packed;
+    }
+
+    // The bits of op from 63 L - gap on, counting from its leading bit, did not fit
+    const int64_t kept = 63 * (int64_t) L - gap;
+    if (kept >= GMP_NUMB_BITS * (int64_t) op_limbs)
+	return 0;
+    mp_size_t i = op_limbs - 1 - kept / GMP_NUMB_BITS;
+    if (d[i] << (kept % GMP_NUMB_BITS))
+	return 1;
+    while (i > 0)
+    {
+	if (d[--i])
+	    return 1;
+    }
+    return 0;
+}
+#endif
+
+// Shift a padded 252 bit number right by gap bits, dropping what falls off the least significant lane
+static inline __m256i avxmpfr_shift_padded252(__m256i x, int64_t gap)
+{
+    if (gap >= 4 * 63)
+	return _mm256_setzero_si256();
+
+    const int q = gap / 63;
+    const int r = gap % 63;
+
+    // Move whole lanes towards the least significant end (lane 3), 32 bit halves at a time
+    static const int32_t lane_index[5][8] = {
+	{0, 1, 2, 3, 4, 5, 6, 7},
+	{0, 0, 0, 1, 2, 3, 4, 5},
+	{0, 0, 0, 0, 0, 1, 2, 3},
+	{0, 0, 0, 0, 0, 0, 0, 1},
+	{0, 0, 0, 0, 0, 0, 0, 0}};
+    static const int64_t lane_keep[5][4] = {
+	{-1, -1, -1, -1},
+	{0, -1, -1, -1},
+	{0, 0, -1, -1},
+	{0, 0, 0, -1},
+	{0, 0, 0, 0}};
+
+    __m256i whole = _mm256_and_si256(_mm256_permutevar8x32_epi32(x, _mm256_loadu_si256((const __m256i *) lane_index[q])),
+				     _mm256_loadu_si256((const __m256i *) lane_keep[q]));
+    if (r == 0)
+	return whole;
+
+    // The bits leaving each lane land at the top of the next lane
+    __m256i next = _mm256_and_si256(_mm256_permutevar8x32_epi32(x, _mm256_loadu_si256((const __m256i *) lane_index[q + 1])),
+				    _mm256_loadu_si256((const __m256i *) lane_keep[q + 1]));
+    __m256i low = _mm256_srl_epi64(whole, _mm_cvtsi32_si128(r));
+    __m256i high = _mm256_sll_epi64(next, _mm_cvtsi32_si128(63 - r));
+    return _mm256_and_si256(_mm256_or_si256(low, high), _mm256_set1_epi64x(AVXMPFR_PAD_MASK));
+}
+
+#ifdef __AVX512F__	// Not in avxmpfr_kernels_avx2.o
+// Shift a padded 504 bit number right by gap bits
+static inline __m512i avxmpfr_shift_padded504(__m512i x, int64_t gap)
+{
+    if (gap >= 8 * 63)
+	return _mm512_setzero_si512();
+
+    const int q = gap / 63;
+    const int r = gap % 63;
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+
+    // Lane k takes lane k - q, lanes below q become zero
+    __m512i whole = _mm512_maskz_permutexvar_epi64((__mmask8) (0xFF << q), _mm512_sub_epi64(lane, _mm512_set1_epi64(q)), x);
+    if (r == 0)
+	return whole;
+
+    __m512i next = _mm512_maskz_permutexvar_epi64((__mmask8) (0xFF << (q + 1)), _mm512_sub_epi64(lane, _mm512_set1_epi64(q + 1)), x);
+    __m512i low = _mm512_srl_epi64(whole, _mm_cvtsi32_si128(r));
+    __m512i high = _mm512_sll_epi64(next, _mm_cvtsi32_si128(63 - r));
+    return _mm512_and_si512(_mm512_or_si512(low, high), _mm512_set1_epi64(AVXMPFR_PAD_MASK));
+}
+#endif
+
+
+// Memory mapped files of packed arrays, see avxmpfr_file.c
+typedef struct
+{
+    int fd;
+    void *map;
+    size_t map_size;
+    avxmpfr_array array;	// Zero-copy view of the values in the file
+} avxmpfr_file;
+
+typedef struct
+{
+    int fd;
+    uint16_t precision;
+    uint32_t layout;
+    uint64_t count;		// Values written so far
+} avxmpfr_writer;
+
 
 
+// Kernels specialised for every padded limb count, see avxmpfr_kernels.c
+#define AVXMPFR_ISA_AVX2 0
+#define AVXMPFR_ISA_AVX512 1
+#define AVXMPFR_KERNEL_MIN_LIMBS 2
+#define AVXMPFR_KERNEL_MAX_LIMBS 64
+#define AVXMPFR_KERNEL_FAST_MIN_LIMBS 8	// The sizes where the AVX512 kernels beat mpfr_add(), the only ones
+#define AVXMPFR_KERNEL_FAST_MAX_LIMBS 8	// avxmpfr_add_prec() uses
+
+typedef void (*avxmpfr_kernel)(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+
+// Interleaved additions of a few independent pairs, see avxmpfr_multi.c
+#define AVXMPFR_MULTI_MAX 4
+
+// Asynchronous submission, see avxmpfr_queue.c
+typedef struct
+{
+    mpfr_ptr rop;
+    mpfr_ptr op1;
+    mpfr_ptr op2;
+    mpfr_rnd_t rnd;
+    int negate;			// 1 for a subtraction
+    AVXMPFR_ATOMIC int done;	// Set by the worker once rop holds the result
+} avxmpfr_request;
+
+typedef struct
+{
+    int workers;		// Worker threads, each with a ring of its own
+    size_t ring_size;		// Requests each ring can hold
+    size_t flush_size;		// Flush a batch once it holds this many requests ...
+    uint64_t flush_deadline_ns;	// ... or once its oldest request has waited this long
+} avxmpfr_queue_config;
+
+typedef struct avxmpfr_queue avxmpfr_queue;
+
+// Monotonic wall clock time in nanoseconds, for the flush deadlines of the queue and for measuring latencies
+static inline uint64_t avxmpfr_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Lazily normalised accumulators, see avxmpfr_lazy.c
+#define AVXMPFR_LAZY_LANES 16		// Padded lanes for precisions up to PRECISION_512, 8 up to PRECISION_256
+#define AVXMPFR_LAZY_MAX_OPS ((uint64_t) 1 << 61)	// Additions before the carry counters have to be resolved
+
+typedef struct
+{
+    mpfr_prec_t precision;
+    int lanes;			// 8 or 16: a headroom lane, the value, then guard lanes
+    int sign;			// Sign of the value the lanes add up to, 0 while nothing has been added
+    int special;		// Sum of the NaNs and infinities added: 0 none, 1 +Inf, -1 -Inf, 2 NaN
+    int sticky;			// Bits below the last lane were dropped
+    mpfr_exp_t exp;		// Exponent of the top of lane 0
+    uint64_t ops;		// Additions since the carries were last resolved
+    uint64_t digits[AVXMPFR_LAZY_LANES] __attribute__((aligned(64)));	// Below 2^63 between additions
+    int64_t carries[AVXMPFR_LAZY_LANES] __attribute__((aligned(64)));	// Carries out of each lane, owed to the lane above
+} avxmpfr_lazy;
+
+// Intervals [left, right] with mpfr endpoints, laid out like MPFI's mpfi_t, see avxmpfi.c
+#define AVXMPFI_PREC_MIN 193		// Narrower intervals are faster with two mpfr calls, see avxmpfi.c
+#define AVXMPFI_PREC_MAX 448		// Widest precision of the one pass kernel, 7 limbs and a guard limb
+
+typedef struct
+{
+    __mpfr_struct left;
+    __mpfr_struct right;
+} avxmpfi_struct;
+
+typedef avxmpfi_struct avxmpfi_t[1];
+typedef avxmpfi_struct *avxmpfi_ptr;
+typedef const avxmpfi_struct *avxmpfi_srcptr;
+
+// Level 1 and 2 BLAS over packed arrays, see avxmpfr_blas.c
+#define AVXMPFR_BLAS_PANEL 256		// Columns of x unpacked at a time by avxmpfr_gemv()
+#define AVXMPFR_BLAS_ROWS 64		// Rows of A sharing an unpacked panel of x
+#define AVXMPFR_BLAS_MAX_LIMBS 8192	// Widest exact accumulator, wider exponent spans go through mpfr_sum()
+#define AVXMPFR_BLAS_THREAD_MIN 4096	// Values each thread needs before a call is split
+#define AVXMPFR_BLAS_SCAN_THREAD_MIN 32768	// Values each thread of a scan needs, its parts read the array 2 - 3 times
+
+// Counter based random numbers, see avxmpfr_random.c
+#define AVXMPFR_RANDOM_UNIFORM 0	// k / 2^prec in [0, 1), like mpfr_urandomb()
+#define AVXMPFR_RANDOM_EXPONENTS 1	// Full significands, either sign, exponents uniform in [low, high)
+
+typedef struct
+{
+    uint64_t seed;
+    uint64_t stream;		// One per thread drawing from the same seed
+    uint64_t counter;		// Next Philox block of the stream
+} avxmpfr_random;
+
+// Hot path instrumentation, see avxmpfr_stats.c. Compiled in with -DAVXMPFR_INSTRUMENT (make INSTRUMENT=1)
+#define AVXMPFR_STAGE_ALIGN 0		// avxmpfr_exp_allign()
+#define AVXMPFR_STAGE_PAD 1		// Padding both operands
+#define AVXMPFR_STAGE_ADD 2		// Loading the lanes, avx_add() and storing the result
+#define AVXMPFR_STAGE_NORMALISE 3	// Normalisation inside avx_add(), part of AVXMPFR_STAGE_ADD
+#define AVXMPFR_STAGE_UNPAD 4		// Unpadding the result
+#define AVXMPFR_STAGE_TOTAL 5		// The whole of avxmpfr_add()
+#define AVXMPFR_STAGES 6
+#define AVXMPFR_CARRY_BUCKETS 16	// Carry loop iterations 0 .. 14, then 15 or more
+#define AVXMPFR_GAP_BUCKETS 12		// Exponent gap 0, [2^(k-1), 2^k) for k = 1 .. 10, then 1024 or more
+
+typedef struct avxmpfr_stats
+{
+    uint64_t stage_cycles[AVXMPFR_STAGES];	// rdtsc cycles spent in each stage
+    uint64_t stage_calls[AVXMPFR_STAGES];
+    uint64_t kernel_calls;			// avx_add() and avx_add_512i() calls
+    uint64_t carry_iterations[AVXMPFR_CARRY_BUCKETS];
+    uint64_t normalisations;
+    uint64_t gaps[AVXMPFR_GAP_BUCKETS];
+    uint64_t batched;				// Values summed by avxmpfr_add_array()
+    uint64_t fallbacks;				// ... of which went through mpfr_add()
+    struct avxmpfr_stats *next;			// Registry of all threads, never freed
+} avxmpfr_stats;
+
+#ifdef AVXMPFR_INSTRUMENT
+extern __thread avxmpfr_stats *avxmpfr_thread_stats;
+avxmpfr_stats *avxmpfr_stats_register(void);
+
+// Counters of the calling thread, registered on first use
+static inline avxmpfr_stats *avxmpfr_stats_local(void)
+{
+    return avxmpfr_thread_stats ? avxmpfr_thread_stats : avxmpfr_stats_register();
+}
+
+static inline void avxmpfr_stats_gap(uint64_t gap)
+{
+    int bucket = gap == 0 ? 0 : 64 - __builtin_clzll(gap);
+    avxmpfr_stats_local()->gaps[bucket < AVXMPFR_GAP_BUCKETS ? bucket : AVXMPFR_GAP_BUCKETS - 1]++;
+}
+
+static inline void avxmpfr_stats_carry(int iterations)
+{
+    avxmpfr_stats *stats = avxmpfr_stats_local();
+    stats->kernel_calls++;
+    stats->carry_iterations[iterations < AVXMPFR_CARRY_BUCKETS ? iterations : AVXMPFR_CARRY_BUCKETS - 1]++;
+}
+
+#define AVXMPFR_STATS_ONLY(code) code
+#define AVXMPFR_TIMER_START(timer) const uint64_t timer = __rdtsc()
+#define AVXMPFR_TIMER_STOP(timer, stage) \
+    do { avxmpfr_stats *stats_ = avxmpfr_stats_local(); \
+	 stats_->stage_cycles[stage] += __rdtsc() - (timer); stats_->stage_calls[stage]++; } while (0)
+#define AVXMPFR_COUNT(counter, n) (avxmpfr_stats_local()->counter += (n))
+#define AVXMPFR_COUNT_GAP(gap) avxmpfr_stats_gap(gap)
+#define AVXMPFR_COUNT_CARRY(iterations) avxmpfr_stats_carry(iterations)
+#else
+// Everything compiles away
+#define AVXMPFR_STATS_ONLY(code)
+#define AVXMPFR_TIMER_START(timer)
+#define AVXMPFR_TIMER_STOP(timer, stage) ((void) 0)
+#define AVXMPFR_COUNT(counter, n) ((void) 0)
+#define AVXMPFR_COUNT_GAP(gap) ((void) 0)
+#define AVXMPFR_COUNT_CARRY(iterations) ((void) 0)
+#endif
+
 // Now to define all the functions
 void print_binary(const mp_limb_t *limbs, mpfr_prec_t precision);
 void hexdump_m256i(const __m256i values, const char* name);
@@ -43,4 +514,116 @@ mp_limb_t* avxmpfr_unpad504(mpfr_t mpfrNumber);
 
 void avxmpfr_add(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const uint16_t PRECISION);
 void avxmpfr_add_512(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, const uint16_t PRECISION);
+void avxmpfr_add_prec(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+void avxmpfr_add_scalar_vec(mpfr_t *rop, mpfr_t *op, mpfr_t c, size_t n, mpfr_rnd_t rnd, const uint16_t PRECISION);
+int avxmpfr_add_mixed(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+int avxmpfr_sub_mixed(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+void avxmpfr_add_128(mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+void avxmpfr_add_128_vec(mpfr_t *rop, mpfr_t *op1, mpfr_t *op2, size_t n, mpfr_rnd_t rnd);
+void avxmpfr_add_ptr_vec(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t n, mpfr_rnd_t rnd, const uint16_t PRECISION);
+int avxmpfr_add_multi(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, int count, mpfr_rnd_t rnd, const uint16_t PRECISION);
+
+// Rounding of raw limbs into mpfr_t variables
+int avxmpfr_round_up_p(int sign, int lsb, int round_bit, int sticky, mpfr_rnd_t rnd);
+int avxmpfr_round_limbs(mpfr_t rop, int sign, const mp_limb_t *src, mp_size_t n, mpfr_exp_t exp, mpfr_rnd_t rnd);
+
+// Batched string conversion
+void avxmpfr_set_str_vec(mpfr_t *rop, const char *const *str, size_t n, int base, mpfr_rnd_t rnd);
+void avxmpfr_get_str_vec(char **str, size_t n_digits, int base, mpfr_t *op, size_t n, mpfr_rnd_t rnd);
+size_t avxmpfr_get_str_size(size_t n_digits);
+
+// Packed arrays
+int avxmpfr_array_init(avxmpfr_array *array, uint16_t precision, uint32_t layout, uint64_t count);
+void avxmpfr_array_clear(avxmpfr_array *array);
+void avxmpfr_array_view(avxmpfr_array *view, const avxmpfr_array *array, uint64_t first, uint64_t count);
+int avxmpfr_array_set(avxmpfr_array *array, uint64_t index, mpfr_t op);
+void avxmpfr_array_get(mpfr_t rop, const avxmpfr_array *array, uint64_t index, mpfr_rnd_t rnd);
+void avxmpfr_add_array(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2);
+void avxmpfr_add_array_bucketed(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2);
+
+// Comparison and sorting of packed arrays
+void avxmpfr_cmp_vec(int8_t *result, const avxmpfr_array *op1, const avxmpfr_array *op2);
+void avxmpfr_min_vec(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2);
+void avxmpfr_max_vec(avxmpfr_array *rop, const avxmpfr_array *op1, const avxmpfr_array *op2);
+int avxmpfr_sort_array(avxmpfr_array *array, int unique);
+
+// Packed array files
+int avxmpfr_file_open(avxmpfr_file *file, const char *path);
+void avxmpfr_file_close(avxmpfr_file *file);
+int avxmpfr_writer_open(avxmpfr_writer *writer, const char *path, uint16_t precision, uint32_t layout);
+int avxmpfr_writer_append(avxmpfr_writer *writer, const avxmpfr_array *array);
+int avxmpfr_writer_close(avxmpfr_writer *writer);
+
+// Instrumentation, these still exist (and report nothing) when it is compiled out
+int avxmpfr_stats_collect(avxmpfr_stats *total);
+void avxmpfr_stats_reset(void);
+void avxmpfr_stats_dump(FILE *stream);
+
+// Specialised kernel registry
+int avxmpfr_kernel_best_isa(void);
+avxmpfr_kernel avxmpfr_kernel_lookup(mpfr_prec_t precision, int isa);
+
+// Asynchronous submission queue
+void avxmpfr_queue_config_init(avxmpfr_queue_config *config);
+avxmpfr_queue *avxmpfr_queue_create(const avxmpfr_queue_config *config);
+void avxmpfr_queue_destroy(avxmpfr_queue *queue);
+void avxmpfr_add_async(avxmpfr_queue *queue, avxmpfr_request *request, mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+void avxmpfr_sub_async(avxmpfr_queue *queue, avxmpfr_request *request, mpfr_t rop, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd);
+int avxmpfr_request_done(avxmpfr_request *request);
+void avxmpfr_request_wait(avxmpfr_request *request);
+
+// Lazily normalised accumulators
+int avxmpfr_lazy_init(avxmpfr_lazy *acc, mpfr_prec_t precision);
+void avxmpfr_lazy_set(avxmpfr_lazy *acc, const mpfr_t op);
+void avxmpfr_lazy_add(avxmpfr_lazy *acc, const mpfr_t op);
+void avxmpfr_lazy_sub(avxmpfr_lazy *acc, const mpfr_t op);
+void avxmpfr_lazy_normalise(avxmpfr_lazy *acc);
+int avxmpfr_lazy_get(mpfr_t rop, const avxmpfr_lazy *acc, mpfr_rnd_t rnd);
+
+// Interval arithmetic, both endpoints in one pass
+void avxmpfi_init2(avxmpfi_t x, mpfr_prec_t precision);
+void avxmpfi_clear(avxmpfi_t x);
+int avxmpfi_add(avxmpfi_ptr rop, avxmpfi_srcptr op1, avxmpfi_srcptr op2);
+int avxmpfi_sub(avxmpfi_ptr rop, avxmpfi_srcptr op1, avxmpfi_srcptr op2);
+
+// Natural numbers, GMP signatures
+mp_limb_t avxmpn_add_n(mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, mp_size_t n);
+mp_limb_t avxmpn_sub_n(mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, mp_size_t n);
+
+// Level 1 and 2 BLAS and prefix sums, reductions rounded once
+void avxmpfr_blas_set_threads(int threads);
+int avxmpfr_dot(mpfr_t rop, const avxmpfr_array *x, const avxmpfr_array *y, mpfr_rnd_t rnd);
+int avxmpfr_asum(mpfr_t rop, const avxmpfr_array *x, mpfr_rnd_t rnd);
+int avxmpfr_nrm2(mpfr_t rop, const avxmpfr_array *x, mpfr_rnd_t rnd);
+int avxmpfr_scal(avxmpfr_array *x, mpfr_t alpha, mpfr_rnd_t rnd);
+int avxmpfr_axpy(avxmpfr_array *y, mpfr_t alpha, const avxmpfr_array *x, mpfr_rnd_t rnd);
+int avxmpfr_gemv(avxmpfr_array *y, mpfr_t alpha, const avxmpfr_array *A, uint64_t rows, uint64_t columns,
+		 const avxmpfr_array *x, mpfr_t beta, mpfr_rnd_t rnd);
+int avxmpfr_inclusive_scan(avxmpfr_array *rop, const avxmpfr_array *x, mpfr_rnd_t rnd, int exact);
+int avxmpfr_exclusive_scan(avxmpfr_array *rop, const avxmpfr_array *x, mpfr_rnd_t rnd, int exact);
+
+// Batched elementary functions up to PRECISION_512, correctly rounded
+void avxmpfr_exp_vec(mpfr_t *rop, mpfr_t *op, size_t n, mpfr_rnd_t rnd);
+void avxmpfr_log_vec(mpfr_t *rop, mpfr_t *op, size_t n, mpfr_rnd_t rnd);
+void avxmpfr_sincos_vec(mpfr_t *sop, mpfr_t *cop, mpfr_t *op, size_t n, mpfr_rnd_t rnd);
+
+// Batched polynomial evaluation up to PRECISION_512, eight points per pass
+#define AVXMPFR_POLY_AUTO 0		// Whichever measures faster, Horner's rule on AVX512
+#define AVXMPFR_POLY_HORNER 1
+#define AVXMPFR_POLY_ESTRIN 2
+void avxmpfr_poly_set_scheme(int scheme);
+void avxmpfr_poly_eval_vec(mpfr_t *rop, mpfr_t *coeffs, size_t degree, mpfr_t *x, size_t n, mpfr_rnd_t rnd);
+
+// Bulk random numbers in limb form
+void avxmpfr_random_init(avxmpfr_random *state, uint64_t seed, uint64_t stream);
+int avxmpfr_urandom_vec(mpfr_t *rop, size_t n, avxmpfr_random *state, int distribution, mpfr_exp_t low, mpfr_exp_t high);
+
+// mpfr_add() / mpfr_sub() interposition, see avxmpfr_shim.c
+void avxmpfr_shim_take_over(int enable);
+void avxmpfr_shim_stats(uint64_t *calls, uint64_t *hits);
+void avxmpfr_shim_report(FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif
 #endif // AVXMPFR_UTILITIES_H
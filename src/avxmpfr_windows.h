@@ -0,0 +1,323 @@
+// avxmpfr_windows.h
+
+/*
+    Windows of full 64 bit limbs in AVX512 registers, for exactly rounded additions and subtractions of a few numbers
+    at once. A register holds 8 / H parts of H lanes each (H = 4 or 8), and every part is the addition of two
+    operands that the steps below treat on their own:
+	windows_prepare()	lines the operands up, the one with the smaller exponent shifted down with lane
+				permutes and variable shifts that stay within the part, noting whether nonzero bits
+				fell off
+	windows_aors()		adds or subtracts with a carry lookahead per part, a difference being a sum with the
+				subtracted part complemented and a carry in of one, and normalises
+	windows_round()		rounds every part in its own rounding mode
+    A window has to hold at least two bits more than the precision. Bits of the shifted operand that fall off it can
+    then only matter as sticky bits, and when they belong to the operand being subtracted the window is decremented
+    first (R - f lies between R - 1 and R).
+*/
+
+#ifndef AVXMPFR_WINDOWS_H
+#define AVXMPFR_WINDOWS_H
+
+#include "avxmpfr_utilities.h"
+
+/* Windows, 8 / H parts of H lanes in a register, part k in lanes k H .. k H + H - 1 */
+
+typedef struct
+{
+    mpfr_exp_t exp[2];	// Exponent of the operand at the top of the window, then of the result
+    int sign[2];	// Sign of the operand at the top, then of the result
+    int other_sign[2];	// Sign of the shifted operand
+    unsigned lost;	// Bit k set if nonzero bits of the shifted operand of part k fell below the window
+    unsigned zero;	// Bit k set if the operands of part k cancelled exactly
+} windows;
+
+// Carry lookahead over the lanes of a part, bit k of the result is the carry into lane k and bit H the carry out
+static inline unsigned lookahead(unsigned generate, unsigned propagate, unsigned carry)
+{
+    return (((generate << 1) | carry) + propagate) ^ propagate;
+}
+
+// The same in every part, bit k of carry into part k. Bits 0 .. 7 of the result are the lanes taking a carry, bit
+// 8 + k the carry out of part k
+static inline unsigned part_lookahead(const int H, unsigned generate, unsigned propagate, unsigned carry)
+{
+    if (H == 8)
+	return lookahead(generate, propagate, carry & 1);
+
+    const unsigned low = lookahead(generate & 0x0F, propagate & 0x0F, carry & 1);
+    const unsigned high = lookahead(generate >> 4, propagate >> 4, carry >> 1);
+    return (low & 0x0F) | ((high & 0x0F) << 4) | ((low >> 4) << 8) | ((high >> 4) << 9);
+}
+
+// Lanes of the parts in bitmask parts
+static inline __mmask8 part_mask(const int H, unsigned parts)
+{
+    if (H == 8)
+	return parts & 1 ? 0xFF : 0;
+    return (__mmask8) ((parts & 1 ? 0x0F : 0) | (parts & 2 ? 0xF0 : 0));
+}
+
+// Bit k set if any lane of part k is set in lanes
+static inline unsigned part_any(const int H, unsigned lanes)
+{
+    if (H == 8)
+	return (lanes & 0xFF) != 0;
+    return ((lanes & 0x0F) != 0) | (((lanes & 0xF0) != 0) << 1);
+}
+
+// Lowest and highest lane of every part
+static inline __mmask8 part_bottom(const int H)
+{
+    return H == 8 ? 0x01 : 0x11;
+}
+
+static inline __mmask8 part_top(const int H)
+{
+    return H == 8 ? 0x80 : 0x88;
+}
+
+// v[k] in the lanes of part k
+static inline __m512i part_broadcast(const int H, const int64_t *v)
+{
+    if (H == 8)
+	return _mm512_set1_epi64(v[0]);
+    return _mm512_mask_blend_epi64(0xF0, _mm512_set1_epi64(v[0]), _mm512_set1_epi64(v[1]));
+}
+
+static inline uint64_t lane_value(__m512i x, int k)
+{
+    return (uint64_t) _mm_cvtsi128_si64(_mm512_castsi512_si128(_mm512_maskz_compress_epi64((__mmask8) (1 << k), x)));
+}
+
+// Every part of x times 2^(64 * lanes + bits), lanes and bits (in [0, 64)) given per lane, nothing crosses parts
+static inline __m512i part_shift(const int H, __m512i x, __m512i lanes, __m512i bits)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i first = _mm512_and_si512(lane, _mm512_set1_epi64(8 - H));
+    const __m512i index = _mm512_sub_epi64(lane, lanes);
+    const __m512i below = _mm512_sub_epi64(index, _mm512_set1_epi64(1));
+    const __m512i size = _mm512_set1_epi64(H);
+
+    // Lane j takes lane j - lanes and the top bits of the lane under it, if they are in the same part
+    const __m512i whole = _mm512_maskz_permutexvar_epi64(_mm512_cmplt_epu64_mask(_mm512_sub_epi64(index, first), size),
+							  index, x);
+    const __m512i next = _mm512_maskz_permutexvar_epi64(_mm512_cmplt_epu64_mask(_mm512_sub_epi64(below, first), size),
+							 below, x);
+    return _mm512_or_si512(_mm512_sllv_epi64(whole, bits),
+			   _mm512_srlv_epi64(next, _mm512_sub_epi64(_mm512_set1_epi64(64), bits)));
+}
+
+// Lanes of x with a bit set below bit number pos of their part, pos given per lane and at most 64 H
+static inline unsigned part_below(const int H, __m512i x, __m512i pos)
+{
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i in_part = _mm512_and_si512(lane, _mm512_set1_epi64(H - 1));
+    const __m512i limb = _mm512_srli_epi64(pos, 6);
+    const __m512i partial = _mm512_sub_epi64(_mm512_sllv_epi64(_mm512_set1_epi64(1),
+								_mm512_and_si512(pos, _mm512_set1_epi64(63))),
+					     _mm512_set1_epi64(1));
+
+    __m512i below = _mm512_maskz_mov_epi64(_mm512_cmplt_epi64_mask(in_part, limb), _mm512_set1_epi64(-1));
+    below = _mm512_mask_mov_epi64(below, _mm512_cmpeq_epi64_mask(in_part, limb), partial);
+    return _mm512_test_epi64_mask(x, below);
+}
+
+// Line the parts of x + y up in the windows a and b, in every part the operand with the bigger exponent on top
+static inline void windows_prepare(const int H, windows *w, __m512i *a, __m512i *b, __m512i x, const mpfr_exp_t *ex,
+				   const int *sx, __m512i y, const mpfr_exp_t *ey, const int *sy)
+{
+    unsigned swap = 0;
+    int64_t gap[2], lanes[2], bits[2];
+    for (int k = 0; k < 8 / H; k++)
+    {
+	const int s = ey[k] > ex[k];
+	swap |= s << k;
+	w->exp[k] = s ? ey[k] : ex[k];
+	w->sign[k] = s ? sy[k] : sx[k];
+	w->other_sign[k] = s ? sx[k] : sy[k];
+
+	// Shifting down by 64 q + r bits is shifting up by 64 (-q - 1) + 64 - r
+	const mpfr_exp_t d = s ? ey[k] - ex[k] : ex[k] - ey[k];
+	gap[k] = d < 64 * H ? d : 64 * H;
+	lanes[k] = gap[k] % 64 == 0 ? -(gap[k] / 64) : -(gap[k] / 64) - 1;
+	bits[k] = gap[k] % 64 == 0 ? 0 : 64 - gap[k] % 64;
+    }
+
+    const __mmask8 swapped = part_mask(H, swap);
+    const __m512i bottom = _mm512_mask_blend_epi64(swapped, y, x);
+    w->lost = part_any(H, part_below(H, bottom, part_broadcast(H, gap)));
+    w->zero = 0;
+
+    *a = _mm512_mask_blend_epi64(swapped, x, y);
+    *b = part_shift(H, bottom, part_broadcast(H, lanes), part_broadcast(H, bits));
+}
+
+// Add or subtract the windows of every part and normalise, the top bit ending at the top of the part
+static inline __m512i windows_aors(const int H, windows *w, __m512i a, __m512i b)
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+    const unsigned parts = (1u << (8 / H)) - 1;
+    unsigned subtract = 0;
+    for (int k = 0; k < 8 / H; k++)
+	subtract |= (w->sign[k] != w->other_sign[k]) << k;
+
+    const __m512i sum = _mm512_add_epi64(a, _mm512_mask_xor_epi64(b, part_mask(H, subtract), b, ones));
+    unsigned take = part_lookahead(H, _mm512_cmplt_epu64_mask(sum, a), _mm512_cmpeq_epi64_mask(sum, ones), subtract);
+    __m512i x = _mm512_mask_sub_epi64(sum, (__mmask8) take, sum, ones);
+    const unsigned carry = take >> 8;
+
+    // One bit too many, the bit shifted out only matters as sticky
+    const unsigned overflow = ~subtract & carry & parts;
+    if (overflow)
+    {
+	w->lost |= overflow & part_any(H, _mm512_test_epi64_mask(x, _mm512_set1_epi64(1)) & part_bottom(H));
+	int64_t lanes[2], bits[2];
+	for (int k = 0; k < 8 / H; k++)
+	{
+	    const int shift = (overflow >> k) & 1;
+	    w->exp[k] += shift;
+	    lanes[k] = -shift;
+	    bits[k] = shift ? 63 : 0;
+	}
+	x = part_shift(H, x, part_broadcast(H, lanes), part_broadcast(H, bits));
+	x = _mm512_mask_or_epi64(x, part_mask(H, overflow) & part_top(H), x, _mm512_set1_epi64((uint64_t) 1 << 63));
+    }
+
+    // The shifted operand was the bigger one, negate. That needs a gap of 0, so nothing was lost
+    const unsigned negate = subtract & ~carry & parts;
+    if (negate)
+    {
+	x = _mm512_mask_xor_epi64(x, part_mask(H, negate), x, ones);
+	take = part_lookahead(H, 0, _mm512_cmpeq_epi64_mask(x, ones), negate);
+	x = _mm512_mask_sub_epi64(x, (__mmask8) take, x, ones);
+	for (int k = 0; k < 8 / H; k++)
+	    w->sign[k] = (negate >> k) & 1 ? w->other_sign[k] : w->sign[k];
+    }
+
+    const unsigned decrement = subtract & carry & w->lost;
+    if (decrement)
+    {
+	take = part_lookahead(H, 0, _mm512_cmpeq_epi64_mask(x, _mm512_setzero_si512()), decrement);
+	x = _mm512_mask_add_epi64(x, (__mmask8) take, x, ones);
+    }
+
+    // After a cancellation the top bit can be anywhere
+    const unsigned normal = part_any(H, _mm512_test_epi64_mask(x, _mm512_set1_epi64((uint64_t) 1 << 63)) & part_top(H));
+    if (normal != parts)
+    {
+	const __mmask8 nonzero = _mm512_test_epi64_mask(x, x);
+	int64_t lanes[2] = {0, 0}, bits[2] = {0, 0};
+	for (int k = 0; k < 8 / H; k++)
+	{
+	    const unsigned part = (nonzero >> (k * H)) & ((1u << H) - 1);
+	    if (part == 0)
+	    {
+		w->zero |= 1u << k;
+		continue;
+	    }
+	    const int top = 31 - __builtin_clz(part);
+	    lanes[k] = H - 1 - top;
+	    bits[k] = __builtin_clzl(lane_value(x, k * H + top));
+	    w->exp[k] -= 64 * lanes[k] + bits[k];
+	}
+	x = part_shift(H, x, part_broadcast(H, lanes), part_broadcast(H, bits));
+    }
+    return x;
+}
+
+// Round every part of the normalised windows x to precision bits, part k with rnd[k], and set its ternary value
+static inline __m512i windows_round(const int H, windows *w, __m512i x, mpfr_prec_t precision, const mpfr_rnd_t *rnd,
+				    int *ternary)
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+    const __m512i lane = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i in_part = _mm512_and_si512(lane, _mm512_set1_epi64(H - 1));
+    const int pos = 64 * H - precision;		// Bit number of the last bit kept, at least 2
+
+    const __m512i last = _mm512_set1_epi64(pos / 64);
+    const __m512i ulp = _mm512_maskz_mov_epi64(_mm512_cmpeq_epi64_mask(in_part, last),
+					       _mm512_set1_epi64((uint64_t) 1 << (pos % 64)));
+    const __m512i half = _mm512_maskz_mov_epi64(_mm512_cmpeq_epi64_mask(in_part, _mm512_set1_epi64((pos - 1) / 64)),
+						_mm512_set1_epi64((uint64_t) 1 << ((pos - 1) % 64)));
+    const unsigned lsb = part_any(H, _mm512_test_epi64_mask(x, ulp));
+    const unsigned round = part_any(H, _mm512_test_epi64_mask(x, half));
+    const unsigned sticky = part_any(H, part_below(H, x, _mm512_set1_epi64(pos - 1)));
+
+    // Everything under the last bit kept goes
+    __m512i keep = _mm512_maskz_mov_epi64(_mm512_cmpgt_epi64_mask(in_part, last), ones);
+    keep = _mm512_mask_mov_epi64(keep, _mm512_cmpeq_epi64_mask(in_part, last),
+				 _mm512_set1_epi64(~((((uint64_t) 1) << (pos % 64)) - 1)));
+    x = _mm512_and_si512(x, keep);
+
+    // The decision of avxmpfr_round_up_p() for all parts at once: to nearest on the round bit unless it is a tie
+    // with an even last bit, away from zero on any bit when the mode points away from the part
+    unsigned nearest = 0, away = 0;
+    for (int k = 0; k < 8 / H; k++)
+    {
+	nearest |= (rnd[k] == MPFR_RNDN) << k;
+	away |= (rnd[k] == MPFR_RNDA || (rnd[k] == MPFR_RNDU && w->sign[k] > 0)
+		 || (rnd[k] == MPFR_RNDD && w->sign[k] < 0)) << k;
+    }
+    const unsigned inexact = round | sticky | w->lost;
+    const unsigned up = (nearest & round & (sticky | w->lost | lsb)) | (away & inexact);
+    for (int k = 0; k < 8 / H; k++)
+	ternary[k] = (inexact >> k) & 1 ? ((up >> k) & 1 ? w->sign[k] : -w->sign[k]) : 0;
+
+    if (up)
+    {
+	const __m512i sum = _mm512_add_epi64(x, _mm512_maskz_mov_epi64(part_mask(H, up), ulp));
+	const unsigned take = part_lookahead(H, _mm512_cmplt_epu64_mask(sum, x), _mm512_cmpeq_epi64_mask(sum, ones), 0);
+	x = _mm512_mask_sub_epi64(sum, (__mmask8) take, sum, ones);
+
+	// Rounded up to the next power of two
+	const unsigned carry = take >> 8;
+	if (carry)
+	{
+	    x = _mm512_mask_mov_epi64(x, part_mask(H, carry),
+				      _mm512_maskz_mov_epi64(part_top(H), _mm512_set1_epi64((uint64_t) 1 << 63)));
+	    for (int k = 0; k < 8 / H; k++)
+		w->exp[k] += (carry >> k) & 1;
+	}
+    }
+    return x;
+}
+
+// The limbs of x in the top lanes of a window of 8
+static inline __m512i window_load(mpfr_srcptr x)
+{
+    const int limbs = (mpfr_get_prec(x) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    return _mm512_maskz_expandloadu_epi64((__mmask8) (0x100 - (0x100 >> limbs)), x->_mpfr_d);
+}
+
+// The rounded window x of 8 limbs into rop
+static inline void window_store(mpfr_ptr rop, __m512i x, const windows *w, mpfr_rnd_t rnd)
+{
+    if (w->zero & 1)
+    {
+	// An exact cancellation is +0, or -0 rounding downwards
+	mpfr_set_zero(rop, rnd == MPFR_RNDD ? -1 : 1);
+	return;
+    }
+
+    const int limbs = (mpfr_get_prec(rop) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    _mm512_mask_storeu_epi64(rop->_mpfr_d, (__mmask8) ((1 << limbs) - 1),
+			     _mm512_maskz_compress_epi64((__mmask8) (0x100 - (0x100 >> limbs)), x));
+    rop->_mpfr_sign = w->sign[0];
+    rop->_mpfr_exp = w->exp[0];
+}
+
+// 1 if windows of the given lanes give the same results as mpfr for operands with exponents in [min, max], in the
+// exponent range [emin, emax]. A sum rounded up may gain two bits, a cancellation may leave only the last bit of the
+// window
+static inline int exponents_fit_in(mpfr_exp_t max, mpfr_exp_t min, int lanes, mpfr_exp_t emin, mpfr_exp_t emax)
+{
+    return max + 2 <= emax && min - 64 * lanes - 2 >= emin;
+}
+
+// The same in the current exponent range
+static inline int exponents_fit(mpfr_exp_t max, mpfr_exp_t min, int lanes)
+{
+    return exponents_fit_in(max, min, lanes, mpfr_get_emin(), mpfr_get_emax());
+}
+
+#endif
@@ -0,0 +1,58 @@
+// avxmpn.c
+
+/*
+    Addition and subtraction of GMP naturals of any length with AVX512, drop-in replacements for mpn_add_n() and
+    mpn_sub_n() with the same signatures and results.
+
+    Unlike avx_add_512i(), which adds 63 bit padded lanes and loops until no carry is left, these work on full 64 bit
+    limbs, 8 limbs (one __m512i, least significant limb in lane 0) at a time. Within a block the carries are resolved
+    with masks: a lane generates a carry if its sum wrapped around, and propagates one if its sum is all ones. With
+    the generate mask shifted up a lane plus the carry into the block as X and the propagate mask as P, the lanes that
+    take a carry are (X + P) ^ P and bit 8 of X + P is the carry out of the block, the scalar carry into the next one.
+    Subtraction works the same way with borrows, a lane propagating one if its difference is zero.
+
+    Source limbs are prefetched AVXMPN_PREFETCH limbs ahead, for the sizes that stream from memory. rp may be equal to
+    s1p or s2p, as with GMP. Returns the carry (borrow) out of the most significant limb.
+*/
+
+#include "avxmpfr_utilities.h"
+
+#define AVXMPN_PREFETCH 128	// Limbs, 16 blocks of 8
+
+static inline mp_limb_t avxmpn_aors_n(mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, mp_size_t n, const int subtract)
+{
+    unsigned carry = 0;
+    mp_size_t i = 0;
+    __m512i r;
+
+    for (; i + 8 <= n; i += 8)
+    {
+	_mm_prefetch((const char *) (s1p + i + AVXMPN_PREFETCH), _MM_HINT_T0);
+	_mm_prefetch((const char *) (s2p + i + AVXMPN_PREFETCH), _MM_HINT_T0);
+
+	carry = avxmpn_block_aors(_mm512_loadu_si512(s1p + i), _mm512_loadu_si512(s2p + i), carry, &r, subtract) >> 8;
+	_mm512_storeu_si512(rp + i, r);
+    }
+
+    // The last limbs, the carry out is the carry into the first lane past the end
+    if (i < n)
+    {
+	const int rest = n - i;
+	const __mmask8 tail = (__mmask8) ((1 << rest) - 1);
+	carry = avxmpn_block_aors(_mm512_maskz_loadu_epi64(tail, s1p + i), _mm512_maskz_loadu_epi64(tail, s2p + i),
+				  carry, &r, subtract) >> rest;
+	_mm512_mask_storeu_epi64(rp + i, tail, r);
+    }
+
+    return carry & 1;
+}
+
+mp_limb_t avxmpn_add_n(mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, mp_size_t n)
+{
+    return avxmpn_aors_n(rp, s1p, s2p, n, 0);
+}
+
+mp_limb_t avxmpn_sub_n(mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, mp_size_t n)
+{
+    return avxmpn_aors_n(rp, s1p, s2p, n, 1);
+}
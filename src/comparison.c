@@ -258,5 +258,8 @@ int main()
     mpfr_printf("\nAverage time taken for mpfr_add():\t %.128Rf seconds\n", mpfr_time);
     mpfr_printf("Average time taken for avxmpfr_add():\t %.128Rf seconds\n", avxmpfr_time);
 
+    // Per stage breakdown when built with INSTRUMENT=1
+    avxmpfr_stats_dump(stdout);
+
     return 0;
 }
@@ -0,0 +1,201 @@
+/*
+    Test file to compare avxmpfr_add_128() and avxmpfr_add_128_vec() against mpfr_add() for values of at most
+    PRECISION_128 bits.
+
+    For operands of at most 126 bits the truncated sum is exactly mpfr_add() with MPFR_RNDZ, so every sum has to be
+    equal to it bit for bit: precisions from 2 to 126 bits with rop, op1 and op2 each drawn separately, gaps across the
+    63 bit lane boundary and past both lanes, sums that carry out of the top lane, and pairs with different signs or
+    zeros that go through mpfr_add().
+
+    The timings are ns per addition at 113 bits (the significand of __float128) and 126 bits, against mpfr_add(), the
+    2 limb specialisation of avxmpfr_kernels.c that avxmpfr_add_prec() picked for these precisions before, and the
+    software __float128 addition of libgcc on the same values.
+*/
+
+#include "comparison_utilities.h"
+
+// A gap between the operands, the lane boundaries more often than the rest
+int64_t draw_gap()
+{
+    static const int64_t gaps[] = {0, 0, 0, 1, 2, 61, 62, 63, 64, 65, 112, 113, 125, 126, 127, 200};
+    return rand() % 2 ? gaps[rand() % (sizeof(gaps) / sizeof(gaps[0]))] : rand() % 140;
+}
+
+// The value of op as a __float128, exact for precisions up to 113 bits
+__float128 to_float128(mpfr_t op, mpfr_t scratch)
+{
+    mpfr_set(scratch, op, MPFR_RNDN);
+    __float128 x = 0;
+    for (int k = 0; k < 3; k++)
+    {
+	const double part = mpfr_get_d(scratch, MPFR_RNDN);
+	x += part;
+	mpfr_sub_d(scratch, scratch, part, MPFR_RNDN);
+    }
+    return x;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {2, 53, 63, 64, 65, 100, 113, 120, 125, PRECISION_128};
+    const int P = sizeof(precisions) / sizeof(precisions[0]);
+    const size_t n = 1 << 12;
+    int all_correct = 1;
+
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, time(NULL), 0);
+    mpfr_t *op1 = malloc(n * sizeof(mpfr_t)), *op2 = malloc(n * sizeof(mpfr_t));
+    mpfr_t *rop = malloc(n * sizeof(mpfr_t)), *expected = malloc(n * sizeof(mpfr_t));
+    uint64_t tried = 0;
+
+    for (int p0 = 0; p0 < P; p0++)
+	for (int p1 = 0; p1 < P; p1++)
+	    for (int p2 = 0; p2 < P; p2++)
+	    {
+		const size_t count = 64;
+		int correct = 1;
+		for (size_t i = 0; i < count; i++)
+		{
+		    mpfr_inits2(precisions[p0], rop[i], expected[i], (mpfr_ptr) 0);
+		    mpfr_init2(op1[i], precisions[p1]);
+		    mpfr_init2(op2[i], precisions[p2]);
+		}
+		avxmpfr_urandom_vec(op1, count, &state, AVXMPFR_RANDOM_EXPONENTS, -64, 64);
+		avxmpfr_urandom_vec(op2, count, &state, AVXMPFR_RANDOM_EXPONENTS, -64, 64);
+		for (size_t i = 0; i < count; i++)
+		{
+		    // All ones significands for carries through both lanes, mostly the same sign, some zeros
+		    for (int j = 0; j < 2 && rand() % 4 == 0; j++)
+		    {
+			mpfr_ptr x = j ? op2[i] : op1[i];
+			mpfr_set_ui_2exp(x, 1, mpfr_get_exp(x), MPFR_RNDN);
+			mpfr_nextbelow(x);
+		    }
+		    if (rand() % 8)
+			mpfr_setsign(op2[i], op2[i], mpfr_signbit(op1[i]), MPFR_RNDN);
+		    mpfr_set_exp(op2[i], mpfr_get_exp(op1[i]) - draw_gap());
+		    if (rand() % 32 == 0)
+			mpfr_set_zero(op2[i], 1);
+		}
+
+		// Truncated sums are mpfr_add() with MPFR_RNDZ, the rest goes through mpfr_add() with rnd, as does an overflow
+		const mpfr_rnd_t rnd = rand() % 2 ? MPFR_RNDZ : MPFR_RNDN;
+		mpfr_set_exp(op1[0], mpfr_get_emax());
+		mpfr_set(op2[0], op1[0], MPFR_RNDZ);
+		mpfr_add(expected[0], op1[0], op2[0], rnd);
+		for (size_t i = 1; i < count; i++)
+		    mpfr_add(expected[i], op1[i], op2[i], mpfr_regular_p(op2[i]) && mpfr_signbit(op1[i]) == mpfr_signbit(op2[i]) ? MPFR_RNDZ : rnd);
+
+		for (size_t i = 0; i < count; i++)
+		{
+		    avxmpfr_add_128(rop[i], op1[i], op2[i], rnd);
+		    correct &= mpfr_equal_p(rop[i], expected[i]) && mpfr_signbit(rop[i]) == mpfr_signbit(expected[i]);
+		}
+		avxmpfr_add_128_vec(rop, op1, op2, count, rnd);
+		for (size_t i = 0; i < count; i++)
+		    correct &= mpfr_equal_p(rop[i], expected[i]) && mpfr_signbit(rop[i]) == mpfr_signbit(expected[i]);
+		tried += 2 * count;
+
+		// In place, odd lengths and the dispatch of avxmpfr_add_prec()
+		if (p0 == p1)
+		{
+		    avxmpfr_add_128_vec(op1 + 1, op1 + 1, op2 + 1, count - 2, rnd);
+		    for (size_t i = 1; i < count - 1; i++)
+			correct &= mpfr_equal_p(op1[i], expected[i]);
+		    avxmpfr_add_prec(op1[count - 1], op1[count - 1], op2[count - 1], rnd);
+		    correct &= mpfr_equal_p(op1[count - 1], expected[count - 1]);
+		}
+
+		if (!correct)
+		    printf("differs with rop %ld, op1 %ld and op2 %ld bits\n", (long) precisions[p0], (long) precisions[p1],
+			   (long) precisions[p2]);
+		all_correct &= correct;
+		for (size_t i = 0; i < count; i++)
+		    mpfr_clears(rop[i], expected[i], op1[i], op2[i], (mpfr_ptr) 0);
+	    }
+    printf("\n%lu additions checked against mpfr\n", (unsigned long) tried);
+
+    // Timings, same signs and exponents in [-16, 16)
+    const int repeats = 64;
+    const mpfr_prec_t timed[2] = {113, PRECISION_128};
+    __float128 *q1 = malloc(n * sizeof(__float128)), *q2 = malloc(n * sizeof(__float128)), *q = malloc(n * sizeof(__float128));
+    mpfr_t scratch;
+    mpfr_init2(scratch, PRECISION_128);
+
+    printf("\nns per addition of operands of the same sign, exponents in [-16, 16)\n\n");
+    printf("%6s %10s %12s %10s %14s %12s %10s %10s\n", "bits", "mpfr_add", "__float128", "2 limbs", "add_128", "add_128_vec",
+	   "mpfr_add", "__float128");
+    for (int t = 0; t < 2; t++)
+    {
+	for (size_t i = 0; i < n; i++)
+	    mpfr_inits2(timed[t], rop[i], op1[i], op2[i], (mpfr_ptr) 0);
+	avxmpfr_urandom_vec(op1, n, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+	avxmpfr_urandom_vec(op2, n, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_setsign(op2[i], op2[i], mpfr_signbit(op1[i]), MPFR_RNDN);
+	    q1[i] = to_float128(op1[i], scratch);
+	    q2[i] = to_float128(op2[i], scratch);
+	}
+	avxmpfr_kernel two_limbs = avxmpfr_kernel_lookup(timed[t], avxmpfr_kernel_best_isa());
+
+	double time[5], start;
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+		mpfr_add(rop[i], op1[i], op2[i], MPFR_RNDZ);
+	time[0] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	{
+	    for (size_t i = 0; i < n; i++)
+		q[i] = q1[i] + q2[i];
+	    __asm__ volatile("" : : "r"(q) : "memory");
+	}
+	time[1] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+		two_limbs(rop[i], op1[i], op2[i], MPFR_RNDZ);
+	time[2] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+		avxmpfr_add_128(rop[i], op1[i], op2[i], MPFR_RNDZ);
+	time[3] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    avxmpfr_add_128_vec(rop, op1, op2, n, MPFR_RNDZ);
+	time[4] = wall_time() - start;
+
+	const double scale = 1e9 / (repeats * n);
+	const double best = time[3] < time[4] ? time[3] : time[4];
+	printf("%6ld %10.1f %12.1f %10.1f %14.1f %12.1f %9.2fx %9.2fx\n", (long) timed[t], time[0] * scale, time[1] * scale,
+	       time[2] * scale, time[3] * scale, time[4] * scale, time[0] / best, time[1] / best);
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(rop[i], op1[i], op2[i], (mpfr_ptr) 0);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    mpfr_clear(scratch);
+    free(op1);
+    free(op2);
+    free(rop);
+    free(expected);
+    free(q1);
+    free(q2);
+    free(q);
+    return 0;
+}
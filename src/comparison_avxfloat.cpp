@@ -0,0 +1,161 @@
+/*
+    Test file to compare the fused sums of avxfloat.hpp against chains of single additions.
+
+    For each precision it times d = a + b + c + e over arrays of values as
+	three mpfr_add() calls per element, rounding every step
+	three avxmpfr_add() calls per element, on scratch copies since it modifies its operands
+	one avxfloat<Prec> expression per element
+	one std::vector<avxfloat<Prec>> expression over the whole arrays
+
+    Half of the sums take exponents in [-16, 16), the others in [-2 Prec, 2 Prec), where terms fall into the guard lane
+    or below it into the sticky bit. Sums of operands with equal signs must match the exact sum rounded once (computed
+    with mpfr_add() at a precision that holds it exactly), in every rounding mode. One operand in 64 is negative: those
+    sums go through the MPFR chain and must match the three mpfr_add() calls bit for bit.
+*/
+
+#include "avxfloat.hpp"
+#include "comparison_utilities.h"
+
+template <mpfr_prec_t Prec>
+int compare(size_t count)
+{
+    typedef avx::avxfloat<Prec> value;
+    std::vector<value> a(count), b(count), c(count), e(count), sum(count), vector_sum(count);
+    for (size_t i = 0; i < count; i++)
+    {
+	// Every other sum spreads its exponents over 4 Prec, so that terms land in the guard lane or below it
+	const int range = i % 2 ? 16 : 2 * Prec;
+	assign_random(a[i].get(), -range, range, RANDOM_RARELY_NEGATIVE);
+	assign_random(b[i].get(), -range, range, RANDOM_RARELY_NEGATIVE);
+	assign_random(c[i].get(), -range, range, RANDOM_RARELY_NEGATIVE);
+	assign_random(e[i].get(), -range, range, RANDOM_RARELY_NEGATIVE);
+    }
+
+    mpfr_t chained, copy1, copy2, exact;
+    mpfr_inits2(Prec, chained, copy1, copy2, NULL);
+    mpfr_init2(exact, 6 * Prec);	// Holds any of the sums exactly
+
+
+    /* Three mpfr_add() */
+    double start = wall_time();
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_add(chained, a[i].get(), b[i].get(), MPFR_RNDN);
+	mpfr_add(chained, chained, c[i].get(), MPFR_RNDN);
+	mpfr_add(sum[i].get(), chained, e[i].get(), MPFR_RNDN);
+    }
+    double mpfr_time = wall_time() - start;
+
+
+    /* Three avxmpfr_add() */
+    double avxmpfr_time = 0;
+    if (Prec == PRECISION_256 || Prec == PRECISION_512)
+    {
+	start = wall_time();
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpfr_set(chained, a[i].get(), MPFR_RNDN);
+	    const value *terms[3] = {&b[i], &c[i], &e[i]};
+	    for (int k = 0; k < 3; k++)
+	    {
+		mpfr_set(copy1, chained, MPFR_RNDN);
+		mpfr_set(copy2, terms[k]->get(), MPFR_RNDN);
+		if (Prec == PRECISION_256)
+		    avxmpfr_add(chained, copy1, copy2, MPFR_RNDF, PRECISION_256);
+		else
+		    avxmpfr_add_512(chained, copy1, copy2, MPFR_RNDF, PRECISION_512);
+	    }
+	}
+	avxmpfr_time = wall_time() - start;
+    }
+
+
+    /* avxfloat expressions */
+    std::vector<value> fused(count);
+    start = wall_time();
+    for (size_t i = 0; i < count; i++)
+	fused[i] = a[i] + b[i] + c[i] + e[i];
+    double fused_time = wall_time() - start;
+
+    start = wall_time();
+    avx::assign(vector_sum, a + b + c + e);
+    double vector_time = wall_time() - start;
+
+
+    /* Check every rounding mode against the exact sum */
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    uint64_t correct = 0, checked = 0;
+    value result;
+    for (size_t i = 0; i < count; i++)
+    {
+	const int mixed = mpfr_signbit(a[i].get()) != mpfr_signbit(b[i].get())
+			  || mpfr_signbit(a[i].get()) != mpfr_signbit(c[i].get())
+			  || mpfr_signbit(a[i].get()) != mpfr_signbit(e[i].get());
+
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+	{
+	    result.assign(a[i] + b[i] + c[i] + e[i], modes[m]);
+
+	    if (mixed)
+	    {
+		mpfr_add(chained, a[i].get(), b[i].get(), modes[m]);
+		mpfr_add(chained, chained, c[i].get(), modes[m]);
+		mpfr_add(chained, chained, e[i].get(), modes[m]);
+	    }
+	    else
+	    {
+		mpfr_add(exact, a[i].get(), b[i].get(), MPFR_RNDN);
+		mpfr_add(exact, exact, c[i].get(), MPFR_RNDN);
+		mpfr_add(exact, exact, e[i].get(), MPFR_RNDN);
+		mpfr_set(chained, exact, modes[m]);
+	    }
+
+	    correct += mpfr_equal_p(result.get(), chained) && mpfr_signbit(result.get()) == mpfr_signbit(chained);
+	    checked++;
+	}
+
+	correct += mpfr_equal_p(fused[i].get(), vector_sum[i].get());
+	checked++;
+    }
+
+    // Single rounding against the chain: how often the three roundings change the result
+    uint64_t differ = 0;
+    for (size_t i = 0; i < count; i++)
+	differ += !mpfr_equal_p(fused[i].get(), sum[i].get());
+
+    // avxmpfr_add() only exists for PRECISION_256 and PRECISION_512
+    char avxmpfr_column[32] = "n/a";
+    if (avxmpfr_time > 0)
+	snprintf(avxmpfr_column, sizeof(avxmpfr_column), "%.2f", avxmpfr_time / count * 1e9);
+
+    printf("%10ld %18.2f %18s %18.2f %18.2f %12.2f%% %10s\n", (long) Prec, mpfr_time / count * 1e9, avxmpfr_column,
+	   fused_time / count * 1e9, vector_time / count * 1e9, 100.0 * differ / count, correct == checked ? "yes" : "NO");
+
+    mpfr_clears(chained, copy1, copy2, exact, NULL);
+    return correct == checked;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const size_t count = 1<<16;	// Sums per precision
+    int all_correct = 1;
+
+    printf("\nd = a + b + c + e, ns per sum\n\n");
+    printf("%10s %18s %18s %18s %18s %13s %10s\n", "precision", "3x mpfr_add()", "3x avxmpfr_add()", "avxfloat",
+	   "std::vector", "chain differs", "correct");
+
+    all_correct &= compare<64>(count);
+    all_correct &= compare<PRECISION_256>(count);
+    all_correct &= compare<PRECISION_512>(count);
+    all_correct &= compare<1024>(count);
+
+    if (all_correct)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    return 0;
+}
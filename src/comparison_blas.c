@@ -0,0 +1,428 @@
+/*
+    Test file to compare the packed array BLAS (avxmpfr_dot(), avxmpfr_asum(), avxmpfr_nrm2(), avxmpfr_axpy(),
+    avxmpfr_scal() and avxmpfr_gemv()) against plain mpfr loops and against MPLAPACK style reference code.
+
+    The mpfr loops are what one would write by hand with mpfr_fma() / mpfr_fmma(). The MPLAPACK style code follows the
+    reference BLAS the way MPLAPACK's Rdot(), Rasum(), Rnrm2() (with its scaled sum of squares), Raxpy(), Rscal() and
+    Rgemv() do on mpreal, rounding to nearest after every operation.
+
+    Values have random signs and exponents in [-16, 16), one in sixty four is zero. Every result has to be the exact
+    result rounded once, built here with mpfr_sum() / mpfr_fma() / mpfr_mul(), in a rounding mode drawn at random,
+    and with the ternary value of the same sign. The reductions and gemv have to give the same bits with 4 threads,
+    and dot once more with one value 2^20 binades away, which takes the mpfr_sum() path.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+int sign_of(int ternary)
+{
+    return (ternary > 0) - (ternary < 0);
+}
+
+
+/* Exact references, rounded once */
+
+enum { DOT, ASUM, NRM2 };
+
+int reference_reduce(mpfr_t rop, int kind, mpfr_t *x, mpfr_t *y, size_t n, mpfr_rnd_t rnd)
+{
+    mpfr_t *terms = malloc(n * sizeof(mpfr_t));
+    mpfr_ptr *pointers = malloc(n * sizeof(mpfr_ptr));
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_init2(terms[i], 2 * mpfr_get_prec(x[i]));
+	if (kind == DOT)
+	    mpfr_mul(terms[i], x[i], y[i], MPFR_RNDN);
+	else if (kind == ASUM)
+	    mpfr_abs(terms[i], x[i], MPFR_RNDN);
+	else
+	    mpfr_sqr(terms[i], x[i], MPFR_RNDN);
+	pointers[i] = terms[i];
+    }
+
+    int ternary;
+    if (kind == NRM2)
+    {
+	mpfr_t sum;
+	mpfr_init2(sum, 4096);
+	mpfr_sum(sum, pointers, n, MPFR_RNDN);	// Exact, the squares span well under 4096 bits
+	ternary = mpfr_sqrt(rop, sum, rnd);
+	mpfr_clear(sum);
+    }
+    else
+	ternary = mpfr_sum(rop, pointers, n, rnd);
+
+    for (size_t i = 0; i < n; i++)
+	mpfr_clear(terms[i]);
+    free(terms);
+    free(pointers);
+    return ternary;
+}
+
+// Row i of alpha A x + beta y as one sum of exact terms
+void reference_gemv_row(mpfr_t rop, mpfr_t alpha, mpfr_t *A, size_t i, size_t n, mpfr_t *x, mpfr_t beta, mpfr_t y_i,
+			mpfr_rnd_t rnd)
+{
+    mpfr_t *terms = malloc((n + 1) * sizeof(mpfr_t));
+    mpfr_ptr *pointers = malloc((n + 1) * sizeof(mpfr_ptr));
+    const mpfr_prec_t p = mpfr_get_prec(y_i);
+    for (size_t j = 0; j < n; j++)
+    {
+	mpfr_init2(terms[j], 3 * p);
+	mpfr_mul(terms[j], A[i * n + j], x[j], MPFR_RNDN);
+	mpfr_mul(terms[j], terms[j], alpha, MPFR_RNDN);
+	pointers[j] = terms[j];
+    }
+    mpfr_init2(terms[n], 2 * p);
+    mpfr_mul(terms[n], beta, y_i, MPFR_RNDN);
+    pointers[n] = terms[n];
+
+    mpfr_sum(rop, pointers, n + 1, rnd);
+
+    for (size_t j = 0; j <= n; j++)
+	mpfr_clear(terms[j]);
+    free(terms);
+    free(pointers);
+}
+
+
+/* MPLAPACK style reference BLAS, every operation rounded to nearest */
+
+void rdot(mpfr_t rop, mpfr_t *x, mpfr_t *y, size_t n, mpfr_t temp)
+{
+    mpfr_set_zero(rop, 1);
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_mul(temp, x[i], y[i], MPFR_RNDN);
+	mpfr_add(rop, rop, temp, MPFR_RNDN);
+    }
+}
+
+void rasum(mpfr_t rop, mpfr_t *x, size_t n, mpfr_t temp)
+{
+    mpfr_set_zero(rop, 1);
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_abs(temp, x[i], MPFR_RNDN);
+	mpfr_add(rop, rop, temp, MPFR_RNDN);
+    }
+}
+
+// The scaled sum of squares of the reference dnrm2()
+void rnrm2(mpfr_t rop, mpfr_t *x, size_t n, mpfr_t scale, mpfr_t ssq, mpfr_t temp)
+{
+    mpfr_set_zero(scale, 1);
+    mpfr_set_ui(ssq, 1, MPFR_RNDN);
+    for (size_t i = 0; i < n; i++)
+    {
+	if (mpfr_zero_p(x[i]))
+	    continue;
+	mpfr_abs(temp, x[i], MPFR_RNDN);
+	if (mpfr_cmp(scale, temp) < 0)
+	{
+	    mpfr_div(scale, scale, temp, MPFR_RNDN);
+	    mpfr_sqr(scale, scale, MPFR_RNDN);
+	    mpfr_mul(ssq, ssq, scale, MPFR_RNDN);
+	    mpfr_add_ui(ssq, ssq, 1, MPFR_RNDN);
+	    mpfr_set(scale, temp, MPFR_RNDN);
+	}
+	else
+	{
+	    mpfr_div(temp, temp, scale, MPFR_RNDN);
+	    mpfr_sqr(temp, temp, MPFR_RNDN);
+	    mpfr_add(ssq, ssq, temp, MPFR_RNDN);
+	}
+    }
+    mpfr_sqrt(ssq, ssq, MPFR_RNDN);
+    mpfr_mul(rop, scale, ssq, MPFR_RNDN);
+}
+
+void raxpy(mpfr_t *y, mpfr_t alpha, mpfr_t *x, size_t n, mpfr_t temp)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_mul(temp, alpha, x[i], MPFR_RNDN);
+	mpfr_add(y[i], y[i], temp, MPFR_RNDN);
+    }
+}
+
+// Column by column, as the reference dgemv() does without transposition
+void rgemv(mpfr_t *y, mpfr_t alpha, mpfr_t *A, size_t m, size_t n, mpfr_t *x, mpfr_t beta, mpfr_t temp, mpfr_t temp2)
+{
+    for (size_t i = 0; i < m; i++)
+	mpfr_mul(y[i], y[i], beta, MPFR_RNDN);
+    for (size_t j = 0; j < n; j++)
+    {
+	mpfr_mul(temp, alpha, x[j], MPFR_RNDN);
+	for (size_t i = 0; i < m; i++)
+	{
+	    mpfr_mul(temp2, temp, A[i * n + j], MPFR_RNDN);
+	    mpfr_add(y[i], y[i], temp2, MPFR_RNDN);
+	}
+    }
+}
+
+
+/* Plain mpfr loops */
+
+void loop_dot(mpfr_t rop, mpfr_t *x, mpfr_t *y, size_t n)
+{
+    mpfr_set_zero(rop, 1);
+    for (size_t i = 0; i < n; i++)
+	mpfr_fma(rop, x[i], y[i], rop, MPFR_RNDN);
+}
+
+void loop_asum(mpfr_t rop, mpfr_t *x, size_t n)
+{
+    mpfr_set_zero(rop, 1);
+    for (size_t i = 0; i < n; i++)
+	mpfr_signbit(x[i]) ? mpfr_sub(rop, rop, x[i], MPFR_RNDN) : mpfr_add(rop, rop, x[i], MPFR_RNDN);
+}
+
+void loop_nrm2(mpfr_t rop, mpfr_t *x, size_t n)
+{
+    mpfr_set_zero(rop, 1);
+    for (size_t i = 0; i < n; i++)
+	mpfr_fma(rop, x[i], x[i], rop, MPFR_RNDN);
+    mpfr_sqrt(rop, rop, MPFR_RNDN);
+}
+
+void loop_gemv(mpfr_t *y, mpfr_t alpha, mpfr_t *A, size_t m, size_t n, mpfr_t *x, mpfr_t beta, mpfr_t temp)
+{
+    for (size_t i = 0; i < m; i++)
+    {
+	mpfr_set_zero(temp, 1);
+	for (size_t j = 0; j < n; j++)
+	    mpfr_fma(temp, A[i * n + j], x[j], temp, MPFR_RNDN);
+	mpfr_fmma(y[i], alpha, temp, beta, y[i], MPFR_RNDN);
+    }
+}
+
+
+// Pack values into a fresh array
+void pack(avxmpfr_array *array, mpfr_t *values, size_t n, uint16_t precision, uint32_t layout)
+{
+    avxmpfr_array_init(array, precision, layout, n);
+    for (size_t i = 0; i < n; i++)
+	avxmpfr_array_set(array, i, values[i]);
+}
+
+void print_row(const char *name, mpfr_prec_t precision, double loop, double mplapack, double avx, int correct)
+{
+    printf("%8s %10ld %12.2f %12.2f %12.2f %10.2fx %10.2fx %8s\n", name, (long) precision, loop, mplapack, avx,
+	   loop / avx, mplapack / avx, correct ? "yes" : "NO");
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint16_t precisions[] = {PRECISION_256, PRECISION_512};
+    const mpfr_rnd_t modes[4] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    const size_t n = 1<<15;
+    const size_t rows = 256, columns = 256;
+    const int repeats = 4;
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(n * sizeof(mpfr_t));
+    mpfr_t *y = malloc(n * sizeof(mpfr_t));
+    mpfr_t *z = malloc(n * sizeof(mpfr_t));
+    mpfr_t *A = malloc(rows * columns * sizeof(mpfr_t));
+
+    printf("\nns per element, gemv per element of A\n\n");
+    printf("%8s %10s %12s %12s %12s %11s %11s %8s\n", "routine", "precision", "mpfr loop", "MPLAPACK", "avxmpfr",
+	   "vs loop", "vs MPLAPACK", "correct");
+
+    for (int p = 0; p < 2; p++)
+    {
+	const mpfr_prec_t prec = precisions[p];
+	mpfr_t alpha, beta, r1, r2, t1, t2, t3, t4;
+	mpfr_inits2(prec, alpha, beta, r1, r2, t1, t2, t3, t4, (mpfr_ptr) 0);
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_inits2(prec, x[i], y[i], z[i], (mpfr_ptr) 0);
+	    assign_random(x[i], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS);
+	    assign_random(y[i], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS);
+	}
+	for (size_t i = 0; i < rows * columns; i++)
+	{
+	    mpfr_init2(A[i], prec);
+	    assign_random(A[i], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS);
+	}
+	do assign_random(alpha, -16, 16, RANDOM_SIGNED | RANDOM_ZEROS); while (mpfr_zero_p(alpha));
+	assign_random(beta, -16, 16, RANDOM_SIGNED | RANDOM_ZEROS);
+
+	avxmpfr_array X, Y, Ap, Z;
+	pack(&X, x, n, prec, AVXMPFR_LAYOUT_NATIVE);
+	pack(&Y, y, n, prec, AVXMPFR_LAYOUT_SOA);
+	pack(&Ap, A, rows * columns, prec, AVXMPFR_LAYOUT_NATIVE);
+	avxmpfr_array_init(&Z, prec, AVXMPFR_LAYOUT_NATIVE, n);
+	double times[3], start;
+	int correct;
+
+	// Reductions
+	const char *names[3] = {"dot", "asum", "nrm2"};
+	for (int kind = DOT; kind <= NRM2; kind++)
+	{
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		kind == DOT ? loop_dot(r1, x, y, n) : kind == ASUM ? loop_asum(r1, x, n) : loop_nrm2(r1, x, n);
+	    times[0] = (wall_time() - start) / (repeats * n) * 1e9;
+
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		kind == DOT ? rdot(r1, x, y, n, t1) : kind == ASUM ? rasum(r1, x, n, t1) : rnrm2(r1, x, n, t1, t2, t3);
+	    times[1] = (wall_time() - start) / (repeats * n) * 1e9;
+
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		kind == DOT ? avxmpfr_dot(r2, &X, &Y, MPFR_RNDN) : kind == ASUM ? avxmpfr_asum(r2, &X, MPFR_RNDN)
+										: avxmpfr_nrm2(r2, &X, MPFR_RNDN);
+	    times[2] = (wall_time() - start) / (repeats * n) * 1e9;
+
+	    correct = 1;
+	    for (int t = 0; t < 8; t++)
+	    {
+		const mpfr_rnd_t rnd = modes[rand() % 4];
+		const int expected = reference_reduce(r1, kind, x, y, n, rnd);
+		avxmpfr_blas_set_threads(t % 2 ? 4 : 1);
+		const int ternary = kind == DOT ? avxmpfr_dot(r2, &X, &Y, rnd) : kind == ASUM ? avxmpfr_asum(r2, &X, rnd)
+											   : avxmpfr_nrm2(r2, &X, rnd);
+		correct &= mpfr_equal_p(r1, r2) && sign_of(expected) == sign_of(ternary);
+	    }
+	    avxmpfr_blas_set_threads(1);
+	    print_row(names[kind], prec, times[0], times[1], times[2], correct);
+	    all_correct &= correct;
+	}
+
+	// An exponent span too wide for the accumulators
+	mpfr_t saved;
+	mpfr_init2(saved, prec);
+	mpfr_set(saved, x[1], MPFR_RNDN);
+	mpfr_set_ui_2exp(x[1], 3, 1 << 20, MPFR_RNDN);
+	avxmpfr_array_set(&X, 1, x[1]);
+	correct = 1;
+	for (int r = 0; r < 4; r++)
+	{
+	    const int expected = reference_reduce(r1, DOT, x, y, n, modes[r]);
+	    const int ternary = avxmpfr_dot(r2, &X, &Y, modes[r]);
+	    correct &= mpfr_equal_p(r1, r2) && sign_of(expected) == sign_of(ternary);
+	}
+	if (!correct)
+	    printf("dot differs with a wide exponent span\n");
+	all_correct &= correct;
+	mpfr_set(x[1], saved, MPFR_RNDN);
+	avxmpfr_array_set(&X, 1, x[1]);
+	mpfr_clear(saved);
+
+	// scal and axpy, on copies that every repeat overwrites
+	for (int op = 0; op < 2; op++)
+	{
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i < n; i++)
+		    op ? mpfr_fma(z[i], alpha, x[i], y[i], MPFR_RNDN) : mpfr_mul(z[i], alpha, x[i], MPFR_RNDN);
+	    times[0] = (wall_time() - start) / (repeats * n) * 1e9;
+
+	    for (size_t i = 0; i < n; i++)
+		mpfr_set(z[i], y[i], MPFR_RNDN);
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+	    {
+		if (op)
+		    raxpy(z, alpha, x, n, t1);
+		else
+		    for (size_t i = 0; i < n; i++)
+			mpfr_mul(z[i], alpha, x[i], MPFR_RNDN);	// Rscal(), on a copy
+	    }
+	    times[1] = (wall_time() - start) / (repeats * n) * 1e9;
+
+	    times[2] = 0;
+	    for (int k = 0; k < repeats; k++)
+	    {
+		for (size_t b = 0; b < avxmpfr_array_blocks(n); b++)
+		    memcpy(avxmpfr_block(&Z, b), avxmpfr_block(op ? &Y : &X, b), avxmpfr_block_words(Z.limbs) * 8);
+		Z.layout = op ? Y.layout : X.layout;
+		start = wall_time();
+		op ? avxmpfr_axpy(&Z, alpha, &X, MPFR_RNDN) : avxmpfr_scal(&Z, alpha, MPFR_RNDN);
+		times[2] += (wall_time() - start) / (repeats * n) * 1e9;
+	    }
+
+	    correct = 1;
+	    const mpfr_rnd_t rnd = modes[rand() % 4];
+	    for (size_t b = 0; b < avxmpfr_array_blocks(n); b++)
+		memcpy(avxmpfr_block(&Z, b), avxmpfr_block(op ? &Y : &X, b), avxmpfr_block_words(Z.limbs) * 8);
+	    avxmpfr_blas_set_threads(4);
+	    op ? avxmpfr_axpy(&Z, alpha, &X, rnd) : avxmpfr_scal(&Z, alpha, rnd);
+	    avxmpfr_blas_set_threads(1);
+	    for (size_t i = 0; i < n; i++)
+	    {
+		op ? mpfr_fma(r1, alpha, x[i], y[i], rnd) : mpfr_mul(r1, alpha, x[i], rnd);
+		avxmpfr_array_get(r2, &Z, i, MPFR_RNDN);
+		correct &= mpfr_equal_p(r1, r2);
+	    }
+	    print_row(op ? "axpy" : "scal", prec, times[0], times[1], times[2], correct);
+	    all_correct &= correct;
+	}
+
+	// gemv, y of rows values overwritten by each repeat
+	avxmpfr_array G, Xg;
+	avxmpfr_array_view(&Xg, &X, 0, columns);
+	avxmpfr_array_init(&G, prec, AVXMPFR_LAYOUT_NATIVE, rows);
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    loop_gemv(z, alpha, A, rows, columns, x, beta, t1);
+	times[0] = (wall_time() - start) / (repeats * rows * columns) * 1e9;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    rgemv(z, alpha, A, rows, columns, x, beta, t1, t2);
+	times[1] = (wall_time() - start) / (repeats * rows * columns) * 1e9;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    avxmpfr_gemv(&G, alpha, &Ap, rows, columns, &Xg, beta, MPFR_RNDN);
+	times[2] = (wall_time() - start) / (repeats * rows * columns) * 1e9;
+
+	correct = 1;
+	for (int t = 0; t < 2; t++)
+	{
+	    const mpfr_rnd_t rnd = modes[rand() % 4];
+	    for (size_t i = 0; i < rows; i++)
+		avxmpfr_array_set(&G, i, y[i]);
+	    avxmpfr_blas_set_threads(t ? 4 : 1);
+	    avxmpfr_gemv(&G, alpha, &Ap, rows, columns, &Xg, beta, rnd);
+	    for (size_t i = 0; i < rows; i++)
+	    {
+		reference_gemv_row(r1, alpha, A, i, columns, x, beta, y[i], rnd);
+		avxmpfr_array_get(r2, &G, i, MPFR_RNDN);
+		correct &= mpfr_equal_p(r1, r2);
+	    }
+	}
+	avxmpfr_blas_set_threads(1);
+	print_row("gemv", prec, times[0], times[1], times[2], correct);
+	all_correct &= correct;
+
+	avxmpfr_array_clear(&X);
+	avxmpfr_array_clear(&Y);
+	avxmpfr_array_clear(&Z);
+	avxmpfr_array_clear(&Ap);
+	avxmpfr_array_clear(&G);
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(x[i], y[i], z[i], (mpfr_ptr) 0);
+	for (size_t i = 0; i < rows * columns; i++)
+	    mpfr_clear(A[i]);
+	mpfr_clears(alpha, beta, r1, r2, t1, t2, t3, t4, (mpfr_ptr) 0);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x); free(y); free(z); free(A);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+    Test file to compare avxmpfr_add_array_bucketed() against avxmpfr_add_array() on packed arrays in the native
+    layout.
+
+    Every sum has to be mpfr_add() with MPFR_RNDZ, as the truncated sums of PRECISION_256 / PRECISION_512 operands are:
+    gaps of every class (equal, below a lane, whole lanes, split across lanes, past the lanes), all ones significands
+    that carry through every lane, zeros, different signs, lengths that end inside a block and a tile, and rop being
+    op1.
+
+    The timings are ns per addition, the best of PASSES passes, over arrays long enough that the branch predictor
+    cannot learn the sequence of gaps as it would on a short array added over and over. The gaps are drawn from
+	equal		every pair with the same exponent
+	skewed		nine in ten pairs with a gap below 3 bits, the rest a gap past the precision
+	realistic	both exponents uniform in [-16, 16)
+	mixed		gaps uniform in [0, 2 * precision), every class shuffled together
+*/
+
+#include "comparison_utilities.h"
+
+#define DISTRIBUTIONS 4
+#define PASSES 5		// Timings are the best of a few passes
+
+// Fill op1 and op2 with n pairs of the same sign, the gaps following distribution
+void fill_pairs(avxmpfr_array *op1, avxmpfr_array *op2, mpfr_t *a, mpfr_t *b, size_t n, int distribution,
+		avxmpfr_random *state)
+{
+    const int precision = op1->precision;
+    avxmpfr_urandom_vec(a, n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    avxmpfr_urandom_vec(b, n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_setsign(b[i], b[i], mpfr_signbit(a[i]), MPFR_RNDN);
+	if (distribution == 0)
+	    mpfr_set_exp(b[i], mpfr_get_exp(a[i]));
+	else if (distribution == 1)
+	    mpfr_set_exp(b[i], mpfr_get_exp(a[i]) - (rand() % 10 ? rand() % 3 : precision + rand() % 64));
+	else if (distribution == 3)
+	    mpfr_set_exp(b[i], mpfr_get_exp(a[i]) - rand() % (2 * precision));
+	avxmpfr_array_set(op1, i, a[i]);
+	avxmpfr_array_set(op2, i, b[i]);
+    }
+}
+
+// Fill op1 and op2 with n pairs of every awkward kind
+void fill_awkward(avxmpfr_array *op1, avxmpfr_array *op2, mpfr_t *a, mpfr_t *b, size_t n, avxmpfr_random *state)
+{
+    const int precision = op1->precision;
+    static const int gaps[] = {0, 1, 62, 63, 64, 125, 126, 127, 189, 251, 252, 253, 378, 441, 503, 504, 505};
+    avxmpfr_urandom_vec(a, n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    avxmpfr_urandom_vec(b, n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    for (size_t i = 0; i < n; i++)
+    {
+	for (int j = 0; j < 2 && rand() % 3 == 0; j++)
+	{
+	    mpfr_ptr x = j ? b[i] : a[i];
+	    mpfr_set_si_2exp(x, mpfr_signbit(x) ? -1 : 1, mpfr_get_exp(x), MPFR_RNDN);
+	    mpfr_nextbelow(x);
+	}
+	if (rand() % 8)
+	    mpfr_setsign(b[i], b[i], mpfr_signbit(a[i]), MPFR_RNDN);
+	mpfr_set_exp(b[i], mpfr_get_exp(a[i]) - (rand() % 2 ? gaps[rand() % (sizeof(gaps) / sizeof(gaps[0]))] : rand() % (precision + 8)));
+	if (rand() % 2)
+	    mpfr_swap(a[i], b[i]);
+	if (rand() % 32 == 0)
+	    mpfr_set_zero(a[i], rand() % 2 ? 1 : -1);
+	if (rand() % 32 == 0)
+	    mpfr_set_zero(b[i], rand() % 2 ? 1 : -1);
+	avxmpfr_array_set(op1, i, a[i]);
+	avxmpfr_array_set(op2, i, b[i]);
+    }
+}
+
+// 1 if value i of rop is mpfr_add() of a[i] and b[i] with MPFR_RNDZ for every i < n
+int check_sums(const avxmpfr_array *rop, mpfr_t *a, mpfr_t *b, size_t n)
+{
+    mpfr_t expected, got;
+    mpfr_inits2(rop->precision, expected, got, (mpfr_ptr) 0);
+    int correct = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_add(expected, a[i], b[i], MPFR_RNDZ);
+	avxmpfr_array_get(got, rop, i, MPFR_RNDZ);
+	correct &= mpfr_equal_p(got, expected) && mpfr_signbit(got) == mpfr_signbit(expected);
+    }
+    mpfr_clears(expected, got, (mpfr_ptr) 0);
+    return correct;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    const char *names[DISTRIBUTIONS] = {"equal", "skewed", "realistic", "mixed"};
+    const size_t n = 1 << 16;
+    const int repeats = 1 << 2;
+    mpfr_t *a = malloc(n * sizeof(mpfr_t)), *b = malloc(n * sizeof(mpfr_t));
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, time(NULL), 0);
+    int all_correct = 1;
+
+    for (int p = 0; p < 2; p++)
+    {
+	avxmpfr_array op1, op2, rop;
+	avxmpfr_array_init(&op1, precisions[p], AVXMPFR_LAYOUT_NATIVE, n);
+	avxmpfr_array_init(&op2, precisions[p], AVXMPFR_LAYOUT_NATIVE, n);
+	avxmpfr_array_init(&rop, precisions[p], AVXMPFR_LAYOUT_NATIVE, n);
+	for (size_t i = 0; i < n; i++)
+	    mpfr_inits2(precisions[p], a[i], b[i], (mpfr_ptr) 0);
+
+	// Correctness, every distribution and the awkward pairs, lengths past a tile, ending inside a block, in place
+	for (int round = 0; round < 4 * (DISTRIBUTIONS + 1); round++)
+	{
+	    const size_t length = 1 + rand() % 1000;
+	    avxmpfr_array left, right, result;
+	    avxmpfr_array_view(&left, &op1, 0, length);
+	    avxmpfr_array_view(&right, &op2, 0, length);
+	    avxmpfr_array_view(&result, &rop, 0, length);
+
+	    if (round % (DISTRIBUTIONS + 1) == DISTRIBUTIONS)
+		fill_awkward(&left, &right, a, b, length, &state);
+	    else
+		fill_pairs(&left, &right, a, b, length, round % (DISTRIBUTIONS + 1), &state);
+
+	    avxmpfr_add_array_bucketed(&result, &left, &right);
+	    int correct = check_sums(&result, a, b, length);
+	    avxmpfr_add_array_bucketed(&left, &left, &right);
+	    correct &= check_sums(&left, a, b, length);
+
+	    if (!correct)
+		printf("differs at %d bits in round %d\n", precisions[p], round);
+	    all_correct &= correct;
+	}
+
+	// Timings
+	printf("\n%d bits, ns per addition over %lu pairs\n%12s %12s %12s %10s\n", precisions[p], (unsigned long) n,
+	       "gaps", "add_array", "bucketed", "speedup");
+	for (int d = 0; d < DISTRIBUTIONS; d++)
+	{
+	    fill_pairs(&op1, &op2, a, b, n, d, &state);
+
+	    double plain = 1e300, bucketed = 1e300;
+	    for (int pass = 0; pass < PASSES; pass++)
+	    {
+		double start = wall_time();
+		for (int k = 0; k < repeats; k++)
+		    avxmpfr_add_array(&rop, &op1, &op2);
+		double time = wall_time() - start;
+		plain = time < plain ? time : plain;
+
+		start = wall_time();
+		for (int k = 0; k < repeats; k++)
+		    avxmpfr_add_array_bucketed(&rop, &op1, &op2);
+		time = wall_time() - start;
+		bucketed = time < bucketed ? time : bucketed;
+	    }
+
+	    const double scale = 1e9 / (repeats * n);
+	    printf("%12s %12.2f %12.2f %9.2fx\n", names[d], plain * scale, bucketed * scale, plain / bucketed);
+	}
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(a[i], b[i], (mpfr_ptr) 0);
+	avxmpfr_array_clear(&op1);
+	avxmpfr_array_clear(&op2);
+	avxmpfr_array_clear(&rop);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(a);
+    free(b);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+    Test file to compare avxmpc_add(), avxmpc_sub() and avxmpc_mul() against mpc_add(), mpc_sub() and mpc_mul().
+
+    Both parts of every number have random signs and exponents in [-16, 16). One in thirty two right operands is the
+    negated left one, so that additions cancel exactly, and one in sixty four numbers has a zero part (which goes
+    through MPC). Every result, its signs of zero and the MPC_INEX() return value have to match MPC, with a rounding
+    mode drawn at random for each part, and also when the result overwrites an operand. Timings use MPC_RNDNN and
+    leave out the conversion to and from mpc_t, which is timed on its own. Precisions under AVXMPC_PREC_AORS_MIN add
+    and subtract through MPC and show the cost of the fallback. Last, avxmpc_init2() has to refuse precisions past
+    AVXMPC_PREC_MAX.
+*/
+
+#include "avxmpc.h"
+#include "comparison_utilities.h"
+
+void assign_complex(mpc_t x)
+{
+    assign_random(mpc_realref(x), -16, 16, RANDOM_SIGNED);
+    assign_random(mpc_imagref(x), -16, 16, RANDOM_SIGNED);
+    if (rand() % 64 == 0)
+	mpfr_set_zero(rand() % 2 ? mpc_realref(x) : mpc_imagref(x), rand() % 2 ? 1 : -1);
+}
+
+int same_part(mpfr_ptr a, mpfr_ptr b)
+{
+    return (mpfr_nan_p(a) && mpfr_nan_p(b)) || (mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b));
+}
+
+// 1 if the avxmpc_t result is the mpc_t one, scratch takes the conversion
+int same(mpc_t expected, avxmpc_t result, mpc_t scratch)
+{
+    avxmpc_get_mpc(scratch, result, MPC_RNDNN);
+    return same_part(mpc_realref(expected), mpc_realref(scratch)) && same_part(mpc_imagref(expected), mpc_imagref(scratch));
+}
+
+int mpc_operation(int op, mpc_ptr rop, mpc_srcptr op1, mpc_srcptr op2, mpc_rnd_t rnd)
+{
+    return op == 0 ? mpc_add(rop, op1, op2, rnd) : op == 1 ? mpc_sub(rop, op1, op2, rnd) : mpc_mul(rop, op1, op2, rnd);
+}
+
+int avxmpc_operation(int op, avxmpc_ptr rop, avxmpc_srcptr op1, avxmpc_srcptr op2, mpc_rnd_t rnd)
+{
+    return op == 0 ? avxmpc_add(rop, op1, op2, rnd) : op == 1 ? avxmpc_sub(rop, op1, op2, rnd)
+			    : avxmpc_mul(rop, op1, op2, rnd);
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {53, 113, 192, PRECISION_256, 448, PRECISION_512};
+    const int n_precisions = sizeof(precisions) / sizeof(precisions[0]);
+    const mpfr_rnd_t modes[4] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    const char *names[3] = {"add", "sub", "mul"};
+    const size_t count = 1<<15;
+    const int repeats = 8;
+    int all_correct = 1;
+
+    mpc_t *x = malloc(count * sizeof(mpc_t));
+    mpc_t *y = malloc(count * sizeof(mpc_t));
+    mpc_t *z = malloc(count * sizeof(mpc_t));
+    avxmpc_t *a = aligned_alloc(64, count * sizeof(avxmpc_t));
+    avxmpc_t *b = aligned_alloc(64, count * sizeof(avxmpc_t));
+    avxmpc_t *c = aligned_alloc(64, count * sizeof(avxmpc_t));
+    mpc_rnd_t *rnd = malloc(count * sizeof(mpc_rnd_t));
+
+    printf("\nns per complex operation\n\n");
+    printf("%10s %12s %12s %9s %12s %12s %9s %12s %12s %9s %10s %8s\n", "precision", "mpc_add()", "avxmpc_add()",
+	   "speedup", "mpc_sub()", "avxmpc_sub()", "speedup", "mpc_mul()", "avxmpc_mul()", "speedup", "convert", "correct");
+
+    for (int p = 0; p < n_precisions; p++)
+    {
+	mpc_t scratch;
+	mpc_init2(scratch, precisions[p]);
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpc_init2(x[i], precisions[p]);
+	    mpc_init2(y[i], precisions[p]);
+	    mpc_init2(z[i], precisions[p]);
+	    assign_complex(x[i]);
+	    assign_complex(y[i]);
+	    if (rand() % 32 == 0)
+	    {
+		mpfr_neg(mpc_realref(y[i]), mpc_realref(x[i]), MPFR_RNDN);
+		mpfr_neg(mpc_imagref(y[i]), mpc_imagref(x[i]), MPFR_RNDN);
+	    }
+	    rnd[i] = MPC_RND(modes[rand() % 4], modes[rand() % 4]);
+	}
+
+	// Converting both operands in, the result out
+	double start = wall_time();
+	for (size_t i = 0; i < count; i++)
+	{
+	    avxmpc_init2(a[i], precisions[p]);
+	    avxmpc_init2(b[i], precisions[p]);
+	    avxmpc_init2(c[i], precisions[p]);
+	    avxmpc_set_mpc(a[i], x[i], MPC_RNDNN);
+	    avxmpc_set_mpc(b[i], y[i], MPC_RNDNN);
+	    avxmpc_get_mpc(z[i], a[i], MPC_RNDNN);
+	}
+	const double convert = (wall_time() - start) / count * 1e9;
+
+	double times[6];
+	int correct = 1;
+	for (int op = 0; op < 3; op++)
+	{
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i < count; i++)
+		    mpc_operation(op, z[i], x[i], y[i], MPC_RNDNN);
+	    times[2 * op] = (wall_time() - start) / (repeats * count) * 1e9;
+
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i < count; i++)
+		    avxmpc_operation(op, c[i], a[i], b[i], MPC_RNDNN);
+	    times[2 * op + 1] = (wall_time() - start) / (repeats * count) * 1e9;
+
+	    for (size_t i = 0; i < count; i++)
+	    {
+		const int expected = mpc_operation(op, z[i], x[i], y[i], rnd[i]);
+		const int inexact = avxmpc_operation(op, c[i], a[i], b[i], rnd[i]);
+		correct &= inexact == expected && same(z[i], c[i], scratch);
+	    }
+
+	    // The result overwriting the second operand
+	    for (size_t i = 0; i < count / 16; i++)
+	    {
+		mpc_operation(op, z[i], x[i], y[i], rnd[i]);
+		c[i][0] = b[i][0];
+		avxmpc_operation(op, c[i], a[i], c[i], rnd[i]);
+		correct &= same(z[i], c[i], scratch);
+	    }
+	    if (!correct)
+		printf("%s differs at precision %ld\n", names[op], (long) precisions[p]);
+	}
+	all_correct &= correct;
+
+	printf("%10ld %12.2f %12.2f %8.2fx %12.2f %12.2f %8.2fx %12.2f %12.2f %8.2fx %10.2f %8s\n",
+	       (long) precisions[p], times[0], times[1], times[0] / times[1], times[2], times[3], times[2] / times[3],
+	       times[4], times[5], times[4] / times[5], convert, correct ? "yes" : "NO");
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpc_clear(x[i]);
+	    mpc_clear(y[i]);
+	    mpc_clear(z[i]);
+	}
+	mpc_clear(scratch);
+    }
+
+    // Wider parts would overflow the limbs of an avxmpc_t
+    avxmpc_t wide;
+    const int refused = avxmpc_init2(wide, AVXMPC_PREC_MAX + 1) == -1 && avxmpc_init2(wide, 0) == -1
+			&& avxmpc_init2(wide, AVXMPC_PREC_MAX) == 0;
+    printf("\n%-40s %s\n", "avxmpc_init2() refuses wide precisions", refused ? "yes" : "NO");
+    all_correct &= refused;
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x); free(y); free(z); free(a); free(b); free(c); free(rnd);
+    return 0;
+}
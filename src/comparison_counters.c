@@ -0,0 +1,589 @@
+/*
+    Benchmark suite of every addition path against mpfr_add() under perf_event_open(), with baselines to catch
+    regressions.
+
+    Each case is one operation at one precision, batch size and distribution of exponent gaps:
+	mpfr_add()			the reference, MPFR_RNDZ
+	avxmpfr_add() / _512()		one pair per call, on scratch copies since it modifies its operands
+	avxmpfr_add_prec()		one pair per call, a kernel where it beats mpfr_add()
+	avxmpfr_add_multi()		AVXMPFR_MULTI_MAX pairs per call
+	avxmpfr_add_ptr_vec()		the whole batch of mpfr_t pointers in one call
+	avxmpfr_add_array()		the whole batch as a packed array
+	avxmpfr_add_array_bucketed()	the same array, pairs classified by gap first
+    over PRECISION_256 and PRECISION_512, batches of 64 (L1), 4096 (L2) and 2^18 (past L3) pairs, and gaps
+	equal		every pair with the same exponent
+	realistic	both exponents uniform in [-16, 16)
+	mixed		gaps uniform in [0, 2 * precision)
+    Every pair has the same sign, so every path runs its vector code and every sum has to be mpfr_add() with MPFR_RNDZ,
+    but for avxmpfr_add() / _512(), which are checked in magnitude on the gaps below a lane they handle.
+
+    Every case runs about 2^18 additions a pass, the best of PASSES passes is kept. Its counters are per addition:
+	ns, task_clock		wall clock and the kernel's software clock of this thread, always there
+	cycles, instructions, branch_misses, l1d_misses (reads), llc_misses
+	stalled_frontend, stalled_backend	stand ins for port pressure on the kernels that export them
+    plus raw events given with -e name=config, e.g. the uops dispatched per port of a known core. A counter the kernel
+    does not export (virtual machines often export none) is n/a in the table and null in the JSON, and multiplexed
+    counters are scaled by their time enabled / time running.
+
+    ./comparison_counters [-o results.json] [-b baseline.json] [-t percent] [-i results.json] [-q] [-e name=config]
+	-o	where to write the results, comparison_counters.json by default, keep a run as the baseline
+	-b	compare the results against a baseline written by -o, the exit status is 1 on a regression
+	-t	regression threshold in percent, 5 by default
+	-i	read the results from a file written by -o instead of running the cases, to compare two runs
+	-q	only the 4096 pairs batches and 2 passes, for a quick check
+	-e	add a raw event, up to MAX_RAW of them
+    A case regresses when its cycles (ns if either run has no cycles) or its instructions per addition grew by more
+    than the threshold. Instructions hardly move between runs, so they catch a regression on a noisy machine.
+*/
+
+#include "comparison_utilities.h"
+#include "comparison_perf.h"
+#include <string.h>
+
+#define PASSES 5		// Timings are the best of a few passes
+#define TOTAL (1 << 18)		// Additions per case and pass
+#define MAX_RAW 4
+#define MAX_COUNTERS (8 + MAX_RAW)
+#define OPERATIONS 7
+#define DISTRIBUTIONS 3
+#define MAX_RESULTS 1024
+
+typedef struct
+{
+    char name[32];
+    uint32_t type;
+    uint64_t config;
+    int fd;
+} counter;
+
+typedef struct
+{
+    char operation[32];
+    char distribution[16];
+    int precision;
+    long batch;
+    double ns;
+    double value[MAX_COUNTERS];		// Per addition, negative where the counter is n/a
+} result;
+
+// One batch of pairs at one precision, as mpfr_t, pointers and packed arrays
+typedef struct
+{
+    uint16_t precision;
+    size_t n;
+    mpfr_t *a, *b, *r, *expected;
+    mpfr_ptr *pa, *pb, *pr;
+    mpfr_t copy1, copy2;
+    avxmpfr_array op1, op2, rop;
+} batch;
+
+typedef void (*operation)(batch *c);
+
+static counter counters[MAX_COUNTERS] = {
+    {"task_clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1},
+    {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1},
+    {"stalled_frontend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, -1},
+    {"stalled_backend", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, -1},
+};
+static int counter_count = 8;
+
+enum {TASK_CLOCK, CYCLES, INSTRUCTIONS};
+
+void counters_start()
+{
+    for (int k = 0; k < counter_count; k++)
+	counter_start(counters[k].fd);
+}
+
+void counters_stop()
+{
+    for (int k = 0; k < counter_count; k++)
+	counter_stop(counters[k].fd);
+}
+
+
+/* The operations, each adds the whole batch once */
+
+void run_mpfr(batch *c)
+{
+    for (size_t i = 0; i < c->n; i++)
+	mpfr_add(c->r[i], c->a[i], c->b[i], MPFR_RNDZ);
+}
+
+void run_avxmpfr(batch *c)
+{
+    for (size_t i = 0; i < c->n; i++)
+    {
+	mpfr_set(c->copy1, c->a[i], MPFR_RNDN);
+	mpfr_set(c->copy2, c->b[i], MPFR_RNDN);
+	if (c->precision == PRECISION_256)
+	    avxmpfr_add(c->r[i], c->copy1, c->copy2, MPFR_RNDZ, PRECISION_256);
+	else
+	    avxmpfr_add_512(c->r[i], c->copy1, c->copy2, MPFR_RNDZ, PRECISION_512);
+    }
+}
+
+void run_prec(batch *c)
+{
+    for (size_t i = 0; i < c->n; i++)
+	avxmpfr_add_prec(c->r[i], c->a[i], c->b[i], MPFR_RNDZ);
+}
+
+void run_multi(batch *c)
+{
+    for (size_t i = 0; i < c->n; i += AVXMPFR_MULTI_MAX)
+    {
+	const int count = (c->n - i < AVXMPFR_MULTI_MAX) ? (int) (c->n - i) : AVXMPFR_MULTI_MAX;
+	avxmpfr_add_multi(c->pr + i, c->pa + i, c->pb + i, count, MPFR_RNDZ, c->precision);
+    }
+}
+
+void run_ptr_vec(batch *c)
+{
+    avxmpfr_add_ptr_vec(c->pr, c->pa, c->pb, c->n, MPFR_RNDZ, c->precision);
+}
+
+void run_array(batch *c)
+{
+    avxmpfr_add_array(&c->rop, &c->op1, &c->op2);
+}
+
+void run_bucketed(batch *c)
+{
+    avxmpfr_add_array_bucketed(&c->rop, &c->op1, &c->op2);
+}
+
+static const operation operations[OPERATIONS] = {run_mpfr, run_avxmpfr, run_prec, run_multi, run_ptr_vec, run_array, run_bucketed};
+static const char *operation_names[OPERATIONS] = {"mpfr_add", "avxmpfr_add", "avxmpfr_add_prec", "avxmpfr_add_multi",
+						  "avxmpfr_add_ptr_vec", "avxmpfr_add_array", "avxmpfr_add_array_bucketed"};
+static const char *distribution_names[DISTRIBUTIONS] = {"equal", "realistic", "mixed"};
+
+
+/* Batches */
+
+void batch_init(batch *c, uint16_t precision, size_t n)
+{
+    c->precision = precision;
+    c->n = n;
+    c->a = malloc(n * sizeof(mpfr_t));
+    c->b = malloc(n * sizeof(mpfr_t));
+    c->r = malloc(n * sizeof(mpfr_t));
+    c->expected = malloc(n * sizeof(mpfr_t));
+    c->pa = malloc(n * sizeof(mpfr_ptr));
+    c->pb = malloc(n * sizeof(mpfr_ptr));
+    c->pr = malloc(n * sizeof(mpfr_ptr));
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_inits2(precision, c->a[i], c->b[i], c->r[i], c->expected[i], (mpfr_ptr) 0);
+	c->pa[i] = c->a[i];
+	c->pb[i] = c->b[i];
+	c->pr[i] = c->r[i];
+    }
+    mpfr_inits2(precision, c->copy1, c->copy2, (mpfr_ptr) 0);
+    avxmpfr_array_init(&c->op1, precision, AVXMPFR_LAYOUT_NATIVE, n);
+    avxmpfr_array_init(&c->op2, precision, AVXMPFR_LAYOUT_NATIVE, n);
+    avxmpfr_array_init(&c->rop, precision, AVXMPFR_LAYOUT_NATIVE, n);
+}
+
+void batch_clear(batch *c)
+{
+    for (size_t i = 0; i < c->n; i++)
+	mpfr_clears(c->a[i], c->b[i], c->r[i], c->expected[i], (mpfr_ptr) 0);
+    mpfr_clears(c->copy1, c->copy2, (mpfr_ptr) 0);
+    avxmpfr_array_clear(&c->op1);
+    avxmpfr_array_clear(&c->op2);
+    avxmpfr_array_clear(&c->rop);
+    free(c->a);
+    free(c->b);
+    free(c->r);
+    free(c->expected);
+    free(c->pa);
+    free(c->pb);
+    free(c->pr);
+}
+
+// Fill the batch with pairs of the same sign, the gaps following distribution, and their sums with MPFR_RNDZ
+void batch_fill(batch *c, int distribution, avxmpfr_random *state)
+{
+    avxmpfr_urandom_vec(c->a, c->n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    avxmpfr_urandom_vec(c->b, c->n, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    for (size_t i = 0; i < c->n; i++)
+    {
+	mpfr_setsign(c->b[i], c->b[i], mpfr_signbit(c->a[i]), MPFR_RNDN);
+	if (distribution == 0)
+	    mpfr_set_exp(c->b[i], mpfr_get_exp(c->a[i]));
+	else if (distribution == 2)
+	    mpfr_set_exp(c->b[i], mpfr_get_exp(c->a[i]) - rand() % (2 * c->precision));
+	mpfr_add(c->expected[i], c->a[i], c->b[i], MPFR_RNDZ);
+	avxmpfr_array_set(&c->op1, i, c->a[i]);
+	avxmpfr_array_set(&c->op2, i, c->b[i]);
+    }
+}
+
+// 1 if the last run of operation k left every sum equal to mpfr_add() with MPFR_RNDZ
+int batch_check(batch *c, int k)
+{
+    mpfr_t got;
+    mpfr_init2(got, c->precision);
+    int correct = 1;
+    for (size_t i = 0; i < c->n; i++)
+    {
+	if (operations[k] == run_array || operations[k] == run_bucketed)
+	    avxmpfr_array_get(got, &c->rop, i, MPFR_RNDZ);
+	else
+	    mpfr_set(got, c->r[i], MPFR_RNDN);
+
+	// avxmpfr_add() / _512() leave the sign to the caller and only allign gaps below a lane
+	if (operations[k] == run_avxmpfr)
+	    correct &= labs(mpfr_get_exp(c->a[i]) - mpfr_get_exp(c->b[i])) >= 63 || mpfr_cmpabs(got, c->expected[i]) == 0;
+	else
+	    correct &= mpfr_equal_p(got, c->expected[i]) && mpfr_signbit(got) == mpfr_signbit(c->expected[i]);
+	mpfr_set_zero(c->r[i], 1);
+    }
+    mpfr_clear(got);
+    return correct;
+}
+
+// Run operation k over the batch, the best of passes passes into res
+void measure(batch *c, int k, int passes, result *res)
+{
+    const size_t repeats = TOTAL / c->n > 0 ? TOTAL / c->n : 1;
+    const double additions = (double) repeats * c->n;
+    res->ns = -1;
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+	double value[MAX_COUNTERS];
+	counters_start();
+	const double start = wall_time();
+	for (size_t j = 0; j < repeats; j++)
+	    operations[k](c);
+	const double ns = (wall_time() - start) * 1e9 / additions;
+	counters_stop();
+	for (int m = 0; m < counter_count; m++)
+	{
+	    const double count = counter_read(counters[m].fd);
+	    value[m] = count < 0 ? -1 : count / additions;
+	}
+
+	// The best pass by cycles, or by time if they are n/a
+	const int better = res->ns < 0 || (value[CYCLES] >= 0 ? value[CYCLES] < res->value[CYCLES] : ns < res->ns);
+	if (better)
+	{
+	    res->ns = ns;
+	    memcpy(res->value, value, sizeof(value));
+	}
+    }
+}
+
+
+/* Results files, one result per line so that they read back line by line */
+
+// The string after "key": in line into out, 0 if it is not there
+int json_string(const char *line, const char *key, char *out, size_t size)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%.40s\": \"", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL)
+	return 0;
+    p += strlen(pattern);
+    size_t length = 0;
+    while (p[length] != '"' && p[length] != '\0' && length + 1 < size)
+    {
+	out[length] = p[length];
+	length++;
+    }
+    out[length] = '\0';
+    return 1;
+}
+
+// The number after "key": in line, -1 if it is null or not there
+double json_number(const char *line, const char *key)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%.40s\": ", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL)
+	return -1;
+    char *end;
+    const double value = strtod(p + strlen(pattern), &end);
+    return end == p + strlen(pattern) ? -1 : value;
+}
+
+// The model name of the CPU, without quotes
+void cpu_name(char *out, size_t size)
+{
+    snprintf(out, size, "unknown");
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file == NULL)
+	return;
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+	if (strncmp(line, "model name", 10) == 0 && strchr(line, ':'))
+	{
+	    const char *p = strchr(line, ':') + 2;
+	    size_t length = 0;
+	    for (; *p != '\0' && *p != '\n' && length + 1 < size; p++)
+		if (*p != '"' && *p != '\\')
+		    out[length++] = *p;
+	    out[length] = '\0';
+	    break;
+	}
+    fclose(file);
+}
+
+int write_results(const char *path, const char *cpu, const result *results, int count)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+	return -1;
+    fprintf(file, "{\n\"cpu\": \"%s\",\n\"unit\": \"per addition\",\n\"counters\": [", cpu);
+    for (int m = 0; m < counter_count; m++)
+	fprintf(file, "%s\"%s\"", m ? ", " : "", counters[m].name);
+    fprintf(file, "],\n\"results\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+	fprintf(file, "{\"operation\": \"%s\", \"precision\": %d, \"batch\": %ld, \"distribution\": \"%s\", \"ns\": %.4f",
+		results[i].operation, results[i].precision, results[i].batch, results[i].distribution, results[i].ns);
+	for (int m = 0; m < counter_count; m++)
+	    if (results[i].value[m] < 0)
+		fprintf(file, ", \"%s\": null", counters[m].name);
+	    else
+		fprintf(file, ", \"%s\": %.4f", counters[m].name, results[i].value[m]);
+	fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "]\n}\n");
+    return fclose(file);
+}
+
+// The results of a file written by write_results(), at most MAX_RESULTS of them, -1 if it cannot be read
+int read_results(const char *path, char *cpu, size_t size, result *results)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+	return -1;
+    char line[2048];
+    int count = 0;
+    snprintf(cpu, size, "unknown");
+    while (fgets(line, sizeof(line), file) && count < MAX_RESULTS)
+    {
+	json_string(line, "cpu", cpu, size);
+	result *res = results + count;
+	if (!json_string(line, "operation", res->operation, sizeof(res->operation)))
+	    continue;
+	json_string(line, "distribution", res->distribution, sizeof(res->distribution));
+	res->precision = (int) json_number(line, "precision");
+	res->batch = (long) json_number(line, "batch");
+	res->ns = json_number(line, "ns");
+	for (int m = 0; m < counter_count; m++)
+	    res->value[m] = json_number(line, counters[m].name);
+	count++;
+    }
+    fclose(file);
+    return count;
+}
+
+// Print the cases that moved by more than threshold percent against the baseline, returns the number of regressions
+int compare_results(const result *results, int count, const result *baseline, int baseline_count, double threshold)
+{
+    int regressions = 0, improvements = 0, missing = 0;
+    printf("\n%-28s %5s %7s %10s %14s %10s %10s %8s\n", "operation", "bits", "batch", "gaps", "metric", "baseline", "now", "change");
+    for (int i = 0; i < count; i++)
+    {
+	const result *now = results + i, *base = NULL;
+	for (int j = 0; j < baseline_count && base == NULL; j++)
+	    if (strcmp(baseline[j].operation, now->operation) == 0 && strcmp(baseline[j].distribution, now->distribution) == 0
+		&& baseline[j].precision == now->precision && baseline[j].batch == now->batch)
+		base = baseline + j;
+	if (base == NULL)
+	{
+	    missing++;
+	    continue;
+	}
+
+	// The time metric, cycles if both runs have them, and instructions where both have them
+	const int have_cycles = now->value[CYCLES] >= 0 && base->value[CYCLES] >= 0;
+	const double times[2][2] = {{base->ns, now->ns}, {base->value[CYCLES], now->value[CYCLES]}};
+	const double pairs[2][2] = {{times[have_cycles][0], times[have_cycles][1]}, {base->value[INSTRUCTIONS], now->value[INSTRUCTIONS]}};
+	const char *metrics[2] = {have_cycles ? "cycles" : "ns", "instructions"};
+	for (int m = 0; m < 2; m++)
+	{
+	    if (pairs[m][0] <= 0 || pairs[m][1] < 0)
+		continue;
+	    const double change = (pairs[m][1] / pairs[m][0] - 1) * 100;
+	    if (change > threshold)
+		regressions++;
+	    else if (change < -threshold)
+		improvements++;
+	    else
+		continue;
+	    printf("%s%-28s %5d %7ld %10s %14s %10.2f %10.2f %+7.1f%%\x1b[0m\n", change > 0 ? "\x1b[31m" : "\x1b[32m",
+		   now->operation, now->precision, now->batch, now->distribution, metrics[m], pairs[m][0], pairs[m][1], change);
+	}
+    }
+    printf("\n%d regressions, %d improvements beyond %.1f%%, %d cases not in the baseline\n", regressions, improvements,
+	   threshold, missing);
+    return regressions;
+}
+
+void print_usage(const char *name)
+{
+    printf("usage: %s [-o results.json] [-b baseline.json] [-t percent] [-i results.json] [-q] [-e name=config]\n", name);
+}
+
+// A counter per addition for the table, n/a if there is none
+void print_value(double value, int width, int decimals)
+{
+    if (value < 0)
+	printf(" %*s", width, "n/a");
+    else
+	printf(" %*.*f", width, decimals, value);
+}
+
+int main(int argc, char **argv)
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const char *output = "comparison_counters.json", *baseline_path = NULL, *input = NULL;
+    double threshold = 5;
+    int quick = 0;
+    for (int i = 1; i < argc; i++)
+    {
+	const int has_value = i + 1 < argc;
+	if (strcmp(argv[i], "-o") == 0 && has_value)
+	    output = argv[++i];
+	else if (strcmp(argv[i], "-b") == 0 && has_value)
+	    baseline_path = argv[++i];
+	else if (strcmp(argv[i], "-i") == 0 && has_value)
+	    input = argv[++i];
+	else if (strcmp(argv[i], "-t") == 0 && has_value)
+	    threshold = atof(argv[++i]);
+	else if (strcmp(argv[i], "-q") == 0)
+	    quick = 1;
+	else if (strcmp(argv[i], "-e") == 0 && has_value && counter_count < MAX_COUNTERS && strchr(argv[i + 1], '='))
+	{
+	    counter *raw = counters + counter_count++;
+	    const char *event = argv[++i];
+	    const size_t length = strchr(event, '=') - event;
+	    snprintf(raw->name, sizeof(raw->name), "%.*s", (int) (length < sizeof(raw->name) ? length : sizeof(raw->name) - 1), event);
+	    raw->type = PERF_TYPE_RAW;
+	    raw->config = strtoull(event + length + 1, NULL, 0);
+	    raw->fd = -1;
+	}
+	else
+	{
+	    print_usage(argv[0]);
+	    return 2;
+	}
+    }
+
+    result *results = malloc(MAX_RESULTS * sizeof(result));
+    char cpu[256];
+    int count = 0, all_correct = 1;
+
+    if (input != NULL)
+    {
+	count = read_results(input, cpu, sizeof(cpu), results);
+	if (count < 0)
+	{
+	    printf("cannot read %s\n", input);
+	    return 2;
+	}
+    }
+    else
+    {
+	cpu_name(cpu, sizeof(cpu));
+	printf("\n%s\nCounters:", cpu);
+	for (int m = 0; m < counter_count; m++)
+	{
+	    counters[m].fd = counter_open(counters[m].type, counters[m].config);
+	    printf(" %s%s", counters[m].name, counters[m].fd < 0 ? " (n/a)" : "");
+	}
+	printf("\n");
+
+	const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+	const size_t batches[3] = {64, 4096, 1 << 18};
+	avxmpfr_random state;
+	avxmpfr_random_init(&state, time(NULL), 0);
+
+	for (int p = 0; p < 2; p++)
+	    for (int s = quick; s < (quick ? 2 : 3); s++)
+	    {
+		batch c;
+		batch_init(&c, precisions[p], batches[s]);
+		printf("\n%d bits, %lu pairs, per addition\n%-28s %10s %8s %8s %6s %8s %8s %8s %8s %8s\n", precisions[p],
+		       (unsigned long) batches[s], "operation", "gaps", "ns", "cycles", "IPC", "br-miss", "L1d-miss", "LLC-miss",
+		       "fe-stall", "be-stall");
+		for (int d = 0; d < DISTRIBUTIONS; d++)
+		{
+		    batch_fill(&c, d, &state);
+		    for (int k = 0; k < OPERATIONS; k++)
+		    {
+			// One run to check the sums and warm the caches
+			operations[k](&c);
+			const int correct = batch_check(&c, k);
+			all_correct &= correct;
+
+			result *res = results + count++;
+			snprintf(res->operation, sizeof(res->operation), "%s", (k == 1 && precisions[p] == PRECISION_512) ? "avxmpfr_add_512" : operation_names[k]);
+			snprintf(res->distribution, sizeof(res->distribution), "%s", distribution_names[d]);
+			res->precision = precisions[p];
+			res->batch = batches[s];
+			measure(&c, k, quick ? 2 : PASSES, res);
+
+			const double *v = res->value;
+			printf("%-28s %10s %8.2f", res->operation, res->distribution, res->ns);
+			print_value(v[CYCLES], 8, 1);
+			print_value(v[CYCLES] > 0 && v[INSTRUCTIONS] >= 0 ? v[INSTRUCTIONS] / v[CYCLES] : -1, 6, 2);
+			for (int m = 3; m < 8; m++)
+			    print_value(v[m], 8, 3);
+			printf("%s\n", correct ? "" : "  differs");
+		    }
+		}
+		batch_clear(&c);
+	    }
+
+	for (int m = 0; m < counter_count; m++)
+	    if (counters[m].fd >= 0)
+		close(counters[m].fd);
+
+	if (write_results(output, cpu, results, count) != 0)
+	    printf("\ncannot write %s\n", output);
+	else
+	    printf("\nResults written to %s\n", output);
+    }
+
+    int regressions = 0;
+    if (baseline_path != NULL)
+    {
+	result *baseline = malloc(MAX_RESULTS * sizeof(result));
+	char baseline_cpu[256];
+	const int baseline_count = read_results(baseline_path, baseline_cpu, sizeof(baseline_cpu), baseline);
+	if (baseline_count < 0)
+	{
+	    printf("cannot read %s\n", baseline_path);
+	    return 2;
+	}
+	if (strcmp(cpu, baseline_cpu) != 0)
+	    printf("\nThe baseline comes from another CPU (%s)\n", baseline_cpu);
+	regressions = compare_results(results, count, baseline, baseline_count, threshold);
+	free(baseline);
+    }
+
+    if (input == NULL)
+    {
+	if (all_correct)
+	    printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+	else
+	    printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+    }
+
+    free(results);
+    return regressions > 0;
+}
@@ -0,0 +1,191 @@
+/*
+    Test file to compare avxmpfr_exp_vec(), avxmpfr_log_vec() and avxmpfr_sincos_vec() against mpfr_exp(),
+    mpfr_log() and mpfr_sin_cos() called in a loop.
+
+    Every result has to have the bits of the mpfr one, which is correctly rounded, in every rounding mode, at
+    precisions from 2 bits to PRECISION_512 (and beyond it, where the batched functions hand everything to mpfr), with
+    destinations of mixed precisions and in place. The arguments are random with exponents where the results are
+    ordinary plus awkward ones: zeros, infinities, NaNs, negatives for log, values next to 1, next to multiples of
+    pi / 2 and past the range the vector path reduces.
+
+    The timings are ns per value at 252 and 504 bits for arguments of both signs with exponents in [-8, 4).
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+// Overwrite some arguments with awkward ones, sixteen of each sixty four
+void assign_awkward(mpfr_t *x, size_t n)
+{
+    mpfr_t pi;
+    mpfr_init2(pi, 1024);
+    mpfr_const_pi(pi, MPFR_RNDN);
+    for (size_t i = 0; i < n; i += 4)
+    {
+	switch (rand() % 12)
+	{
+	    case 0: mpfr_set_zero(x[i], rand() % 2 ? 1 : -1); break;
+	    case 1: mpfr_set_inf(x[i], rand() % 2 ? 1 : -1); break;
+	    case 2: mpfr_set_nan(x[i]); break;
+	    case 3: mpfr_set_ui(x[i], 1, MPFR_RNDN); break;
+	    case 4: mpfr_set_ui_2exp(x[i], 1, -(rand() % 200), MPFR_RNDN);
+		    mpfr_add_ui(x[i], x[i], 1, MPFR_RNDN); break;			// 1 + 2^-k, rounded
+	    case 5: mpfr_set_si_2exp(x[i], rand() % 2 ? 1 : -1, -(rand() % 2000), MPFR_RNDN); break;
+	    case 6: mpfr_mul_si(x[i], pi, rand() % 64 - 32, MPFR_RNDN);
+		    mpfr_div_2ui(x[i], x[i], 1, MPFR_RNDN); break;			// k pi / 2, rounded
+	    case 7: assign_random(x[i], 20, 60, RANDOM_SIGNED); break;			// Past the reduction ranges
+	    case 8: mpfr_set_si(x[i], rand() % 2 ? 710 : -745, MPFR_RNDN); break;	// exp near overflow / underflow
+	    case 9: assign_random(x[i], -60, -20, RANDOM_SIGNED); break;
+	    default: assign_random(x[i], -4, 12, RANDOM_SIGNED); break;
+	}
+    }
+    mpfr_clear(pi);
+}
+
+// 1 if the n values of a are those of b, NaNs and signs of zeros included
+int same(mpfr_t *a, mpfr_t *b, size_t n)
+{
+    int equal = 1;
+    for (size_t i = 0; i < n; i++)
+	equal &= (mpfr_nan_p(a[i]) && mpfr_nan_p(b[i]))
+		 || (mpfr_equal_p(a[i], b[i]) && mpfr_signbit(a[i]) == mpfr_signbit(b[i]));
+    return equal;
+}
+
+enum { EXP, LOG, SINCOS };
+const char *names[3] = {"exp", "log", "sin_cos"};
+
+// The function on n values, batched or through the mpfr loop. Sines (or the only results) in s, cosines in c
+void evaluate(int function, int batched, mpfr_t *s, mpfr_t *c, mpfr_t *x, size_t n, mpfr_rnd_t rnd)
+{
+    if (batched)
+    {
+	if (function == EXP)
+	    avxmpfr_exp_vec(s, x, n, rnd);
+	else if (function == LOG)
+	    avxmpfr_log_vec(s, x, n, rnd);
+	else
+	    avxmpfr_sincos_vec(s, c, x, n, rnd);
+	return;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+	if (function == EXP)
+	    mpfr_exp(s[i], x[i], rnd);
+	else if (function == LOG)
+	    mpfr_log(s[i], x[i], rnd);
+	else
+	    mpfr_sin_cos(s[i], c[i], x[i], rnd);
+    }
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {2, 24, 53, 113, 200, PRECISION_256, 300, 400, PRECISION_512, 640};
+    const mpfr_rnd_t modes[5] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const size_t n = 4096, timed = 1024;
+    const int repeats = 4;
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(n * sizeof(mpfr_t));
+    mpfr_t *s = malloc(n * sizeof(mpfr_t)), *c = malloc(n * sizeof(mpfr_t));
+    mpfr_t *es = malloc(n * sizeof(mpfr_t)), *ec = malloc(n * sizeof(mpfr_t));
+
+    // Every precision and rounding mode, arguments and results of one precision, then of mixed ones
+    for (int p = 0; p <= 10; p++)
+    {
+	const int mixed = p == 10;
+	for (size_t i = 0; i < n; i++)
+	{
+	    const mpfr_prec_t prec = mixed ? precisions[rand() % 9] : precisions[p];
+	    mpfr_inits2(prec, s[i], c[i], es[i], ec[i], (mpfr_ptr) 0);
+	    mpfr_init2(x[i], mixed ? precisions[rand() % 9] : prec);
+	}
+
+	for (int function = 0; function < 3; function++)
+	{
+	    int correct = 1;
+	    for (int m = 0; m < 5; m++)
+	    {
+		for (size_t i = 0; i < n; i++)
+		    assign_random(x[i], function == LOG ? -64 : -16, function == LOG ? 64 : 8, RANDOM_SIGNED);
+		assign_awkward(x, n);
+		if (function == LOG)
+		    for (size_t i = 0; i < n; i++)
+			if (rand() % 8)
+			    mpfr_abs(x[i], x[i], MPFR_RNDN);
+
+		evaluate(function, 0, es, ec, x, n, modes[m]);
+		evaluate(function, 1, s, c, x, n, modes[m]);
+		correct &= same(s, es, n) && (function != SINCOS || same(c, ec, n));
+
+		// In place, where the destinations have the precision of the arguments
+		if (!mixed)
+		{
+		    evaluate(function, 1, x, c, x, n, modes[m]);
+		    correct &= same(x, es, n);
+		}
+	    }
+	    if (!correct)
+	    {
+		if (mixed)
+		    printf("%s differs at mixed precisions\n", names[function]);
+		else
+		    printf("%s differs at precision %ld\n", names[function], (long) precisions[p]);
+	    }
+	    all_correct &= correct;
+	}
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(x[i], s[i], c[i], es[i], ec[i], (mpfr_ptr) 0);
+    }
+
+    // Timings
+    printf("\nns per value, speedup over the mpfr loop\n\n");
+    printf("%10s %10s %14s %14s %9s\n", "precision", "function", "mpfr", "batched", "speedup");
+    for (int p = 0; p < 2; p++)
+    {
+	const mpfr_prec_t prec = p ? PRECISION_512 : PRECISION_256;
+	for (size_t i = 0; i < timed; i++)
+	{
+	    mpfr_inits2(prec, x[i], s[i], c[i], (mpfr_ptr) 0);
+	    assign_random(x[i], -8, 4, RANDOM_SIGNED);
+	}
+
+	for (int function = 0; function < 3; function++)
+	{
+	    if (function == LOG)
+		for (size_t i = 0; i < timed; i++)
+		    mpfr_abs(x[i], x[i], MPFR_RNDN);
+
+	    double time[2];
+	    for (int batched = 0; batched < 2; batched++)
+	    {
+		const double start = wall_time();
+		for (int k = 0; k < repeats; k++)
+		    evaluate(function, batched, s, c, x, timed, MPFR_RNDN);
+		time[batched] = (wall_time() - start) / (repeats * timed) * 1e9;
+	    }
+	    printf("%10ld %10s %14.1f %14.1f %8.2fx\n", (long) prec, names[function], time[0], time[1],
+		   time[0] / time[1]);
+	}
+
+	for (size_t i = 0; i < timed; i++)
+	    mpfr_clears(x[i], s[i], c[i], (mpfr_ptr) 0);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x);
+    free(s);
+    free(c);
+    free(es);
+    free(ec);
+    return 0;
+}
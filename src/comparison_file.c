@@ -0,0 +1,269 @@
+/*
+    Test file to measure end-to-end file -> sum -> file bandwidth of the packed array container.
+
+    For every precision and layout, two files of random values of either sign are written first (untimed). The timed
+    part maps both, adds them chunk by chunk with avxmpfr_add_array() and streams the sums out with an avxmpfr_writer.
+
+    For reference the same values go through the text path: mpfr_inp_str() -> mpfr_add() -> mpfr_out_str().
+    Every sum in the output file is checked against mpfr_add() with MPFR_RNDZ on the same inputs, which is what the
+    packed array gives for either sign. Sums of signed zeros, and of a zero and a number of either sign, are checked
+    the same way in every precision and layout.
+*/
+
+#include "comparison_utilities.h"
+#include <unistd.h>
+
+// Add every pair of +0, -0, +1 and -1 in packed arrays, returns the number of sums (sign included) unlike mpfr_add()
+uint64_t check_zeros()
+{
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    const uint32_t layouts[2] = {AVXMPFR_LAYOUT_NATIVE, AVXMPFR_LAYOUT_SOA};
+    const int values[4][2] = {{0, 1}, {0, -1}, {1, 1}, {1, -1}};	// Magnitude, sign
+    uint64_t mismatches = 0;
+
+    for (int p = 0; p < 2; p++)
+	for (int l = 0; l < 2; l++)
+	{
+	    avxmpfr_array op1, op2, rop;
+	    avxmpfr_array_init(&op1, precisions[p], layouts[l], 16);
+	    avxmpfr_array_init(&op2, precisions[p], layouts[l], 16);
+	    avxmpfr_array_init(&rop, precisions[p], layouts[l], 16);
+	    mpfr_t a[16], b[16], expected, actual;
+	    mpfr_inits2(precisions[p], expected, actual, NULL);
+
+	    for (int i = 0; i < 16; i++)
+	    {
+		mpfr_inits2(precisions[p], a[i], b[i], NULL);
+		mpfr_set_si(a[i], values[i / 4][0], MPFR_RNDN);
+		mpfr_setsign(a[i], a[i], values[i / 4][1] < 0, MPFR_RNDN);
+		mpfr_set_si(b[i], values[i % 4][0], MPFR_RNDN);
+		mpfr_setsign(b[i], b[i], values[i % 4][1] < 0, MPFR_RNDN);
+		avxmpfr_array_set(&op1, i, a[i]);
+		avxmpfr_array_set(&op2, i, b[i]);
+	    }
+	    avxmpfr_add_array(&rop, &op1, &op2);
+
+	    for (int i = 0; i < 16; i++)
+	    {
+		mpfr_add(expected, a[i], b[i], MPFR_RNDZ);
+		avxmpfr_array_get(actual, &rop, i, MPFR_RNDZ);
+		mismatches += !mpfr_equal_p(expected, actual) || mpfr_signbit(expected) != mpfr_signbit(actual);
+		mpfr_clears(a[i], b[i], NULL);
+	    }
+
+	    mpfr_clears(expected, actual, NULL);
+	    avxmpfr_array_clear(&op1);
+	    avxmpfr_array_clear(&op2);
+	    avxmpfr_array_clear(&rop);
+	}
+    return mismatches;
+}
+
+// Write two files of count values, add them through the container and check every sum. Returns the number of sums
+// equal to mpfr_add() with MPFR_RNDZ, -1 if a file could not be opened
+int64_t run_files(uint16_t PRECISION, uint32_t LAYOUT, uint64_t count, uint64_t chunk, uint64_t text_count)
+{
+    const char* first_path = "comparison_first.avx";
+    const char* second_path = "comparison_second.avx";
+    const char* result_path = "comparison_result.avx";
+
+    // Write the two input files
+    mpfr_t number;
+    mpfr_init2(number, PRECISION);
+    avxmpfr_array block_buffer;
+    avxmpfr_array_init(&block_buffer, PRECISION, LAYOUT, chunk);
+
+    const char* inputs[2] = {first_path, second_path};
+    for (int f = 0; f < 2; f++)
+    {
+	avxmpfr_writer writer;
+	if (avxmpfr_writer_open(&writer, inputs[f], PRECISION, LAYOUT) < 0)
+	{
+	    perror(inputs[f]);
+	    return -1;
+	}
+	for (uint64_t i = 0; i < count; i += chunk)
+	{
+	    for (uint64_t j = 0; j < chunk; j++)
+	    {
+		assign_random(number, -32, 32, RANDOM_SIGNED);
+		avxmpfr_array_set(&block_buffer, j, number);
+	    }
+	    avxmpfr_writer_append(&writer, &block_buffer);
+	}
+	avxmpfr_writer_close(&writer);
+    }
+
+
+    /* Packed file path */
+    double start = wall_time();
+
+    avxmpfr_file first, second;
+    avxmpfr_writer result;
+    if (avxmpfr_file_open(&first, first_path) < 0 || avxmpfr_file_open(&second, second_path) < 0
+	|| avxmpfr_writer_open(&result, result_path, PRECISION, LAYOUT) < 0)
+    {
+	perror("open");
+	return -1;
+    }
+
+    for (uint64_t i = 0; i < count; i += chunk)
+    {
+	avxmpfr_array first_view, second_view;
+	uint64_t n = (count - i < chunk) ? count - i : chunk;
+	avxmpfr_array_view(&first_view, &first.array, i, n);
+	avxmpfr_array_view(&second_view, &second.array, i, n);
+	block_buffer.count = n;
+
+	avxmpfr_add_array(&block_buffer, &first_view, &second_view);
+	avxmpfr_writer_append(&result, &block_buffer);
+    }
+    avxmpfr_writer_close(&result);
+
+    double packed_time = wall_time() - start;
+    double packed_bytes = 3.0 * avxmpfr_array_blocks(count) * avxmpfr_block_words(first.array.limbs) * sizeof(uint64_t);
+
+
+    /* Check every sum against mpfr_add() */
+    avxmpfr_file sums;
+    avxmpfr_file_open(&sums, result_path);
+    mpfr_t number1, number2, expected, actual;
+    mpfr_inits2(PRECISION, number1, number2, expected, actual, NULL);
+    int64_t total = 0;
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+	avxmpfr_array_get(number1, &first.array, i, MPFR_RNDN);
+	avxmpfr_array_get(number2, &second.array, i, MPFR_RNDN);
+	mpfr_add(expected, number1, number2, MPFR_RNDZ);
+
+	avxmpfr_array_get(actual, &sums.array, i, MPFR_RNDN);
+	total += mpfr_equal_p(expected, actual) && mpfr_signbit(expected) == mpfr_signbit(actual);
+    }
+
+
+    /* Text path on a prefix of the same values */
+    FILE* text_files[2];
+    const char* text_paths[2] = {"comparison_first.txt", "comparison_second.txt"};
+    const avxmpfr_array* text_sources[2] = {&first.array, &second.array};
+    for (int f = 0; f < 2; f++)
+    {
+	text_files[f] = fopen(text_paths[f], "w");
+	for (uint64_t i = 0; i < text_count; i++)
+	{
+	    avxmpfr_array_get(number, text_sources[f], i, MPFR_RNDN);
+	    mpfr_out_str(text_files[f], 2, 0, number, MPFR_RNDN);
+	    fputc('\n', text_files[f]);
+	}
+	fclose(text_files[f]);
+    }
+
+    start = wall_time();
+    text_files[0] = fopen(text_paths[0], "r");
+    text_files[1] = fopen(text_paths[1], "r");
+    FILE* text_result = fopen("comparison_result.txt", "w");
+    for (uint64_t i = 0; i < text_count; i++)
+    {
+	mpfr_inp_str(number1, text_files[0], 2, MPFR_RNDN);
+	mpfr_inp_str(number2, text_files[1], 2, MPFR_RNDN);
+	mpfr_add(expected, number1, number2, MPFR_RNDZ);
+	mpfr_out_str(text_result, 2, 0, expected, MPFR_RNDN);
+	fputc('\n', text_result);
+    }
+    fclose(text_files[0]);
+    fclose(text_files[1]);
+    fclose(text_result);
+    double text_time = wall_time() - start;
+
+    printf("%4d bits, %s:\t%ld / %ld sums match\n", PRECISION, LAYOUT == AVXMPFR_LAYOUT_SOA ? "SoA   " : "native",
+	   total, count);
+    printf("    Packed file -> avxmpfr_add_array() -> file:\t %f seconds, %f MB/s, %f Mvalues/s\n",
+	   packed_time, packed_bytes / packed_time / 1e6, count / packed_time / 1e6);
+    printf("    mpfr_inp_str() -> mpfr_add() -> mpfr_out_str():\t %f seconds, %f Mvalues/s\n",
+	   text_time, text_count / text_time / 1e6);
+
+    avxmpfr_file_close(&sums);
+    avxmpfr_file_close(&first);
+    avxmpfr_file_close(&second);
+    avxmpfr_array_clear(&block_buffer);
+    mpfr_clears(number, number1, number2, expected, actual, NULL);
+
+    unlink(first_path);
+    unlink(second_path);
+    unlink(result_path);
+    unlink(text_paths[0]);
+    unlink(text_paths[1]);
+    unlink("comparison_result.txt");
+
+    return total;
+}
+
+// Files that are too short or claim more values than they hold must be rejected, returns the number accepted
+uint64_t check_bad_files()
+{
+    const char* path = "comparison_bad.avx";
+    avxmpfr_array array;
+    avxmpfr_array_init(&array, PRECISION_256, AVXMPFR_LAYOUT_NATIVE, AVXMPFR_BLOCK);
+    uint64_t accepted = 0;
+
+    // Claimed counts: one block too many, and a count whose size overflows 64 bits
+    const uint64_t counts[2] = {2 * AVXMPFR_BLOCK, UINT64_MAX - 3};
+    for (int c = 0; c < 2; c++)
+    {
+	avxmpfr_writer writer;
+	avxmpfr_writer_open(&writer, path, PRECISION_256, AVXMPFR_LAYOUT_NATIVE);
+	avxmpfr_writer_append(&writer, &array);
+	writer.count = counts[c];
+	avxmpfr_writer_close(&writer);
+
+	avxmpfr_file file;
+	if (avxmpfr_file_open(&file, path) == 0)
+	{
+	    accepted++;
+	    avxmpfr_file_close(&file);
+	}
+	avxmpfr_file_close(&file);	// A second close, or one after a failed open, does nothing
+    }
+
+    // Shorter than a header
+    FILE* short_file = fopen(path, "w");
+    fputs("AVXMPFR", short_file);
+    fclose(short_file);
+    avxmpfr_file file;
+    accepted += avxmpfr_file_open(&file, path) == 0;
+
+    unlink(path);
+    avxmpfr_array_clear(&array);
+    return accepted;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    // Initialise some variables
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    const uint32_t layouts[2] = {AVXMPFR_LAYOUT_NATIVE, AVXMPFR_LAYOUT_SOA};
+    const uint64_t count = 1<<20;		// Values per file
+    const uint64_t chunk = 1<<12;		// Values summed and written per step, a multiple of AVXMPFR_BLOCK
+    const uint64_t text_count = 1<<15;		// Values for the (much slower) text path
+
+    printf("\n");
+    int equal = 1;
+    for (int p = 0; p < 2; p++)
+	for (int l = 0; l < 2; l++)
+	    equal &= run_files(precisions[p], layouts[l], count, chunk, text_count) == (int64_t) count;
+
+    const uint64_t zero_mismatches = check_zeros();
+    const uint64_t bad_accepted = check_bad_files();
+
+    printf("\nSums with zeros unlike mpfr_add() : %ld\n", zero_mismatches);
+    printf("Malformed files accepted : %ld\n", bad_accepted);
+    if (equal && zero_mismatches == 0 && bad_accepted == 0)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+    Test file to compare avxmpfr_add_ptr_vec() against adding the same scattered operands one at a time.
+
+    The operands live inside records of a bigger struct, the records are visited in a random order and the limb
+    blocks were allocated in yet another order, like values kept in the data structures of an application. Every sum
+    has to be mpfr_add() with MPFR_RNDZ, as the truncated sums of PRECISION_256 / PRECISION_512 operands are, and the
+    pairs with different signs or zeros, or with rop, op1 or op2 of another precision, have to be mpfr_add() with rnd.
+
+    The timings are ns per addition over COLD_RECORDS triples, well over a gigabyte of records and limbs so that the
+    working set is larger than the L3 cache and each pass starts cold, against a loop of mpfr_add() and a loop of
+    avxmpfr_add_prec() (a SIMD kernel without the prefetching and staging at 504 bits, mpfr_add() itself at 252 bits,
+    see avxmpfr_kernels.c). Each is the best of a few passes.
+*/
+
+#include "comparison_utilities.h"
+
+#define COLD_RECORDS (1 << 21)	// Triples of records for the timings
+#define PASSES 3
+
+// A value inside an application's struct
+typedef struct
+{
+    uint64_t id;
+    double weights[12];
+    mpfr_t value;
+    char name[24];
+} record;
+
+// A random permutation of 0 .. n - 1
+size_t *random_order(size_t n)
+{
+    size_t *order = malloc(n * sizeof(size_t));
+    for (size_t i = 0; i < n; i++)
+	order[i] = i;
+    for (size_t i = n; i > 1; i--)
+    {
+	const size_t j = (((size_t) rand() << 31) ^ rand()) % i;
+	const size_t t = order[i - 1];
+	order[i - 1] = order[j];
+	order[j] = t;
+    }
+    return order;
+}
+
+// 3 n records of the given precision, limbs allocated in a random order, with pointers to them in a random order
+record *make_records(mpfr_ptr *rop, mpfr_ptr *op1, mpfr_ptr *op2, size_t n, mpfr_prec_t precision, avxmpfr_random *state)
+{
+    record *records = malloc(3 * n * sizeof(record));
+    size_t *allocation = random_order(3 * n), *visit = random_order(3 * n);
+    mpfr_t batch[1024];
+    for (int k = 0; k < 1024; k++)
+	mpfr_init2(batch[k], precision);
+
+    for (size_t i = 0; i < 3 * n; i++)
+    {
+	records[allocation[i]].id = allocation[i];
+	mpfr_init2(records[allocation[i]].value, precision);
+    }
+    for (size_t i = 0; i < 3 * n; i++)
+    {
+	if (i % 1024 == 0)
+	    avxmpfr_urandom_vec(batch, 1024, state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+	mpfr_set(records[i].value, batch[i % 1024], MPFR_RNDN);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+	rop[i] = records[visit[3 * i]].value;
+	op1[i] = records[visit[3 * i + 1]].value;
+	op2[i] = records[visit[3 * i + 2]].value;
+    }
+
+    for (int k = 0; k < 1024; k++)
+	mpfr_clear(batch[k]);
+    free(allocation);
+    free(visit);
+    return records;
+}
+
+void clear_records(record *records, size_t n)
+{
+    for (size_t i = 0; i < 3 * n; i++)
+	mpfr_clear(records[i].value);
+    free(records);
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    mpfr_ptr *rop = malloc(COLD_RECORDS * sizeof(mpfr_ptr));
+    mpfr_ptr *op1 = malloc(COLD_RECORDS * sizeof(mpfr_ptr));
+    mpfr_ptr *op2 = malloc(COLD_RECORDS * sizeof(mpfr_ptr));
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, time(NULL), 0);
+    int all_correct = 1;
+
+    // Correctness, on sets small enough to check quickly, every length up to past a few chunks
+    for (int p = 0; p < 2; p++)
+	for (size_t n = 0; n < 100; n++)
+	{
+	    record *records = make_records(rop, op1, op2, n, precisions[p], &state);
+	    mpfr_t *expected = malloc((n + 1) * sizeof(mpfr_t));
+	    const mpfr_rnd_t rnd = rand() % 2 ? MPFR_RNDN : MPFR_RNDU;
+	    for (size_t i = 0; i < n; i++)
+	    {
+		// Mostly the same sign, with gaps past the lanes, some zeros and an overflow
+		if (rand() % 4)
+		    mpfr_setsign(op2[i], op2[i], mpfr_signbit(op1[i]), MPFR_RNDN);
+		mpfr_set_exp(op2[i], mpfr_get_exp(op1[i]) - rand() % (precisions[p] + 8));
+		if (rand() % 16 == 0)
+		    mpfr_set_zero(op1[i], 1);
+		if (i == 7)
+		{
+		    mpfr_set_exp(op1[i], mpfr_get_emax());
+		    mpfr_set(op2[i], op1[i], MPFR_RNDN);
+		}
+
+		// A few values of other precisions, rop only matters past the in place half
+		if (i % 11 == 3)
+		    mpfr_prec_round(op2[i], precisions[p] + 64, MPFR_RNDN);
+		if (i % 11 == 5)
+		    mpfr_prec_round(op1[i], precisions[p] - 64, MPFR_RNDN);
+		if (i % 11 == 9)
+		    mpfr_set_prec(rop[i], precisions[p] / 2);
+
+		mpfr_ptr result = i < n / 2 ? op1[i] : rop[i];
+		const int same_prec = mpfr_get_prec(op1[i]) == precisions[p] && mpfr_get_prec(op2[i]) == precisions[p]
+				      && mpfr_get_prec(result) == precisions[p];
+		mpfr_init2(expected[i], mpfr_get_prec(result));
+		mpfr_add(expected[i], op1[i], op2[i], mpfr_regular_p(op1[i]) && mpfr_signbit(op1[i]) == mpfr_signbit(op2[i])
+						      && i != 7 && same_prec ? MPFR_RNDZ : rnd);
+	    }
+
+	    // In place for the first half
+	    for (size_t i = 0; i < n / 2; i++)
+		rop[i] = op1[i];
+	    avxmpfr_add_ptr_vec(rop, op1, op2, n, rnd, precisions[p]);
+
+	    int correct = 1;
+	    for (size_t i = 0; i < n; i++)
+	    {
+		correct &= mpfr_equal_p(rop[i], expected[i]) && mpfr_signbit(rop[i]) == mpfr_signbit(expected[i]);
+		mpfr_clear(expected[i]);
+	    }
+	    if (!correct)
+		printf("differs at %d bits with %lu values\n", precisions[p], (unsigned long) n);
+	    all_correct &= correct;
+	    free(expected);
+	    clear_records(records, n);
+	}
+
+    // Timings on cold sets
+    printf("\nns per addition over %d scattered triples, operands of the same sign, exponents in [-16, 16)\n\n",
+	   COLD_RECORDS);
+    printf("%6s %12s %18s %12s %10s %18s\n", "bits", "mpfr_add", "avxmpfr_add_prec", "ptr_vec", "mpfr_add",
+	   "avxmpfr_add_prec");
+    for (int p = 0; p < 2; p++)
+    {
+	record *records = make_records(rop, op1, op2, COLD_RECORDS, precisions[p], &state);
+	for (size_t i = 0; i < COLD_RECORDS; i++)
+	    mpfr_setsign(op2[i], op2[i], mpfr_signbit(op1[i]), MPFR_RNDN);
+
+	double best[3] = {1e300, 1e300, 1e300};
+	for (int pass = 0; pass < PASSES; pass++)
+	{
+	    double start = wall_time();
+	    for (size_t i = 0; i < COLD_RECORDS; i++)
+		mpfr_add(rop[i], op1[i], op2[i], MPFR_RNDZ);
+	    double time = wall_time() - start;
+	    best[0] = time < best[0] ? time : best[0];
+
+	    start = wall_time();
+	    for (size_t i = 0; i < COLD_RECORDS; i++)
+		avxmpfr_add_prec(rop[i], op1[i], op2[i], MPFR_RNDZ);
+	    time = wall_time() - start;
+	    best[1] = time < best[1] ? time : best[1];
+
+	    start = wall_time();
+	    avxmpfr_add_ptr_vec(rop, op1, op2, COLD_RECORDS, MPFR_RNDZ, precisions[p]);
+	    time = wall_time() - start;
+	    best[2] = time < best[2] ? time : best[2];
+	}
+
+	const double scale = 1e9 / COLD_RECORDS;
+	printf("%6d %12.1f %18.1f %12.1f %9.2fx %17.2fx\n", precisions[p], best[0] * scale, best[1] * scale,
+	       best[2] * scale, best[0] / best[2], best[1] / best[2]);
+	clear_records(records, COLD_RECORDS);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(rop);
+    free(op1);
+    free(op2);
+    return 0;
+}
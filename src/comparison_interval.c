@@ -0,0 +1,127 @@
+/*
+    Test file to compare avxmpfi_add() / avxmpfi_sub() against the two mpfr calls an interval operation costs
+    otherwise, mpfr_add() / mpfr_sub() with MPFR_RNDD for the left endpoint and MPFR_RNDU for the right one.
+
+    Intervals are made of two random values of either sign with exponents in [-16, 16), so endpoint sums mix
+    additions, cancellations and large exponent gaps. One in thirty two intervals is a point, one in sixty four has a
+    zero endpoint (which goes through mpfr). Every endpoint, its sign and the inexact bits have to match mpfr, also
+    when the result overwrites an operand. Precisions under AVXMPFI_PREC_MIN (53, 113 and 192) and 504, past
+    AVXMPFI_PREC_MAX, go through mpfr and show the cost of the fallback.
+*/
+
+#include "comparison_utilities.h"
+
+void assign_interval(avxmpfi_t x)
+{
+    assign_random(&x->left, -16, 16, RANDOM_SIGNED);
+    assign_random(&x->right, -16, 16, RANDOM_SIGNED);
+    if (rand() % 32 == 0)
+	mpfr_set(&x->right, &x->left, MPFR_RNDN);
+    if (rand() % 64 == 0)
+	mpfr_set_zero(rand() % 2 ? &x->left : &x->right, 1);
+    if (mpfr_cmp(&x->left, &x->right) > 0)
+	mpfr_swap(&x->left, &x->right);
+}
+
+int same(mpfr_t a, mpfr_t b)
+{
+    return mpfr_equal_p(a, b) && mpfr_signbit(a) == mpfr_signbit(b);
+}
+
+// Both endpoints the mpfr way, with the same return value as avxmpfi_add() / avxmpfi_sub()
+int reference(avxmpfi_t rop, avxmpfi_t op1, avxmpfi_t op2, int subtract)
+{
+    if (subtract)
+	return (mpfr_sub(&rop->left, &op1->left, &op2->right, MPFR_RNDD) != 0)
+	       | ((mpfr_sub(&rop->right, &op1->right, &op2->left, MPFR_RNDU) != 0) << 1);
+    return (mpfr_add(&rop->left, &op1->left, &op2->left, MPFR_RNDD) != 0)
+	   | ((mpfr_add(&rop->right, &op1->right, &op2->right, MPFR_RNDU) != 0) << 1);
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {53, 113, 192, PRECISION_256, 320, 448, PRECISION_512};
+    const int n_precisions = sizeof(precisions) / sizeof(precisions[0]);
+    const size_t count = 1<<16;
+    const int repeats = 8;
+    int all_correct = 1;
+
+    avxmpfi_t *x = malloc(count * sizeof(avxmpfi_t));
+    avxmpfi_t *y = malloc(count * sizeof(avxmpfi_t));
+    avxmpfi_t *z1 = malloc(count * sizeof(avxmpfi_t));
+    avxmpfi_t *z2 = malloc(count * sizeof(avxmpfi_t));
+
+    printf("\nns per interval operation\n\n");
+    printf("%10s %14s %14s %10s %14s %14s %10s %10s\n", "precision", "2x mpfr_add()", "avxmpfi_add()", "speedup",
+	   "2x mpfr_sub()", "avxmpfi_sub()", "speedup", "correct");
+
+    for (int p = 0; p < n_precisions; p++)
+    {
+	for (size_t i = 0; i < count; i++)
+	{
+	    avxmpfi_init2(x[i], precisions[p]);
+	    avxmpfi_init2(y[i], precisions[p]);
+	    avxmpfi_init2(z1[i], precisions[p]);
+	    avxmpfi_init2(z2[i], precisions[p]);
+	    assign_interval(x[i]);
+	    assign_interval(y[i]);
+	}
+
+	double times[4];
+	int correct = 1;
+	for (int subtract = 0; subtract < 2; subtract++)
+	{
+	    double start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i < count; i++)
+		    reference(z1[i], x[i], y[i], subtract);
+	    times[2 * subtract] = (wall_time() - start) / (repeats * count) * 1e9;
+
+	    start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i < count; i++)
+		    subtract ? avxmpfi_sub(z2[i], x[i], y[i]) : avxmpfi_add(z2[i], x[i], y[i]);
+	    times[2 * subtract + 1] = (wall_time() - start) / (repeats * count) * 1e9;
+
+	    for (size_t i = 0; i < count; i++)
+	    {
+		const int expected = reference(z1[i], x[i], y[i], subtract);
+		const int inexact = subtract ? avxmpfi_sub(z2[i], x[i], y[i]) : avxmpfi_add(z2[i], x[i], y[i]);
+		correct &= inexact == expected && same(&z1[i]->left, &z2[i]->left) && same(&z1[i]->right, &z2[i]->right);
+	    }
+
+	    // The result overwriting the second operand, the left endpoint must not be written too early
+	    for (size_t i = 0; i < count / 16; i++)
+	    {
+		reference(z1[i], x[i], y[i], subtract);
+		mpfr_set(&z2[i]->left, &y[i]->left, MPFR_RNDN);
+		mpfr_set(&z2[i]->right, &y[i]->right, MPFR_RNDN);
+		subtract ? avxmpfi_sub(z2[i], x[i], z2[i]) : avxmpfi_add(z2[i], x[i], z2[i]);
+		correct &= same(&z1[i]->left, &z2[i]->left) && same(&z1[i]->right, &z2[i]->right);
+	    }
+	}
+	all_correct &= correct;
+
+	printf("%10ld %14.2f %14.2f %9.2fx %14.2f %14.2f %9.2fx %10s\n", (long) precisions[p], times[0], times[1],
+	       times[0] / times[1], times[2], times[3], times[2] / times[3], correct ? "yes" : "NO");
+
+	for (size_t i = 0; i < count; i++)
+	{
+	    avxmpfi_clear(x[i]);
+	    avxmpfi_clear(y[i]);
+	    avxmpfi_clear(z1[i]);
+	    avxmpfi_clear(z2[i]);
+	}
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x); free(y); free(z1); free(z2);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+    Test file to compare the specialised kernels of avxmpfr_kernels.c against mpfr_add() over a matrix of sizes.
+
+    For every number of padded limbs in the list below, and both instruction sets, it times the kernel picked by
+    avxmpfr_kernel_lookup() against mpfr_add() on the same operands. Each result has to be mpfr_add() with MPFR_RNDZ
+    exactly, as the truncated sums of operands that fit the padded limbs are, and the AVX2 and AVX512 specialisations
+    have to agree bit for bit.
+
+    avxmpfr_add_prec() is timed as well, with the same check. The speedup is its time against mpfr_add(): it only
+    picks a kernel in the range where the AVX512 column beats mpfr_add() and forwards the rest, so it should never
+    drop far below 1.
+
+    Last, operands wider than rop, which the kernels have to forward since their low bits would be lost when packed,
+    and the other rounding modes are added through the kernels and avxmpfr_add_prec(), and have to give mpfr_add()
+    in that mode.
+*/
+
+#include "comparison_utilities.h"
+
+// 1 if x is reference, sign included
+int same(mpfr_t x, mpfr_t reference)
+{
+    return mpfr_equal_p(x, reference) && mpfr_signbit(x) == mpfr_signbit(reference);
+}
+
+// Number of additions of count wide operands into rop_precision bits, in every rounding mode, through the kernels of
+// both instruction sets and avxmpfr_add_prec() that give mpfr_add(). Returns the number of checks made in checks
+uint64_t check_wide(mpfr_prec_t rop_precision, mpfr_prec_t precision, size_t count, uint64_t *checks)
+{
+    const mpfr_rnd_t modes[5] = {MPFR_RNDZ, MPFR_RNDN, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    mpfr_t op1, op2, rop, reference;
+    mpfr_inits2(precision, op1, op2, NULL);
+    mpfr_inits2(rop_precision, rop, reference, NULL);
+
+    uint64_t correct = 0;
+    *checks = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+	assign_random(op1, -64, 64, RANDOM_RARELY_NEGATIVE);
+	assign_random(op2, -64, 64, RANDOM_RARELY_NEGATIVE);
+	const mpfr_rnd_t rnd = modes[i % 5];
+	mpfr_add(reference, op1, op2, rnd);
+	for (int isa = AVXMPFR_ISA_AVX2; isa <= AVXMPFR_ISA_AVX512; isa++)
+	{
+	    avxmpfr_kernel_lookup(rop_precision, isa)(rop, op1, op2, rnd);
+	    correct += same(rop, reference);
+	}
+	avxmpfr_add_prec(rop, op1, op2, rnd);
+	correct += same(rop, reference);
+	*checks += 3;
+    }
+
+    mpfr_clears(op1, op2, rop, reference, NULL);
+    return correct;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const int sizes[] = {2, 3, 4, 5, 6, 8, 12, 16, 24, 32, 48, 64};	// Padded limbs to compare
+    const size_t count = 1<<14;						// Additions per size
+    int all_correct = 1;
+
+    printf("\n%6s %10s %14s %14s %14s %14s %10s %10s\n", "limbs", "precision", "mpfr_add() ns", "AVX2 ns", "AVX512 ns",
+	   "add_prec ns", "speedup", "correct");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+	const mpfr_prec_t precision = 63 * sizes[s];
+	mpfr_t* op1 = malloc(count * sizeof(mpfr_t));
+	mpfr_t* op2 = malloc(count * sizeof(mpfr_t));
+	mpfr_t* reference = malloc(count * sizeof(mpfr_t));
+	mpfr_t* result[2] = {malloc(count * sizeof(mpfr_t)), malloc(count * sizeof(mpfr_t))};
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpfr_inits2(precision, op1[i], op2[i], reference[i], result[0][i], result[1][i], NULL);
+	    assign_random(op1[i], -64, 64, 0);
+	    assign_random(op2[i], -64, 64, 0);
+	}
+
+	// Untimed pass first, so that the reference does not pay for touching the arrays before the kernels do
+	for (int isa = AVXMPFR_ISA_AVX2; isa <= AVXMPFR_ISA_AVX512; isa++)
+	    for (size_t i = 0; i < count; i++)
+		mpfr_add(result[isa][i], op1[i], op2[i], MPFR_RNDZ);
+
+	double start = wall_time();
+	for (size_t i = 0; i < count; i++)
+	    mpfr_add(reference[i], op1[i], op2[i], MPFR_RNDZ);
+	double mpfr_time = wall_time() - start;
+
+	double kernel_time[2];
+	for (int isa = AVXMPFR_ISA_AVX2; isa <= AVXMPFR_ISA_AVX512; isa++)
+	{
+	    avxmpfr_kernel kernel = avxmpfr_kernel_lookup(precision, isa);
+	    start = wall_time();
+	    for (size_t i = 0; i < count; i++)
+		kernel(result[isa][i], op1[i], op2[i], MPFR_RNDZ);
+	    kernel_time[isa] = wall_time() - start;
+	}
+
+	uint64_t correct = 0;
+	for (size_t i = 0; i < count; i++)
+	    correct += same(result[0][i], reference[i]) && mpfr_equal_p(result[0][i], result[1][i]);
+
+	start = wall_time();
+	for (size_t i = 0; i < count; i++)
+	    avxmpfr_add_prec(result[0][i], op1[i], op2[i], MPFR_RNDZ);
+	double prec_time = wall_time() - start;
+	for (size_t i = 0; i < count; i++)
+	    correct -= !same(result[0][i], reference[i]);
+	all_correct &= (correct == count);
+
+	printf("%6d %10ld %14.2f %14.2f %14.2f %14.2f %9.2fx %10s\n", sizes[s], precision, mpfr_time / count * 1e9,
+	       kernel_time[0] / count * 1e9, kernel_time[1] / count * 1e9, prec_time / count * 1e9, mpfr_time / prec_time,
+	       correct == count ? "yes" : "NO");
+
+	for (size_t i = 0; i < count; i++)
+	    mpfr_clears(op1[i], op2[i], reference[i], result[0][i], result[1][i], NULL);
+	free(op1); free(op2); free(reference); free(result[0]); free(result[1]);
+    }
+
+    // Operands wider than rop, then as wide, in every rounding mode
+    const mpfr_prec_t wide[][2] = {{PRECISION_512, 2000}, {1000, 2000}, {PRECISION_256, PRECISION_512},
+				   {PRECISION_128 + 1, 1000}, {PRECISION_512, PRECISION_512}};
+    printf("\n%10s %10s %14s\n", "rop bits", "op bits", "equal");
+    for (size_t w = 0; w < sizeof(wide) / sizeof(wide[0]); w++)
+    {
+	uint64_t checks;
+	const uint64_t correct = check_wide(wide[w][0], wide[w][1], 1<<12, &checks);
+	printf("%10ld %10ld %6lu / %-6lu\n", wide[w][0], wide[w][1], correct, checks);
+	all_correct &= (correct == checks);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/*
+    Test file to compare chains of dependent additions, x = x + a[i], with and without lazy normalisation.
+
+    For chains of 10 to 10000 additions it times
+	mpfr_add() into x every step
+	avxmpfr_add() into x every step, on scratch copies since it modifies its operands
+	an avxmpfr_lazy accumulator, read once at the end of the chain
+
+    One operand in 64 is negative. The accumulator has to match the exact sum rounded once, in MPFR_RNDN and
+    MPFR_RNDZ (the exact sum comes from mpfr_add() at a precision that holds it).
+
+    Then chains mixing operands around 1 with tiny ones, whose bits fall partly or wholly below the lanes, are read
+    in every rounding mode. Tiny operands that are only added (the lanes are below the exact sum) or only subtracted
+    (above it) have to give the exact sum rounded once, tiny operands of both kinds a faithful result: between the
+    exact sum rounded down and rounded up.
+*/
+
+#include "comparison_utilities.h"
+
+// Time one chain length at one precision and print a line, returns 1 if the accumulator was exact
+int compare(uint16_t PRECISION, size_t length)
+{
+    const size_t total = 1<<18;					// Additions timed per path
+    const size_t repeats = total / length > 0 ? total / length : 1;
+
+    mpfr_t* a = malloc(length * sizeof(mpfr_t));
+    for (size_t i = 0; i < length; i++)
+    {
+	mpfr_init2(a[i], PRECISION);
+	assign_random(a[i], -16, 16, RANDOM_RARELY_NEGATIVE);
+    }
+
+    mpfr_t x, copy1, copy2, exact, expected;
+    mpfr_inits2(PRECISION, x, copy1, copy2, expected, NULL);
+    mpfr_init2(exact, 2 * PRECISION);
+    avxmpfr_lazy acc;
+    avxmpfr_lazy_init(&acc, PRECISION);
+
+
+    /* mpfr_add() */
+    double start = wall_time();
+    for (size_t r = 0; r < repeats; r++)
+    {
+	mpfr_set(x, a[0], MPFR_RNDN);
+	for (size_t i = 1; i < length; i++)
+	    mpfr_add(x, x, a[i], MPFR_RNDN);
+    }
+    double mpfr_time = wall_time() - start;
+
+
+    /* avxmpfr_add() on copies */
+    start = wall_time();
+    for (size_t r = 0; r < repeats; r++)
+    {
+	mpfr_set(x, a[0], MPFR_RNDN);
+	for (size_t i = 1; i < length; i++)
+	{
+	    mpfr_set(copy1, x, MPFR_RNDN);
+	    mpfr_set(copy2, a[i], MPFR_RNDN);
+	    if (PRECISION == PRECISION_256)
+		avxmpfr_add(x, copy1, copy2, MPFR_RNDF, PRECISION_256);
+	    else
+		avxmpfr_add_512(x, copy1, copy2, MPFR_RNDF, PRECISION_512);
+	}
+    }
+    double avxmpfr_time = wall_time() - start;
+
+
+    /* Lazy accumulator */
+    start = wall_time();
+    for (size_t r = 0; r < repeats; r++)
+    {
+	avxmpfr_lazy_set(&acc, a[0]);
+	for (size_t i = 1; i < length; i++)
+	    avxmpfr_lazy_add(&acc, a[i]);
+	avxmpfr_lazy_get(x, &acc, MPFR_RNDN);
+    }
+    double lazy_time = wall_time() - start;
+
+
+    /* Check against the exact sum */
+    mpfr_set(exact, a[0], MPFR_RNDN);
+    for (size_t i = 1; i < length; i++)
+	mpfr_add(exact, exact, a[i], MPFR_RNDN);
+
+    int correct = 1;
+    const mpfr_rnd_t modes[] = {MPFR_RNDN, MPFR_RNDZ};
+    for (int m = 0; m < 2; m++)
+    {
+	mpfr_set(expected, exact, modes[m]);
+	avxmpfr_lazy_get(x, &acc, modes[m]);
+	correct &= mpfr_equal_p(x, expected);
+    }
+
+    const double adds = (double) repeats * (length - 1);
+    printf("%10d %10zu %16.2f %16.2f %16.2f %9.2fx %10s\n", PRECISION, length, mpfr_time / adds * 1e9,
+	   avxmpfr_time / adds * 1e9, lazy_time / adds * 1e9, mpfr_time / lazy_time, correct ? "yes" : "NO");
+
+    for (size_t i = 0; i < length; i++)
+	mpfr_clear(a[i]);
+    mpfr_clears(x, copy1, copy2, exact, expected, NULL);
+    free(a);
+    return correct;
+}
+
+// Check chains of operands around 1 and tiny ones, added when tiny & 1 and subtracted when tiny & 2, in every rounding
+// mode. Returns the number of correct results, out of 5 count
+uint64_t check_gaps(uint16_t PRECISION, int tiny, size_t count)
+{
+    const mpfr_rnd_t modes[5] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const int length = 16;
+    mpfr_t a, half, x, exact, expected, low, high;
+    mpfr_inits2(PRECISION, a, x, expected, low, high, NULL);
+    mpfr_init2(half, PRECISION / 2);
+    mpfr_init2(exact, 5 * PRECISION + 400);	// Down to the last bit of the tiniest operand
+    avxmpfr_lazy acc;
+    avxmpfr_lazy_init(&acc, PRECISION);
+
+    uint64_t correct = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_set_zero(exact, 1);
+	avxmpfr_lazy_init(&acc, PRECISION);
+	for (int k = 0; k < length; k++)
+	{
+	    // Every other operand is tiny, its exponent well below the last lane or reaching into it
+	    int subtract = 0;
+	    if (k % 2)
+	    {
+		assign_random(a, -3 * PRECISION - 200, -PRECISION, 0);
+		subtract = tiny == 2 || (tiny == 3 && rand() % 2);
+	    }
+	    else
+	    {
+		// Half as many bits, so that the bits of the sum below the last of rop are only the dropped ones
+		assign_random(half, -16, 16, 0);
+		mpfr_set(a, half, MPFR_RNDN);
+	    }
+
+	    if (subtract)
+	    {
+		avxmpfr_lazy_sub(&acc, a);
+		mpfr_sub(exact, exact, a, MPFR_RNDN);
+	    }
+	    else
+	    {
+		avxmpfr_lazy_add(&acc, a);
+		mpfr_add(exact, exact, a, MPFR_RNDN);
+	    }
+	}
+
+	for (int m = 0; m < 5; m++)
+	{
+	    avxmpfr_lazy_get(x, &acc, modes[m]);
+	    if (tiny == 3)
+	    {
+		mpfr_set(low, exact, MPFR_RNDD);
+		mpfr_set(high, exact, MPFR_RNDU);
+		correct += mpfr_lessequal_p(low, x) && mpfr_lessequal_p(x, high);
+	    }
+	    else
+	    {
+		mpfr_set(expected, exact, modes[m]);
+		correct += mpfr_equal_p(x, expected);
+	    }
+	}
+    }
+
+    mpfr_clears(a, half, x, exact, expected, low, high, NULL);
+    return correct;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const size_t lengths[] = {10, 100, 1000, 10000};	// Chain lengths to compare
+    int all_correct = 1;
+
+    printf("\nx = x + a[i], ns per addition\n\n");
+    printf("%10s %10s %16s %16s %16s %10s %10s\n", "precision", "chain", "mpfr_add()", "avxmpfr_add()", "avxmpfr_lazy",
+	   "speedup", "correct");
+
+    for (int p = 0; p < 2; p++)
+    {
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+	    all_correct &= compare(p ? PRECISION_512 : PRECISION_256, lengths[l]);
+    }
+
+    // Operands falling below the lanes
+    const char *names[3] = {"added", "subtracted", "both"};
+    const size_t count = 1<<12;
+    printf("\n%10s %12s %16s\n", "precision", "tiny ones", "correct");
+    for (int p = 0; p < 2; p++)
+    {
+	for (int tiny = 1; tiny <= 3; tiny++)
+	{
+	    const uint64_t correct = check_gaps(p ? PRECISION_512 : PRECISION_256, tiny, count);
+	    printf("%10d %12s %7lu / %-7lu\n", p ? PRECISION_512 : PRECISION_256, names[tiny - 1], correct, 5 * count);
+	    all_correct &= correct == 5 * count;
+	}
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    return 0;
+}
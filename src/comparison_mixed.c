@@ -0,0 +1,186 @@
+/*
+    Test file to compare avxmpfr_add_mixed() / avxmpfr_sub_mixed() against mpfr_add() / mpfr_sub() when rop, op1
+    and op2 have differing precisions.
+
+    Every combination of precisions for the three of them, from 2 bits to PRECISION_512 (ten precisions, a thousand
+    combinations), is tried in every rounding mode, both operations and both signs. The pairs have exponent gaps
+    from 0 to well past the 512 bit window, around the limbs and the widest precision, plus exact cancellations, near
+    cancellations and sums at the ends of the exponent range. The value, the sign of zero, the ternary value and the
+    inexact flag all have to be those of mpfr.
+
+    The timings are ns per addition for the precision mixes the batched code meets, against mpfr_add() and against
+    widening the operands with mpfr_set() to call avxmpfr_add_512() (on copies, as it modifies its operands).
+*/
+
+#include "comparison_utilities.h"
+
+// A gap between the operands, the interesting ones more often than the rest
+int64_t draw_gap()
+{
+    static const int64_t gaps[] = {0, 0, 0, 1, 2, 62, 63, 64, 126, 440, 441, 442, 443, 503, 504, 505, 944, 945, 946,
+				   1007, 1008, 1009, 5000};
+    return rand() % 2 ? gaps[rand() % (sizeof(gaps) / sizeof(gaps[0]))] : rand() % 1100;
+}
+
+// op2 from op1 for the awkward cases, returns 1 if it made one
+int assign_awkward(mpfr_t op2, mpfr_t op1)
+{
+    switch (rand() % 16)
+    {
+	case 0: mpfr_neg(op2, op1, MPFR_RNDN); return 1;				// Cancellation once rounded
+	case 1: mpfr_set(op2, op1, MPFR_RNDZ); return 1;
+	case 2: mpfr_neg(op2, op1, MPFR_RNDZ);
+		mpfr_nextabove(op2); return 1;						// Near cancellation
+	case 3: mpfr_set_exp(op1, mpfr_get_emax());
+		mpfr_set(op2, op1, MPFR_RNDZ); return 1;				// Overflow
+	case 4: mpfr_set_exp(op1, mpfr_get_emin() + rand() % 8);
+		mpfr_neg(op2, op1, MPFR_RNDN);
+		mpfr_nextabove(op2); return 1;						// Underflow
+	default: return 0;
+    }
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[10] = {2, 53, 64, 113, 200, PRECISION_256, 256, 441, 442, PRECISION_512};
+    const mpfr_rnd_t modes[5] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const int pairs = 48;
+    int all_correct = 1;
+
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, time(NULL), 0);
+    mpfr_t op[2], rop, expected;
+    uint64_t tried = 0;
+
+    for (int p0 = 0; p0 < 10; p0++)
+	for (int p1 = 0; p1 < 10; p1++)
+	    for (int p2 = 0; p2 < 10; p2++)
+	    {
+		mpfr_inits2(precisions[p0], rop, expected, (mpfr_ptr) 0);
+		mpfr_init2(op[0], precisions[p1]);
+		mpfr_init2(op[1], precisions[p2]);
+		int correct = 1;
+
+		for (int k = 0; k < pairs; k++)
+		{
+		    avxmpfr_urandom_vec(op, 2, &state, AVXMPFR_RANDOM_EXPONENTS, -64, 64);
+		    if (!assign_awkward(op[1], op[0]))
+			mpfr_set_exp(op[1], mpfr_get_exp(op[0]) - draw_gap());
+		    if (rand() % 2)
+			mpfr_swap(op[0], op[1]);	// Keeps the precisions with the values, put them back
+		    if (mpfr_get_prec(op[0]) != precisions[p1])
+		    {
+			mpfr_prec_round(op[0], precisions[p1], MPFR_RNDN);
+			mpfr_prec_round(op[1], precisions[p2], MPFR_RNDN);
+		    }
+
+		    for (int m = 0; m < 5; m++)
+			for (int negate = 0; negate < 2; negate++)
+			{
+			    mpfr_clear_flags();
+			    const int t_expected = negate ? mpfr_sub(expected, op[0], op[1], modes[m])
+							  : mpfr_add(expected, op[0], op[1], modes[m]);
+			    const int inexact_expected = mpfr_inexflag_p();
+			    mpfr_clear_flags();
+			    const int t = negate ? avxmpfr_sub_mixed(rop, op[0], op[1], modes[m])
+						 : avxmpfr_add_mixed(rop, op[0], op[1], modes[m]);
+			    correct &= mpfr_equal_p(rop, expected) && mpfr_signbit(rop) == mpfr_signbit(expected)
+				       && (t > 0) == (t_expected > 0) && (t < 0) == (t_expected < 0)
+				       && mpfr_inexflag_p() == inexact_expected;
+			    tried++;
+			}
+		}
+
+		// In place, rop is op1
+		if (p0 == p1)
+		    for (int k = 0; k < pairs; k++)
+		    {
+			avxmpfr_urandom_vec(op, 2, &state, AVXMPFR_RANDOM_EXPONENTS, -64, 64);
+			mpfr_set_exp(op[1], mpfr_get_exp(op[0]) - draw_gap());
+			const mpfr_rnd_t rnd = modes[rand() % 5];
+			mpfr_add(expected, op[0], op[1], rnd);
+			avxmpfr_add_mixed(op[0], op[0], op[1], rnd);
+			correct &= mpfr_equal_p(op[0], expected);
+		    }
+
+		if (!correct)
+		    printf("differs with rop %ld, op1 %ld and op2 %ld bits\n", (long) precisions[p0], (long) precisions[p1],
+			   (long) precisions[p2]);
+		all_correct &= correct;
+		mpfr_clears(rop, expected, op[0], op[1], (mpfr_ptr) 0);
+	    }
+    printf("\n%lu additions and subtractions checked against mpfr\n", (unsigned long) tried);
+
+    // Timings
+    const mpfr_prec_t mixes[4][3] = {{PRECISION_512, PRECISION_512, PRECISION_256},
+				     {PRECISION_512, PRECISION_256, PRECISION_256},
+				     {PRECISION_256, PRECISION_512, PRECISION_256},
+				     {PRECISION_256, PRECISION_256, PRECISION_256}};
+    const size_t n = 4096;
+    const int repeats = 64;
+    mpfr_t *a = malloc(n * sizeof(mpfr_t)), *b = malloc(n * sizeof(mpfr_t)), *r = malloc(n * sizeof(mpfr_t));
+    mpfr_t wide1, wide2;
+    mpfr_inits2(PRECISION_512, wide1, wide2, (mpfr_ptr) 0);
+
+    printf("\nns per addition of operands of the same sign, exponents in [-16, 16)\n\n");
+    printf("%6s %6s %6s %12s %16s %12s %9s %9s\n", "rop", "op1", "op2", "mpfr_add", "mpfr_set + 512", "mixed",
+	   "mpfr_add", "widening");
+    for (int x = 0; x < 4; x++)
+    {
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_init2(r[i], mixes[x][0]);
+	    mpfr_init2(a[i], mixes[x][1]);
+	    mpfr_init2(b[i], mixes[x][2]);
+	}
+	avxmpfr_urandom_vec(a, n, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+	avxmpfr_urandom_vec(b, n, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+	for (size_t i = 0; i < n; i++)
+	    mpfr_setsign(b[i], b[i], mpfr_signbit(a[i]), MPFR_RNDN);
+
+	double time[3], start;
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+		mpfr_add(r[i], a[i], b[i], MPFR_RNDN);
+	time[0] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+	    {
+		mpfr_set(wide1, a[i], MPFR_RNDN);
+		mpfr_set(wide2, b[i], MPFR_RNDN);
+		avxmpfr_add_512(wide1, wide1, wide2, MPFR_RNDN, PRECISION_512);
+		mpfr_set(r[i], wide1, MPFR_RNDN);
+	    }
+	time[1] = wall_time() - start;
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    for (size_t i = 0; i < n; i++)
+		avxmpfr_add_mixed(r[i], a[i], b[i], MPFR_RNDN);
+	time[2] = wall_time() - start;
+
+	const double scale = 1e9 / (repeats * n);
+	printf("%6ld %6ld %6ld %12.1f %16.1f %12.1f %8.2fx %8.2fx\n", (long) mixes[x][0], (long) mixes[x][1],
+	       (long) mixes[x][2], time[0] * scale, time[1] * scale, time[2] * scale, time[0] / time[2], time[1] / time[2]);
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(r[i], a[i], b[i], (mpfr_ptr) 0);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    mpfr_clears(wide1, wide2, (mpfr_ptr) 0);
+    free(a);
+    free(b);
+    free(r);
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+    Test file to compare avxmpn_add_n() / avxmpn_sub_n() against mpn_add_n() / mpn_sub_n() from 1 to 1M limbs.
+
+    Each size is timed over enough calls to add about 2^24 limbs per path, the largest sizes (three arrays of 8 MB at
+    1M limbs) stream from memory. Every result and carry has to match GMP exactly, on random limbs and on the
+    patterns that carry or borrow through every limb.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+uint64_t random_limb()
+{
+    return ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ (uint64_t) rand();
+}
+
+// 1 if both functions give the same limbs and carry on s1, s2, also in place
+int check(mp_limb_t *r1, mp_limb_t *r2, const mp_limb_t *s1, const mp_limb_t *s2, mp_size_t n)
+{
+    int same = mpn_add_n(r1, s1, s2, n) == avxmpn_add_n(r2, s1, s2, n) && memcmp(r1, r2, n * sizeof(mp_limb_t)) == 0;
+    same &= mpn_sub_n(r1, s1, s2, n) == avxmpn_sub_n(r2, s1, s2, n) && memcmp(r1, r2, n * sizeof(mp_limb_t)) == 0;
+
+    memcpy(r2, s1, n * sizeof(mp_limb_t));
+    same &= mpn_sub_n(r1, s1, s2, n) == avxmpn_sub_n(r2, r2, s2, n) && memcmp(r1, r2, n * sizeof(mp_limb_t)) == 0;
+    return same;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mp_size_t max_limbs = 1<<20;
+    mp_limb_t *s1 = aligned_alloc(64, max_limbs * sizeof(mp_limb_t));
+    mp_limb_t *s2 = aligned_alloc(64, max_limbs * sizeof(mp_limb_t));
+    mp_limb_t *r1 = aligned_alloc(64, max_limbs * sizeof(mp_limb_t));
+    mp_limb_t *r2 = aligned_alloc(64, max_limbs * sizeof(mp_limb_t));
+    mp_limb_t *ones = aligned_alloc(64, max_limbs * sizeof(mp_limb_t));
+    mp_limb_t *unit = calloc(max_limbs, sizeof(mp_limb_t));
+    for (mp_size_t i = 0; i < max_limbs; i++)
+    {
+	s1[i] = random_limb();
+	s2[i] = random_limb();
+	ones[i] = ~(mp_limb_t) 0;
+    }
+    unit[0] = 1;
+    int all_correct = 1;
+
+    printf("\nns per limb\n\n");
+    printf("%10s %14s %14s %14s %14s %10s %10s %10s\n", "limbs", "mpn_add_n()", "avxmpn_add_n()", "mpn_sub_n()",
+	   "avxmpn_sub_n()", "add", "sub", "correct");
+
+    for (mp_size_t n = 1; n <= max_limbs; n *= 4)
+    {
+	const size_t calls = (1<<24) / n;
+	double times[4];
+
+	for (int f = 0; f < 4; f++)
+	{
+	    double start = wall_time();
+	    for (size_t c = 0; c < calls; c++)
+	    {
+		switch (f)
+		{
+		    case 0: mpn_add_n(r1, s1, s2, n); break;
+		    case 1: avxmpn_add_n(r1, s1, s2, n); break;
+		    case 2: mpn_sub_n(r1, s1, s2, n); break;
+		    default: avxmpn_sub_n(r1, s1, s2, n); break;
+		}
+	    }
+	    times[f] = (wall_time() - start) / ((double) calls * n) * 1e9;
+	}
+
+	// Random limbs, a carry through every limb, a borrow through every limb, and every length up to 17 limbs
+	int correct = check(r1, r2, s1, s2, n) && check(r1, r2, ones, unit, n) && check(r1, r2, unit, ones, n)
+		      && check(r1, r2, unit, s2, n);
+	for (mp_size_t m = 1; m <= 17 && m <= n; m++)
+	    correct &= check(r1, r2, ones + n - m, s2 + n - m, m);
+	all_correct &= correct;
+
+	printf("%10ld %14.3f %14.3f %14.3f %14.3f %9.2fx %9.2fx %10s\n", (long) n, times[0], times[1], times[2], times[3],
+	       times[0] / times[1], times[2] / times[3], correct ? "yes" : "NO");
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    free(s1); free(s2); free(r1); free(r2); free(ones); free(unit);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+    Test file to compare avxmpfr_add_multi() on 2 to AVXMPFR_MULTI_MAX pairs per call against the same kernel on one
+    pair per call.
+
+    Every sum has to be mpfr_add() with MPFR_RNDZ, as the truncated sums of PRECISION_256 / PRECISION_512 operands are,
+    and pairs with different signs or zeros, or overflowing, mpfr_add() with rnd. The pairs of a call are drawn
+    separately so that they need different allignments, carry loop lengths and normalisations.
+
+    The timings are ns per addition and, where the kernel lets perf_event_open() count cycles and instructions (see
+    comparison_perf.h), instructions per cycle, over arrays small enough to stay in the L1 cache. Without hardware
+    counters, as in most virtual machines, the IPC column is n/a and only the times are measured.
+*/
+
+#include "comparison_utilities.h"
+#include "comparison_perf.h"
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    const size_t n = 1 << 10;
+    const int repeats = 1 << 9;
+    mpfr_t *a = malloc(n * sizeof(mpfr_t)), *b = malloc(n * sizeof(mpfr_t)), *r = malloc(n * sizeof(mpfr_t));
+    mpfr_t *expected = malloc(n * sizeof(mpfr_t));
+    mpfr_ptr *rop = malloc(n * sizeof(mpfr_ptr)), *op1 = malloc(n * sizeof(mpfr_ptr)), *op2 = malloc(n * sizeof(mpfr_ptr));
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, time(NULL), 0);
+    int all_correct = 1;
+
+    const int cycles = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    const int instructions = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    if (cycles < 0 || instructions < 0)
+	printf("\nNo hardware counters, instructions per cycle are not measured\n");
+
+    for (int p = 0; p < 2; p++)
+    {
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_inits2(precisions[p], a[i], b[i], r[i], expected[i], (mpfr_ptr) 0);
+	    rop[i] = r[i];
+	    op1[i] = a[i];
+	    op2[i] = b[i];
+	}
+
+	// Correctness, gaps within and past the lanes, all ones significands, some fallbacks
+	for (int round = 0; round < 16; round++)
+	{
+	    avxmpfr_urandom_vec(a, n, &state, AVXMPFR_RANDOM_EXPONENTS, -8, 8);
+	    avxmpfr_urandom_vec(b, n, &state, AVXMPFR_RANDOM_EXPONENTS, -8, 8);
+	    const mpfr_rnd_t rnd = rand() % 2 ? MPFR_RNDN : MPFR_RNDU;
+	    for (size_t i = 0; i < n; i++)
+	    {
+		if (rand() % 8)
+		    mpfr_setsign(b[i], b[i], mpfr_signbit(a[i]), MPFR_RNDN);
+		if (rand() % 4 == 0)
+		    mpfr_set_exp(b[i], mpfr_get_exp(a[i]) - rand() % (precisions[p] + 8));
+		if (rand() % 8 == 0)
+		{
+		    mpfr_set_si_2exp(a[i], mpfr_signbit(a[i]) ? -1 : 1, mpfr_get_exp(a[i]), MPFR_RNDN);
+		    mpfr_nextbelow(a[i]);
+		}
+		if (rand() % 32 == 0)
+		    mpfr_set_zero(b[i], 1);
+		if (rand() % 64 == 0)
+		{
+		    mpfr_set_exp(a[i], mpfr_get_emax());
+		    mpfr_set(b[i], a[i], MPFR_RNDN);
+		}
+		const int truncated = mpfr_regular_p(b[i]) && mpfr_signbit(a[i]) == mpfr_signbit(b[i]) && mpfr_get_exp(a[i]) < mpfr_get_emax();
+		mpfr_add(expected[i], a[i], b[i], truncated ? MPFR_RNDZ : rnd);
+	    }
+
+	    // Calls of every size, in place for odd rounds
+	    if (round % 2)
+		for (size_t i = 0; i < n; i++)
+		    rop[i] = op1[i];
+	    for (size_t i = 0; i < n;)
+	    {
+		const int count = 1 + rand() % AVXMPFR_MULTI_MAX;
+		const int take = (n - i < (size_t) count) ? (int) (n - i) : count;
+		avxmpfr_add_multi(rop + i, op1 + i, op2 + i, take, rnd, precisions[p]);
+		i += take;
+	    }
+
+	    int correct = 1;
+	    for (size_t i = 0; i < n; i++)
+	    {
+		correct &= mpfr_equal_p(rop[i], expected[i]) && mpfr_signbit(rop[i]) == mpfr_signbit(expected[i]);
+		rop[i] = r[i];
+	    }
+	    if (!correct)
+		printf("differs at %d bits in round %d\n", precisions[p], round);
+	    all_correct &= correct;
+	}
+	all_correct &= avxmpfr_add_multi(rop, op1, op2, 0, MPFR_RNDN, precisions[p]) == -1
+		       && avxmpfr_add_multi(rop, op1, op2, AVXMPFR_MULTI_MAX + 1, MPFR_RNDN, precisions[p]) == -1;
+
+	// Timings, same signs and exponents in [-4, 4) so that most sums carry across lanes
+	avxmpfr_urandom_vec(a, n, &state, AVXMPFR_RANDOM_EXPONENTS, -4, 4);
+	avxmpfr_urandom_vec(b, n, &state, AVXMPFR_RANDOM_EXPONENTS, -4, 4);
+	for (size_t i = 0; i < n; i++)
+	    mpfr_setsign(b[i], b[i], mpfr_signbit(a[i]), MPFR_RNDN);
+
+	printf("\n%d bits\n%14s %12s %10s %10s\n", precisions[p], "pairs per call", "ns per add", "IPC", "speedup");
+	double single = 0;
+	for (int count = 1; count <= AVXMPFR_MULTI_MAX; count++)
+	{
+	    counter_start(cycles);
+	    counter_start(instructions);
+	    const double start = wall_time();
+	    for (int k = 0; k < repeats; k++)
+		for (size_t i = 0; i + count <= n; i += count)
+		    avxmpfr_add_multi(rop + i, op1 + i, op2 + i, count, MPFR_RNDZ, precisions[p]);
+	    const double time = (wall_time() - start) / (repeats * (n - n % count)) * 1e9;
+	    counter_stop(cycles);
+	    counter_stop(instructions);
+	    const double c = counter_read(cycles), ins = counter_read(instructions);
+
+	    if (count == 1)
+		single = time;
+	    if (c > 0 && ins >= 0)
+		printf("%14d %12.2f %10.2f %9.2fx\n", count, time, ins / c, single / time);
+	    else
+		printf("%14d %12.2f %10s %9.2fx\n", count, time, "n/a", single / time);
+	}
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(a[i], b[i], r[i], expected[i], (mpfr_ptr) 0);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(a);
+    free(b);
+    free(r);
+    free(expected);
+    free(rop);
+    free(op1);
+    free(op2);
+    return 0;
+}
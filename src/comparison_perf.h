@@ -0,0 +1,61 @@
+// comparison_perf.h
+
+/*
+    perf_event_open() counters of the calling thread, shared by comparison_multi.c and comparison_counters.c. Kept out
+    of comparison_utilities.h so that only the tests reading counters need the Linux headers.
+
+    A counter is opened disabled, counter_start() resets and enables it, counter_stop() disables it and counter_read()
+    gives its count, scaled by time enabled / time running if the kernel multiplexed it. A counter the kernel does not
+    export (virtual machines often export none) opens as -1 and reads as -1, the tests print it as n/a.
+*/
+
+#ifndef COMPARISON_PERF_H
+#define COMPARISON_PERF_H
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+// A disabled counter of this thread's user space events, -1 if there is none
+static inline int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static inline void counter_start(int fd)
+{
+    if (fd >= 0)
+    {
+	ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static inline void counter_stop(int fd)
+{
+    if (fd >= 0)
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+// The count since the last counter_start(), scaled up if the counter was multiplexed, -1 if it never ran
+static inline double counter_read(int fd)
+{
+    uint64_t values[3];
+    if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+	return -1;
+    return (double) values[0] * values[1] / values[2];
+}
+
+#endif // COMPARISON_PERF_H
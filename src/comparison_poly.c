@@ -0,0 +1,224 @@
+/*
+    Test file to compare avxmpfr_poly_eval_vec() against the loop it replaces, Horner's rule with mpfr_mul() and
+    mpfr_add() at the precision of the result, point after point.
+
+    Coefficients and points are random with either sign, points have exponents in [-2, 1) and coefficients in
+    [-8, 8), one in sixteen coefficients is zero. Each result is checked against the polynomial evaluated in mpfr with
+    128 bits more, where avxmpfr_poly_eval_vec() promises |rop - p(x)| <= ulp(rop) + (degree + 2) 2^(-prec - 46) S,
+    S = sum |c_j x^j|, with both schemes, every rounding mode and in place. Some points are zeros, infinities, NaNs and
+    values far out of the unit range, the ones that do not fit the vectors go through mpfr and have to give what it gives.
+
+    The table shows the worst error of each method over 2^-prec S and the ns per point at 53, 252 and 504 bits for
+    degrees 1 to 256.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+// Overwrite one point in sixteen with an awkward one
+void assign_awkward(mpfr_t *x, size_t n)
+{
+    for (size_t i = 0; i < n; i += 16)
+    {
+	switch (rand() % 5)
+	{
+	    case 0: mpfr_set_zero(x[i], rand() % 2 ? 1 : -1); break;
+	    case 1: mpfr_set_inf(x[i], rand() % 2 ? 1 : -1); break;
+	    case 2: mpfr_set_nan(x[i]); break;
+	    case 3: mpfr_set_si_2exp(x[i], rand() % 2 ? 3 : -3, 1 << 20, MPFR_RNDN); break;
+	    default: assign_random(x[i], -400, -200, RANDOM_SIGNED); break;
+	}
+    }
+}
+
+// The loop: Horner's rule, every step rounded to the precision of rop
+void horner_loop(mpfr_t *rop, mpfr_t *coeffs, size_t degree, mpfr_t *x, size_t n, mpfr_rnd_t rnd)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+	mpfr_set(rop[i], coeffs[degree], rnd);
+	for (size_t j = degree; j-- > 0;)
+	{
+	    mpfr_mul(rop[i], rop[i], x[i], rnd);
+	    mpfr_add(rop[i], rop[i], coeffs[j], rnd);
+	}
+    }
+}
+
+// p(x) on precision bits, and S = sum |c_j x^j| roughly
+void reference(mpfr_t p, mpfr_t s, mpfr_t *coeffs, size_t degree, mpfr_srcptr x)
+{
+    mpfr_t ax, ac;
+    mpfr_inits2(64, ax, ac, (mpfr_ptr) 0);
+    mpfr_abs(ax, x, MPFR_RNDN);
+    mpfr_set(p, coeffs[degree], MPFR_RNDN);
+    mpfr_abs(s, coeffs[degree], MPFR_RNDU);
+    for (size_t j = degree; j-- > 0;)
+    {
+	mpfr_fma(p, p, x, coeffs[j], MPFR_RNDN);
+	mpfr_abs(ac, coeffs[j], MPFR_RNDU);
+	mpfr_fma(s, s, ax, ac, MPFR_RNDU);
+    }
+    mpfr_clears(ax, ac, (mpfr_ptr) 0);
+}
+
+// The worst |rop - p| / (2^-prec S) over the points, where p and S are finite, or -1 if a result breaks the bound or
+// one at another point is not what mpfr gives
+double worst_error(mpfr_t *rop, mpfr_t *p, mpfr_t *s, size_t n, size_t degree, int check)
+{
+    mpfr_t e, bound, t;
+    mpfr_inits2(64, e, bound, t, (mpfr_ptr) 0);
+    double worst = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+	const mpfr_prec_t prec = mpfr_get_prec(rop[i]);
+	if (!mpfr_regular_p(s[i]) || !mpfr_regular_p(p[i]))
+	{
+	    if (check && !(mpfr_nan_p(rop[i]) && mpfr_nan_p(p[i])) && !mpfr_equal_p(rop[i], p[i]))
+		worst = -1;
+	    continue;
+	}
+	mpfr_sub(e, rop[i], p[i], MPFR_RNDU);
+	mpfr_abs(e, e, MPFR_RNDU);
+	mpfr_mul_2si(t, s[i], -prec, MPFR_RNDD);
+	mpfr_div(bound, e, t, MPFR_RNDU);
+	if (worst >= 0 && mpfr_get_d(bound, MPFR_RNDU) > worst)
+	    worst = mpfr_get_d(bound, MPFR_RNDU);
+
+	if (check)
+	{
+	    mpfr_mul_ui(bound, t, degree + 2, MPFR_RNDD);
+	    mpfr_div_2ui(bound, bound, 46, MPFR_RNDD);
+	    if (!mpfr_zero_p(rop[i]))
+	    {
+		mpfr_set_ui_2exp(t, 1, mpfr_get_exp(rop[i]) - prec, MPFR_RNDN);
+		mpfr_add(bound, bound, t, MPFR_RNDD);
+	    }
+	    if (mpfr_cmp(e, bound) > 0)
+		worst = -1;
+	}
+	if (worst < 0)
+	    break;
+    }
+    mpfr_clears(e, bound, t, (mpfr_ptr) 0);
+    return worst;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[3] = {53, PRECISION_256, PRECISION_512};
+    const size_t degrees[5] = {1, 4, 16, 64, 256};
+    const mpfr_rnd_t modes[5] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const char *schemes[3] = {"auto", "Horner", "Estrin"};
+    const size_t n = 1024;
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(n * sizeof(mpfr_t)), *rop = malloc(n * sizeof(mpfr_t));
+    mpfr_t *p = malloc(n * sizeof(mpfr_t)), *s = malloc(n * sizeof(mpfr_t));
+    mpfr_t coeffs[257];
+
+    printf("\nworst error over 2^-prec S, ns per point and speedup over the mpfr Horner loop\n\n");
+    printf("%10s %7s %12s %12s %12s %12s %12s %9s %9s\n", "precision", "degree", "loop error", "Horner err",
+	   "Estrin err", "loop ns", "Horner ns", "Horner", "Estrin");
+
+    for (int q = 0; q < 3; q++)
+    {
+	const mpfr_prec_t prec = precisions[q];
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_inits2(prec, x[i], rop[i], (mpfr_ptr) 0);
+	    mpfr_init2(s[i], 64);
+	}
+	for (int j = 0; j <= 256; j++)
+	    mpfr_init2(coeffs[j], prec);
+
+	for (int k = 0; k < 5; k++)
+	{
+	    const size_t degree = degrees[k];
+	    for (size_t i = 0; i < n; i++)
+	    {
+		mpfr_init2(p[i], prec + 128 + 8);
+		assign_random(x[i], -2, 1, RANDOM_SIGNED);
+	    }
+	    for (size_t j = 0; j <= degree; j++)
+	    {
+		assign_random(coeffs[j], -8, 8, RANDOM_SIGNED);
+		if (rand() % 16 == 0)
+		    mpfr_set_zero(coeffs[j], 1);
+	    }
+
+	    // Timings and errors in round to nearest on ordinary points
+	    double error[3], time[3];
+	    for (size_t i = 0; i < n; i++)
+		reference(p[i], s[i], coeffs, degree, x[i]);
+	    for (int method = 0; method < 3; method++)
+	    {
+		const int repeats = degree <= 16 ? 16 : 2;
+		const double start = wall_time();
+		for (int r = 0; r < repeats; r++)
+		{
+		    if (method == 0)
+			horner_loop(rop, coeffs, degree, x, n, MPFR_RNDN);
+		    else
+		    {
+			avxmpfr_poly_set_scheme(method);
+			avxmpfr_poly_eval_vec(rop, coeffs, degree, x, n, MPFR_RNDN);
+		    }
+		}
+		time[method] = (wall_time() - start) / (repeats * n) * 1e9;
+		error[method] = worst_error(rop, p, s, n, degree, method > 0);
+	    }
+
+	    // Every rounding mode and scheme with awkward points, then in place
+	    assign_awkward(x, n);
+	    for (size_t i = 0; i < n; i++)
+		reference(p[i], s[i], coeffs, degree, x[i]);
+	    int correct = error[1] >= 0 && error[2] >= 0;
+	    for (int scheme = 0; scheme < 3; scheme++)
+	    {
+		avxmpfr_poly_set_scheme(scheme);
+		for (int m = 0; m < 5; m++)
+		{
+		    avxmpfr_poly_eval_vec(rop, coeffs, degree, x, n, modes[m]);
+		    correct &= worst_error(rop, p, s, n, degree, 1) >= 0;
+		}
+		for (size_t i = 0; i < n; i++)
+		    mpfr_set(rop[i], x[i], MPFR_RNDN);
+		avxmpfr_poly_eval_vec(rop, coeffs, degree, rop, n, modes[rand() % 5]);
+		correct &= worst_error(rop, p, s, n, degree, 1) >= 0;
+		if (!correct)
+		{
+		    printf("%s scheme out of its bound at degree %zu, precision %ld\n", schemes[scheme], degree, (long) prec);
+		    break;
+		}
+	    }
+	    avxmpfr_poly_set_scheme(AVXMPFR_POLY_AUTO);
+	    all_correct &= correct;
+
+	    printf("%10ld %7zu %12.3g %12.3g %12.3g %12.1f %12.1f %8.2fx %8.2fx\n", (long) prec, degree, error[0],
+		   error[1], error[2], time[0], time[1], time[0] / time[1], time[0] / time[2]);
+
+	    for (size_t i = 0; i < n; i++)
+		mpfr_clear(p[i]);
+	}
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(x[i], rop[i], s[i], (mpfr_ptr) 0);
+	for (int j = 0; j <= 256; j++)
+	    mpfr_clear(coeffs[j]);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x);
+    free(rop);
+    free(p);
+    free(s);
+    return 0;
+}
@@ -0,0 +1,210 @@
+/*
+    Test file to measure latency against throughput of the asynchronous submission queue under contention.
+
+    PRODUCERS threads each submit BURSTS bursts of BURST_SIZE additions and wait for the whole burst, recording the
+    time from the first submission to the last completion. The same is repeated for several flush policies, and for
+    reference with every thread calling mpfr_add() itself. Last, queues are destroyed right after a run of
+    submissions, every one of which has to be finished by then.
+
+    The operands have either sign and are zeros of either sign one time in 64. Half of the bursts are in MPFR_RNDZ,
+    which the queue batches, the others in MPFR_RNDN, U, D and A, which it hands to mpfr. Every result is checked,
+    sign included, against mpfr_add() in the rounding mode of its burst.
+*/
+
+#include "comparison_utilities.h"
+#include <pthread.h>
+
+#define PRODUCERS 4
+#define BURSTS 2000
+#define BURST_SIZE 4
+
+typedef struct
+{
+    int id;
+    avxmpfr_queue *queue;		// NULL for the synchronous reference
+    uint64_t *latencies;		// BURSTS entries
+    uint64_t matches;
+} producer;
+
+uint16_t PRECISION = PRECISION_256;	// Set the precision you want to compare
+
+// Rounding mode of each burst, cycling
+static const mpfr_rnd_t modes[8] = {MPFR_RNDZ, MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDZ, MPFR_RNDD, MPFR_RNDZ, MPFR_RNDA};
+
+void *producer_main(void *arg)
+{
+    producer *p = arg;
+    unsigned seed = p->id * 7919 + 1;
+    mpfr_t op1[BURST_SIZE], op2[BURST_SIZE], rop[BURST_SIZE], expected;
+    avxmpfr_request requests[BURST_SIZE];
+
+    for (int k = 0; k < BURST_SIZE; k++)
+	mpfr_inits2(PRECISION, op1[k], op2[k], rop[k], NULL);
+    mpfr_init2(expected, PRECISION);
+
+    for (int b = 0; b < BURSTS; b++)
+    {
+	const mpfr_rnd_t rnd = modes[b % 8];
+	for (int k = 0; k < BURST_SIZE; k++)
+	{
+	    assign_random_r(op1[k], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS | RANDOM_SIGNED_ZEROS, &seed);
+	    assign_random_r(op2[k], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS | RANDOM_SIGNED_ZEROS, &seed);
+	}
+
+	uint64_t start = avxmpfr_now_ns();
+	for (int k = 0; k < BURST_SIZE; k++)
+	{
+	    if (p->queue)
+		avxmpfr_add_async(p->queue, &requests[k], rop[k], op1[k], op2[k], rnd);
+	    else
+		mpfr_add(rop[k], op1[k], op2[k], rnd);
+	}
+	if (p->queue)
+	{
+	    for (int k = 0; k < BURST_SIZE; k++)
+		avxmpfr_request_wait(&requests[k]);
+	}
+	p->latencies[b] = avxmpfr_now_ns() - start;
+
+	for (int k = 0; k < BURST_SIZE; k++)
+	{
+	    mpfr_add(expected, op1[k], op2[k], rnd);
+	    p->matches += mpfr_equal_p(expected, rop[k]) && mpfr_signbit(expected) == mpfr_signbit(rop[k]);
+	}
+    }
+
+    for (int k = 0; k < BURST_SIZE; k++)
+	mpfr_clears(op1[k], op2[k], rop[k], NULL);
+    mpfr_clear(expected);
+    return NULL;
+}
+
+int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Run all producers against queue (or synchronously if NULL) and print one line of results
+int run(const char *name, avxmpfr_queue *queue)
+{
+    pthread_t threads[PRODUCERS];
+    producer producers[PRODUCERS];
+    uint64_t *latencies = malloc(PRODUCERS * BURSTS * sizeof(uint64_t));
+
+    uint64_t start = avxmpfr_now_ns();
+    for (int t = 0; t < PRODUCERS; t++)
+    {
+	producers[t] = (producer) {t, queue, latencies + t * BURSTS, 0};
+	pthread_create(&threads[t], NULL, producer_main, &producers[t]);
+    }
+    uint64_t matches = 0;
+    for (int t = 0; t < PRODUCERS; t++)
+    {
+	pthread_join(threads[t], NULL);
+	matches += producers[t].matches;
+    }
+    double seconds = (avxmpfr_now_ns() - start) * 1e-9;
+
+    qsort(latencies, PRODUCERS * BURSTS, sizeof(uint64_t), compare_u64);
+    const uint64_t total = (uint64_t) PRODUCERS * BURSTS * BURST_SIZE;
+    printf("%-40s %10.2f %10.2f %14.3f %10s\n", name,
+	   latencies[PRODUCERS * BURSTS / 2] * 1e-3, latencies[PRODUCERS * BURSTS * 99 / 100] * 1e-3,
+	   total / seconds / 1e6, matches == total ? "yes" : "NO");
+
+    free(latencies);
+    return matches == total;
+}
+
+// Submit additions and destroy the queue straight away, returns 1 if destroying it finished every one of them
+int drain_on_destroy(int rounds)
+{
+    const int n = 256;
+    unsigned seed = 12345;
+    mpfr_t *op = malloc(n * sizeof(mpfr_t)), *rop = malloc(n * sizeof(mpfr_t));
+    avxmpfr_request *requests = malloc(n * sizeof(avxmpfr_request));
+    for (int k = 0; k < n; k++)
+    {
+	mpfr_inits2(PRECISION, op[k], rop[k], NULL);
+	assign_random_r(op[k], -16, 16, 0, &seed);
+    }
+
+    int finished = 1;
+    for (int round = 0; round < rounds; round++)
+    {
+	avxmpfr_queue_config config;
+	avxmpfr_queue_config_init(&config);
+	config.flush_size = 1 + round % 64;
+	config.flush_deadline_ns = 1000000;
+	avxmpfr_queue *queue = avxmpfr_queue_create(&config);
+	for (int k = 0; k < n; k++)
+	    avxmpfr_add_async(queue, &requests[k], rop[k], op[k], op[k], MPFR_RNDZ);
+	avxmpfr_queue_destroy(queue);
+	for (int k = 0; k < n; k++)
+	    finished &= avxmpfr_request_done(&requests[k]);
+    }
+
+    for (int k = 0; k < n; k++)
+	mpfr_clears(op[k], rop[k], NULL);
+    free(op);
+    free(rop);
+    free(requests);
+    return finished;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+
+    // Flush policies to compare: batch size, deadline in ns
+    const size_t flush_sizes[] = {1, 16, 64, 256};
+    const uint64_t deadlines[] = {0, 2000, 20000, 200000};
+    int all_match = 1;
+
+    printf("\n%d producers, bursts of %d additions\n\n", PRODUCERS, BURST_SIZE);
+    printf("%-40s %10s %10s %14s %10s\n", "Path", "p50 us", "p99 us", "Madds/s", "correct");
+
+    all_match &= run("mpfr_add() in every thread", NULL);
+
+    for (int workers = 1; workers <= 2; workers++)
+    {
+	for (size_t i = 0; i < sizeof(flush_sizes) / sizeof(flush_sizes[0]); i++)
+	{
+	    avxmpfr_queue_config config;
+	    avxmpfr_queue_config_init(&config);
+	    config.workers = workers;
+	    config.flush_size = flush_sizes[i];
+	    config.flush_deadline_ns = deadlines[i];
+
+	    char name[64];
+	    snprintf(name, sizeof(name), "queue, %d worker%s, flush %zu / %lu ns", workers, workers == 1 ? "" : "s",
+		     config.flush_size, config.flush_deadline_ns);
+
+	    avxmpfr_queue *queue = avxmpfr_queue_create(&config);
+	    all_match &= run(name, queue);
+	    avxmpfr_queue_destroy(queue);
+	}
+    }
+
+    // A ring too big to allocate, and one too big to even size, have to fail without leaving anything running
+    avxmpfr_queue_config config;
+    avxmpfr_queue_config_init(&config);
+    config.workers = 2;
+    config.ring_size = SIZE_MAX / 64;
+    int refused = avxmpfr_queue_create(&config) == NULL;
+    config.ring_size = SIZE_MAX;
+    refused &= avxmpfr_queue_create(&config) == NULL;
+    printf("\n%-40s %s", "avxmpfr_queue_create() refuses huge rings", refused ? "yes" : "NO");
+    all_match &= refused;
+
+    const int drained = drain_on_destroy(200);
+    printf("\n%-40s %s\n", "avxmpfr_queue_destroy() finishes all", drained ? "yes" : "NO");
+    all_match &= drained;
+
+    if (all_match)
+	printf("\n\x1b[32mSums are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mSums are unequal\x1b[0m\n\n");
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*
+    Test file to compare avxmpfr_urandom_vec() against the ways operands are made elsewhere: the string of rand() bits
+    parsed by mpfr_set_str() in comparison.c, and mpfr_urandomb() called per value.
+
+    The generator is checked against a scalar Philox4x32-10 written from the paper, which has to reproduce the known
+    answer vectors of the Random123 reference code; every value of every precision (1 bit to past a whole chunk of
+    blocks, and arrays of mixed precisions) has to have exactly the limbs, sign and exponent the documented layout gives
+    from that scalar code. Calls split at random points have to give the numbers of one call, threads on their own
+    streams the numbers the same streams give on one thread, and invalid distributions have to be refused. Uniform
+    values have to average 1/2 and have exponent 0 half of the time, the exponents of AVXMPFR_RANDOM_EXPONENTS have to
+    fill their range evenly with balanced signs.
+
+    The timings are ns per value at 252 and 504 bits, then the values per second of 1 to 8 threads each on its own
+    stream.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+#include <pthread.h>
+
+// Philox4x32-10 on one counter, the way the paper writes it
+void philox(uint32_t out[4], const uint32_t counter[4], const uint32_t key[2])
+{
+    uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]}, k[2] = {key[0], key[1]};
+    for (int r = 0; r < 10; r++)
+    {
+	const uint64_t p0 = (uint64_t) 0xD2511F53 * c[0], p1 = (uint64_t) 0xCD9E8D57 * c[2];
+	const uint32_t d[4] = {(uint32_t) (p1 >> 32) ^ c[1] ^ k[0], (uint32_t) p1, (uint32_t) (p0 >> 32) ^ c[3] ^ k[1],
+			       (uint32_t) p0};
+	memcpy(c, d, sizeof(c));
+	k[0] += 0x9E3779B9;
+	k[1] += 0xBB67AE85;
+    }
+    memcpy(out, c, sizeof(c));
+}
+
+// The known answers of the Random123 distribution for philox4x32_10
+int philox_known_answers()
+{
+    static const uint32_t cases[3][10] = {
+	{0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+	{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+	 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+	{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+	 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+    int correct = 1;
+    for (int t = 0; t < 3; t++)
+    {
+	uint32_t out[4];
+	philox(out, cases[t], cases[t] + 4);
+	correct &= memcmp(out, cases[t] + 6, sizeof(out)) == 0;
+    }
+    return correct;
+}
+
+// Word w of a stream, the low or high half of block w / 2
+uint64_t stream_word(const avxmpfr_random *state, uint64_t w)
+{
+    const uint64_t g = w / 2;
+    const uint32_t counter[4] = {(uint32_t) g, (uint32_t) (g >> 32), (uint32_t) state->stream,
+				 (uint32_t) (state->stream >> 32)};
+    const uint32_t key[2] = {(uint32_t) state->seed, (uint32_t) (state->seed >> 32)};
+    uint32_t out[4];
+    philox(out, counter, key);
+    return w % 2 ? out[2] | (uint64_t) out[3] << 32 : out[0] | (uint64_t) out[1] << 32;
+}
+
+// The value the layout gives from word w on, in expected, returns the first word of the next value
+uint64_t expected_value(mpfr_t expected, const avxmpfr_random *state, uint64_t w, int distribution, mpfr_exp_t low,
+			mpfr_exp_t high)
+{
+    const mpfr_prec_t precision = mpfr_get_prec(expected);
+    const mp_size_t limbs = (precision + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    mpz_t k;
+    mpz_init(k);
+    for (mp_size_t j = limbs; j-- > 0;)
+    {
+	mpz_mul_2exp(k, k, 64);
+	mpz_add_ui(k, k, stream_word(state, w + j));
+    }
+    mpz_fdiv_q_2exp(k, k, limbs * GMP_NUMB_BITS - precision);
+    const uint64_t extra = stream_word(state, w + limbs);
+
+    if (distribution == AVXMPFR_RANDOM_UNIFORM)
+	mpfr_set_z_2exp(expected, k, -precision, MPFR_RNDN);
+    else
+    {
+	mpz_setbit(k, precision - 1);
+	mpfr_set_z_2exp(expected, k, -precision, MPFR_RNDN);
+	mpfr_set_exp(expected, low + (mpfr_exp_t) (((extra & 0xFFFFFFFF) * (uint64_t) (high - low)) >> 32));
+	if (extra >> 63)
+	    mpfr_neg(expected, expected, MPFR_RNDN);
+    }
+    mpz_clear(k);
+    return (w + limbs + 2) & ~(uint64_t) 1;
+}
+
+// 1 if the n values of a are those of b, signs of zeros included
+int same(mpfr_t *a, mpfr_t *b, size_t n)
+{
+    int equal = 1;
+    for (size_t i = 0; i < n; i++)
+	equal &= mpfr_equal_p(a[i], b[i]) && mpfr_signbit(a[i]) == mpfr_signbit(b[i]);
+    return equal;
+}
+
+// The operands of comparison.c: 252 or 504 rand() bits with a point somewhere among them, through mpfr_set_str()
+void assign_binary(mpfr_t number, char *binNum, int bits)
+{
+    const int pointLocation = rand() % bits;
+    for (int i = 0; i < bits + 1; i++)
+	binNum[i] = i == pointLocation ? '.' : '0' + (rand() % 2);
+    binNum[bits + 1] = '\0';
+    mpfr_set_str(number, binNum, 2, MPFR_RNDN);
+}
+
+typedef struct
+{
+    mpfr_t *values;
+    size_t n;
+    int stream;
+    int repeats;
+} thread_job;
+
+void *thread_main(void *arg)
+{
+    thread_job *job = arg;
+    avxmpfr_random state;
+    avxmpfr_random_init(&state, 42, job->stream);
+    for (int r = 0; r < job->repeats; r++)
+	avxmpfr_urandom_vec(job->values, job->n, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    return NULL;
+}
+
+// Fill values by parts on threads, part t from stream t, returns the seconds taken
+double run_threads(mpfr_t *values, size_t n, int threads, int repeats)
+{
+    pthread_t id[8];
+    thread_job jobs[8];
+    const double start = wall_time();
+    for (int t = 0; t < threads; t++)
+    {
+	jobs[t] = (thread_job) {values + n * t / threads, n * (t + 1) / threads - n * t / threads, t, repeats};
+	pthread_create(&id[t], NULL, thread_main, &jobs[t]);
+    }
+    for (int t = 0; t < threads; t++)
+	pthread_join(id[t], NULL);
+    return wall_time() - start;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {1, 2, 53, 63, 64, 65, 113, PRECISION_256, 256, PRECISION_512, 1000, 40000};
+    const int kinds = sizeof(precisions) / sizeof(precisions[0]);
+    const size_t n = 1 << 16;
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(n * sizeof(mpfr_t)), *y = malloc(n * sizeof(mpfr_t));
+    avxmpfr_random state, copy;
+
+    // The scalar reference against the known answers
+    if (!philox_known_answers())
+    {
+	printf("the scalar Philox4x32-10 misses its known answers\n");
+	all_correct = 0;
+    }
+
+    // Every value against the layout, one precision per array then mixed ones, both distributions
+    for (int p = 0; p <= kinds; p++)
+    {
+	const int mixed = p == kinds;
+	const size_t count = mixed || precisions[p] < 1000 ? 4096 : 64;
+	for (size_t i = 0; i < count; i++)
+	{
+	    const mpfr_prec_t prec = mixed ? precisions[rand() % (kinds - 1)] : precisions[p];
+	    mpfr_inits2(prec, x[i], y[i], (mpfr_ptr) 0);
+	}
+
+	for (int distribution = 0; distribution < 2; distribution++)
+	{
+	    const mpfr_exp_t low = rand() % 64 - 32, high = low + 1 + rand() % 40;
+	    avxmpfr_random_init(&state, ((uint64_t) rand() << 40) ^ rand(), rand() % 4 ? (uint64_t) rand() : ~(uint64_t) 0);
+	    state.counter = rand() % 2 ? 0 : ((uint64_t) 1 << 32) - 1 - rand() % 64;	// Across the 32 bit carry
+	    copy = state;
+
+	    avxmpfr_urandom_vec(x, count, &state, distribution, low, high);
+	    uint64_t w = 2 * copy.counter;
+	    for (size_t i = 0; i < count; i++)
+		w = expected_value(y[i], &copy, w, distribution, low, high);
+	    int correct = same(x, y, count) && state.counter == w / 2;
+
+	    // Split at random points
+	    state = copy;
+	    for (size_t first = 0; first < count;)
+	    {
+		size_t part = 1 + rand() % 100;
+		if (part > count - first)
+		    part = count - first;
+		avxmpfr_urandom_vec(x + first, part, &state, distribution, low, high);
+		first += part;
+	    }
+	    correct &= same(x, y, count);
+
+	    if (!correct)
+	    {
+		if (mixed)
+		    printf("values differ from the layout at mixed precisions, distribution %d\n", distribution);
+		else
+		    printf("values differ from the layout at precision %ld, distribution %d\n", (long) precisions[p],
+			   distribution);
+	    }
+	    all_correct &= correct;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	    mpfr_clears(x[i], y[i], (mpfr_ptr) 0);
+    }
+
+    // Invalid requests leave everything alone
+    mpfr_init2(x[0], 53);
+    mpfr_set_ui(x[0], 7, MPFR_RNDN);
+    avxmpfr_random_init(&state, 1, 2);
+    int refused = avxmpfr_urandom_vec(x, 1, &state, 2, 0, 1) == -1
+		  && avxmpfr_urandom_vec(x, 1, &state, AVXMPFR_RANDOM_EXPONENTS, 4, 4) == -1
+		  && avxmpfr_urandom_vec(x, 1, &state, AVXMPFR_RANDOM_EXPONENTS, 0, ((mpfr_exp_t) 1 << 32) + 1) == -1
+		  && avxmpfr_urandom_vec(x, 1, &state, AVXMPFR_RANDOM_EXPONENTS, mpfr_get_emax(), mpfr_get_emax() + 2) == -1
+		  && mpfr_cmp_ui(x[0], 7) == 0 && state.counter == 0;
+    if (!refused)
+	printf("invalid requests are not refused\n");
+    all_correct &= refused;
+    mpfr_clear(x[0]);
+
+    // The distributions
+    for (size_t i = 0; i < n; i++)
+	mpfr_inits2(PRECISION_256, x[i], y[i], (mpfr_ptr) 0);
+    avxmpfr_random_init(&state, time(NULL), 0);
+    avxmpfr_urandom_vec(x, n, &state, AVXMPFR_RANDOM_UNIFORM, 0, 0);
+    double mean = 0;
+    size_t top_binade = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+	mean += mpfr_get_d(x[i], MPFR_RNDN) / n;
+	top_binade += mpfr_get_exp(x[i]) == 0;
+    }
+    int even = mean > 0.49 && mean < 0.51 && top_binade > 0.48 * n && top_binade < 0.52 * n;
+
+    size_t counts[8] = {0}, negative = 0;
+    avxmpfr_urandom_vec(x, n, &state, AVXMPFR_RANDOM_EXPONENTS, -3, 5);
+    for (size_t i = 0; i < n; i++)
+    {
+	counts[mpfr_get_exp(x[i]) + 3]++;
+	negative += mpfr_signbit(x[i]) != 0;
+    }
+    for (int e = 0; e < 8; e++)
+	even &= counts[e] > 0.9 * n / 8 && counts[e] < 1.1 * n / 8;
+    even &= negative > 0.48 * n && negative < 0.52 * n;
+    if (!even)
+	printf("the distributions are off: mean %.4f, top binade %zu, negative %zu of %zu\n", mean, top_binade, negative, n);
+    all_correct &= even;
+
+    // Threads on their own streams give what the streams give on one thread
+    run_threads(x, n, 4, 1);
+    for (int t = 0; t < 4; t++)
+    {
+	avxmpfr_random_init(&state, 42, t);
+	avxmpfr_urandom_vec(y + n * t / 4, n / 4, &state, AVXMPFR_RANDOM_EXPONENTS, -16, 16);
+    }
+    if (!same(x, y, n))
+    {
+	printf("threads differ from their streams\n");
+	all_correct = 0;
+    }
+    for (size_t i = 0; i < n; i++)
+	mpfr_clears(x[i], y[i], (mpfr_ptr) 0);
+
+    // Timings
+    printf("\nns per value, speedup over the strings of comparison.c and over mpfr_urandomb()\n\n");
+    printf("%10s %14s %14s %14s %14s %9s %9s\n", "precision", "strings", "urandomb", "uniform", "exponents",
+	   "strings", "urandomb");
+    const size_t timed = 1 << 14;
+    char binNum[PRECISION_512 + 2];
+    gmp_randstate_t gmp_state;
+    gmp_randinit_default(gmp_state);
+    for (int p = 0; p < 2; p++)
+    {
+	const mpfr_prec_t prec = p ? PRECISION_512 : PRECISION_256;
+	for (size_t i = 0; i < timed; i++)
+	    mpfr_init2(x[i], prec);
+
+	double time[4], start;
+	start = wall_time();
+	for (size_t i = 0; i < timed; i++)
+	    assign_binary(x[i], binNum, prec);
+	time[0] = wall_time() - start;
+
+	start = wall_time();
+	for (int r = 0; r < 16; r++)
+	    for (size_t i = 0; i < timed; i++)
+		mpfr_urandomb(x[i], gmp_state);
+	time[1] = (wall_time() - start) / 16;
+
+	for (int distribution = 0; distribution < 2; distribution++)
+	{
+	    start = wall_time();
+	    for (int r = 0; r < 16; r++)
+		avxmpfr_urandom_vec(x, timed, &state, distribution, -16, 16);
+	    time[2 + distribution] = (wall_time() - start) / 16;
+	}
+	printf("%10ld %14.1f %14.1f %14.1f %14.1f %8.1fx %8.2fx\n", (long) prec, time[0] / timed * 1e9,
+	       time[1] / timed * 1e9, time[2] / timed * 1e9, time[3] / timed * 1e9, time[0] / time[3], time[1] / time[3]);
+
+	for (size_t i = 0; i < timed; i++)
+	    mpfr_clear(x[i]);
+    }
+    gmp_randclear(gmp_state);
+
+    printf("\nmillions of 252 bit values per second, one stream per thread\n\n");
+    printf("%10s %14s\n", "threads", "Mvalues/s");
+    for (size_t i = 0; i < n; i++)
+	mpfr_init2(x[i], PRECISION_256);
+    for (int threads = 1; threads <= 8; threads *= 2)
+	printf("%10d %14.1f\n", threads, 16.0 * n / run_threads(x, n, threads, 16) * 1e-6);
+    for (size_t i = 0; i < n; i++)
+	mpfr_clear(x[i]);
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x);
+    free(y);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+    Test file to compare the cost per element of adding one fixed value to a whole array.
+
+    The paths timed are:
+	mpfr_add() on every element
+	avxmpfr_add() on every element, on scratch copies since it modifies both operands
+	avxmpfr_add_scalar_vec() over the whole array
+	avx_add() alone on numbers that are already padded and alligned, the floor for any of the above
+
+    Every result of avxmpfr_add_scalar_vec() has to be mpfr_add() with MPFR_RNDZ, as the truncated sums of
+    PRECISION_256 / PRECISION_512 operands are. A shorter array is then added in every other rounding mode, where
+    the results have to be mpfr_add() in that mode.
+*/
+
+#include "comparison_utilities.h"
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    // Initialise some variables
+    uint16_t PRECISION = PRECISION_256;	// Set the precision you want to compare
+    const size_t count = 1<<18;		// Elements in the array
+    const int L = (PRECISION + 62) / 63;
+    double start;
+
+    mpfr_t c, c_copy, op_copy, reference;
+    mpfr_inits2(PRECISION, c, c_copy, op_copy, reference, NULL);
+    assign_random(c, -16, 16, RANDOM_RARELY_NEGATIVE);
+    c->_mpfr_sign = 1;
+
+    mpfr_t* op = malloc(count * sizeof(mpfr_t));
+    mpfr_t* rop = malloc(count * sizeof(mpfr_t));
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_inits2(PRECISION, op[i], rop[i], NULL);
+	assign_random(op[i], -16, 16, RANDOM_RARELY_NEGATIVE);
+    }
+
+    // Pre-padded copies for the bare kernel
+    uint64_t* lanes = aligned_alloc(64, (count + 1) * L * sizeof(uint64_t));
+    uint64_t* results = aligned_alloc(64, count * L * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++)
+	avxmpfr_pack_lanes(lanes + i * L, 1, L, op[i]);
+    avxmpfr_pack_lanes(lanes + count * L, 1, L, c);
+
+
+    /* mpfr_add() */
+    start = wall_time();
+    for (size_t i = 0; i < count; i++)
+	mpfr_add(rop[i], op[i], c, MPFR_RNDZ);
+    double mpfr_time = wall_time() - start;
+
+
+    /* avxmpfr_add() on copies */
+    start = wall_time();
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_set(op_copy, op[i], MPFR_RNDN);
+	mpfr_set(c_copy, c, MPFR_RNDN);
+	if (PRECISION == PRECISION_256)
+	    avxmpfr_add(rop[i], op_copy, c_copy, MPFR_RNDF, PRECISION_256);
+	else
+	    avxmpfr_add_512(rop[i], op_copy, c_copy, MPFR_RNDF, PRECISION_512);
+    }
+    double avxmpfr_time = wall_time() - start;
+
+
+    /* avxmpfr_add_scalar_vec() */
+    start = wall_time();
+    avxmpfr_add_scalar_vec(rop, op, c, count, MPFR_RNDZ, PRECISION);
+    double scalar_time = wall_time() - start;
+
+
+    /* Bare avx_add() */
+    start = wall_time();
+    mpfr_exp_t exponent = 0;
+    if (PRECISION == PRECISION_256)
+    {
+	const __m256i c_avx = _mm256_load_si256((const __m256i *) (lanes + count * L));
+	for (size_t i = 0; i < count; i++)
+	{
+	    __m256i x = _mm256_load_si256((const __m256i *) (lanes + i * L));
+	    _mm256_store_si256((__m256i *) (results + i * L), avx_add(x, c_avx, &exponent));
+	}
+    }
+    else
+    {
+	const __m512i c_avx = _mm512_load_si512((const void *) (lanes + count * L));
+	for (size_t i = 0; i < count; i++)
+	{
+	    __m512i x = _mm512_load_si512((const void *) (lanes + i * L));
+	    _mm512_store_si512((void *) (results + i * L), avx_add_512i(x, c_avx, &exponent));
+	}
+    }
+    double bare_time = wall_time() - start;
+
+
+    /* Check avxmpfr_add_scalar_vec() against mpfr_add() */
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_add(reference, op[i], c, MPFR_RNDZ);
+	total += mpfr_equal_p(rop[i], reference) && mpfr_signbit(rop[i]) == mpfr_signbit(reference);
+    }
+
+    // The other rounding modes, on a prefix with c of either sign
+    const mpfr_rnd_t modes[4] = {MPFR_RNDN, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const size_t mode_count = 1<<12;
+    uint64_t mode_total = 0;
+    for (int m = 0; m < 4; m++)
+    {
+	c->_mpfr_sign = m % 2 ? -1 : 1;
+	avxmpfr_add_scalar_vec(rop, op, c, mode_count, modes[m], PRECISION);
+	for (size_t i = 0; i < mode_count; i++)
+	{
+	    mpfr_add(reference, op[i], c, modes[m]);
+	    mode_total += mpfr_equal_p(rop[i], reference) && mpfr_signbit(rop[i]) == mpfr_signbit(reference);
+	}
+    }
+
+
+    printf("\n\nTotal equal to mpfr_add(MPFR_RNDZ) : %ld / %ld\n", total, count);
+    printf("Total equal to mpfr_add() in the other modes : %ld / %ld\n", mode_total, 4 * mode_count);
+    if (total == count && mode_total == 4 * mode_count)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    printf("mpfr_add():\t\t\t %f ns/element\n", mpfr_time / count * 1e9);
+    printf("avxmpfr_add() on copies:\t %f ns/element\n", avxmpfr_time / count * 1e9);
+    printf("avxmpfr_add_scalar_vec():\t %f ns/element\n", scalar_time / count * 1e9);
+    printf("Bare avx_add():\t\t\t %f ns/element (ignore %ld)\n", bare_time / count * 1e9, (long) exponent & 1);
+
+    for (size_t i = 0; i < count; i++)
+	mpfr_clears(op[i], rop[i], NULL);
+    mpfr_clears(c, c_copy, op_copy, reference, NULL);
+    free(op); free(rop); free(lanes); free(results);
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+    Test file to compare avxmpfr_inclusive_scan() / avxmpfr_exclusive_scan() against the sequential loops they
+    replace, prefix[i] = prefix[i - 1] + x[i] with mpfr_add() and with avxmpfr_add() (on copies, as it modifies its
+    operands).
+
+    Values have random signs and exponents in [-16, 16), one in sixty four is zero. The exact scans have to give every
+    exact prefix sum rounded once (built here with mpfr_add() at a precision that holds them all), in a rounding mode
+    drawn at random, with 1 to 8 threads, in place and in both layouts. The rounded scans on one thread have to give
+    the bits of the mpfr_add() loop, zeros and their signs included. One more exact scan has a value 2^20 binades
+    away, which takes the running mpfr_t path.
+
+    The scans are timed on 1, 2, 4 and 8 threads, the speedup is over the mpfr_add() loop.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+// The sequential loop, rounding after every addition
+void loop_scan(mpfr_t *rop, mpfr_t *x, size_t n, int exclusive, mpfr_rnd_t rnd)
+{
+    if (exclusive)
+    {
+	mpfr_set_zero(rop[0], 1);
+	mpfr_set(rop[1], x[0], MPFR_RNDN);
+	for (size_t i = 2; i < n; i++)
+	    mpfr_add(rop[i], rop[i - 1], x[i - 1], rnd);
+    }
+    else
+    {
+	mpfr_set(rop[0], x[0], MPFR_RNDN);
+	for (size_t i = 1; i < n; i++)
+	    mpfr_add(rop[i], rop[i - 1], x[i], rnd);
+    }
+}
+
+// Every exact prefix sum rounded once, width bits hold them all
+void reference_scan(mpfr_t *rop, mpfr_t *x, size_t n, int exclusive, mpfr_prec_t width, mpfr_rnd_t rnd)
+{
+    mpfr_t sum;
+    mpfr_init2(sum, width);
+    mpfr_set_zero(sum, 1);
+    for (size_t i = 0; i < n; i++)
+    {
+	if (!exclusive)
+	    mpfr_add(sum, sum, x[i], MPFR_RNDN);
+	if (mpfr_zero_p(sum))
+	    mpfr_set_zero(rop[i], rnd == MPFR_RNDD ? -1 : 1);
+	else
+	    mpfr_set(rop[i], sum, rnd);
+	if (exclusive)
+	    mpfr_add(sum, sum, x[i], MPFR_RNDN);
+    }
+    mpfr_clear(sum);
+}
+
+// 1 if the n values of array are those of expected, signs of zeros included
+int same(const avxmpfr_array *array, mpfr_t *expected, size_t n, mpfr_t scratch)
+{
+    int equal = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+	avxmpfr_array_get(scratch, array, i, MPFR_RNDN);
+	equal &= mpfr_equal_p(scratch, expected[i]) && mpfr_signbit(scratch) == mpfr_signbit(expected[i]);
+    }
+    return equal;
+}
+
+void pack(avxmpfr_array *array, mpfr_t *values, size_t n, uint16_t precision, uint32_t layout)
+{
+    avxmpfr_array_init(array, precision, layout, n);
+    for (size_t i = 0; i < n; i++)
+	avxmpfr_array_set(array, i, values[i]);
+}
+
+void print_row(mpfr_prec_t precision, const char *name, int threads, double time, double loop, const char *correct)
+{
+    printf("%10ld %22s %8d %12.2f %8.2fx %8s\n", (long) precision, name, threads, time, loop / time, correct);
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint16_t precisions[] = {PRECISION_256, PRECISION_512};
+    const mpfr_rnd_t modes[4] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD};
+    const int threads[4] = {1, 2, 4, 8};
+    const size_t n = 1<<16;
+    const size_t wide = 4096;	// Values in the wide span check
+    const int repeats = 4;
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(n * sizeof(mpfr_t));
+    mpfr_t *z = malloc(n * sizeof(mpfr_t));
+
+    printf("\nns per value, speedup over the mpfr_add() loop\n\n");
+    printf("%10s %22s %8s %12s %9s %8s\n", "precision", "scan", "threads", "ns/value", "speedup", "correct");
+
+    for (int p = 0; p < 2; p++)
+    {
+	const mpfr_prec_t prec = precisions[p];
+	mpfr_t copy1, copy2, scratch;
+	mpfr_inits2(prec, copy1, copy2, scratch, (mpfr_ptr) 0);
+	for (size_t i = 0; i < n; i++)
+	{
+	    mpfr_inits2(prec, x[i], z[i], (mpfr_ptr) 0);
+	    assign_random(x[i], -16, 16, RANDOM_SIGNED | RANDOM_ZEROS | RANDOM_SIGNED_ZEROS);
+	}
+
+	avxmpfr_array X, Z;
+	pack(&X, x, n, prec, AVXMPFR_LAYOUT_NATIVE);
+	avxmpfr_array_init(&Z, prec, AVXMPFR_LAYOUT_NATIVE, n);
+	double start, loop;
+
+	// The sequential loops
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	    loop_scan(z, x, n, 0, MPFR_RNDN);
+	loop = (wall_time() - start) / (repeats * n) * 1e9;
+	print_row(prec, "mpfr_add() loop", 1, loop, loop, "-");
+
+	start = wall_time();
+	for (int k = 0; k < repeats; k++)
+	{
+	    mpfr_set(z[0], x[0], MPFR_RNDN);
+	    for (size_t i = 1; i < n; i++)
+	    {
+		mpfr_set(copy1, z[i - 1], MPFR_RNDN);
+		mpfr_set(copy2, x[i], MPFR_RNDN);
+		if (prec == PRECISION_256)
+		    avxmpfr_add(z[i], copy1, copy2, MPFR_RNDF, PRECISION_256);
+		else
+		    avxmpfr_add_512(z[i], copy1, copy2, MPFR_RNDF, PRECISION_512);
+	    }
+	}
+	print_row(prec, "avxmpfr_add() loop", 1, (wall_time() - start) / (repeats * n) * 1e9, loop, "-");
+
+	// The scans, rounded then exact
+	for (int exact = 0; exact < 2; exact++)
+	    for (int t = 0; t < 4; t++)
+	    {
+		avxmpfr_blas_set_threads(threads[t]);
+		start = wall_time();
+		for (int k = 0; k < repeats; k++)
+		    avxmpfr_inclusive_scan(&Z, &X, MPFR_RNDN, exact);
+		const double time = (wall_time() - start) / (repeats * n) * 1e9;
+
+		int correct = 1;
+		for (int exclusive = 0; exclusive < 2; exclusive++)
+		{
+		    const mpfr_rnd_t rnd = modes[rand() % 4];
+		    if (exact)
+			reference_scan(z, x, n, exclusive, 4096, rnd);
+		    else if (threads[t] == 1)
+			loop_scan(z, x, n, exclusive, rnd);
+		    else
+			continue;	// The last bits depend on the number of threads
+
+		    exclusive ? avxmpfr_exclusive_scan(&Z, &X, rnd, exact) : avxmpfr_inclusive_scan(&Z, &X, rnd, exact);
+		    correct &= same(&Z, z, n, scratch);
+
+		    // In place
+		    for (size_t b = 0; b < avxmpfr_array_blocks(n); b++)
+			memcpy(avxmpfr_block(&Z, b), avxmpfr_block(&X, b), avxmpfr_block_words(X.limbs) * 8);
+		    exclusive ? avxmpfr_exclusive_scan(&Z, &Z, rnd, exact) : avxmpfr_inclusive_scan(&Z, &Z, rnd, exact);
+		    correct &= same(&Z, z, n, scratch);
+
+		    // In the other layout
+		    avxmpfr_array XS, ZS;
+		    pack(&XS, x, n, prec, AVXMPFR_LAYOUT_SOA);
+		    avxmpfr_array_init(&ZS, prec, AVXMPFR_LAYOUT_SOA, n);
+		    exclusive ? avxmpfr_exclusive_scan(&ZS, &XS, rnd, exact) : avxmpfr_inclusive_scan(&ZS, &XS, rnd, exact);
+		    correct &= same(&ZS, z, n, scratch);
+		    avxmpfr_array_clear(&XS);
+		    avxmpfr_array_clear(&ZS);
+		}
+
+		if (!correct)
+		    printf("%s scan differs on %d threads\n", exact ? "exact" : "rounded", threads[t]);
+		all_correct &= correct;
+		print_row(prec, exact ? "inclusive, exact" : "inclusive, rounded", threads[t], time, loop,
+			  !exact && threads[t] > 1 ? "-" : correct ? "yes" : "NO");
+	    }
+	avxmpfr_blas_set_threads(1);
+
+	// An exponent span too wide for the accumulators
+	avxmpfr_array view;
+	mpfr_set_ui_2exp(x[1], 3, 1 << 20, MPFR_RNDN);
+	avxmpfr_array_set(&X, 1, x[1]);
+	avxmpfr_array_view(&view, &X, 0, wide);
+	int correct = 1;
+	for (int exclusive = 0; exclusive < 2; exclusive++)
+	{
+	    const mpfr_rnd_t rnd = modes[rand() % 4];
+	    reference_scan(z, x, wide, exclusive, (1 << 20) + 4096, rnd);
+	    exclusive ? avxmpfr_exclusive_scan(&Z, &view, rnd, 1) : avxmpfr_inclusive_scan(&Z, &view, rnd, 1);
+	    correct &= same(&Z, z, wide, scratch);
+	}
+	if (!correct)
+	    printf("exact scan differs with a wide exponent span\n");
+	all_correct &= correct;
+
+	for (size_t i = 0; i < n; i++)
+	    mpfr_clears(x[i], z[i], (mpfr_ptr) 0);
+	mpfr_clears(copy1, copy2, scratch, (mpfr_ptr) 0);
+	avxmpfr_array_clear(&X);
+	avxmpfr_array_clear(&Z);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x);
+    free(z);
+    return 0;
+}
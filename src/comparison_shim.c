@@ -0,0 +1,137 @@
+/*
+    Test file for the mpfr_add() / mpfr_sub() interposition of avxmpfr_shim.c, linked with --wrap.
+
+    Calls to mpfr_add() and mpfr_sub() in this file go through the shim, __real_mpfr_add() and __real_mpfr_sub() reach
+    MPFR itself. With the shim taking over eligible calls, random calls over mixed precisions, signs, exponent gaps,
+    rounding modes, special values, exact cancellations and exponents at the edge of the range have to give the same
+    value, sign, ternary value and flags.
+
+    Then it times the shim against MPFR on eligible calls, forwarded (the default) and taken over, and on calls that
+    are not eligible. The difference on forwarded calls is the cost of the check, each time is the best of PASSES.
+*/
+
+#include "comparison_utilities.h"
+
+#define PASSES 5
+
+int __real_mpfr_add(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd);
+int __real_mpfr_sub(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd);
+
+int sign_of(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+// Compare one call through the shim with MPFR, returns 1 if everything matches
+int check(mpfr_t rop1, mpfr_t rop2, mpfr_t op1, mpfr_t op2, mpfr_rnd_t rnd, int subtract)
+{
+    mpfr_clear_flags();
+    int t1 = subtract ? mpfr_sub(rop1, op1, op2, rnd) : mpfr_add(rop1, op1, op2, rnd);
+    mpfr_flags_t f1 = mpfr_flags_save();
+
+    mpfr_clear_flags();
+    int t2 = subtract ? __real_mpfr_sub(rop2, op1, op2, rnd) : __real_mpfr_add(rop2, op1, op2, rnd);
+    mpfr_flags_t f2 = mpfr_flags_save();
+
+    // RNDF only promises a faithful result, only MPFR itself reproduces its choice
+    int same_value = (mpfr_nan_p(rop1) && mpfr_nan_p(rop2))
+		     || (mpfr_equal_p(rop1, rop2) && mpfr_signbit(rop1) == mpfr_signbit(rop2));
+    return same_value && f1 == f2 && (rnd == MPFR_RNDF || sign_of(t1) == sign_of(t2));
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const mpfr_prec_t precisions[] = {2, 53, 64, 113, 200, PRECISION_256, 256, 400, PRECISION_512, 600};
+    const int n_precisions = sizeof(precisions) / sizeof(precisions[0]);
+    const size_t cases = 1<<19;
+    uint64_t matches = 0;
+
+    mpfr_t op1, op2, rop1, rop2;
+    mpfr_inits2(64, op1, op2, rop1, rop2, NULL);
+    avxmpfr_shim_take_over(1);
+
+    for (size_t c = 0; c < cases; c++)
+    {
+	mpfr_set_prec(op1, precisions[rand() % n_precisions]);
+	mpfr_set_prec(op2, rand() % 2 ? mpfr_get_prec(op1) : precisions[rand() % n_precisions]);
+	mpfr_set_prec(rop1, rand() % 2 ? mpfr_get_prec(op1) : precisions[rand() % n_precisions]);
+	mpfr_set_prec(rop2, mpfr_get_prec(rop1));
+
+	const int range = rand() % 2 ? 8 : 700;
+	assign_random(op1, -range, range, RANDOM_SIGNED | RANDOM_RUNS);
+	assign_random(op2, -range, range, RANDOM_SIGNED | RANDOM_RUNS);
+
+	switch (rand() % 16)
+	{
+	    case 0: mpfr_set_zero(op2, rand() % 2 ? 1 : -1); break;
+	    case 1: mpfr_set_inf(op2, rand() % 2 ? 1 : -1); break;
+	    case 2: mpfr_set_nan(op1); break;
+	    case 3: mpfr_set(op2, op1, MPFR_RNDN); break;		// Exact cancellation or doubling
+	    case 4: mpfr_set_exp(op1, mpfr_get_emax() - rand() % 3); break;
+	    case 5: mpfr_set_exp(op1, mpfr_get_emin() + rand() % 3); break;
+	    default: break;
+	}
+
+	matches += check(rop1, rop2, op1, op2, rand() % 6, rand() % 2);
+    }
+
+    printf("\nCalls matching MPFR (value, ternary value, flags): %lu / %zu\n", matches, cases);
+    avxmpfr_shim_report(stdout);
+
+
+    /* Timing */
+    const size_t count = 1<<16;
+    const char *rows[3] = {"252 bits, forwarded", "252 bits, taken over", "1000 bits, not eligible"};
+    double times[3][2];
+    for (int row = 0; row < 3; row++)
+    {
+	const mpfr_prec_t precision = row < 2 ? PRECISION_256 : 1000;
+	mpfr_t* a = malloc(count * sizeof(mpfr_t));
+	mpfr_t* b = malloc(count * sizeof(mpfr_t));
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpfr_inits2(precision, a[i], b[i], NULL);
+	    assign_random(a[i], -16, 16, RANDOM_SIGNED | RANDOM_RUNS);
+	    assign_random(b[i], -16, 16, RANDOM_SIGNED | RANDOM_RUNS);
+	}
+	mpfr_set_prec(rop1, precision);
+	avxmpfr_shim_take_over(row == 1);
+
+	times[row][0] = times[row][1] = 1e9;
+	for (int pass = 0; pass < PASSES; pass++)
+	{
+	    double start = wall_time();
+	    for (size_t i = 0; i < count; i++)
+		mpfr_add(rop1, a[i], b[i], MPFR_RNDN);
+	    double shim_time = (wall_time() - start) / count * 1e9;
+
+	    start = wall_time();
+	    for (size_t i = 0; i < count; i++)
+		__real_mpfr_add(rop1, a[i], b[i], MPFR_RNDN);
+	    double mpfr_time = (wall_time() - start) / count * 1e9;
+
+	    times[row][0] = shim_time < times[row][0] ? shim_time : times[row][0];
+	    times[row][1] = mpfr_time < times[row][1] ? mpfr_time : times[row][1];
+	}
+
+	for (size_t i = 0; i < count; i++)
+	    mpfr_clears(a[i], b[i], NULL);
+	free(a); free(b);
+    }
+    avxmpfr_shim_take_over(0);
+
+    printf("\n%-36s %14s %14s\n", "ns per mpfr_add()", "through shim", "MPFR");
+    for (int row = 0; row < 3; row++)
+	printf("%-36s %14.2f %14.2f\n", rows[row], times[row][0], times[row][1]);
+
+    if (matches == cases)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    mpfr_clears(op1, op2, rop1, rop2, NULL);
+    return 0;
+}
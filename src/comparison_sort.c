@@ -0,0 +1,172 @@
+/*
+    Test file to compare avxmpfr_cmp_vec(), avxmpfr_min_vec() and avxmpfr_sort_array() on packed arrays against
+    mpfr_cmp(), mpfr_min() and qsort() with mpfr_cmp() on arrays of mpfr_t.
+
+    Values have random signs and exponents in [-8, 8), one in eight repeats an earlier value and one in sixty four is
+    a zero of either sign, so that comparisons often have to go down to the last limb and sorting has duplicates to
+    drop. Every comparison, every minimum and every sorted (and deduplicated) position has to match mpfr.
+*/
+
+#include "comparison_utilities.h"
+#include <string.h>
+
+int compare(const void *a, const void *b)
+{
+    return mpfr_cmp(*(const mpfr_t *) a, *(const mpfr_t *) b);
+}
+
+// 1 if value index of array is the same as number, zeros of the same sign
+int same(const avxmpfr_array *array, uint64_t index, mpfr_t number, mpfr_t scratch)
+{
+    avxmpfr_array_get(scratch, array, index, MPFR_RNDN);
+    return mpfr_equal_p(scratch, number) && mpfr_signbit(scratch) == mpfr_signbit(number);
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    const uint64_t count = 1<<20;
+    const uint16_t precisions[2] = {PRECISION_256, PRECISION_512};
+    const char *layouts[2] = {"native", "SoA"};
+    int all_correct = 1;
+
+    mpfr_t *x = malloc(count * sizeof(mpfr_t));
+    mpfr_t *y = malloc(count * sizeof(mpfr_t));
+    mpfr_t *sorted = malloc(count * sizeof(mpfr_t));
+    int8_t *order1 = malloc(count), *order2 = malloc(count);
+
+    printf("\nms for %lu values\n\n", (unsigned long) count);
+    printf("%-12s %9s %9s %9s %9s %9s %9s %9s %9s %10s %10s %10s %8s\n", "", "mpfr_cmp", "cmp_vec", "mpfr_min",
+	   "min_vec", "qsort", "sort", "qs+dedup", "unique", "cmp", "sort", "unique", "correct");
+
+    for (int p = 0; p < 2; p++)
+    {
+	const uint16_t precision = precisions[p];
+	for (uint64_t i = 0; i < count; i++)
+	{
+	    mpfr_inits2(precision, x[i], y[i], sorted[i], NULL);
+	    assign_random(x[i], -8, 8, RANDOM_SIGNED);
+	    assign_random(y[i], -8, 8, RANDOM_SIGNED);
+	    if (i > 0 && rand() % 8 == 0)
+		mpfr_set(x[i], x[rand() % i], MPFR_RNDN);
+	    if (rand() % 8 == 0)
+		mpfr_set(y[i], x[i], MPFR_RNDN);
+	    if (rand() % 64 == 0)
+		mpfr_set_zero(x[i], rand() % 2 ? 1 : -1);
+	}
+
+	for (uint32_t layout = AVXMPFR_LAYOUT_NATIVE; layout <= AVXMPFR_LAYOUT_SOA; layout++)
+	{
+	    avxmpfr_array a, b, r;
+	    avxmpfr_array_init(&a, precision, layout, count);
+	    avxmpfr_array_init(&b, precision, layout, count);
+	    avxmpfr_array_init(&r, precision, layout, count);
+	    for (uint64_t i = 0; i < count; i++)
+	    {
+		avxmpfr_array_set(&a, i, x[i]);
+		avxmpfr_array_set(&b, i, y[i]);
+	    }
+	    const size_t bytes = avxmpfr_array_blocks(count) * avxmpfr_block_words(a.limbs) * sizeof(uint64_t);
+	    double times[8];
+	    double start;
+
+	    // Element wise comparison
+	    start = wall_time();
+	    for (uint64_t i = 0; i < count; i++)
+		order1[i] = (int8_t) mpfr_cmp(x[i], y[i]);
+	    times[0] = wall_time() - start;
+
+	    start = wall_time();
+	    avxmpfr_cmp_vec(order2, &a, &b);
+	    times[1] = wall_time() - start;
+
+	    int cmp_correct = 1;
+	    for (uint64_t i = 0; i < count; i++)
+		cmp_correct &= (order1[i] > 0) - (order1[i] < 0) == order2[i];
+
+	    // Element wise minimum
+	    start = wall_time();
+	    for (uint64_t i = 0; i < count; i++)
+		mpfr_min(sorted[i], x[i], y[i], MPFR_RNDN);
+	    times[2] = wall_time() - start;
+
+	    start = wall_time();
+	    avxmpfr_min_vec(&r, &a, &b);
+	    times[3] = wall_time() - start;
+
+	    mpfr_t value;
+	    mpfr_init2(value, precision);
+	    for (uint64_t i = 0; i < count; i++)
+		cmp_correct &= same(&r, i, sorted[i], value);
+
+	    // Sorting, on copies so that every run starts from the same order
+	    for (uint64_t i = 0; i < count; i++)
+		mpfr_set(sorted[i], x[i], MPFR_RNDN);
+	    start = wall_time();
+	    qsort(sorted, count, sizeof(mpfr_t), compare);
+	    times[4] = wall_time() - start;
+
+	    memcpy(r.blocks, a.blocks, bytes);
+	    start = wall_time();
+	    avxmpfr_sort_array(&r, 0);
+	    times[5] = wall_time() - start;
+
+	    // Equal values may come in any order, -0 and +0 included
+	    int sort_correct = 1;
+	    for (uint64_t i = 0; i < count; i++)
+	    {
+		avxmpfr_array_get(value, &r, i, MPFR_RNDN);
+		sort_correct &= mpfr_equal_p(value, sorted[i]);
+	    }
+
+	    // Deduplication, mpfr keeps the first of every run of equal values of the sorted array
+	    start = wall_time();
+	    uint64_t unique = count > 0;
+	    for (uint64_t i = 1; i < count; i++)
+	    {
+		if (!mpfr_equal_p(sorted[i], sorted[unique - 1]))
+		    mpfr_swap(sorted[unique++], sorted[i]);
+	    }
+	    times[6] = times[4] + wall_time() - start;
+
+	    memcpy(r.blocks, a.blocks, bytes);
+	    r.count = count;
+	    start = wall_time();
+	    avxmpfr_sort_array(&r, 1);
+	    times[7] = wall_time() - start;
+
+	    sort_correct &= r.count == unique;
+	    for (uint64_t i = 0; i < unique && i < r.count; i++)
+	    {
+		avxmpfr_array_get(value, &r, i, MPFR_RNDN);
+		sort_correct &= mpfr_equal_p(value, sorted[i]);
+	    }
+	    mpfr_clear(value);
+	    all_correct &= cmp_correct && sort_correct;
+
+	    char label[32];
+	    snprintf(label, sizeof(label), "%u %s", precision, layouts[layout]);
+	    printf("%-12s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2fx %9.2fx %9.2fx %8s\n", label,
+		   times[0] * 1e3, times[1] * 1e3, times[2] * 1e3, times[3] * 1e3, times[4] * 1e3, times[5] * 1e3,
+		   times[6] * 1e3, times[7] * 1e3, times[0] / times[1], times[4] / times[5], times[6] / times[7],
+		   cmp_correct && sort_correct ? "yes" : "NO");
+
+	    avxmpfr_array_clear(&a);
+	    avxmpfr_array_clear(&b);
+	    avxmpfr_array_clear(&r);
+	}
+
+	for (uint64_t i = 0; i < count; i++)
+	    mpfr_clears(x[i], y[i], sorted[i], NULL);
+    }
+
+    if (all_correct)
+	printf("\n\x1b[32mResults are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mResults are unequal\x1b[0m\n\n");
+
+    free(x); free(y); free(sorted); free(order1); free(order2);
+    return 0;
+}
@@ -0,0 +1,252 @@
+/*
+    Test file to compare parse + add + print throughput of the batched string conversion against mpfr.
+
+    The mpfr path is mpfr_set_str() -> avxmpfr_add() -> mpfr_sprintf() for every number.
+    The avxmpfr path is avxmpfr_set_str_vec() -> avxmpfr_add() -> avxmpfr_get_str_vec() over the whole batch.
+
+    It also checks that every parsed value and every printed string matches what mpfr produces. Then, in base 10 and
+    base 2 and in every rounding mode, strings longer than the precision holds are parsed against mpfr_set_str() and
+    printed to fewer digits than the precision holds against mpfr_get_str().
+*/
+
+#include "avxmpfr_utilities.h"
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fill str with a random decimal number of the given number of significant digits
+void assign_decimal(char* str, int digits)
+{
+    int pointLocation = rand() % digits;
+    char* p = str;
+
+    for (int i = 0; i < digits; i++)
+    {
+	if (i == pointLocation)
+	    *p++ = '.';
+	*p++ = '0' + (rand() % 10);
+    }
+
+    // Random exponent so that alignment has some work to do
+    sprintf(p, "e%d", (rand() % 41) - 20);
+}
+
+// Fill str with a random signed number of the given number of significant digits in base 10 or 2
+void assign_digits(char* str, int digits, int base)
+{
+    char* p = str;
+    if (rand() % 2)
+	*p++ = '-';
+
+    // A leading non zero digit keeps every number at full length
+    int pointLocation = rand() % digits;
+    for (int i = 0; i < digits; i++)
+    {
+	if (i == pointLocation)
+	    *p++ = '.';
+	*p++ = (i == 0) ? '1' + rand() % (base - 1) : '0' + rand() % base;
+    }
+
+    if (base == 2)
+	sprintf(p, "p%d", (rand() % 161) - 80);
+    else
+	sprintf(p, "e%d", (rand() % 41) - 20);
+}
+
+// Parse and print a batch in base 10 or 2 with every rounding mode, returns the number of mismatches with mpfr
+size_t check_rounding(uint16_t PRECISION, int base)
+{
+    const mpfr_rnd_t modes[5] = {MPFR_RNDN, MPFR_RNDZ, MPFR_RNDU, MPFR_RNDD, MPFR_RNDA};
+    const size_t count = 1<<10;
+    const int digits = (base == 2) ? PRECISION + 40 : PRECISION * 30103 / 100000 + 12;	// More than the precision holds
+    const size_t out_digits = (base == 2) ? PRECISION / 3 : PRECISION / 5;		// Fewer than the precision holds
+    size_t mismatches = 0;
+
+    char** str = malloc(count * sizeof(char*));
+    char** out = malloc(count * sizeof(char*));
+    char* expected_str = malloc(avxmpfr_get_str_size(out_digits));
+    mpfr_t* parsed = malloc(count * sizeof(mpfr_t));
+    mpfr_t expected;
+    mpfr_init2(expected, PRECISION);
+    for (size_t i = 0; i < count; i++)
+    {
+	str[i] = malloc(digits + 16);
+	out[i] = malloc(avxmpfr_get_str_size(out_digits));
+	assign_digits(str[i], digits, base);
+	mpfr_init2(parsed[i], PRECISION);
+    }
+
+    for (int m = 0; m < 5; m++)
+    {
+	avxmpfr_set_str_vec(parsed, (const char* const*) str, count, base, modes[m]);
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpfr_set_str(expected, str[i], base, modes[m]);
+	    mismatches += !mpfr_equal_p(parsed[i], expected);
+	}
+
+	// mpfr_get_str() gives the digits and the exponent of 0.ddd, avxmpfr_get_str_vec() writes d.ddd
+	avxmpfr_get_str_vec(out, out_digits, base, parsed, count, modes[m]);
+	for (size_t i = 0; i < count; i++)
+	{
+	    mpfr_exp_t exponent;
+	    char* digits_str = mpfr_get_str(NULL, &exponent, base, out_digits, parsed[i], modes[m]);
+	    const char* d = digits_str;
+	    char* q = expected_str;
+	    if (*d == '-')
+		*q++ = *d++;
+	    *q++ = *d++;
+	    if (*d != '\0')
+		*q++ = '.';
+	    strcpy(q, d);
+	    q += strlen(d);
+	    sprintf(q, (base == 2) ? "p%+ld" : "e%+03ld", (long) exponent - 1);
+	    mpfr_free_str(digits_str);
+	    mismatches += (strcmp(out[i], expected_str) != 0);
+	}
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_clear(parsed[i]);
+	free(str[i]);
+	free(out[i]);
+    }
+    mpfr_clear(expected);
+    free(parsed); free(str); free(out); free(expected_str);
+    return mismatches;
+}
+
+int main()
+{
+    setbuf(stdout, NULL);  // Disable buffering for stdout
+    srand(time(NULL));
+
+    // Initialise some variables
+    uint16_t PRECISION = PRECISION_256;	// Set the precision you want to compare
+    const size_t count = 1<<14;		// Numbers per batch
+    const int digits = (PRECISION == PRECISION_256) ? 76 : 152;	// Enough digits to fill the mantissa
+    const size_t out_digits = digits;
+    clock_t start, end;
+    double mpfr_time = 0, avxmpfr_time = 0;
+    uint64_t parse_matches = 0, print_matches = 0;
+
+    // Input strings
+    char** first_str = malloc(count * sizeof(char*));
+    char** second_str = malloc(count * sizeof(char*));
+    for (size_t i = 0; i < count; i++)
+    {
+	first_str[i] = malloc(digits + 16);
+	second_str[i] = malloc(digits + 16);
+	assign_decimal(first_str[i], digits);
+	assign_decimal(second_str[i], digits);
+    }
+
+    // Output strings
+    char** mpfr_out = malloc(count * sizeof(char*));
+    char** avxmpfr_out = malloc(count * sizeof(char*));
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_out[i] = malloc(avxmpfr_get_str_size(out_digits));
+	avxmpfr_out[i] = malloc(avxmpfr_get_str_size(out_digits));
+    }
+
+    // Initialise the mpfr_t numbers
+    mpfr_t* number1 = malloc(count * sizeof(mpfr_t));
+    mpfr_t* number2 = malloc(count * sizeof(mpfr_t));
+    mpfr_t* check1 = malloc(count * sizeof(mpfr_t));
+    mpfr_t* check2 = malloc(count * sizeof(mpfr_t));
+    mpfr_t* result = malloc(count * sizeof(mpfr_t));
+    for (size_t i = 0; i < count; i++)
+	mpfr_inits2(PRECISION, number1[i], number2[i], check1[i], check2[i], result[i], NULL);
+
+
+    /* mpfr path */
+    start = clock();
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_set_str(number1[i], first_str[i], 10, MPFR_RNDN);
+	mpfr_set_str(number2[i], second_str[i], 10, MPFR_RNDN);
+    }
+    end = clock();
+    mpfr_time += (double) (end - start) / CLOCKS_PER_SEC;
+
+    // Copies for the parsing check, untimed, made before the add pads the operands in place
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_set(check1[i], number1[i], MPFR_RNDN);
+	mpfr_set(check2[i], number2[i], MPFR_RNDN);
+    }
+
+    start = clock();
+    for (size_t i = 0; i < count; i++)
+    {
+	if (PRECISION == PRECISION_256)
+	    avxmpfr_add(result[i], number1[i], number2[i], MPFR_RNDF, PRECISION_256);
+	else
+	    avxmpfr_add_512(result[i], number1[i], number2[i], MPFR_RNDF, PRECISION_512);
+
+	mpfr_sprintf(mpfr_out[i], "%.*Re", (int) out_digits - 1, result[i]);
+    }
+    end = clock();
+    mpfr_time += (double) (end - start) / CLOCKS_PER_SEC;
+
+
+    /* avxmpfr path */
+    start = clock();
+    avxmpfr_set_str_vec(number1, (const char* const*) first_str, count, 10, MPFR_RNDN);
+    avxmpfr_set_str_vec(number2, (const char* const*) second_str, count, 10, MPFR_RNDN);
+    end = clock();
+    avxmpfr_time += (double) (end - start) / CLOCKS_PER_SEC;
+
+    // Check the parsing before the add pads the operands in place
+    for (size_t i = 0; i < count; i++)
+	parse_matches += mpfr_equal_p(number1[i], check1[i]) + mpfr_equal_p(number2[i], check2[i]);
+
+    start = clock();
+    for (size_t i = 0; i < count; i++)
+    {
+	if (PRECISION == PRECISION_256)
+	    avxmpfr_add(result[i], number1[i], number2[i], MPFR_RNDF, PRECISION_256);
+	else
+	    avxmpfr_add_512(result[i], number1[i], number2[i], MPFR_RNDF, PRECISION_512);
+    }
+    avxmpfr_get_str_vec(avxmpfr_out, out_digits, 10, result, count, MPFR_RNDN);
+    end = clock();
+    avxmpfr_time += (double) (end - start) / CLOCKS_PER_SEC;
+
+    for (size_t i = 0; i < count; i++)
+	print_matches += (strcmp(mpfr_out[i], avxmpfr_out[i]) == 0);
+
+
+    size_t rounding_mismatches = 0;
+    for (int p = 0; p < 2; p++)
+	for (int base = 2; base <= 10; base += 8)
+	    rounding_mismatches += check_rounding(p ? PRECISION_512 : PRECISION_256, base);
+
+    printf("\nParsed values matching mpfr_set_str() : %ld / %ld", parse_matches, 2 * count);
+    printf("\nPrinted strings matching mpfr_sprintf() : %ld / %ld", print_matches, count);
+    printf("\nBase 2 and 10 in every rounding mode, mismatches with mpfr_set_str() / mpfr_get_str() : %zu\n", rounding_mismatches);
+    if (parse_matches == 2 * count && print_matches == count && rounding_mismatches == 0)
+	printf("\n\x1b[32mConversions are equal\x1b[0m\n\n");
+    else
+	printf("\n\x1b[31mConversions are unequal\x1b[0m\n\n");
+
+    printf("Time taken for mpfr_set_str() -> avxmpfr_add() -> mpfr_sprintf():\t\t\t %f seconds\n", mpfr_time);
+    printf("Time taken for avxmpfr_set_str_vec() -> avxmpfr_add() -> avxmpfr_get_str_vec():\t %f seconds\n", avxmpfr_time);
+    printf("\nThroughput mpfr path:\t\t %f Mnumbers/s\n", count / mpfr_time / 1e6);
+    printf("Throughput avxmpfr path:\t %f Mnumbers/s\n", count / avxmpfr_time / 1e6);
+
+    for (size_t i = 0; i < count; i++)
+    {
+	mpfr_clears(number1[i], number2[i], check1[i], check2[i], result[i], NULL);
+	free(first_str[i]);
+	free(second_str[i]);
+	free(mpfr_out[i]);
+	free(avxmpfr_out[i]);
+    }
+    free(number1); free(number2); free(check1); free(check2); free(result);
+    free(first_str); free(second_str); free(mpfr_out); free(avxmpfr_out);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// comparison_utilities.h
+
+/*
+    Timing and random operands shared by the comparison_*.c test programs.
+
+    assign_random() fills a value with random limbs and an exponent in [low, high), its flags picking the signs and
+    the special values each test wants. assign_random_r() does the same from a rand_r() seed, for tests that draw
+    values from several threads.
+*/
+
+#ifndef COMPARISON_UTILITIES_H
+#define COMPARISON_UTILITIES_H
+
+#include "avxmpfr_utilities.h"
+#include <time.h>
+#include <stdlib.h>
+
+// Flags of assign_random(), the values are positive without any
+#define RANDOM_SIGNED 1		// Either sign
+#define RANDOM_RARELY_NEGATIVE 2	// Negative one time in 64
+#define RANDOM_ZEROS 4			// +0 one time in 64
+#define RANDOM_SIGNED_ZEROS 8		// With RANDOM_ZEROS, -0 half of those times
+#define RANDOM_RUNS 16			// A limb of all ones or all zeros one time in 4, making carries and ties likelier
+
+// Wall clock time in seconds, clock() would miss the time spent waiting on I/O and other threads
+static inline double wall_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// rand_r(seed), or rand() without a seed
+static inline int random_int(unsigned *seed)
+{
+    return seed ? rand_r(seed) : rand();
+}
+
+// Assign a random normalised value with an exponent in [low, high), drawn from seed, see the flags above
+static inline void assign_random_r(mpfr_ptr number, int low, int high, int flags, unsigned *seed)
+{
+    mp_size_t limbs = (mpfr_get_prec(number) + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    for (mp_size_t i = 0; i < limbs; i++)
+	number->_mpfr_d[i] = ((uint64_t) random_int(seed) << 42) ^ ((uint64_t) random_int(seed) << 21)
+			     ^ (uint64_t) random_int(seed);
+
+    if ((flags & RANDOM_RUNS) && random_int(seed) % 4 == 0)
+	number->_mpfr_d[random_int(seed) % limbs] = random_int(seed) % 2 ? ~(mp_limb_t) 0 : 0;
+
+    // Clear the bits below the precision and set the leading bit
+    number->_mpfr_d[0] &= ~((((mp_limb_t) 1) << (limbs * GMP_NUMB_BITS - mpfr_get_prec(number))) - 1);
+    number->_mpfr_d[limbs - 1] |= ((mp_limb_t) 1) << (GMP_NUMB_BITS - 1);
+    if (flags & RANDOM_SIGNED)
+	number->_mpfr_sign = random_int(seed) % 2 ? -1 : 1;
+    else if (flags & RANDOM_RARELY_NEGATIVE)
+	number->_mpfr_sign = random_int(seed) % 64 == 0 ? -1 : 1;
+    else
+	number->_mpfr_sign = 1;
+    number->_mpfr_exp = low + random_int(seed) % (high - low);
+
+    if ((flags & RANDOM_ZEROS) && random_int(seed) % 64 == 0)
+	mpfr_set_zero(number, (flags & RANDOM_SIGNED_ZEROS) && random_int(seed) % 2 ? -1 : 1);
+}
+
+// Assign a random normalised value with an exponent in [low, high), drawn from rand()
+static inline void assign_random(mpfr_ptr number, int low, int high, int flags)
+{
+    assign_random_r(number, low, high, flags, NULL);
+}
+
+#endif
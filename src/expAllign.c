@@ -26,6 +26,7 @@ mpfr_exp_t avxmpfr_exp_allign(mpfr_t firstNum, mpfr_t secondNum, const uint16_t
     // Reduce some function calls by grabbing the exponents early
     mpfr_exp_t firstExp = (firstNum)->_mpfr_exp;
     mpfr_exp_t secondExp = (secondNum)->_mpfr_exp;
+    AVXMPFR_COUNT_GAP(firstExp > secondExp ? firstExp - secondExp : secondExp - firstExp);
 
     // Check if exponents are already alligned
     if (firstExp == secondExp)
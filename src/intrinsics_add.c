@@ -32,8 +32,10 @@ __m256i avx_add (const __m256i_u a, const __m256i_u b, mpfr_exp_t* exponent)
     __m256i_u carry = b;
 
     char normalise = 0;
+    AVXMPFR_STATS_ONLY(int carry_iterations = 0;)
     while (!is_all_zeros(carry))
     {
+	AVXMPFR_STATS_ONLY(carry_iterations++;)
 	// Add code here to test if MSB of most significant lane is currently 1
 	// If it is, you know there has been a carry over in previous iterations
 	// You can run the normalisation if this is the case	
@@ -76,9 +78,12 @@ __m256i avx_add (const __m256i_u a, const __m256i_u b, mpfr_exp_t* exponent)
     }
 
 
+    AVXMPFR_COUNT_CARRY(carry_iterations);
+
     // Normalise the result with truncation.
     if (normalise)
     {
+	AVXMPFR_TIMER_START(normalise_timer);
 //	printf("\n\n\n had to normALISE\n\n");
 //    printf("NOrmalised\n");
         // Extract bits to be shifted right across lanes.
@@ -119,6 +124,8 @@ __m256i avx_add (const __m256i_u a, const __m256i_u b, mpfr_exp_t* exponent)
 //					result[1],
 //					result[2],
 //					result[3]);
+	AVXMPFR_COUNT(normalisations, 1);
+	AVXMPFR_TIMER_STOP(normalise_timer, AVXMPFR_STAGE_NORMALISE);
    } // Normalisation
 
     return result;
@@ -21,8 +21,10 @@ __m512i avx_add_512i (const __m512i_u a, const __m512i_u b, mpfr_exp_t* exponent
 	__m512i carry = b;
 
     char normalise = 0;
+    AVXMPFR_STATS_ONLY(int carry_iterations = 0;)
     while (!is_all_zeros_512i(carry))
     {
+	AVXMPFR_STATS_ONLY(carry_iterations++;)
 	// Add code here to test if MSB of most significant lane is currently 1
 	// If it is, you know there has been a carry over in previous iterations
 	// You can run the normalisation if this is the case		
@@ -66,9 +68,12 @@ __m512i avx_add_512i (const __m512i_u a, const __m512i_u b, mpfr_exp_t* exponent
     }
 
 
+    AVXMPFR_COUNT_CARRY(carry_iterations);
+
     // Normalise the result with truncation.
     if (normalise)
     {
+	AVXMPFR_TIMER_START(normalise_timer);
 //    printf("NOrmalised\n");
         // Extract bits to be shifted right across lanes.
         const __m512i_u last_bit_mask = _mm512_set1_epi64(0x0000000000000001);
@@ -112,6 +117,8 @@ __m512i avx_add_512i (const __m512i_u a, const __m512i_u b, mpfr_exp_t* exponent
 //					result[1],
 //					result[2],
 //					result[3]);
+	AVXMPFR_COUNT(normalisations, 1);
+	AVXMPFR_TIMER_STOP(normalise_timer, AVXMPFR_STAGE_NORMALISE);
    } // Normalisation
 
     return result;